@@ -1,19 +1,110 @@
+#include <ctype.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include "ast.h"
 #include "common.h"
 #include "c_type.h"
+#include "parse.h"
+
+bool
+declaration_specifiers_n::has_specifier(specifier_t specifier) const
+{
+  for (auto const& decl_spec : this->get_list()) {
+    if (decl_spec->get_declaration_specifier() == specifier) {
+      return true;
+    }
+  }
+  return false;
+}
+
+attribute_n const*
+declaration_specifiers_n::get_attribute(string const& name) const
+{
+  for (auto const& decl_spec : this->get_list()) {
+    if (decl_spec->get_declaration_specifier() != specifier_t::ATTRIBUTE) {
+      continue;
+    }
+    for (auto const& attribute : static_cast<attribute_specifier_n const*>(decl_spec)->get_attributes()) {
+      if (attribute->get_name() == name) {
+        return attribute;
+      }
+    }
+  }
+  return nullptr;
+}
+
+void
+attribute_n::add_argument(char* s)
+{
+  string str(s);
+  assert(str.size() >= 2 && str.front() == '"' && str.back() == '"');
+  this->m_arguments.push_back(str.substr(1, str.size() - 2));
+}
+
+// Reason c_type cannot be made _Atomic, empty if it can. Only the types
+// every target accesses lock-free are taken, which leaves long double out.
+static string
+atomic_type_error(c_type_t const* c_type)
+{
+  if (c_type->is_function() || c_type->is_void()) {
+    return "_Atomic cannot be applied to " + c_type->c_type_to_string() + "type";
+  }
+  if (c_type->get_base_type() == c_type_t::LONG_DOUBLE) {
+    return "_Atomic long double is not supported";
+  }
+  return "";
+}
 
-c_type_t*
-declaration_specifiers_n::declaration_specifiers_get_c_type() const
+c_type_t const*
+declaration_specifiers_n::declaration_specifiers_get_c_type(string* error) const
 {
+  auto fail = [&](string const& msg) -> c_type_t const* {
+    if (error != nullptr) {
+      *error = msg;
+    }
+    return nullptr;
+  };
   vector<declaration_specifier_n*> decl_spec_v = this->get_list();
   c_type_t::base_type_t base_type = c_type_t::NO_TYPE;
   size_t num_long = 0;
   bool is_const = false;
+  bool is_volatile = false;
+  bool is_atomic = false;
+  // the type _Atomic(type-name) names
+  c_type_t const* atomic_type = nullptr;
   bool is_signed = false;
   bool is_unsigned = false;
+  size_t num_storage_class = 0;
+  bool is_thread_local = false;
+  // _Thread_local goes along with static or extern, the others stand alone
+  bool is_static_or_extern = false;
   for (auto const& decl_spec : decl_spec_v) {
+    // storage class and function specifiers are not part of the type
+    if (decl_spec->is_storage_class_specifier()) {
+      specifier_t storage_class = decl_spec->get_declaration_specifier();
+      if (storage_class == specifier_t::THREAD_LOCAL) {
+        if (is_thread_local) {
+          return fail("duplicate _Thread_local");
+        }
+        is_thread_local = true;
+      }
+      else if (storage_class == specifier_t::STATIC || storage_class == specifier_t::EXTERN) {
+        is_static_or_extern = true;
+      }
+      if (++num_storage_class > 1 && (num_storage_class > 2 || !is_thread_local || !is_static_or_extern)) {
+        return fail("multiple storage classes in declaration specifiers");
+      }
+      continue;
+    }
+    if (decl_spec->is_function_specifier() ||
+        decl_spec->get_declaration_specifier() == specifier_t::ATTRIBUTE) {
+      continue;
+    }
     if (decl_spec->is_base_type_specifier() && base_type != c_type_t::NO_TYPE) {
-      return nullptr;
+      return fail("two or more data types in declaration specifiers");
     }
     switch (decl_spec->get_declaration_specifier()) {
       case specifier_t::VOID: {
@@ -34,8 +125,7 @@ declaration_specifiers_n::declaration_specifiers_get_c_type() const
       }
       case specifier_t::LONG: {
         if (num_long >= 2) {
-          cout << "More than 2 \"long\" specifiers" << endl;
-          return nullptr;
+          return fail("more than 2 \"long\" specifiers");
         }
         num_long++;
         break;
@@ -60,12 +150,47 @@ declaration_specifiers_n::declaration_specifiers_get_c_type() const
         is_const = true;
         break;
       }
+      case specifier_t::VOLATILE: {
+        is_volatile = true;
+        break;
+      }
+      case specifier_t::RESTRICT: {
+        return fail("restrict requires a pointer type");
+      }
+      case specifier_t::ATOMIC: {
+        is_atomic = true;
+        break;
+      }
+      case specifier_t::ATOMIC_TYPE: {
+        if (atomic_type != nullptr) {
+          return fail("two or more data types in declaration specifiers");
+        }
+        type_name_n const* type_name = static_cast<atomic_type_specifier_n const*>(decl_spec)->get_type_name();
+        atomic_type = type_name->get_c_type(error);
+        if (atomic_type == nullptr) {
+          return nullptr;
+        }
+        if (atomic_type->is_qualified()) {
+          return fail("_Atomic cannot be applied to qualified type " + atomic_type->c_type_to_string());
+        }
+        string atomic_error = atomic_type_error(atomic_type);
+        if (!atomic_error.empty()) {
+          return fail(atomic_error);
+        }
+        break;
+      }
       default: {
         // Ideally this should only handle start and end specifer markers
         NOT_REACHED();
       }
     }
   }
+  if (atomic_type != nullptr) {
+    if (base_type != c_type_t::NO_TYPE || num_long > 0 || is_signed || is_unsigned) {
+      return fail("two or more data types in declaration specifiers");
+    }
+    return c_type_t::mk_qualified(atomic_type, is_const, is_volatile, false, true);
+  }
   if (num_long > 0) {
     if (base_type == c_type_t::NO_TYPE) {
       base_type = (c_type_t::base_type_t)((int)c_type_t::INT + num_long);
@@ -77,23 +202,17 @@ declaration_specifiers_n::declaration_specifiers_get_c_type() const
       base_type = c_type_t::LONG_DOUBLE;
     }
     else if (num_long == 1) {
-      cout << "long " << c_type_t::base_type_to_string(base_type)
-           << "is not a valid c type" << endl;
-      return nullptr;
+      return fail("long " + c_type_t::base_type_to_string(base_type) + " is not a valid c type");
     }
     else if (num_long == 2) {
-      cout << "long long " << c_type_t::base_type_to_string(base_type)
-           << "is not a valid c type" << endl;
-      return nullptr;
+      return fail("long long " + c_type_t::base_type_to_string(base_type) + " is not a valid c type");
     }
     else {
-      cout << __FUNCTION__ << "unknown error in getting c type" << endl;
-      exit(1);
+      NOT_REACHED();
     }
   }
   if (is_signed && is_unsigned) {
-    cout << "signed and unsigned keywords appearing together" << endl;
-    return nullptr;
+    return fail("signed and unsigned keywords appearing together");
   }
   if (is_signed && base_type == c_type_t::NO_TYPE) {
     base_type = c_type_t::INT;
@@ -102,25 +221,37 @@ declaration_specifiers_n::declaration_specifiers_get_c_type() const
     base_type = c_type_t::INT;
   }
   if (base_type == c_type_t::NO_TYPE) {
-    cout << "base type not found using declaration specifiers" << endl;
-    return nullptr;
+    return fail("base type not found using declaration specifiers");
   }
   if ((is_signed || is_unsigned) &&
       !c_type_t::base_type_can_have_sign_keywords(base_type)) {
-    cout << c_type_t::base_type_to_string(base_type) << " does not take sign keywords" << endl;
-    return nullptr;
+    return fail(c_type_t::base_type_to_string(base_type) + " does not take sign keywords");
   }
-  return new c_type_t(base_type, is_const, is_signed, is_unsigned);
+  c_type_t const* c_type = c_type_t::mk_base_type(base_type, is_const, is_signed, is_unsigned);
+  if (is_atomic) {
+    string atomic_error = atomic_type_error(c_type);
+    if (!atomic_error.empty()) {
+      return fail(atomic_error);
+    }
+  }
+  return c_type_t::mk_qualified(c_type, false, is_volatile, false, is_atomic);
+}
+
+c_type_t const*
+type_name_n::get_c_type(string* error) const
+{
+  c_type_t const* c_type = this->m_specifier_qualifier_list->declaration_specifiers_get_c_type(error);
+  if (c_type != nullptr && this->m_pointer != nullptr) {
+    c_type = this->m_pointer->get_c_type(c_type);
+  }
+  return c_type;
 }
 
 declaration_n::declaration_n(declaration_specifiers_n* declaration_specifiers,
                              init_declarator_list_n* init_declarator_list) :
   m_declaration_specifiers(declaration_specifiers),
   m_init_declarator_list(init_declarator_list)
-{
-  c_type_t* c_type = this->m_declaration_specifiers->declaration_specifiers_get_c_type();
-  cout << c_type->c_type_to_string() << endl;
-}
+{ }
 
 function_definition_n::function_definition_n(
     declaration_specifiers_n* declaration_specifiers,
@@ -129,9 +260,135 @@ function_definition_n::function_definition_n(
   m_declaration_specifiers(declaration_specifiers),
   m_declarator(declarator),
   m_compound_statement(compound_statement)
+{ }
+
+function_definition_n::function_definition_n(
+    declaration_specifiers_n* declaration_specifiers,
+    declarator_n* declarator,
+    lazy_body_t* lazy_body) :
+  m_declaration_specifiers(declaration_specifiers),
+  m_declarator(declarator),
+  m_compound_statement(nullptr),
+  m_lazy_body(lazy_body)
+{ }
+
+compound_statement_n const*
+function_definition_n::get_compound_statement() const
 {
-  c_type_t* c_type = this->m_declaration_specifiers->declaration_specifiers_get_c_type();
-  cout << c_type->c_type_to_string() << endl;
+  call_once(this->m_body_parsed, [this]() {
+    if (this->m_lazy_body) {
+      // kept for sema, which reports it in the thread with the diagnostics
+      auto on_syntax_error = [this](string const& msg, source_range_t const& range) {
+        if (this->m_body_error.empty()) {
+          this->m_body_error = msg;
+          this->m_body_error_range = range;
+        }
+      };
+      this->m_compound_statement = parse_function_body(*this->m_lazy_body, on_syntax_error);
+      this->m_lazy_body = nullptr;
+    }
+  });
+  return this->m_compound_statement;
+}
+
+bool
+function_definition_n::get_body_syntax_error(string& msg, source_range_t& range) const
+{
+  if (this->m_body_error.empty()) {
+    return false;
+  }
+  msg = this->m_body_error;
+  range = this->m_body_error_range;
+  return true;
+}
+
+void
+function_definition_n::parse_bodies(vector<function_definition_n const*> const& functions,
+                                    unsigned num_threads,
+                                    vector<node_arena_t*> const& arenas)
+{
+  node_arena_t* outer_arena = node_arena_t::get_thread_arena();
+  if (num_threads <= 1 || functions.size() <= 1) {
+    for (size_t i = 0;i < functions.size();i++) {
+      node_arena_t::set_thread_arena(arenas.empty() ? outer_arena : arenas[i]);
+      functions[i]->get_compound_statement();
+    }
+    node_arena_t::set_thread_arena(outer_arena);
+    return;
+  }
+  // the functions are handed out one at a time, bodies vary a lot in size
+  atomic<size_t> next(0);
+  vector<node_counts_t> counts(min<size_t>(num_threads, functions.size()));
+  vector<thread> threads;
+  for (size_t i = 0;i < counts.size();i++) {
+    threads.emplace_back([&, i]() {
+      node_counts_t::set_thread_counts(&counts[i]);
+      for (size_t j = next++;j < functions.size();j = next++) {
+        // an arena is not shared between threads
+        node_arena_t::set_thread_arena(arenas.empty() ? nullptr : arenas[j]);
+        functions[j]->get_compound_statement();
+      }
+      node_arena_t::set_thread_arena(nullptr);
+      node_counts_t::set_thread_counts(nullptr);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto const& c : counts) {
+    c.add_to_stats();
+  }
+}
+
+static thread_local node_counts_t* thread_node_counts = nullptr;
+
+node_counts_t*
+node_counts_t::get_thread_counts()
+{
+  return thread_node_counts;
+}
+
+void
+node_counts_t::set_thread_counts(node_counts_t* counts)
+{
+  thread_node_counts = counts;
+}
+
+static thread_local node_arena_t* thread_node_arena = nullptr;
+
+node_arena_t*
+node_arena_t::get_thread_arena()
+{
+  return thread_node_arena;
+}
+
+void
+node_arena_t::set_thread_arena(node_arena_t* arena)
+{
+  thread_node_arena = arena;
+}
+
+void
+node_arena_t::release()
+{
+  STATS_ADD("parse.nodes_released", this->m_nodes.size());
+  for (auto const& node : this->m_nodes) {
+    delete node;
+  }
+  // the capacity is kept for the next declaration
+  this->m_nodes.clear();
+}
+
+void
+node_counts_t::add_to_stats() const
+{
+  uint64_t num_nodes = 0;
+  for (auto const& count : this->m_counts) {
+    *stats_t::get_counter("parse.nodes." + stats_t::demangle(count.first.name())) += count.second;
+    num_nodes += count.second;
+  }
+  *stats_t::get_counter("parse.nodes") += num_nodes;
+  *stats_t::get_counter("parse.node_bytes") += this->m_num_bytes;
 }
 
 parameter_declaration_n::parameter_declaration_n(
@@ -139,8 +396,524 @@ parameter_declaration_n::parameter_declaration_n(
     declarator_n* declarator) :
   m_declaration_specifiers(declaration_specifiers),
   m_declarator(declarator)
+{ }
+
+
+bool
+expression_n::is_builtin_expect_call() const
+{
+  return this->get_kind() == OP_FUNC_CALL && this->get_child(0)->is_var() &&
+         this->get_child(0)->get_identifier()->get_identifier_name() == "__builtin_expect" &&
+         this->get_child(1)->get_size() == 2;
+}
+
+atomic_builtin_t
+expression_n::get_atomic_builtin(bool& is_explicit) const
+{
+  // the fences only come with a memory order
+  static map<string, pair<atomic_builtin_t, bool>> const builtins = {
+    {"atomic_init", {atomic_builtin_t::INIT, false}},
+    {"atomic_load", {atomic_builtin_t::LOAD, false}},
+    {"atomic_load_explicit", {atomic_builtin_t::LOAD, true}},
+    {"atomic_store", {atomic_builtin_t::STORE, false}},
+    {"atomic_store_explicit", {atomic_builtin_t::STORE, true}},
+    {"atomic_exchange", {atomic_builtin_t::EXCHANGE, false}},
+    {"atomic_exchange_explicit", {atomic_builtin_t::EXCHANGE, true}},
+    {"atomic_compare_exchange_strong", {atomic_builtin_t::COMPARE_EXCHANGE_STRONG, false}},
+    {"atomic_compare_exchange_strong_explicit", {atomic_builtin_t::COMPARE_EXCHANGE_STRONG, true}},
+    {"atomic_compare_exchange_weak", {atomic_builtin_t::COMPARE_EXCHANGE_WEAK, false}},
+    {"atomic_compare_exchange_weak_explicit", {atomic_builtin_t::COMPARE_EXCHANGE_WEAK, true}},
+    {"atomic_fetch_add", {atomic_builtin_t::FETCH_ADD, false}},
+    {"atomic_fetch_add_explicit", {atomic_builtin_t::FETCH_ADD, true}},
+    {"atomic_fetch_sub", {atomic_builtin_t::FETCH_SUB, false}},
+    {"atomic_fetch_sub_explicit", {atomic_builtin_t::FETCH_SUB, true}},
+    {"atomic_fetch_or", {atomic_builtin_t::FETCH_OR, false}},
+    {"atomic_fetch_or_explicit", {atomic_builtin_t::FETCH_OR, true}},
+    {"atomic_fetch_xor", {atomic_builtin_t::FETCH_XOR, false}},
+    {"atomic_fetch_xor_explicit", {atomic_builtin_t::FETCH_XOR, true}},
+    {"atomic_fetch_and", {atomic_builtin_t::FETCH_AND, false}},
+    {"atomic_fetch_and_explicit", {atomic_builtin_t::FETCH_AND, true}},
+    {"atomic_thread_fence", {atomic_builtin_t::THREAD_FENCE, true}},
+    {"atomic_signal_fence", {atomic_builtin_t::SIGNAL_FENCE, true}},
+    {"atomic_is_lock_free", {atomic_builtin_t::IS_LOCK_FREE, false}},
+  };
+  is_explicit = false;
+  if (this->get_kind() != OP_FUNC_CALL || !this->get_child(0)->is_var()) {
+    return atomic_builtin_t::NONE;
+  }
+  auto builtin = builtins.find(this->get_child(0)->get_identifier()->get_identifier_name());
+  if (builtin == builtins.end()) {
+    return atomic_builtin_t::NONE;
+  }
+  is_explicit = builtin->second.second;
+  return builtin->second.first;
+}
+
+bool
+get_builtin_constant(string const& name, int& value)
 {
-  c_type_t* c_type = this->m_declaration_specifiers->declaration_specifiers_get_c_type();
-  cout << c_type->c_type_to_string() << endl;
+  // every atomic type cc takes is always lock-free, hence the 2s
+  static map<string, int> const constants = {
+    {"memory_order_relaxed", (int)memory_order_t::RELAXED},
+    {"memory_order_consume", (int)memory_order_t::CONSUME},
+    {"memory_order_acquire", (int)memory_order_t::ACQUIRE},
+    {"memory_order_release", (int)memory_order_t::RELEASE},
+    {"memory_order_acq_rel", (int)memory_order_t::ACQ_REL},
+    {"memory_order_seq_cst", (int)memory_order_t::SEQ_CST},
+    {"ATOMIC_BOOL_LOCK_FREE", 2},
+    {"ATOMIC_CHAR_LOCK_FREE", 2},
+    {"ATOMIC_CHAR16_T_LOCK_FREE", 2},
+    {"ATOMIC_CHAR32_T_LOCK_FREE", 2},
+    {"ATOMIC_WCHAR_T_LOCK_FREE", 2},
+    {"ATOMIC_SHORT_LOCK_FREE", 2},
+    {"ATOMIC_INT_LOCK_FREE", 2},
+    {"ATOMIC_LONG_LOCK_FREE", 2},
+    {"ATOMIC_LLONG_LOCK_FREE", 2},
+    {"ATOMIC_POINTER_LOCK_FREE", 2},
+  };
+  auto constant = constants.find(name);
+  if (constant == constants.end()) {
+    return false;
+  }
+  value = constant->second;
+  return true;
 }
 
+static char
+decode_escape_sequence(string const& s, size_t& i)
+{
+  assert(s[i] == '\\');
+  i++;
+  char c = s[i++];
+  switch (c) {
+    case 'a': return '\a';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 't': return '\t';
+    case 'v': return '\v';
+    case 'x': {
+      size_t start = i;
+      while (i < s.size() && isxdigit(s[i])) {
+        i++;
+      }
+      return (char)stoul(s.substr(start, i - start), nullptr, 16);
+    }
+    default: {
+      if (c >= '0' && c <= '7') {
+        size_t start = i - 1;
+        while (i < s.size() && i - start < 3 && s[i] >= '0' && s[i] <= '7') {
+          i++;
+        }
+        return (char)stoul(s.substr(start, i - start), nullptr, 8);
+      }
+      // \' \" \? and \\ stand for themselves
+      return c;
+    }
+  }
+}
+
+char
+constant_n::get_char_value() const
+{
+  // optionally prefixed by L, u or U
+  string const& s = this->get_str();
+  size_t i = s.find('\'') + 1;
+  return s[i] == '\\' ? decode_escape_sequence(s, i) : s[i];
+}
+
+unsigned long long
+constant_n::get_integer_value() const
+{
+  string const& s = this->get_str();
+  return stoull(s.substr(0, s.find_first_of("uUlL")), nullptr, 0);
+}
+
+// The raw text of a STRING_LITERAL token may be several adjacent literals
+// separated by whitespace
+bool
+constant_n::get_string_value(string& value) const
+{
+  string const& s = this->get_str();
+  value = "";
+  size_t i = 0;
+  while (i < s.size()) {
+    if (s[i] != '"') {
+      if (s[i] == 'L' || s[i] == 'u' || s[i] == 'U') {
+        if (s.compare(i, 3, "u8\"") != 0) {
+          return false;
+        }
+      }
+      i++;
+      continue;
+    }
+    i++;
+    while (s[i] != '"') {
+      value += s[i] == '\\' ? decode_escape_sequence(s, i) : s[i++];
+    }
+    i++;
+  }
+  return true;
+}
+
+c_type_t const*
+parameter_declaration_n::get_c_type() const
+{
+  c_type_t const* c_type = this->m_declaration_specifiers->declaration_specifiers_get_c_type();
+  if (this->m_declarator) {
+    c_type = this->m_declarator->get_c_type(c_type);
+  }
+  // a parameter declared as a function is adjusted to a pointer to it
+  if (c_type && c_type->is_function()) {
+    return c_type_t::mk_pointer(c_type);
+  }
+  return c_type;
+}
+
+bool
+parameter_declaration_n::is_void_parameter() const
+{
+  return this->m_declarator == nullptr && this->get_c_type()->is_void();
+}
+
+string const&
+declarator_n::get_identifier_name() const
+{
+  return this->get_identifier()->get_identifier_name();
+}
+
+identifier_n const*
+declarator_n::get_identifier() const
+{
+  vector<direct_declarator_item_n*> const& items = this->m_direct_declarator->get_list();
+  assert(!items.empty());
+  return items[0]->get_identifier();
+}
+
+bool
+declarator_n::is_function_declarator() const
+{
+  return this->get_parameter_list() != nullptr;
+}
+
+parameter_list_n const*
+declarator_n::get_parameter_list() const
+{
+  for (auto const& item : this->m_direct_declarator->get_list()) {
+    if (item->get_item_opt() == direct_declarator_item_n::PARAMETER_LIST) {
+      return item->get_parameter_list();
+    }
+  }
+  return nullptr;
+}
+
+c_type_t const*
+pointer_n::get_c_type(c_type_t const* pointee) const
+{
+  c_type_t const* c_type = pointee;
+  for (auto const& qualifiers : this->get_list()) {
+    c_type = c_type_t::mk_pointer(c_type);
+    if (qualifiers) {
+      c_type = c_type_t::mk_qualified(c_type,
+                                      qualifiers->has_specifier(specifier_t::CONST),
+                                      qualifiers->has_specifier(specifier_t::VOLATILE),
+                                      qualifiers->has_specifier(specifier_t::RESTRICT),
+                                      qualifiers->has_specifier(specifier_t::ATOMIC));
+    }
+  }
+  return c_type;
+}
+
+c_type_t const*
+declarator_n::get_c_type(c_type_t const* base_type) const
+{
+  c_type_t const* c_type = base_type;
+  if (this->m_pointer) {
+    c_type = this->m_pointer->get_c_type(c_type);
+  }
+  parameter_list_n const* parameter_list = this->get_parameter_list();
+  if (parameter_list) {
+    vector<c_type_t const*> param_types;
+    vector<parameter_declaration_n*> const& params = parameter_list->get_list();
+    if (!(params.size() == 1 && params[0]->is_void_parameter())) {
+      for (auto const& param : params) {
+        param_types.push_back(param->get_c_type());
+      }
+    }
+    c_type = c_type_t::mk_function(c_type, param_types, parameter_list->get_is_vararg());
+  }
+  return c_type;
+}
+
+// Reads an optional "(<arg>)" following a clause name
+static bool
+parse_pragma_clause_arg(string const& pragma, size_t& pos, string& arg)
+{
+  arg = "";
+  while (pos < pragma.size() && isspace(pragma[pos])) {
+    pos++;
+  }
+  if (pos >= pragma.size() || pragma[pos] != '(') {
+    return true;
+  }
+  size_t end = pragma.find(')', pos);
+  if (end == string::npos) {
+    return false;
+  }
+  arg = pragma.substr(pos + 1, end - pos - 1);
+  arg.erase(0, arg.find_first_not_of(" \t"));
+  arg.erase(arg.find_last_not_of(" \t") + 1);
+  pos = end + 1;
+  return true;
+}
+
+static bool
+parse_positive_count(string const& arg, unsigned& count)
+{
+  if (arg.empty() || arg.find_first_not_of("0123456789") != string::npos) {
+    return false;
+  }
+  count = stoul(arg);
+  return count > 0;
+}
+
+bool
+loop_hints_t::parse_pragma(string const& pragma)
+{
+  size_t pos = pragma.find("loop");
+  assert(pos != string::npos);
+  pos += 4;
+  while (true) {
+    while (pos < pragma.size() && isspace(pragma[pos])) {
+      pos++;
+    }
+    if (pos >= pragma.size()) {
+      return true;
+    }
+    size_t name_end = pos;
+    while (name_end < pragma.size() && (isalnum(pragma[name_end]) || pragma[name_end] == '_')) {
+      name_end++;
+    }
+    string name = pragma.substr(pos, name_end - pos);
+    string arg;
+    pos = name_end;
+    if (name.empty() || !parse_pragma_clause_arg(pragma, pos, arg)) {
+      return false;
+    }
+    if (name == "unroll") {
+      if (arg == "" || arg == "enable") {
+        this->m_unroll = HINT_ENABLE;
+      }
+      else if (arg == "disable") {
+        this->m_unroll = HINT_DISABLE;
+      }
+      else if (arg == "full") {
+        this->m_unroll = HINT_ENABLE;
+        this->m_unroll_full = true;
+      }
+      else if (parse_positive_count(arg, this->m_unroll_count)) {
+        this->m_unroll = this->m_unroll_count == 1 ? HINT_DISABLE : HINT_ENABLE;
+      }
+      else {
+        return false;
+      }
+    }
+    else if (name == "vectorize") {
+      if (arg == "" || arg == "enable") {
+        this->m_vectorize = HINT_ENABLE;
+      }
+      else if (arg == "disable") {
+        this->m_vectorize = HINT_DISABLE;
+      }
+      else if (parse_positive_count(arg, this->m_vectorize_width)) {
+        this->m_vectorize = this->m_vectorize_width == 1 ? HINT_DISABLE : HINT_ENABLE;
+      }
+      else {
+        return false;
+      }
+    }
+    else if (name == "interleave") {
+      if (!parse_positive_count(arg, this->m_interleave_count)) {
+        return false;
+      }
+    }
+    else if (name == "distribute" && arg == "") {
+      this->m_distribute = true;
+    }
+    else {
+      return false;
+    }
+  }
+}
+
+string
+loop_hints_t::to_string() const
+{
+  string ret = "";
+  if (this->m_unroll == HINT_DISABLE) {
+    ret += "unroll(disable) ";
+  }
+  else if (this->m_unroll == HINT_ENABLE) {
+    ret += this->m_unroll_full ? "unroll(full) " :
+           this->m_unroll_count ? "unroll(" + std::to_string(this->m_unroll_count) + ") " :
+           "unroll ";
+  }
+  if (this->m_vectorize == HINT_DISABLE) {
+    ret += "vectorize(disable) ";
+  }
+  else if (this->m_vectorize == HINT_ENABLE) {
+    ret += this->m_vectorize_width ?
+           "vectorize(" + std::to_string(this->m_vectorize_width) + ") " :
+           "vectorize(enable) ";
+  }
+  if (this->m_interleave_count) {
+    ret += "interleave(" + std::to_string(this->m_interleave_count) + ") ";
+  }
+  if (this->m_distribute) {
+    ret += "distribute ";
+  }
+  if (!ret.empty()) {
+    ret.pop_back();
+  }
+  return ret;
+}
+
+// The flags "#pragma cc fp" turns on or off by name, fast being all of them
+static struct
+{
+  char const* name;
+  unsigned flags;
+} const fp_pragma_flags[] = {
+  {"reassoc", fp_pragma_n::FP_REASSOC},
+  {"nnan", fp_pragma_n::FP_NNAN},
+  {"ninf", fp_pragma_n::FP_NINF},
+  {"nsz", fp_pragma_n::FP_NSZ},
+  {"arcp", fp_pragma_n::FP_ARCP},
+  {"afn", fp_pragma_n::FP_AFN},
+  {"fast", fp_pragma_n::FP_ALL},
+};
+
+void
+fp_pragma_n::set_flags(unsigned flags, bool is_enabled)
+{
+  if (is_enabled) {
+    this->m_enabled_flags |= flags;
+    this->m_disabled_flags &= ~flags;
+  }
+  else {
+    this->m_disabled_flags |= flags;
+    this->m_enabled_flags &= ~flags;
+  }
+}
+
+bool
+fp_pragma_n::parse_pragma(string const& pragma)
+{
+  size_t pos = pragma.find("FP_CONTRACT");
+  if (pos != string::npos) {
+    // #pragma STDC FP_CONTRACT ON|OFF|DEFAULT
+    size_t begin = pragma.find_first_not_of(" \t", pos + 11);
+    if (begin == string::npos) {
+      return false;
+    }
+    size_t end = pragma.find_first_of(" \t\r", begin);
+    string state = pragma.substr(begin, end == string::npos ? string::npos : end - begin);
+    if (end != string::npos && pragma.find_first_not_of(" \t\r", end) != string::npos) {
+      return false;
+    }
+    if (state == "ON") {
+      this->m_contract = CONTRACT_ON;
+    }
+    else if (state == "OFF") {
+      this->m_contract = CONTRACT_OFF;
+    }
+    else if (state == "DEFAULT") {
+      this->m_contract = CONTRACT_DEFAULT;
+    }
+    else {
+      return false;
+    }
+    return true;
+  }
+  // #pragma cc fp <clause>(<arg>) ...
+  pos = pragma.find("fp");
+  assert(pos != string::npos);
+  pos += 2;
+  while (true) {
+    while (pos < pragma.size() && isspace(pragma[pos])) {
+      pos++;
+    }
+    if (pos >= pragma.size()) {
+      return true;
+    }
+    size_t name_end = pos;
+    while (name_end < pragma.size() && (isalnum(pragma[name_end]) || pragma[name_end] == '_')) {
+      name_end++;
+    }
+    string name = pragma.substr(pos, name_end - pos);
+    string arg;
+    pos = name_end;
+    if (name.empty() || !parse_pragma_clause_arg(pragma, pos, arg)) {
+      return false;
+    }
+    if (name == "contract") {
+      if (arg == "fast") {
+        this->m_contract = CONTRACT_FAST;
+      }
+      else if (arg == "on") {
+        this->m_contract = CONTRACT_ON;
+      }
+      else if (arg == "off") {
+        this->m_contract = CONTRACT_OFF;
+      }
+      else {
+        return false;
+      }
+      continue;
+    }
+    if (arg != "" && arg != "on" && arg != "off") {
+      return false;
+    }
+    bool is_enabled = arg != "off";
+    bool is_known = false;
+    for (auto const& flag : fp_pragma_flags) {
+      if (name == flag.name) {
+        this->set_flags(flag.flags, is_enabled);
+        is_known = true;
+      }
+    }
+    if (!is_known) {
+      return false;
+    }
+    if (name == "fast") {
+      // -ffast-math also lets any multiplication and addition fuse
+      this->m_contract = is_enabled ? CONTRACT_FAST : CONTRACT_DEFAULT;
+    }
+  }
+}
+
+string
+fp_pragma_n::to_string() const
+{
+  string ret = "";
+  for (auto const& flag : fp_pragma_flags) {
+    if (flag.flags == FP_ALL) {
+      continue;
+    }
+    if (this->m_enabled_flags & flag.flags) {
+      ret += string(flag.name) + "(on) ";
+    }
+    else if (this->m_disabled_flags & flag.flags) {
+      ret += string(flag.name) + "(off) ";
+    }
+  }
+  static char const* const contract_names[] = {"", "default", "off", "on", "fast"};
+  if (this->m_contract != CONTRACT_UNCHANGED) {
+    ret += string("contract(") + contract_names[this->m_contract] + ") ";
+  }
+  if (!ret.empty()) {
+    ret.pop_back();
+  }
+  return ret;
+}
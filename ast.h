@@ -1,15 +1,43 @@
 #pragma once
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <stddef.h>
+#include <stdint.h>
 #include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
 #include <vector>
 
 #include "common.h"
 #include "c_type.h"
+#include "stats.h"
 #include "symbol_table.h"
 
 using namespace std;
 
+namespace llvm {
+class Function;
+class LLVMContext;
+class Module;
+}
+
+class llvm_codegen_t;
+class sema_t;
+class tail_recursion_t;
+struct llvm_codegen_options_t;
+struct llvm_value_t;
+
+// Bytes [begin, end) of the input some source text spans, the parser tracks
+// one for every token and every grammar symbol
+struct source_range_t
+{
+  size_t begin;
+  size_t end;
+};
+
 class ast_n
 {
 public:
@@ -17,6 +45,66 @@ public:
   virtual ~ast_n() { }
 };
 
+// The nodes a thread other than the compiling one creates, by class. Such a
+// thread may not update the stats counters, so it counts in one of these and
+// the compiling thread adds them to the counters when the thread is done.
+class node_counts_t
+{
+public:
+  // counts of the calling thread, nullptr if it updates the counters
+  static node_counts_t* get_thread_counts();
+  static void set_thread_counts(node_counts_t* counts);
+  void add(type_info const& type, size_t size)
+  {
+    this->m_counts[type_index(type)]++;
+    this->m_num_bytes += size;
+  }
+  void add_to_stats() const;
+private:
+  map<type_index, uint64_t> m_counts;
+  uint64_t m_num_bytes = 0;
+};
+
+// Owns the nodes a thread creates while it is the arena of that thread. cc
+// --stream releases the nodes of each external declaration once it is
+// lowered, so that they do not pile up over the whole unit.
+class node_arena_t
+{
+public:
+  ~node_arena_t() { this->release(); }
+  // arena of the calling thread, nullptr if its nodes are never freed
+  static node_arena_t* get_thread_arena();
+  static void set_thread_arena(node_arena_t* arena);
+  void add(ast_n* node) { this->m_nodes.push_back(node); }
+  // Deletes every node added so far, nothing may point to them any more
+  void release();
+private:
+  vector<ast_n*> m_nodes;
+};
+
+// The parser creates every node through this so that --stats can count them
+// by class, and so that they go in the arena of the thread if it has one
+template <typename T_NODE, typename... T_ARGS>
+T_NODE*
+new_node(T_ARGS&&... args)
+{
+#ifndef NO_STATS
+  if (node_counts_t* counts = node_counts_t::get_thread_counts()) {
+    counts->add(typeid(T_NODE), sizeof(T_NODE));
+  }
+  else {
+    STATS_INC("parse.nodes." + stats_t::demangle(typeid(T_NODE).name()));
+    STATS_INC("parse.nodes");
+    STATS_ADD("parse.node_bytes", sizeof(T_NODE));
+  }
+#endif
+  T_NODE* node = new T_NODE(std::forward<T_ARGS>(args)...);
+  if (node_arena_t* arena = node_arena_t::get_thread_arena()) {
+    arena->add(node);
+  }
+  return node;
+}
+
 template <typename T_NODE>
 class list_n : public ast_n
 {
@@ -29,6 +117,8 @@ public:
   vector<T_NODE*> const& get_list() const { return this->m_list; }
   void add_child(T_NODE* c) { this->m_list.push_back(c); }
   void add_child_front(T_NODE* c) { this->m_list.insert(this->m_list.begin(), c); }
+  // Forgets the children, without freeing them
+  void clear() { this->m_list.clear(); }
 private:
   vector<T_NODE*> m_list;
 };
@@ -51,13 +141,17 @@ enum class specifier_t {
   STORAGE_CLASS_SPECIFIER_END,
   // type specifiers
   TYPE_SPECIFIER_START, VOID, CHAR, SHORT, INT, LONG, FLOAT, DOUBLE, SIGNED, UNSIGNED, BOOL,
-  COMPLEX, IMAGINARY, STRUCT, UNION, ENUM, TYPE_SPECIFIER_END,
+  COMPLEX, IMAGINARY, STRUCT, UNION, ENUM,
+  // _Atomic(type-name), the qualifier is ATOMIC
+  ATOMIC_TYPE, TYPE_SPECIFIER_END,
   // type qualfiers
   TYPE_QUALIFIER_START, CONST, RESTRICT, VOLATILE, ATOMIC, TYPE_QUALIFIER_END,
   // function specifiers
   FUNCTION_SPECIFIER_START, INLINE, NORETURN, FUNCTION_SPECIFIER_END,
   // alignment Specifiers
-  ALIGNAS
+  ALIGNAS,
+  // GNU __attribute__((...))
+  ATTRIBUTE
 };
 
 class declaration_specifier_n : public ast_n
@@ -102,22 +196,57 @@ private:
   specifier_t m_declaration_specifier;
 };
 
+// One attribute of __attribute__((...)), only string arguments are supported
+class attribute_n : public ast_n
+{
+public:
+  attribute_n(char* name) : m_name(name) { }
+
+  // s is a string literal, quotes included
+  void add_argument(char* s);
+  string to_string_ast(string prefix="") const;
+  string const& get_name() const { return this->m_name; }
+  vector<string> const& get_arguments() const { return this->m_arguments; }
+private:
+  string m_name;
+  vector<string> m_arguments;
+};
+
+class attribute_specifier_n : public declaration_specifier_n
+{
+public:
+  attribute_specifier_n() : declaration_specifier_n(specifier_t::ATTRIBUTE) { }
+
+  void add_attribute(attribute_n* attribute) { this->m_attributes.push_back(attribute); }
+  vector<attribute_n*> const& get_attributes() const { return this->m_attributes; }
+  string to_string_ast(string prefix="") const;
+private:
+  vector<attribute_n*> m_attributes;
+};
+
 class declaration_specifiers_n : public list_n<declaration_specifier_n>
 {
 public:
   declaration_specifiers_n() : list_n<declaration_specifier_n>() { }
   declaration_specifiers_n(vector<declaration_specifier_n*> l) : list_n<declaration_specifier_n>(l) { }
 
-  c_type_t* declaration_specifiers_get_c_type() const;
+  // nullptr if the specifiers make no valid type, with the reason in error
+  c_type_t const* declaration_specifiers_get_c_type(string* error = nullptr) const;
+  bool has_specifier(specifier_t specifier) const;
+  // nullptr if no __attribute__ of the declaration is called name
+  attribute_n const* get_attribute(string const& name) const;
   string to_string_ast(string prefix="") const;
 };
 
 class identifier_n : public string_n
 {
 public:
-  identifier_n(char* s) : string_n(s) { }
+  identifier_n(char* s, source_range_t range) : string_n(s), m_range(range) { }
   string to_string_ast(string prefix="") const;
   string const& get_identifier_name() const { return this->get_str(); }
+  source_range_t get_range() const { return this->m_range; }
+private:
+  source_range_t m_range;
 };
 
 class constant_n : public string_n // Node for compile time constants, including enums
@@ -131,6 +260,16 @@ public:
   };
   constant_n(constant_sort_t constant_sort, char* s) : string_n(s), m_sort(constant_sort) { }
   constant_sort_t get_sort() const { return this->m_sort; }
+  c_type_t const* get_c_type() const;
+  // Value of a character constant
+  char get_char_value() const;
+  // Value of an integer constant that is not a character constant
+  unsigned long long get_integer_value() const;
+  // Value of a string literal with its escapes decoded and its adjacent
+  // literals concatenated, without the terminating NUL. Returns false for
+  // wide literals, which are not supported.
+  bool get_string_value(string& value) const;
+  llvm_value_t llvm_codegen(llvm_codegen_t& cg, c_type_t const* c_type) const;
   string to_string_ast(string prefix="") const;
 private:
   constant_sort_t m_sort;
@@ -142,6 +281,9 @@ class parameter_declaration_n : public ast_n
 public:
   parameter_declaration_n(declaration_specifiers_n* declaration_specifiers,
                           declarator_n* declarator = nullptr);
+  declarator_n const* get_declarator() const { return this->m_declarator; }
+  c_type_t const* get_c_type() const;
+  bool is_void_parameter() const;
   string to_string_ast(string prefix="") const;
 private:
   declaration_specifiers_n* m_declaration_specifiers;
@@ -176,6 +318,17 @@ public:
   direct_declarator_item_n(parameter_list_n* parameter_list) :
     m_item_opt(PARAMETER_LIST), m_item(parameter_list)
   { }
+  item_opt_t get_item_opt() const { return this->m_item_opt; }
+  identifier_n const* get_identifier() const
+  {
+    assert(this->m_item_opt == IDENTIFIER);
+    return dynamic_cast<identifier_n const*>(this->m_item);
+  }
+  parameter_list_n const* get_parameter_list() const
+  {
+    assert(this->m_item_opt == PARAMETER_LIST);
+    return dynamic_cast<parameter_list_n const*>(this->m_item);
+  }
   string to_string_ast(string prefix="") const;
 private:
   item_opt_t m_item_opt;
@@ -195,9 +348,41 @@ class pointer_n : public list_n<declaration_specifiers_n>
 public:
   pointer_n() : list_n<declaration_specifiers_n>() { }
   pointer_n(vector<declaration_specifiers_n*> l) : list_n<declaration_specifiers_n>(l) { }
+  // Type of a pointer to pointee, with each '*' and its qualifiers applied
+  c_type_t const* get_c_type(c_type_t const* pointee) const;
   string to_string_ast(string prefix="") const;
 };
 
+// A type without a name, as in _Atomic(int*): specifiers and qualifiers,
+// then optionally pointers
+class type_name_n : public ast_n
+{
+public:
+  type_name_n(declaration_specifiers_n* specifier_qualifier_list, pointer_n* pointer = nullptr) :
+    m_specifier_qualifier_list(specifier_qualifier_list),
+    m_pointer(pointer)
+  { }
+  // nullptr if it names no valid type, with the reason in error
+  c_type_t const* get_c_type(string* error) const;
+  string to_string_ast(string prefix="") const;
+private:
+  declaration_specifiers_n* m_specifier_qualifier_list;
+  pointer_n* m_pointer;
+};
+
+class atomic_type_specifier_n : public declaration_specifier_n
+{
+public:
+  atomic_type_specifier_n(type_name_n* type_name) :
+    declaration_specifier_n(specifier_t::ATOMIC_TYPE),
+    m_type_name(type_name)
+  { }
+  type_name_n const* get_type_name() const { return this->m_type_name; }
+  string to_string_ast(string prefix="") const;
+private:
+  type_name_n* m_type_name;
+};
+
 class declarator_n : public ast_n
 {
 public:
@@ -209,6 +394,11 @@ public:
     m_pointer(nullptr),
     m_direct_declarator(direct_declarator)
   { }
+  string const& get_identifier_name() const;
+  identifier_n const* get_identifier() const;
+  bool is_function_declarator() const;
+  parameter_list_n const* get_parameter_list() const;
+  c_type_t const* get_c_type(c_type_t const* base_type) const;
   string to_string_ast(string prefix="") const;
 private:
   pointer_n* m_pointer;
@@ -232,6 +422,7 @@ public:
     m_declarator(declarator),
     m_initializer(initializer)
   { }
+  declarator_n const* get_declarator() const { return this->m_declarator; }
   string to_string_ast(string prefix="") const;
 private:
   declarator_n* m_declarator;
@@ -251,6 +442,16 @@ class declaration_n : public ast_n
 public:
   declaration_n(declaration_specifiers_n* declaration_specifiers,
                 init_declarator_list_n* init_declarator_list = nullptr);
+  declaration_specifiers_n const* get_declaration_specifiers() const
+  {
+    return this->m_declaration_specifiers;
+  }
+  init_declarator_list_n const* get_init_declarator_list() const
+  {
+    return this->m_init_declarator_list;
+  }
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
 private:
   declaration_specifiers_n* m_declaration_specifiers;
@@ -258,15 +459,65 @@ private:
 };
 
 class statement_n;
+// A "#pragma STDC FP_CONTRACT" or "#pragma cc fp" line, which changes the
+// floating point semantics for the rest of the enclosing block, or for the
+// functions that follow it at file scope
+class fp_pragma_n : public ast_n
+{
+public:
+  // the fast-math flags the pragma turns on or off
+  enum fp_flag_t
+  {
+    FP_REASSOC = 1 << 0,
+    FP_NNAN = 1 << 1,
+    FP_NINF = 1 << 2,
+    FP_NSZ = 1 << 3,
+    FP_ARCP = 1 << 4,
+    FP_AFN = 1 << 5,
+    FP_ALL = (1 << 6) - 1,
+  };
+  enum contract_t
+  {
+    CONTRACT_UNCHANGED,
+    // back to the mode of -ffp-contract
+    CONTRACT_DEFAULT,
+    CONTRACT_OFF,
+    CONTRACT_ON,
+    CONTRACT_FAST,
+  };
+
+  // Adds the clauses of a pragma, returns false if one of them is malformed
+  bool parse_pragma(string const& pragma);
+  unsigned get_enabled_flags() const { return this->m_enabled_flags; }
+  unsigned get_disabled_flags() const { return this->m_disabled_flags; }
+  contract_t get_contract() const { return this->m_contract; }
+  void llvm_codegen(llvm_codegen_t& cg) const;
+  string to_string() const;
+  string to_string_ast(string prefix="") const;
+private:
+  void set_flags(unsigned flags, bool is_enabled);
+
+  unsigned m_enabled_flags = 0;
+  unsigned m_disabled_flags = 0;
+  contract_t m_contract = CONTRACT_UNCHANGED;
+};
+
 class block_item_n : public ast_n
 {
 public:
   block_item_n(declaration_n* declaration) : m_declaration(declaration), m_statement(nullptr) { }
   block_item_n(statement_n* statement) : m_declaration(nullptr), m_statement(statement) { }
+  block_item_n(fp_pragma_n* fp_pragma) : m_declaration(nullptr), m_statement(nullptr), m_fp_pragma(fp_pragma) { }
+  declaration_n const* get_declaration() const { return this->m_declaration; }
+  statement_n const* get_statement() const { return this->m_statement; }
+  void find_tail_calls(tail_recursion_t& tre, bool is_tail) const;
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
 private:
   declaration_n* m_declaration;
   statement_n* m_statement;
+  fp_pragma_n* m_fp_pragma = nullptr;
 };
 
 class compound_statement_n : public list_n<block_item_n>
@@ -274,9 +525,50 @@ class compound_statement_n : public list_n<block_item_n>
 public:
   compound_statement_n() : list_n<block_item_n>() { }
   compound_statement_n(vector<block_item_n*> l) : list_n<block_item_n>(l) { }
+  void find_tail_calls(tail_recursion_t& tre, bool is_tail) const;
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
 };
 
+// The generic functions of <stdatomic.h>. cc has no headers, so it knows
+// them by name, along with their _explicit forms that take the memory
+// orders as extra arguments.
+enum class atomic_builtin_t
+{
+  NONE,
+  INIT,
+  LOAD,
+  STORE,
+  EXCHANGE,
+  COMPARE_EXCHANGE_STRONG,
+  COMPARE_EXCHANGE_WEAK,
+  FETCH_ADD,
+  FETCH_SUB,
+  FETCH_OR,
+  FETCH_XOR,
+  FETCH_AND,
+  THREAD_FENCE,
+  SIGNAL_FENCE,
+  IS_LOCK_FREE,
+};
+
+// memory_order of C11 7.17.3, with the values of __ATOMIC_RELAXED and the
+// others
+enum class memory_order_t
+{
+  RELAXED,
+  CONSUME,
+  ACQUIRE,
+  RELEASE,
+  ACQ_REL,
+  SEQ_CST,
+};
+
+// Value of a name <stdatomic.h> would define, memory_order_seq_cst or
+// ATOMIC_INT_LOCK_FREE for instance. Returns false for any other name.
+bool get_builtin_constant(string const& name, int& value);
+
 class expression_n : public list_n<expression_n>
 {
 public:
@@ -288,6 +580,7 @@ public:
     OP_CONST,
     OP_FUNC_CALL,
     OP_FUNC_ARGS,
+    OP_SUBSCRIPT, // a[i], that is *(a + i)
     OP_POST_INC,
     OP_POST_DEC,
     OP_PRE_INC,
@@ -296,6 +589,8 @@ public:
     OP_NEG,
     OP_COMPLEMENT,
     OP_LOGIC_NOT,
+    OP_ADDR, // &a
+    OP_DEREF, // *a
     OP_MUL,
     OP_DIV,
     OP_MOD,
@@ -353,18 +648,33 @@ public:
   bool is_const() const { return this->get_kind() == OP_CONST; }
   identifier_n const* get_identifier() const { assert(this->is_var()); return this->m_identifier; }
   constant_n const* get_constant() const { assert(this->is_const()); return this->m_constant; }
+  expression_n const* get_child(size_t i) const { return this->get_list().at(i); }
+  // long __builtin_expect(long exp, long c)
+  bool is_builtin_expect_call() const;
+  // The <stdatomic.h> function a call is to, NONE if it is not a call to
+  // one. is_explicit is set for the forms that take memory orders.
+  atomic_builtin_t get_atomic_builtin(bool& is_explicit) const;
+  // position in the side table of sema_t, set by analyze()
+  size_t get_id() const { return this->m_id; }
+  // Returns the type of the value of the expression
+  c_type_t const* analyze(sema_t& sema) const;
+  llvm_value_t llvm_codegen(llvm_codegen_t& cg) const;
+  llvm_value_t llvm_codegen_lvalue(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
 
   static expression_n* mk_func_args()
   {
-    return new expression_n(OP_FUNC_ARGS);
+    return new_node<expression_n>(OP_FUNC_ARGS);
   }
 
   static expression_n* mk_func_args(vector<expression_n*> args)
   {
-    return new expression_n(OP_FUNC_ARGS, args);
+    return new_node<expression_n>(OP_FUNC_ARGS, args);
   }
 private:
+  template <typename T_NODE, typename... T_ARGS>
+  friend T_NODE* new_node(T_ARGS&&... args);
+
   expression_n(operation_kind_t op_kind) : m_op_kind(op_kind) { }
   expression_n(operation_kind_t op_kind, vector<expression_n*> expr_vec) :
     m_op_kind(op_kind), list_n<expression_n>(expr_vec)
@@ -372,6 +682,9 @@ private:
   operation_kind_t m_op_kind;
   identifier_n* m_identifier;
   constant_n* m_constant;
+  mutable size_t m_id = SIZE_MAX;
+
+  friend class sema_t;
 };
 
 class selection_statement_n : public ast_n
@@ -381,6 +694,7 @@ public:
   {
     IF_THEN,
     IF_THEN_ELSE,
+    SWITCH,
   };
   selection_statement_n(selection_sort_t sort, expression_n* cond, statement_n* body) :
     m_sort(sort), m_cond(cond), m_body(body)
@@ -397,6 +711,9 @@ public:
     assert(this->get_selection_sort() == IF_THEN_ELSE);
     return this->m_else_body;
   }
+  void find_tail_calls(tail_recursion_t& tre, bool is_tail) const;
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
 private:
   selection_sort_t m_sort;
@@ -405,6 +722,42 @@ private:
   statement_n* m_else_body = nullptr;
 };
 
+// Optimizer hints given by "#pragma cc loop" lines right before a loop
+class loop_hints_t
+{
+public:
+  enum hint_state_t
+  {
+    HINT_DEFAULT,
+    HINT_ENABLE,
+    HINT_DISABLE,
+  };
+
+  // Adds the clauses of a pragma, returns false if one of them is malformed
+  bool parse_pragma(string const& pragma);
+  bool empty() const
+  {
+    return this->m_unroll == HINT_DEFAULT && this->m_vectorize == HINT_DEFAULT &&
+           this->m_interleave_count == 0 && !this->m_distribute;
+  }
+  hint_state_t get_unroll() const { return this->m_unroll; }
+  unsigned get_unroll_count() const { return this->m_unroll_count; }
+  bool get_unroll_full() const { return this->m_unroll_full; }
+  hint_state_t get_vectorize() const { return this->m_vectorize; }
+  unsigned get_vectorize_width() const { return this->m_vectorize_width; }
+  unsigned get_interleave_count() const { return this->m_interleave_count; }
+  bool get_distribute() const { return this->m_distribute; }
+  string to_string() const;
+private:
+  hint_state_t m_unroll = HINT_DEFAULT;
+  unsigned m_unroll_count = 0;
+  bool m_unroll_full = false;
+  hint_state_t m_vectorize = HINT_DEFAULT;
+  unsigned m_vectorize_width = 0;
+  unsigned m_interleave_count = 0;
+  bool m_distribute = false;
+};
+
 class iteration_statement_n : public ast_n
 {
 public:
@@ -439,43 +792,51 @@ public:
     return (this->get_iteration_sort() == FOR || this->get_iteration_sort() == FOR_DECL) &&
            this->m_update != nullptr;
   }
+  loop_hints_t const& get_loop_hints() const { return this->m_loop_hints; }
+  loop_hints_t& get_loop_hints() { return this->m_loop_hints; }
+  void find_tail_calls(tail_recursion_t& tre) const;
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
 
   static iteration_statement_n* mk_while_iteration_statement(expression_n* cond, statement_n* body)
   {
-    return new iteration_statement_n(WHILE, cond, body);
+    return new_node<iteration_statement_n>(WHILE, cond, body);
   }
   static iteration_statement_n* mk_do_while_iteration_statement(statement_n* body, expression_n* cond)
   {
-    return new iteration_statement_n(DO_WHILE, cond, body);
+    return new_node<iteration_statement_n>(DO_WHILE, cond, body);
   }
   static iteration_statement_n* mk_for_iteration_statement(expression_n* init_expr,
                                                            expression_n* cond,
                                                            statement_n* body)
   {
-    return new iteration_statement_n(FOR, init_expr, cond, body);
+    return new_node<iteration_statement_n>(FOR, init_expr, cond, body);
   }
   static iteration_statement_n* mk_for_iteration_statement(expression_n* init_expr,
                                                            expression_n* cond,
                                                            expression_n* update,
                                                            statement_n* body)
   {
-    return new iteration_statement_n(FOR, init_expr, cond, update, body);
+    return new_node<iteration_statement_n>(FOR, init_expr, cond, update, body);
   }
   static iteration_statement_n* mk_for_iteration_statement(declaration_n* init_decl,
                                                            expression_n* cond,
                                                            statement_n* body)
   {
-    return new iteration_statement_n(FOR_DECL, init_decl, cond, body);
+    return new_node<iteration_statement_n>(FOR_DECL, init_decl, cond, body);
   }
   static iteration_statement_n* mk_for_iteration_statement(declaration_n* init_decl,
                                                            expression_n* cond,
                                                            expression_n* update,
                                                            statement_n* body)
   {
-    return new iteration_statement_n(FOR_DECL, init_decl, cond, update, body);
+    return new_node<iteration_statement_n>(FOR_DECL, init_decl, cond, update, body);
   }
 private:
+  template <typename T_NODE, typename... T_ARGS>
+  friend T_NODE* new_node(T_ARGS&&... args);
+
   iteration_statement_n(iteration_sort_t sort, expression_n* cond, statement_n* body) :
     m_sort(sort), m_cond(cond), m_body(body)
   { }
@@ -512,6 +873,7 @@ private:
   expression_n* m_cond;
   expression_n* m_update = nullptr;
   statement_n* m_body;
+  loop_hints_t m_loop_hints;
 };
 
 class jump_statement_n : public ast_n
@@ -519,6 +881,8 @@ class jump_statement_n : public ast_n
 public:
   enum jump_sort_t
   {
+    CONTINUE,
+    BREAK,
     RETURN,
   };
   jump_statement_n(jump_sort_t sort) : m_sort(sort) { }
@@ -532,23 +896,62 @@ public:
     assert(this->get_jump_sort() == RETURN);
     return this->m_expr;
   }
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
 private:
   jump_sort_t m_sort;
   expression_n* m_expr = nullptr;
 };
 
+class labeled_statement_n : public ast_n
+{
+public:
+  enum label_sort_t
+  {
+    CASE,
+    DEFAULT,
+  };
+  labeled_statement_n(expression_n* case_expr, statement_n* body) :
+    m_sort(CASE), m_case_expr(case_expr), m_body(body)
+  { }
+  labeled_statement_n(statement_n* body) :
+    m_sort(DEFAULT), m_case_expr(nullptr), m_body(body)
+  { }
+
+  label_sort_t get_label_sort() const { return this->m_sort; }
+  expression_n const* get_case_expr() const
+  {
+    assert(this->get_label_sort() == CASE);
+    return this->m_case_expr;
+  }
+  statement_n const* get_body() const { return this->m_body; }
+  void find_tail_calls(tail_recursion_t& tre) const;
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
+  string to_string_ast(string prefix="") const;
+private:
+  label_sort_t m_sort;
+  expression_n* m_case_expr;
+  statement_n* m_body;
+};
+
 class statement_n : public ast_n
 {
 public:
   enum statement_type_t
   {
+    LABELED_STATEMENT,
     COMPOUND_STATEMENT,
     EXPRESSION,
     SELECTION_STATEMENT,
     ITERATION_STATEMENT,
     JUMP_STATEMENT
   };
+  statement_n(labeled_statement_n* labeled_statement) :
+    m_statement_type(LABELED_STATEMENT),
+    m_generic_statement(labeled_statement)
+  { }
   statement_n(compound_statement_n* compound_statement) :
     m_statement_type(COMPOUND_STATEMENT),
     m_generic_statement(compound_statement)
@@ -569,23 +972,90 @@ public:
     m_statement_type(JUMP_STATEMENT),
     m_generic_statement(jump_statement)
   { }
+  // "return;"
+  bool is_return_without_value() const
+  {
+    if (this->m_statement_type != JUMP_STATEMENT) {
+      return false;
+    }
+    jump_statement_n const* jump_statement = dynamic_cast<jump_statement_n const*>(this->m_generic_statement);
+    return jump_statement->get_jump_sort() == jump_statement_n::RETURN &&
+           jump_statement->get_expr_for_return() == nullptr;
+  }
+  void find_tail_calls(tail_recursion_t& tre, bool is_tail) const;
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
 private:
   statement_type_t m_statement_type;
   ast_n* m_generic_statement;
 };
 
+// A function body the parser skipped by matching braces: its tokens, from
+// the '{' to the '}', until something asks for the body
+struct lazy_body_t
+{
+  struct token_t
+  {
+    int kind;
+    // offset in texts of the text of an identifier, constant, string
+    // literal or pragma
+    size_t text;
+    // where the token is in the input of the unit
+    source_range_t range;
+  };
+
+  vector<token_t> tokens;
+  // the texts, each ending with a NUL
+  string texts;
+};
+
 class function_definition_n : public ast_n
 {
 public:
   function_definition_n(declaration_specifiers_n* declaration_specifiers,
                         declarator_n* declarator,
                         compound_statement_n* compound_statement);
+  // with a body the parser skipped, which the node then owns
+  function_definition_n(declaration_specifiers_n* declaration_specifiers,
+                        declarator_n* declarator,
+                        lazy_body_t* lazy_body);
+  declaration_specifiers_n const* get_declaration_specifiers() const
+  {
+    return this->m_declaration_specifiers;
+  }
+  declarator_n const* get_declarator() const { return this->m_declarator; }
+  // The body, parsed by the first call if the parser skipped it. Any thread
+  // may call it, the first one parses and the others wait. nullptr if the
+  // skipped body does not parse, see get_body_syntax_error().
+  compound_statement_n const* get_compound_statement() const;
+  // The syntax error a skipped body stopped parsing at, located in the
+  // input of the unit like the errors of the parser. False if the body
+  // parsed or has not been parsed yet.
+  bool get_body_syntax_error(string& msg, source_range_t& range) const;
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
+
+  // Parses the skipped bodies of functions on up to num_threads threads.
+  // With arenas, the nodes of the body of functions[i] go in arenas[i].
+  // Without, the bodies parsed on other threads are never freed.
+  static void parse_bodies(vector<function_definition_n const*> const& functions,
+                           unsigned num_threads,
+                           vector<node_arena_t*> const& arenas = {});
 private:
+  // Lowers the body into function, once per clone with target_clones
+  void llvm_codegen_body(llvm_codegen_t& cg, llvm::Function* function, c_type_t const* c_type) const;
+
   declaration_specifiers_n* m_declaration_specifiers;
   declarator_n* m_declarator;
-  compound_statement_n* m_compound_statement;
+  mutable compound_statement_n* m_compound_statement;
+  // the skipped body until it is parsed
+  mutable unique_ptr<lazy_body_t> m_lazy_body;
+  mutable once_flag m_body_parsed;
+  // empty if the body parsed
+  mutable string m_body_error;
+  mutable source_range_t m_body_error_range = {0, 0};
 };
 
 class external_declaration_n : public ast_n
@@ -599,11 +1069,21 @@ public:
     m_function_definition(nullptr),
     m_declaration(declaration)
   { }
+  external_declaration_n(fp_pragma_n* fp_pragma) :
+    m_function_definition(nullptr),
+    m_declaration(nullptr),
+    m_fp_pragma(fp_pragma)
+  { }
 
+  // nullptr for a declaration or a pragma
+  function_definition_n const* get_function_definition() const { return this->m_function_definition; }
+  void analyze(sema_t& sema) const;
+  void llvm_codegen(llvm_codegen_t& cg) const;
   string to_string_ast(string prefix="") const;
 private:
   function_definition_n* m_function_definition;
   declaration_n* m_declaration;
+  fp_pragma_n* m_fp_pragma = nullptr;
 };
 
 class translation_unit_n : public list_n<external_declaration_n>
@@ -633,11 +1113,20 @@ public:
     m_output_filename(output_filename),
     m_base_table(new symbol_table_t())
   { }
+  // the declarations are not freed, they may live in a node_arena_t
+  ~translation_unit_n() { delete this->m_base_table; }
+  translation_unit_n(translation_unit_n const&) = delete;
+  translation_unit_n& operator=(translation_unit_n const&) = delete;
 
-  void llvm_codegen() const;
+  // sema must have analyzed the unit without errors
+  unique_ptr<llvm::Module> llvm_codegen(llvm::LLVMContext& ctx,
+                                       sema_t const& sema,
+                                       llvm_codegen_options_t const& options) const;
   string to_string_ast(string prefix="") const;
   string const get_filename() const { return this->m_filename; }
   string const get_output_filename() const { return this->m_output_filename; }
+  // file scope of the unit
+  symbol_table_t* get_base_table() const { return this->m_base_table; }
   string generate_output_filename() const
   {
     return this->m_filename.substr(0, this->m_filename.size() - 2) + ".ll";
@@ -5,6 +5,7 @@
 
 #include "ast.h"
 #include "common.h"
+#include "stack_space.h"
 
 using namespace std;
 
@@ -32,6 +33,7 @@ static const map<specifier_t, string> specifier_to_str_map = {
   {specifier_t::STRUCT, "struct"},
   {specifier_t::UNION, "union"},
   {specifier_t::ENUM, "enum"},
+  {specifier_t::ATOMIC_TYPE, "atomic"},
   // type qualfiers
   {specifier_t::CONST, "const"},
   {specifier_t::RESTRICT, "restrict"},
@@ -42,6 +44,8 @@ static const map<specifier_t, string> specifier_to_str_map = {
   {specifier_t::NORETURN, "noreturn"},
   // alignment specifier
   {specifier_t::ALIGNAS, "alignas"},
+  // attributes
+  {specifier_t::ATTRIBUTE, "__attribute__"},
 };
 
 static const map<constant_n::constant_sort_t, string> constant_sort_to_str_map = {
@@ -55,6 +59,7 @@ static const map<expression_n::operation_kind_t, string> op_kind_to_str_map = {
   {expression_n::OP_COMMA, "comma"},
   {expression_n::OP_FUNC_CALL, "function_call"},
   {expression_n::OP_FUNC_ARGS, "args"},
+  {expression_n::OP_SUBSCRIPT, "subscript"},
   {expression_n::OP_POST_INC, "post_inc"},
   {expression_n::OP_POST_DEC, "post_dec"},
   {expression_n::OP_PRE_INC, "pre_inc"},
@@ -63,6 +68,8 @@ static const map<expression_n::operation_kind_t, string> op_kind_to_str_map = {
   {expression_n::OP_NEG, "neg"},
   {expression_n::OP_COMPLEMENT, "~"},
   {expression_n::OP_LOGIC_NOT, "not"},
+  {expression_n::OP_ADDR, "addr"},
+  {expression_n::OP_DEREF, "deref"},
   {expression_n::OP_MUL, "mul"},
   {expression_n::OP_DIV, "div"},
   {expression_n::OP_MOD, "mod"},
@@ -98,6 +105,7 @@ static const map<expression_n::operation_kind_t, string> op_kind_to_str_map = {
 static const map<selection_statement_n::selection_sort_t, string> selection_sort_to_str_map = {
   {selection_statement_n::IF_THEN, "if_then"},
   {selection_statement_n::IF_THEN_ELSE, "if_then_else"},
+  {selection_statement_n::SWITCH, "switch"},
 };
 
 static const map<iteration_statement_n::iteration_sort_t, string> iteration_sort_to_str_map = {
@@ -107,7 +115,14 @@ static const map<iteration_statement_n::iteration_sort_t, string> iteration_sort
   {iteration_statement_n::FOR_DECL, "for_decl"},
 };
 
+static const map<labeled_statement_n::label_sort_t, string> label_sort_to_str_map = {
+  {labeled_statement_n::CASE, "case"},
+  {labeled_statement_n::DEFAULT, "default"},
+};
+
 static const map<jump_statement_n::jump_sort_t, string> jump_sort_to_str_map = {
+  {jump_statement_n::CONTINUE, "continue"},
+  {jump_statement_n::BREAK, "break"},
   {jump_statement_n::RETURN, "return"},
 };
 
@@ -151,9 +166,55 @@ declaration_specifier_n::to_string_ast(string prefix) const
       decl_spec == specifier_t::FUNCTION_SPECIFIER_END) {
     NOT_REACHED();
   }
+  if (decl_spec == specifier_t::ATTRIBUTE) {
+    return static_cast<attribute_specifier_n const*>(this)->to_string_ast(prefix);
+  }
+  if (decl_spec == specifier_t::ATOMIC_TYPE) {
+    return static_cast<atomic_type_specifier_n const*>(this)->to_string_ast(prefix);
+  }
   return specifier_to_str_map.at(decl_spec);
 }
 
+string
+atomic_type_specifier_n::to_string_ast(string prefix) const
+{
+  return specifier_to_str_map.at(specifier_t::ATOMIC_TYPE) + "(" + this->m_type_name->to_string_ast(prefix) + ")";
+}
+
+string
+type_name_n::to_string_ast(string prefix) const
+{
+  string ret = this->m_specifier_qualifier_list->to_string_ast(prefix);
+  if (this->m_pointer != nullptr) {
+    ret += this->m_pointer->to_string_ast(prefix);
+  }
+  return ret;
+}
+
+string
+attribute_n::to_string_ast(string prefix) const
+{
+  string ret = this->m_name;
+  if (!this->m_arguments.empty()) {
+    ret += "(";
+    for (size_t i = 0;i < this->m_arguments.size();i++) {
+      ret += (i == 0 ? "\"" : ", \"") + this->m_arguments[i] + "\"";
+    }
+    ret += ")";
+  }
+  return ret;
+}
+
+string
+attribute_specifier_n::to_string_ast(string prefix) const
+{
+  string ret = specifier_to_str_map.at(specifier_t::ATTRIBUTE) + "((";
+  for (size_t i = 0;i < this->m_attributes.size();i++) {
+    ret += (i == 0 ? "" : ", ") + this->m_attributes[i]->to_string_ast(prefix);
+  }
+  return ret + "))";
+}
+
 string
 declaration_specifiers_n::to_string_ast(string prefix) const
 {
@@ -272,6 +333,13 @@ init_declarator_list_n::to_string_ast(string prefix) const
 string
 expression_n::to_string_ast(string prefix) const
 {
+  if (!stack_space_t::has_space()) {
+    string ret;
+    if (!stack_space_t::run_on_new_stack([&]() { ret = this->to_string_ast(prefix); })) {
+      ret = string("<") + stack_space_t::get_error() + ">";
+    }
+    return ret;
+  }
   switch (this->get_kind()) {
     case expression_n::OP_VAR: {
       return this->get_identifier()->to_string_ast(prefix);
@@ -310,6 +378,9 @@ string
 iteration_statement_n::to_string_ast(string prefix) const
 {
   string ret = iteration_sort_to_str_map.at(this->get_iteration_sort());
+  if (!this->get_loop_hints().empty()) {
+    ret += "\n" + prefix + "|-" "loop_hints " + this->get_loop_hints().to_string();
+  }
   if (this->get_iteration_sort() == iteration_statement_n::FOR) {
     ret += "\n" + prefix + "|-" "initalizer";
     ret += "\n" + prefix + "| " + this->get_init_expr()->to_string_ast(prefix + "| ");
@@ -341,10 +412,33 @@ jump_statement_n::to_string_ast(string prefix) const
   return ret;
 }
 
+string
+labeled_statement_n::to_string_ast(string prefix) const
+{
+  string ret = label_sort_to_str_map.at(this->get_label_sort());
+  if (this->get_label_sort() == labeled_statement_n::CASE) {
+    ret += "\n" + prefix + "|-" + this->get_case_expr()->to_string_ast(prefix + "| ");
+  }
+  ret += "\n" + prefix + "`-" + this->get_body()->to_string_ast(prefix + "  ");
+  return ret;
+}
+
 string
 statement_n::to_string_ast(string prefix) const
 {
+  if (!stack_space_t::has_space()) {
+    string ret;
+    if (!stack_space_t::run_on_new_stack([&]() { ret = this->to_string_ast(prefix); })) {
+      ret = string("<") + stack_space_t::get_error() + ">";
+    }
+    return ret;
+  }
   switch (this->m_statement_type) {
+    case statement_n::LABELED_STATEMENT: {
+      labeled_statement_n* labeled_statement =
+        dynamic_cast<labeled_statement_n*>(this->m_generic_statement);
+      return labeled_statement->to_string_ast(prefix);
+    }
     case statement_n::COMPOUND_STATEMENT: {
       compound_statement_n* compound_statement =
         dynamic_cast<compound_statement_n*>(this->m_generic_statement);
@@ -375,12 +469,21 @@ statement_n::to_string_ast(string prefix) const
   }
 }
 
+string
+fp_pragma_n::to_string_ast(string prefix) const
+{
+  return "fp_pragma " + this->to_string();
+}
+
 string
 block_item_n::to_string_ast(string prefix) const
 {
   if (this->m_declaration) {
     return this->m_declaration->to_string_ast(prefix);
   }
+  if (this->m_fp_pragma) {
+    return this->m_fp_pragma->to_string_ast(prefix);
+  }
   assert(this->m_statement);
   return this->m_statement->to_string_ast(prefix);
 }
@@ -403,7 +506,8 @@ function_definition_n::to_string_ast(string prefix) const
   string ret = "function_definition";
   ret += "\n" + prefix + "|-" + this->m_declaration_specifiers->to_string_ast(prefix + "| ");
   ret += "\n" + prefix + "|-" + this->m_declarator->to_string_ast(prefix + "| ");
-  ret += "\n" + prefix + "`-" + this->m_compound_statement->to_string_ast(prefix + "  ");
+  compound_statement_n const* body = this->get_compound_statement();
+  ret += "\n" + prefix + "`-" + (body ? body->to_string_ast(prefix + "  ") : "<body does not parse>");
   return ret;
 }
 
@@ -428,6 +532,9 @@ external_declaration_n::to_string_ast(string prefix) const
   if (this->m_function_definition) {
     return this->m_function_definition->to_string_ast(prefix);
   }
+  if (this->m_fp_pragma) {
+    return this->m_fp_pragma->to_string_ast(prefix);
+  }
   assert(this->m_declaration);
   return this->m_declaration->to_string_ast(prefix);
 }
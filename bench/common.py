@@ -0,0 +1,57 @@
+# Helpers the benchmark scripts share: running a command, building a kernel
+# with cc, timing its runs and measuring a compilation.
+
+import os
+import subprocess
+import tempfile
+import time
+
+KERNELS_DIR = os.path.join(os.path.dirname(__file__), "kernels")
+
+def run(cmd):
+  p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+  return p.returncode, p.stdout.decode(errors="replace")
+
+# Compiles src with cc at level and flags, lowers it with llc at the same
+# level and links it with linker. Returns None, or what failed.
+def build_cc(cc, llc, linker, level, flags, src, exe):
+  bc = exe + ".bc"
+  obj = exe + ".o"
+  steps = [
+    [cc, "-O%d" % level] + flags + [src, "-o", bc],
+    [llc, "-O%d" % level, "-filetype=obj", "-relocation-model=pic", bc, "-o", obj],
+    [linker, obj, "-o", exe],
+  ]
+  for cmd in steps:
+    status, output = run(cmd)
+    if status != 0:
+      return "%s failed:\n%s" % (" ".join(cmd), output[-2000:])
+  return None
+
+# Returns the output of the first run and the best wall time of all of them
+def time_runs(exe, runs):
+  best = None
+  first_output = None
+  for _ in range(runs):
+    start = time.monotonic()
+    p = subprocess.run([exe], stdout=subprocess.PIPE)
+    elapsed = time.monotonic() - start
+    output = p.stdout.decode(errors="replace")
+    if p.returncode != 0:
+      output += "exit status %d\n" % p.returncode
+    if first_output is None:
+      first_output = output
+    best = elapsed if best is None else min(best, elapsed)
+  return first_output, best
+
+# Compiles src to out with cc and flags. Returns the exit status, the
+# output, the wall time and the peak RSS in KB.
+def compile_one(cc, flags, src, out):
+  with tempfile.TemporaryFile() as log:
+    start = time.monotonic()
+    p = subprocess.Popen([cc] + flags + [src, "-o", out], stdout=log, stderr=subprocess.STDOUT)
+    # wait4 gives the peak RSS of this compilation alone
+    _, status, usage = os.wait4(p.pid, 0)
+    elapsed = time.monotonic() - start
+    log.seek(0)
+    return os.waitstatus_to_exitcode(status), log.read().decode(errors="replace"), elapsed, usage.ru_maxrss
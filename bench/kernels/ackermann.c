@@ -0,0 +1,17 @@
+// Deep recursion with a tail call in two of its three cases
+int printf(const char *fmt, ...);
+
+int ackermann(int m, int n)
+{
+  if (m == 0)
+    return n + 1;
+  if (n == 0)
+    return ackermann(m - 1, 1);
+  return ackermann(m - 1, ackermann(m, n - 1));
+}
+
+int main()
+{
+  printf("%d\n", ackermann(2, 8000) + ackermann(3, 9));
+  return 0;
+}
@@ -0,0 +1,35 @@
+// Data-dependent integer loop with a division and an unpredictable branch
+int printf(const char *fmt, ...);
+
+int steps(long n)
+{
+  int s;
+  s = 0;
+  while (n != 1) {
+    if (n % 2 == 0)
+      n = n / 2;
+    else
+      n = 3 * n + 1;
+    s++;
+  }
+  return s;
+}
+
+int main()
+{
+  long n;
+  long best;
+  int most;
+  most = 0;
+  best = 0;
+  for (n = 1;n < 1000000;n++) {
+    int s;
+    s = steps(n);
+    if (s > most) {
+      most = s;
+      best = n;
+    }
+  }
+  printf("%ld %d\n", best, most);
+  return 0;
+}
@@ -0,0 +1,15 @@
+// Doubly recursive calls: call overhead, argument passing
+int printf(const char *fmt, ...);
+
+int fib(int n)
+{
+  if (n < 2)
+    return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+int main()
+{
+  printf("%d\n", fib(38));
+  return 0;
+}
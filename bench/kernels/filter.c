@@ -0,0 +1,33 @@
+// Counts the values that pass data-dependent range checks, which mispredict
+// half the time when && and || are lowered with branches
+int printf(const char *fmt, ...);
+void *malloc(unsigned long n);
+
+int main()
+{
+  int *values;
+  unsigned seed;
+  long count;
+  int n;
+  int i;
+  int r;
+  int d;
+  n = 1 << 16;
+  // no sizeof yet, ints are 4 bytes
+  values = malloc(n * 4);
+  seed = 12345;
+  for (i = 0;i < n;i++) {
+    seed = seed * 1103515245 + 12345;
+    values[i] = (seed >> 16) % 200;
+  }
+  count = 0;
+  for (r = 0;r < 2000;r++) {
+    for (i = 0;i < n;i++) {
+      d = values[i];
+      count += (d < 50 + r % 3) || (d >= 100) && (d < 150);
+      count += d > 20 && d < 120 ? d - r : d & 1;
+    }
+  }
+  printf("%ld\n", count);
+  return 0;
+}
@@ -0,0 +1,35 @@
+// Floating point multiplies and compares in nested loops with early exits
+int printf(const char *fmt, ...);
+
+int escape(double cr, double ci)
+{
+  double zr;
+  double zi;
+  int i;
+  zr = 0.0;
+  zi = 0.0;
+  for (i = 0;i < 200;i++) {
+    double t;
+    if (zr * zr + zi * zi > 4.0)
+      return i;
+    t = zr * zr - zi * zi + cr;
+    zi = 2.0 * zr * zi + ci;
+    zr = t;
+  }
+  return i;
+}
+
+int main()
+{
+  int x;
+  int y;
+  long total;
+  total = 0;
+  for (y = 0;y < 600;y++) {
+    for (x = 0;x < 800;x++) {
+      total += escape(-2.0 + 2.6 * x / 800, -1.2 + 2.4 * y / 600);
+    }
+  }
+  printf("%ld\n", total);
+  return 0;
+}
@@ -0,0 +1,17 @@
+// Floating point loop: the Leibniz series, a division per term
+int printf(const char *fmt, ...);
+
+int main()
+{
+  double sum;
+  double sign;
+  int k;
+  sum = 0.0;
+  sign = 1.0;
+  for (k = 0;k < 200000000;k++) {
+    sum += sign / (2.0 * k + 1.0);
+    sign = -sign;
+  }
+  printf("%.9f\n", 4.0 * sum);
+  return 0;
+}
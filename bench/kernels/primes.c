@@ -0,0 +1,26 @@
+// Trial division: nested loops around an integer remainder
+int printf(const char *fmt, ...);
+
+int is_prime(int n)
+{
+  int d;
+  if (n < 2)
+    return 0;
+  for (d = 2;d * d <= n;d++) {
+    if (n % d == 0)
+      return 0;
+  }
+  return 1;
+}
+
+int main()
+{
+  int n;
+  int count;
+  count = 0;
+  for (n = 0;n < 3000000;n++) {
+    count += is_prime(n);
+  }
+  printf("%d\n", count);
+  return 0;
+}
@@ -0,0 +1,39 @@
+// Streams over restrict-qualified arrays: the loop vectorizes only if the
+// stores through y cannot change x
+int printf(const char *fmt, ...);
+void *malloc(unsigned long n);
+
+void saxpy(int n, double a, double const *restrict x, double *restrict y)
+{
+  int i;
+  for (i = 0;i < n;i++) {
+    y[i] = a * x[i] + y[i];
+  }
+}
+
+int main()
+{
+  double *x;
+  double *y;
+  double sum;
+  int n;
+  int i;
+  int r;
+  n = 4096;
+  // no sizeof yet, doubles are 8 bytes
+  x = malloc(n * 8);
+  y = malloc(n * 8);
+  for (i = 0;i < n;i++) {
+    x[i] = i % 7;
+    y[i] = 1.0;
+  }
+  for (r = 0;r < 100000;r++) {
+    saxpy(n, 0.000001, x, y);
+  }
+  sum = 0.0;
+  for (i = 0;i < n;i++) {
+    sum += y[i];
+  }
+  printf("%.6f\n", sum);
+  return 0;
+}
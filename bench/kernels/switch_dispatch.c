@@ -0,0 +1,37 @@
+// A small interpreter loop: switch dispatch on a computed opcode
+int printf(const char *fmt, ...);
+
+int main()
+{
+  long acc;
+  int pc;
+  long i;
+  acc = 1;
+  pc = 0;
+  for (i = 0;i < 100000000;i++) {
+    switch (pc) {
+      case 0:
+        acc = acc + 7;
+        pc = 1;
+        break;
+      case 1:
+        acc = acc * 3;
+        pc = 2;
+        break;
+      case 2:
+        acc = acc % 1000003;
+        pc = 3;
+        break;
+      case 3:
+        acc = acc ^ (i & 1023);
+        pc = 4;
+        break;
+      default:
+        acc = acc - 1;
+        pc = acc & 3;
+        break;
+    }
+  }
+  printf("%ld\n", acc);
+  return 0;
+}
@@ -0,0 +1,41 @@
+// Sums windows that slide over an array. The index i + k only makes a 64
+// bit address without a sign extension in the loop if i + k cannot wrap,
+// which C promises for int and -fwrapv takes back.
+int printf(const char *fmt, ...);
+void *malloc(unsigned long n);
+
+int window_sum(int const *x, int k, int n)
+{
+  int s;
+  int i;
+  s = 0;
+  for (i = 0;i < n;i++) {
+    s += x[i + k] * 3;
+  }
+  return s;
+}
+
+int main()
+{
+  int *x;
+  int n;
+  int w;
+  int i;
+  int r;
+  long total;
+  n = 4096;
+  w = 1024;
+  // no sizeof yet, ints are 4 bytes
+  x = malloc((n + w) * 4);
+  for (i = 0;i < n + w;i++) {
+    x[i] = i % 13 - 6;
+  }
+  total = 0;
+  for (r = 0;r < 20000;r++) {
+    for (i = 0;i < n;i = i + 16) {
+      total += window_sum(x, i + r % 3, w);
+    }
+  }
+  printf("%ld\n", total);
+  return 0;
+}
@@ -0,0 +1,25 @@
+// Shifts, xors and multiplies on unsigned 64 bit values in a hot loop
+int printf(const char *fmt, ...);
+
+unsigned long next(unsigned long x)
+{
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return x;
+}
+
+int main()
+{
+  unsigned long x;
+  unsigned long h;
+  int i;
+  x = 88172645463325252;
+  h = 0;
+  for (i = 0;i < 200000000;i++) {
+    x = next(x);
+    h = h * 31 + (x & 255);
+  }
+  printf("%lu\n", h);
+  return 0;
+}
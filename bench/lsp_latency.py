@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+# Latency of cc --lsp on a large generated file: opens it, then times the
+# round trip from a one-character didChange to the publishDiagnostics that
+# answers it, and the same for hover requests.
+#
+#   bench/lsp_latency.py [--cc ./cc] [--lines 500000] [--edits 50]
+#
+# The edits go to a function in the middle of the file and keep it valid,
+# except for a pair that breaks and repairs it, whose diagnostics are checked.
+# A last edit renames a function, which makes the server reanalyze every
+# declaration after it, and is reported on its own.
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import time
+
+FUNCTION_LINES = 10
+
+def gen(num_lines):
+  out = ["int printf(char const* fmt, ...);", "int f0(int a, int b) { return a; }"]
+  i = 1
+  while len(out) + FUNCTION_LINES <= num_lines:
+    out += ["int f%d(int a, int b)" % i,
+            "{",
+            "  int x;",
+            "  x = a + b * %d;" % (i % 10),
+            "  if (x > 100) {",
+            "    x = x - f%d(a, b);" % (i - 1),
+            "  }",
+            "  return x;",
+            "}",
+            ""]
+    i += 1
+  return out, i - 1
+
+class client_t:
+  def __init__(self, cmd):
+    self.proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    self.next_id = 1
+
+  def send(self, method, params, is_request=False):
+    message = {"jsonrpc": "2.0", "method": method, "params": params}
+    if is_request:
+      message["id"] = self.next_id
+      self.next_id += 1
+    body = json.dumps(message).encode()
+    self.proc.stdin.write(b"Content-Length: %d\r\n\r\n" % len(body) + body)
+    self.proc.stdin.flush()
+    return message.get("id")
+
+  def receive(self):
+    length = 0
+    while True:
+      line = self.proc.stdout.readline()
+      if not line:
+        raise EOFError("server exited")
+      if line in (b"\r\n", b"\n"):
+        break
+      if line.lower().startswith(b"content-length:"):
+        length = int(line.split(b":")[1])
+    return json.loads(self.proc.stdout.read(length))
+
+  def wait_for(self, predicate):
+    while True:
+      message = self.receive()
+      if predicate(message):
+        return message
+
+  def request(self, method, params):
+    id = self.send(method, params, True)
+    return self.wait_for(lambda m: m.get("id") == id)
+
+def summary(name, samples):
+  samples = sorted(samples)
+  p95 = samples[min(len(samples) - 1, int(len(samples) * 0.95))]
+  print("%-24s n=%-4d median %8.2f ms  p95 %8.2f ms  max %8.2f ms" %
+        (name, len(samples), statistics.median(samples), p95, samples[-1]))
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument("--cc", default=os.path.join(os.path.dirname(__file__), "..", "cc"))
+  parser.add_argument("--lines", type=int, default=500000)
+  parser.add_argument("--edits", type=int, default=50)
+  args = parser.parse_args()
+
+  lines, num_functions = gen(args.lines)
+  text = "\n".join(lines) + "\n"
+  uri = "file:///bench/generated.c"
+  client = client_t([args.cc, "--lsp"])
+  client.request("initialize", {"processId": None, "rootUri": None, "capabilities": {}})
+  client.send("initialized", {})
+
+  is_diagnostics = lambda m: m.get("method") == "textDocument/publishDiagnostics"
+  start = time.monotonic()
+  client.send("textDocument/didOpen",
+              {"textDocument": {"uri": uri, "languageId": "c", "version": 1, "text": text}})
+  diagnostics = client.wait_for(is_diagnostics)["params"]["diagnostics"]
+  print("open: %d lines, %d functions, %.1f MB in %.1f ms, %d diagnostics" %
+        (len(lines), num_functions, len(text) / 1e6, (time.monotonic() - start) * 1000, len(diagnostics)))
+  ok = not diagnostics
+
+  # the "b * <digit>" line of the middle function
+  function = num_functions // 2
+  line = 2 + (function - 1) * FUNCTION_LINES + 3
+  character = lines[line].index("*") + 2
+  version = 1
+
+  def change(start_character, end_character, new_text, at_line=line):
+    nonlocal version
+    version += 1
+    start = time.monotonic()
+    client.send("textDocument/didChange", {
+      "textDocument": {"uri": uri, "version": version},
+      "contentChanges": [{"range": {"start": {"line": at_line, "character": start_character},
+                                    "end": {"line": at_line, "character": end_character}},
+                          "text": new_text}]})
+    diagnostics = client.wait_for(is_diagnostics)["params"]["diagnostics"]
+    return (time.monotonic() - start) * 1000, diagnostics
+
+  edit_ms = []
+  for i in range(args.edits):
+    ms, diagnostics = change(character, character + 1, str(i % 10))
+    edit_ms.append(ms)
+    ok = ok and not diagnostics
+  summary("one character edit", edit_ms)
+
+  # a stray character is a syntax error, removing it fixes it
+  ms_break, diagnostics = change(character, character, ")")
+  broken = diagnostics and diagnostics[0]["message"] == "syntax error" and diagnostics[0]["range"]["start"]["line"] == line
+  ms_fix, diagnostics = change(character, character + 1, "")
+  ok = ok and broken and not diagnostics
+  summary("break and repair", [ms_break, ms_fix])
+
+  hover_ms = []
+  call_line = line + 2
+  call_character = lines[call_line].index("f")
+  for i in range(args.edits):
+    start = time.monotonic()
+    hover = client.request("textDocument/hover", {"textDocument": {"uri": uri},
+                                                  "position": {"line": call_line, "character": call_character}})
+    hover_ms.append((time.monotonic() - start) * 1000)
+  ok = ok and hover["result"] is not None and hover["result"]["contents"]["value"].startswith("f%d: int" % (function - 1))
+  summary("hover", hover_ms)
+
+  # renaming a function changes the file scope, the callers after it must
+  # now report an undeclared identifier
+  declaration_line = 2 + (function - 1) * FUNCTION_LINES
+  ms, diagnostics = change(4, 4, "x", declaration_line)
+  print("%-24s %.2f ms, %d diagnostics" % ("rename a function", ms, len(diagnostics)))
+  ok = ok and diagnostics and "undeclared identifier f%d" % function in diagnostics[0]["message"]
+
+  client.request("shutdown", None)
+  client.send("exit", None)
+  status = client.proc.wait()
+  if not ok or status != 0:
+    print("FAILED: unexpected diagnostics, hover or exit status %d" % status)
+    return 1
+  return 0
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+# Compiles generated programs of n small functions, for growing n, with and
+# without --stream, and checks what --stream bounds.
+#
+# The syntax trees of only one declaration are alive at a time, so the
+# memory of the front end is bounded by the largest function. This is
+# checked with --signatures-only, which parses every body but generates no
+# code: the RSS growth per function with --stream must stay under
+# --max-front-end-ratio times the growth without it. What is left is the
+# file scope symbol of each function.
+#
+# The whole compilation is not bounded. The LLVM module is the output and
+# grows with every function, since the whole unit steps at the end
+# (attribute inference, calling conventions, string merging) need all of
+# it. For it, the growth per function with --stream must only be under
+# --max-ratio times the growth without.
+#
+#   bench/memory.py [--cc ./cc] [--sizes 1000,10000] [--flags -O0]
+#                   [--max-ratio 0.8] [--max-front-end-ratio 0.2]
+#
+# Prints the peak RSS of each compilation, and exits with status 1 if a
+# compilation fails, if the outputs differ, or if a growth is over its
+# bound.
+
+import argparse
+import filecmp
+import os
+import sys
+import tempfile
+
+from common import compile_one
+
+def gen(n):
+  out = ["int printf(char const* fmt, ...);"]
+  for i in range(n):
+    out += [
+      "int f%d(int a, int b)" % i,
+      "{",
+      "  int x;",
+      "  int y;",
+      "  x = a + b * %d;" % (i % 10),
+      "  y = 0;",
+      "  while (x > 0) {",
+      "    y = y + x * 3 - (x / 7) + (a << 2);",
+      "    x = x - 1 - (y & 3);",
+      "  }",
+      "  if (y > 100 && x < 5) {",
+      "    y = y - %d;" % i,
+      "  }",
+      "  return x + y;",
+      "}",
+    ]
+  return "\n".join(out) + "\n"
+
+# the smallest size is dominated by startup, compare the RSS growths from
+# it to the largest size
+def get_growth(sizes, kbs):
+  return (kbs[-1] - kbs[0]) / (sizes[-1] - sizes[0])
+
+def check_growth(what, growth, stream_growth, max_ratio):
+  print("%s growth: %.2f KB per function, %.2f KB with --stream" % (what, growth, stream_growth))
+  if stream_growth > max_ratio * growth:
+    print("%s: --stream grows more than %.2f times as fast as the default" % (what, max_ratio))
+    return False
+  return True
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument("--cc", default=os.path.join(os.path.dirname(__file__), "..", "cc"))
+  parser.add_argument("--sizes", default="1000,10000")
+  parser.add_argument("--flags", default="-O0")
+  parser.add_argument("--max-ratio", type=float, default=0.8)
+  parser.add_argument("--max-front-end-ratio", type=float, default=0.2)
+  args = parser.parse_args()
+  sizes = [int(s) for s in args.sizes.split(",")]
+  flags = args.flags.split()
+
+  ok = True
+  modes = ["", "--stream", "--signatures-only", "--signatures-only --stream"]
+  rss = {mode: [] for mode in modes}
+  with tempfile.TemporaryDirectory() as tmp:
+    for n in sizes:
+      src = os.path.join(tmp, "funcs_%d.c" % n)
+      with open(src, "w") as f:
+        f.write(gen(n))
+      outs = []
+      for mode in modes:
+        out = os.path.join(tmp, "out%d.ll" % len(outs))
+        status, output, _, kb = compile_one(args.cc, flags + mode.split(), src, out)
+        print("%-26s n=%-8d %8d KB%s" % (mode or "default", n, kb,
+              "" if status == 0 else "  FAILED (status %d)" % status))
+        if status != 0:
+          sys.stdout.write(output[-2000:])
+          return 1
+        rss[mode].append(kb)
+        outs.append(out)
+      if not filecmp.cmp(outs[0], outs[1], shallow=False):
+        print("n=%d: the output with --stream differs" % n)
+        ok = False
+  if len(sizes) >= 2:
+    growth = {mode: get_growth(sizes, kbs) for mode, kbs in rss.items()}
+    ok &= check_growth("front end", growth["--signatures-only"], growth["--signatures-only --stream"],
+                       args.max_front_end_ratio)
+    ok &= check_growth("compilation", growth[""], growth["--stream"], args.max_ratio)
+  return 0 if ok else 1
+
+if __name__ == "__main__":
+  sys.exit(main())
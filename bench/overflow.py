@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# Measures what signed overflow being undefined buys the loops of the
+# kernels in bench/kernels. Every kernel is compiled by cc in each overflow
+# mode: undefined (nsw, the default), -fwrapv and -ftrapv, lowered with llc
+# and linked by --linker. Each program is run several times, and the
+# outputs of all the modes must be the same.
+#
+#   bench/overflow.py [--cc ./cc] [--llc llc] [--linker cc] [--level 2]
+#                     [--runs 5] [kernel ...]
+#
+# Prints the best time of each mode and its ratio to the default's, and
+# exits with status 1 if a build fails or if the outputs differ.
+
+import argparse
+import os
+import sys
+import tempfile
+
+from common import KERNELS_DIR, build_cc, time_runs
+
+MODES = [("nsw", []), ("-fwrapv", ["-fwrapv"]), ("-ftrapv", ["-ftrapv"])]
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument("--cc", default=os.path.join(os.path.dirname(__file__), "..", "cc"))
+  parser.add_argument("--llc", default="llc")
+  parser.add_argument("--linker", default="cc")
+  parser.add_argument("--level", type=int, default=2)
+  parser.add_argument("--runs", type=int, default=5)
+  parser.add_argument("kernels", nargs="*")
+  args = parser.parse_args()
+  kernels = args.kernels or sorted(f[:-2] for f in os.listdir(KERNELS_DIR) if f.endswith(".c"))
+
+  ok = True
+  with tempfile.TemporaryDirectory() as tmp:
+    for name in kernels:
+      src = os.path.join(KERNELS_DIR, name + ".c")
+      expected = None
+      base_time = None
+      for mode, flags in MODES:
+        exe = os.path.join(tmp, "%s.%s" % (name, mode.lstrip("-")))
+        error = build_cc(args.cc, args.llc, args.linker, args.level, flags, src, exe)
+        if error is not None:
+          print("%-16s %-8s  FAILED" % (name, mode))
+          sys.stdout.write(error)
+          ok = False
+          continue
+        output, elapsed = time_runs(exe, args.runs)
+        if expected is None:
+          expected = output
+          base_time = elapsed
+        print("%-16s %-8s %8.3fs %6.2fx%s" % (name, mode, elapsed, elapsed / base_time,
+              "" if output == expected else "  OUTPUT DIFFERS"))
+        if output != expected:
+          ok = False
+  return 0 if ok else 1
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+# Measures the speed of the code cc generates. Every kernel in
+# bench/kernels is compiled by cc at each -O level, lowered with llc at the
+# same level, and compiled by a reference compiler. Each program is run
+# several times with its fixed inputs, and its output must match the
+# reference's.
+#
+#   bench/runtime.py [--cc ./cc] [--reference clang] [--levels 0,1,2,3]
+#                    [--runs 5] [--report runtime.json]
+#                    [--compare old.json] [--max-regression 1.1] [kernel ...]
+#
+# Prints the best time of each build and its ratio to the reference's best
+# time, and writes them to the --report JSON file. With --compare, the
+# ratios are checked against an earlier report, and a kernel and level whose
+# ratio grew more than --max-regression times counts as a regression.
+# Comparing ratios rather than times keeps reports from different machines
+# comparable.
+#
+# Exits with status 1 if a build fails, if an output differs from the
+# reference's, or if there is a regression.
+
+import argparse
+import json
+import os
+import sys
+import tempfile
+
+from common import KERNELS_DIR, build_cc, run, time_runs
+
+def build_reference(args, src, exe):
+  cmd = [args.reference] + args.reference_flags.split() + [src, "-o", exe]
+  status, output = run(cmd)
+  if status != 0:
+    return "%s failed:\n%s" % (" ".join(cmd), output[-2000:])
+  return None
+
+def compare(report, old, max_regression):
+  regressions = []
+  for name, kernel in report["kernels"].items():
+    old_kernel = old.get("kernels", {}).get(name)
+    if old_kernel is None:
+      continue
+    for level, result in kernel["cc"].items():
+      old_result = old_kernel["cc"].get(level)
+      if old_result is None or "ratio" not in old_result or "ratio" not in result:
+        continue
+      if result["ratio"] > max_regression * old_result["ratio"]:
+        regressions.append("%s %s: %.2fx the reference, was %.2fx" %
+                           (name, level, result["ratio"], old_result["ratio"]))
+  return regressions
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument("--cc", default=os.path.join(os.path.dirname(__file__), "..", "cc"))
+  parser.add_argument("--llc", default="llc")
+  parser.add_argument("--reference", default="clang")
+  parser.add_argument("--reference-flags", default="-O2 -w")
+  parser.add_argument("--levels", default="0,1,2,3")
+  parser.add_argument("--runs", type=int, default=5)
+  parser.add_argument("--report", default="runtime.json")
+  parser.add_argument("--compare")
+  parser.add_argument("--max-regression", type=float, default=1.1)
+  parser.add_argument("kernels", nargs="*")
+  args = parser.parse_args()
+  levels = [int(l) for l in args.levels.split(",")]
+  kernels = args.kernels or sorted(f[:-2] for f in os.listdir(KERNELS_DIR) if f.endswith(".c"))
+
+  ok = True
+  report = {
+    "reference": " ".join([args.reference, args.reference_flags]),
+    "runs": args.runs,
+    "kernels": {},
+  }
+  with tempfile.TemporaryDirectory() as tmp:
+    for name in kernels:
+      src = os.path.join(KERNELS_DIR, name + ".c")
+      kernel = {"cc": {}}
+      report["kernels"][name] = kernel
+      ref_exe = os.path.join(tmp, name + ".ref")
+      error = build_reference(args, src, ref_exe)
+      if error is not None:
+        print("%-16s reference  FAILED" % name)
+        sys.stdout.write(error)
+        kernel["error"] = error
+        ok = False
+        continue
+      expected, ref_time = time_runs(ref_exe, args.runs)
+      kernel["reference_s"] = ref_time
+      kernel["output"] = expected
+      print("%-16s reference  %8.3fs" % (name, ref_time))
+      for level in levels:
+        key = "O%d" % level
+        exe = os.path.join(tmp, "%s.%s" % (name, key))
+        error = build_cc(args.cc, args.llc, args.reference, level, [], src, exe)
+        if error is not None:
+          print("%-16s cc -%s     FAILED" % (name, key))
+          sys.stdout.write(error)
+          kernel["cc"][key] = {"error": error}
+          ok = False
+          continue
+        output, elapsed = time_runs(exe, args.runs)
+        result = {"time_s": elapsed, "ratio": elapsed / ref_time}
+        if output != expected:
+          result["error"] = "output differs from the reference's:\n" + output
+          ok = False
+        kernel["cc"][key] = result
+        print("%-16s cc -%s     %8.3fs %6.2fx%s" % (name, key, elapsed, result["ratio"],
+              "" if output == expected else "  WRONG OUTPUT"))
+
+  with open(args.report, "w") as f:
+    json.dump(report, f, indent=2, sort_keys=True)
+    f.write("\n")
+  if args.compare:
+    with open(args.compare) as f:
+      old = json.load(f)
+    for regression in compare(report, old, args.max_regression):
+      print("regression: " + regression)
+      ok = False
+  return 0 if ok else 1
+
+if __name__ == "__main__":
+  sys.exit(main())
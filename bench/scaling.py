@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# Compiles generated programs that nest or chain one construct n times, for
+# growing n, and checks that cc neither crashes nor slows down faster than
+# linearly. Each shape is one that a recursive front end or a per-scope
+# symbol lookup turns into deep recursion or quadratic time.
+#
+#   bench/scaling.py [--cc ./cc] [--sizes 1000,10000,100000] [shape ...]
+#
+# Prints one line per shape and size with the compile time and the peak RSS,
+# and exits with status 1 if a compilation fails or if the time per
+# construct grows more than --max-ratio times between the second and the
+# largest size.
+
+import argparse
+import os
+import sys
+import tempfile
+
+from common import compile_one
+
+def gen(shape, n):
+  out = ["int printf(char const* fmt, ...);", "int main()", "{", "  int x;", "  x = 1;"]
+  if shape == "sum":
+    out.append("  x = " + " + ".join(["x"] * n) + ";")
+  elif shape == "assign":
+    out.append("  x = " + "x = " * n + "1;")
+  elif shape == "unary":
+    out.append("  x = " + "- " * n + "x;")
+  elif shape == "parens":
+    out.append("  x = " + "(" * n + "x" + ")" * n + ";")
+  elif shape == "cond":
+    out.append("  x = " + "".join("x == %d ? %d : " % (i, i) for i in range(n)) + "0;")
+  elif shape == "call":
+    out.append("  x = " + "printf(\"\", " * n + "x" + ")" * n + ";")
+  elif shape == "nested_if":
+    out.append("  " + "if (x) { " * n + "x = x + 1;" + " }" * n)
+  elif shape == "else_if":
+    out.append("  if (x == 0) x = 0;" + "".join(" else if (x == %d) x = %d;" % (i, i) for i in range(1, n)))
+  elif shape == "blocks":
+    # every statement looks x up through all the enclosing blocks
+    out.append("  " + "{ x = x + 1; " * n + "}" * n)
+  elif shape == "statements":
+    out += ["  x = x + %d;" % i for i in range(n)]
+  out.append('  printf("%d\\n", x);')
+  out.append("  return 0;")
+  out.append("}")
+  return "\n".join(out) + "\n"
+
+SHAPES = ["sum", "assign", "unary", "parens", "cond", "call",
+          "nested_if", "else_if", "blocks", "statements"]
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument("--cc", default=os.path.join(os.path.dirname(__file__), "..", "cc"))
+  parser.add_argument("--sizes", default="1000,10000,100000")
+  parser.add_argument("--flags", default="-O0")
+  parser.add_argument("--max-ratio", type=float, default=4.0)
+  parser.add_argument("shapes", nargs="*", default=SHAPES)
+  args = parser.parse_args()
+  sizes = [int(s) for s in args.sizes.split(",")]
+  flags = args.flags.split()
+
+  ok = True
+  with tempfile.TemporaryDirectory() as tmp:
+    for shape in args.shapes:
+      per_item = []
+      for n in sizes:
+        src = os.path.join(tmp, "%s_%d.c" % (shape, n))
+        with open(src, "w") as f:
+          f.write(gen(shape, n))
+        status, output, elapsed, rss = compile_one(args.cc, flags, src, os.path.join(tmp, "out"))
+        print("%-10s n=%-8d %8.3fs %8d KB%s" % (shape, n, elapsed, rss,
+              "" if status == 0 else "  FAILED (status %d)" % status))
+        if status != 0:
+          sys.stdout.write(output[-2000:])
+          ok = False
+          break
+        per_item.append(elapsed / n)
+      # the smallest size is dominated by startup, compare per construct
+      # costs from the second size on
+      if len(per_item) >= 3 and per_item[-1] > args.max_ratio * per_item[1]:
+        print("%-10s superlinear: %.2f us per construct at n=%d, %.2f us at n=%d" %
+              (shape, per_item[-1] * 1e6, sizes[-1], per_item[1] * 1e6, sizes[1]))
+        ok = False
+  return 0 if ok else 1
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -1,16 +1,98 @@
 %{
 #include <cstdio>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <iostream>
+#include <memory>
 
 #include "ast.h"
 #include "common.h"
 #include "lex.h"
 #include "parse.h"
+#include "trace.h"
+
+// The stacks live on the heap and double as needed, the bison default of
+// 10000 entries rejects generated code such as long else if chains
+#define YYMAXDEPTH (1 << 26)
+// Bison only grows the stacks itself in C++ for a location type of its own,
+// so they are grown by grow_stacks(), in buffers the parse context owns
+#define yyoverflow(msg, ss, ss_bytes, vs, vs_bytes, ls, ls_bytes, size) \
+  grow_stacks(context, yylsp, msg, ss, ss_bytes, vs, vs_bytes, ls, ls_bytes, size)
+// which leaves the parser states to allocate
+#define YYMALLOC malloc
+#define YYFREE free
+
+// A symbol spans from the first byte of its first token to the end of its
+// last one, an empty rule sits at the end of the preceding symbol
+#define YYLLOC_DEFAULT(Current, Rhs, N) \
+  do { \
+    if (N) { \
+      (Current).begin = YYRHSLOC(Rhs, 1).begin; \
+      (Current).end = YYRHSLOC(Rhs, N).end; \
+    } \
+    else { \
+      (Current).begin = (Current).end = YYRHSLOC(Rhs, 0).end; \
+    } \
+  } while (0)
+
+// State of one parse. The parser is pure so that function bodies can be
+// parsed on several threads at once, each with its own.
+struct parse_context_t
+{
+  // the parse_translation_unit() call in progress
+  translation_unit_n* root;
+  declaration_handler_t const* on_declaration;
+  syntax_error_handler_t const* on_syntax_error;
+  // the body a parse_function_body() call is after
+  compound_statement_n* body;
+  // the state, value and location stacks once they outgrow the ones of the
+  // parser state
+  unique_ptr<char[]> stacks[3];
+};
+
+static void yyerror(source_range_t const* range, parse_context_t* context, const char *s);
+
+// Moves the num_bytes in use of stack to a buffer of size entries
+template <typename T>
+static void grow_stack(unique_ptr<char[]>& buffer, T** stack, size_t num_bytes, size_t size)
+{
+	unique_ptr<char[]> grown(new char[size * sizeof(T)]);
+	memcpy(grown.get(), *stack, num_bytes);
+	buffer = std::move(grown);
+	*stack = (T*)buffer.get();
+}
+
+// Doubles the stacks of a parse, up to YYMAXDEPTH entries
+template <typename T_STATE, typename T_VALUE, typename T_SIZE>
+static void grow_stacks(parse_context_t* context,
+                        source_range_t const* range,
+                        char const* msg,
+                        T_STATE** ss, size_t ss_bytes,
+                        T_VALUE** vs, size_t vs_bytes,
+                        source_range_t** ls, size_t ls_bytes,
+                        T_SIZE* size)
+{
+	if (*size >= YYMAXDEPTH) {
+		// the parse aborts with the stacks as they are
+		yyerror(range, context, msg);
+		return;
+	}
+	*size = min<T_SIZE>(*size * 2, YYMAXDEPTH);
+	grow_stack(context->stacks[0], ss, ss_bytes, *size);
+	grow_stack(context->stacks[1], vs, vs_bytes, *size);
+	grow_stack(context->stacks[2], ls, ls_bytes, *size);
+}
+static void handle_declaration(parse_context_t* context,
+                               external_declaration_n* external_declaration,
+                               source_range_t const& range);
 %}
 
 %code requires {
   #include "ast.h"
+
+  struct parse_context_t;
 }
 
 %union {
@@ -21,15 +103,19 @@
   declaration_n* decl;
   declaration_specifiers_n* decl_specs;
   declaration_specifier_n* decl_spec;
+  attribute_specifier_n* attr_spec;
+  attribute_n* attr;
   init_declarator_list_n* init_decl_list;
   init_declarator_n* init_decl;
   declarator_n* declarator;
   initializer_n* initializer;
   pointer_n* pointer;
+  type_name_n* type_name;
   direct_declarator_n* dir_decl;
   parameter_list_n* param_list;
   parameter_declaration_n* param_decl;
   statement_n* stmt;
+  labeled_statement_n* labeled_stmt;
   block_item_n* block_item;
   compound_statement_n* compound_stmt;
   expression_n::operation_kind_t op_kind;
@@ -37,9 +123,16 @@
   selection_statement_n* sel_stmt;
   iteration_statement_n* iter_stmt;
   jump_statement_n* jump_stmt;
+  lazy_body_t* lazy_body;
+  fp_pragma_n* fp_pragma;
 }
 
-%parse-param {translation_unit_n **root}
+%define api.pure full
+%define api.push-pull push
+%define api.location.type {source_range_t}
+%locations
+%parse-param {parse_context_t* context}
+%token-table
 
 %token  <lex_val> IDENTIFIER I_CONSTANT F_CONSTANT STRING_LITERAL
 %token  FUNC_NAME SIZEOF PTR_OP INC_OP DEC_OP LEFT_OP RIGHT_OP
@@ -59,6 +152,15 @@
 
 %token	ALIGNAS ALIGNOF ATOMIC GENERIC NORETURN STATIC_ASSERT THREAD_LOCAL
 
+%token  <lex_val> LOOP_PRAGMA FP_PRAGMA
+%token	ATTRIBUTE
+
+// A function body skipped by brace matching, which parse_translation_unit()
+// hands over instead of its tokens
+%token  <lazy_body> LAZY_BODY
+// Never scanned, starts the token stream of parse_function_body()
+%token  FUNCTION_BODY
+
 %type  <jump_stmt> jump_statement
 %type  <iter_stmt> iteration_statement
 %type  <sel_stmt> selection_statement
@@ -67,11 +169,13 @@
               exclusive_or_expression and_expression equality_expression relational_expression
               shift_expression additive_expression multiplicative_expression cast_expression
               unary_expression argument_expression_list postfix_expression primary_expression
-              constant string
+              constant string constant_expression
 %type  <op_kind> unary_operator assignment_operator
 %type  <compound_stmt> compound_statement block_item_list
 %type  <stmt> statement
+%type  <labeled_stmt> labeled_statement
 %type  <block_item> block_item
+%type  <fp_pragma> fp_pragma
 %type  <param_decl> parameter_declaration
 %type  <param_list> parameter_type_list parameter_list
 %type  <dir_decl> direct_declarator
@@ -79,20 +183,29 @@
 %type  <declarator> declarator
 %type  <init_decl> init_declarator
 %type  <init_decl_list> init_declarator_list
-%type  <decl_spec> /* storage_class_specifier */ type_specifier type_qualifier /* function_specifier alignment_specifier */
-%type  <decl_specs> declaration_specifiers type_qualifier_list
+%type  <decl_spec> storage_class_specifier type_specifier type_qualifier function_specifier /* alignment_specifier */
+%type  <decl_spec> atomic_type_specifier
+%type  <decl_specs> declaration_specifiers type_qualifier_list specifier_qualifier_list
+%type  <type_name> type_name
+%type  <attr_spec> attribute_specifier attribute_list
+%type  <attr> attribute attribute_name attribute_arguments
 %type  <decl> declaration
 %type  <func_def> function_definition
 %type  <ext_decl> external_declaration
 %type  <transl_unit> translation_unit
 
-%start translation_unit
+%start unit
 %%
 
+unit
+	: translation_unit
+	| FUNCTION_BODY compound_statement { context->body = $2; }
+	;
+
 primary_expression
 	: IDENTIFIER {
-	  identifier_n* identifier = new identifier_n($1);
-	  $$ = new expression_n(identifier);
+	  identifier_n* identifier = new_node<identifier_n>($1, @1);
+	  $$ = new_node<expression_n>(identifier);
 	}
 	| constant { $$ = $1; }
 	| string { $$ = $1; }
@@ -102,12 +215,12 @@ primary_expression
 
 constant
 	: I_CONSTANT {
-	  constant_n* integer_constant = new constant_n(constant_n::INTEGER_CONST, $1);
-	  $$ = new expression_n(integer_constant);
+	  constant_n* integer_constant = new_node<constant_n>(constant_n::INTEGER_CONST, $1);
+	  $$ = new_node<expression_n>(integer_constant);
   }		/* includes character_constant */
 	| F_CONSTANT {
-    constant_n* float_constant = new constant_n(constant_n::FLOAT_CONST, $1);
-    $$ = new expression_n(float_constant);
+    constant_n* float_constant = new_node<constant_n>(constant_n::FLOAT_CONST, $1);
+    $$ = new_node<expression_n>(float_constant);
   }
 //	| ENUMERATION_CONSTANT	/* after it has been defined as such */
 	;
@@ -118,8 +231,8 @@ constant
 
 string
 	: STRING_LITERAL {
-    constant_n* string_constant = new constant_n(constant_n::STRING_LITERAL, $1);
-    $$ = new expression_n(string_constant);
+    constant_n* string_constant = new_node<constant_n>(constant_n::STRING_LITERAL, $1);
+    $$ = new_node<expression_n>(string_constant);
   }
 //	| FUNC_NAME
 	;
@@ -140,18 +253,20 @@ string
 
 postfix_expression
 	: primary_expression { $$ = $1; }
-//	| postfix_expression '[' expression ']'
+	| postfix_expression '[' expression ']' {
+	  $$ = new_node<expression_n>(expression_n::OP_SUBSCRIPT, $1, $3);
+	}
 	| postfix_expression '(' ')' {
 	  expression_n* func_args = expression_n::mk_func_args();
-	  $$ = new expression_n(expression_n::OP_FUNC_CALL, $1, func_args);
+	  $$ = new_node<expression_n>(expression_n::OP_FUNC_CALL, $1, func_args);
 	}
 	| postfix_expression '(' argument_expression_list ')' {
-	  $$ = new expression_n(expression_n::OP_FUNC_CALL, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_FUNC_CALL, $1, $3);
 	}
 //	| postfix_expression '.' IDENTIFIER
 //	| postfix_expression PTR_OP IDENTIFIER
-	| postfix_expression INC_OP { $$ = new expression_n(expression_n::OP_POST_INC, $1); }
-	| postfix_expression DEC_OP { $$ = new expression_n(expression_n::OP_POST_DEC, $1); }
+	| postfix_expression INC_OP { $$ = new_node<expression_n>(expression_n::OP_POST_INC, $1); }
+	| postfix_expression DEC_OP { $$ = new_node<expression_n>(expression_n::OP_POST_DEC, $1); }
 //	| '(' type_name ')' '{' initializer_list '}'
 //	| '(' type_name ')' '{' initializer_list ',' '}'
 	;
@@ -169,18 +284,18 @@ argument_expression_list
 
 unary_expression
 	: postfix_expression { $$ = $1; }
-	| INC_OP unary_expression { $$ = new expression_n(expression_n::OP_PRE_INC, $2); }
-	| DEC_OP unary_expression { $$ = new expression_n(expression_n::OP_PRE_DEC, $2); }
-	| unary_operator cast_expression { $$ = new expression_n($1, $2); }
+	| INC_OP unary_expression { $$ = new_node<expression_n>(expression_n::OP_PRE_INC, $2); }
+	| DEC_OP unary_expression { $$ = new_node<expression_n>(expression_n::OP_PRE_DEC, $2); }
+	| unary_operator cast_expression { $$ = new_node<expression_n>($1, $2); }
 //	| SIZEOF unary_expression
 //	| SIZEOF '(' type_name ')'
 //	| ALIGNOF '(' type_name ')'
 	;
 
 unary_operator
-//	: '&'
-//	| '*'
-	: '+' { $$ = expression_n::OP_POS; }
+	: '&' { $$ = expression_n::OP_ADDR; }
+	| '*' { $$ = expression_n::OP_DEREF; }
+	| '+' { $$ = expression_n::OP_POS; }
 	| '-' { $$ = expression_n::OP_NEG; }
 	| '~' { $$ = expression_n::OP_COMPLEMENT; }
 	| '!' { $$ = expression_n::OP_LOGIC_NOT; }
@@ -194,108 +309,108 @@ cast_expression
 multiplicative_expression
 	: cast_expression { $$ = $1; }
 	| multiplicative_expression '*' cast_expression {
-	  $$ = new expression_n(expression_n::OP_MUL, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_MUL, $1, $3);
 	}
 	| multiplicative_expression '/' cast_expression {
-	  $$ = new expression_n(expression_n::OP_DIV, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_DIV, $1, $3);
 	}
 	| multiplicative_expression '%' cast_expression {
-	  $$ = new expression_n(expression_n::OP_MOD, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_MOD, $1, $3);
 	}
 	;
 
 additive_expression
 	: multiplicative_expression { $$ = $1; }
 	| additive_expression '+' multiplicative_expression {
-	  $$ = new expression_n(expression_n::OP_ADD, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_ADD, $1, $3);
 	}
 	| additive_expression '-' multiplicative_expression {
-	  $$ = new expression_n(expression_n::OP_SUB, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_SUB, $1, $3);
 	}
 	;
 
 shift_expression
 	: additive_expression { $$ = $1; }
 	| shift_expression LEFT_OP additive_expression {
-	  $$ = new expression_n(expression_n::OP_LSHIFT, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_LSHIFT, $1, $3);
 	}
 	| shift_expression RIGHT_OP additive_expression {
-	  $$ = new expression_n(expression_n::OP_RSHIFT, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_RSHIFT, $1, $3);
 	}
 	;
 
 relational_expression
 	: shift_expression { $$ = $1; }
 	| relational_expression '<' shift_expression {
-	  $$ = new expression_n(expression_n::OP_LT, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_LT, $1, $3);
 	}
 	| relational_expression '>' shift_expression {
-	  $$ = new expression_n(expression_n::OP_GT, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_GT, $1, $3);
 	}
 	| relational_expression LE_OP shift_expression {
-	  $$ = new expression_n(expression_n::OP_LTE, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_LTE, $1, $3);
 	}
 	| relational_expression GE_OP shift_expression {
-	  $$ = new expression_n(expression_n::OP_GTE, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_GTE, $1, $3);
 	}
 	;
 
 equality_expression
 	: relational_expression { $$ = $1; }
 	| equality_expression EQ_OP relational_expression {
-	  $$ = new expression_n(expression_n::OP_EQ, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_EQ, $1, $3);
 	}
 	| equality_expression NE_OP relational_expression {
-	  $$ = new expression_n(expression_n::OP_NEQ, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_NEQ, $1, $3);
 	}
 	;
 
 and_expression
 	: equality_expression { $$ = $1; }
 	| and_expression '&' equality_expression {
-	  $$ = new expression_n(expression_n::OP_BIT_AND, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_BIT_AND, $1, $3);
 	}
 	;
 
 exclusive_or_expression
 	: and_expression { $$ = $1; }
 	| exclusive_or_expression '^' and_expression {
-	  $$ = new expression_n(expression_n::OP_XOR, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_XOR, $1, $3);
 	}
 	;
 
 inclusive_or_expression
 	: exclusive_or_expression { $$ = $1; }
 	| inclusive_or_expression '|' exclusive_or_expression {
-	  $$ = new expression_n(expression_n::OP_BIT_OR, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_BIT_OR, $1, $3);
 	}
 	;
 
 logical_and_expression
 	: inclusive_or_expression { $$ = $1; }
 	| logical_and_expression AND_OP inclusive_or_expression {
-	  $$ = new expression_n(expression_n::OP_LOGIC_AND, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_LOGIC_AND, $1, $3);
 	}
 	;
 
 logical_or_expression
 	: logical_and_expression { $$ = $1; }
 	| logical_or_expression OR_OP logical_and_expression {
-	  $$ = new expression_n(expression_n::OP_LOGIC_OR, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_LOGIC_OR, $1, $3);
 	}
 	;
 
 conditional_expression
 	: logical_or_expression { $$ = $1; }
 	| logical_or_expression '?' expression ':' conditional_expression {
-	  $$ = new expression_n(expression_n::OP_CONDITIONAL, $1, $3, $5);
+	  $$ = new_node<expression_n>(expression_n::OP_CONDITIONAL, $1, $3, $5);
 	}
 	;
 
 assignment_expression
 	: conditional_expression { $$ = $1; }
 	| unary_expression assignment_operator assignment_expression {
-	  $$ = new expression_n($2, $1, $3);
+	  $$ = new_node<expression_n>($2, $1, $3);
 	}
 	;
 
@@ -316,35 +431,35 @@ assignment_operator
 expression
 	: assignment_expression { $$ = $1; }
 	| expression ',' assignment_expression {
-	  $$ = new expression_n(expression_n::OP_COMMA, $1, $3);
+	  $$ = new_node<expression_n>(expression_n::OP_COMMA, $1, $3);
 	}
 	;
 
-//constant_expression
-//	: conditional_expression	/* with constraints */
-//	;
+constant_expression
+	: conditional_expression { $$ = $1; }	/* with constraints */
+	;
 
 declaration
-	: declaration_specifiers ';' { $$ = new declaration_n($1); }
-	| declaration_specifiers init_declarator_list ';' { $$ = new declaration_n($1, $2); }
+	: declaration_specifiers ';' { $$ = new_node<declaration_n>($1); }
+	| declaration_specifiers init_declarator_list ';' { $$ = new_node<declaration_n>($1, $2); }
 	// | static_assert_declaration
 	;
 
 declaration_specifiers
-//	: storage_class_specifier declaration_specifiers {
-//	  $$ = $2;
-//	  $$->add_child_front($1);
-//	}
-//	| storage_class_specifier {
-//	  $$ = new declaration_specifiers_n();
-//	  $$->add_child($1);
-//	}
-	: type_specifier declaration_specifiers {
+	: storage_class_specifier declaration_specifiers {
+	  $$ = $2;
+	  $$->add_child_front($1);
+	}
+	| storage_class_specifier {
+	  $$ = new_node<declaration_specifiers_n>();
+	  $$->add_child($1);
+	}
+	| type_specifier declaration_specifiers {
 	  $$ = $2;
 	  $$->add_child_front($1);
 	}
 	| type_specifier {
-	  $$ = new declaration_specifiers_n();
+	  $$ = new_node<declaration_specifiers_n>();
 	  $$->add_child($1);
 	}
 	| type_qualifier declaration_specifiers {
@@ -352,24 +467,32 @@ declaration_specifiers
 	  $$->add_child_front($1);
 	}
 	| type_qualifier {
-    $$ = new declaration_specifiers_n();
+    $$ = new_node<declaration_specifiers_n>();
     $$->add_child($1);
   }
-//	| function_specifier declaration_specifiers {
-//	  $$ = $2;
-//	  $$->add_child_front($1);
-//	}
-//	| function_specifier {
-//	  $$ = new declaration_specifiers_n();
-//	  $$->add_child($1);
-//	}
+	| function_specifier declaration_specifiers {
+	  $$ = $2;
+	  $$->add_child_front($1);
+	}
+	| function_specifier {
+	  $$ = new_node<declaration_specifiers_n>();
+	  $$->add_child($1);
+	}
 //	| alignment_specifier declaration_specifiers
 //	| alignment_specifier
+	| attribute_specifier declaration_specifiers {
+	  $$ = $2;
+	  $$->add_child_front($1);
+	}
+	| attribute_specifier {
+	  $$ = new_node<declaration_specifiers_n>();
+	  $$->add_child($1);
+	}
 	;
 
 init_declarator_list
 	: init_declarator {
-	  $$ = new init_declarator_list_n();
+	  $$ = new_node<init_declarator_list_n>();
 	  $$->add_child($1);
 	}
 	| init_declarator_list ',' init_declarator {
@@ -379,33 +502,33 @@ init_declarator_list
 	;
 
 init_declarator
-//  : declarator '=' initializer { $$ = new init_declarator_n($1, $3); }
-	: declarator { $$ = new init_declarator_n($1); }
+//  : declarator '=' initializer { $$ = new_node<init_declarator_n>($1, $3); }
+	: declarator { $$ = new_node<init_declarator_n>($1); }
 	;
 
-//storage_class_specifier
-//	: TYPEDEF { $$ = new declaration_specifier_n(specifier_t::TYPEDEF); }	/* identifiers must be flagged as TYPEDEF_NAME */
-//	| EXTERN { $$ = new declaration_specifier_n(specifier_t::EXTERN); }
-//	| STATIC { $$ = new declaration_specifier_n(specifier_t::STATIC); }
-//	| THREAD_LOCAL { $$ = new declaration_specifier_n(specifier_t::THREAD_LOCAL); }
-//	| AUTO { $$ = new declaration_specifier_n(specifier_t::AUTO); }
-//	| REGISTER { $$ = new declaration_specifier_n(specifier_t::RESTRICT); }
-//	;
+storage_class_specifier
+//	: TYPEDEF { $$ = new_node<declaration_specifier_n>(specifier_t::TYPEDEF); }	/* identifiers must be flagged as TYPEDEF_NAME */
+	: EXTERN { $$ = new_node<declaration_specifier_n>(specifier_t::EXTERN); }
+	| STATIC { $$ = new_node<declaration_specifier_n>(specifier_t::STATIC); }
+	| THREAD_LOCAL { $$ = new_node<declaration_specifier_n>(specifier_t::THREAD_LOCAL); }
+	| AUTO { $$ = new_node<declaration_specifier_n>(specifier_t::AUTO); }
+	| REGISTER { $$ = new_node<declaration_specifier_n>(specifier_t::REGISTER); }
+	;
 
 type_specifier
-	: VOID { $$ = new declaration_specifier_n(specifier_t::VOID); }
-	| CHAR { $$ = new declaration_specifier_n(specifier_t::CHAR); }
-	| SHORT { $$ = new declaration_specifier_n(specifier_t::SHORT); }
-	| INT { $$ = new declaration_specifier_n(specifier_t::INT); }
-	| LONG { $$ = new declaration_specifier_n(specifier_t::LONG); }
-	| FLOAT { $$ = new declaration_specifier_n(specifier_t::FLOAT); }
-	| DOUBLE { $$ = new declaration_specifier_n(specifier_t::DOUBLE); }
-	| SIGNED { $$ = new declaration_specifier_n(specifier_t::SIGNED); }
-	| UNSIGNED { $$ = new declaration_specifier_n(specifier_t::UNSIGNED); }
-//	| BOOL { $$ = new declaration_specifier_n(specifier_t::BOOL); }
-//	| COMPLEX { $$ = new declaration_specifier_n(specifier_t::COMPLEX); }
-//	| IMAGINARY { $$ = new declaration_specifier_n(specifier_t::IMAGINARY); }	  	/* non-mandated extension */
-//	| atomic_type_specifier
+	: VOID { $$ = new_node<declaration_specifier_n>(specifier_t::VOID); }
+	| CHAR { $$ = new_node<declaration_specifier_n>(specifier_t::CHAR); }
+	| SHORT { $$ = new_node<declaration_specifier_n>(specifier_t::SHORT); }
+	| INT { $$ = new_node<declaration_specifier_n>(specifier_t::INT); }
+	| LONG { $$ = new_node<declaration_specifier_n>(specifier_t::LONG); }
+	| FLOAT { $$ = new_node<declaration_specifier_n>(specifier_t::FLOAT); }
+	| DOUBLE { $$ = new_node<declaration_specifier_n>(specifier_t::DOUBLE); }
+	| SIGNED { $$ = new_node<declaration_specifier_n>(specifier_t::SIGNED); }
+	| UNSIGNED { $$ = new_node<declaration_specifier_n>(specifier_t::UNSIGNED); }
+//	| BOOL { $$ = new_node<declaration_specifier_n>(specifier_t::BOOL); }
+//	| COMPLEX { $$ = new_node<declaration_specifier_n>(specifier_t::COMPLEX); }
+//	| IMAGINARY { $$ = new_node<declaration_specifier_n>(specifier_t::IMAGINARY); }	  	/* non-mandated extension */
+	| atomic_type_specifier { $$ = $1; }
 //	| struct_or_union_specifier
 //	| enum_specifier
 //	| TYPEDEF_NAME		/* after it has been defined as such */
@@ -433,12 +556,24 @@ type_specifier
 //	| static_assert_declaration
 //	;
 
-//specifier_qualifier_list
-//	: type_specifier specifier_qualifier_list
-//	| type_specifier
-//	| type_qualifier specifier_qualifier_list
-//	| type_qualifier
-//	;
+specifier_qualifier_list
+	: type_specifier specifier_qualifier_list {
+	  $$ = $2;
+	  $$->add_child_front($1);
+	}
+	| type_specifier {
+	  $$ = new_node<declaration_specifiers_n>();
+	  $$->add_child($1);
+	}
+	| type_qualifier specifier_qualifier_list {
+	  $$ = $2;
+	  $$->add_child_front($1);
+	}
+	| type_qualifier {
+	  $$ = new_node<declaration_specifiers_n>();
+	  $$->add_child($1);
+	}
+	;
 
 //struct_declarator_list
 //	: struct_declarator
@@ -469,37 +604,72 @@ type_specifier
 //	| enumeration_constant
 //	;
 
-//atomic_type_specifier
-//	: ATOMIC '(' type_name ')'
-//	;
+atomic_type_specifier
+	: ATOMIC '(' type_name ')' { $$ = new_node<atomic_type_specifier_n>($3); }
+	;
 
 type_qualifier
-	: CONST { $$ = new declaration_specifier_n(specifier_t::CONST); }
-//	| RESTRICT { $$ = new declaration_specifier_n(specifier_t::RESTRICT); }
-//	| VOLATILE { $$ = new declaration_specifier_n(specifier_t::VOLATILE); }
-//	| ATOMIC { $$ = new declaration_specifier_n(specifier_t::ATOMIC); }
+	: CONST { $$ = new_node<declaration_specifier_n>(specifier_t::CONST); }
+	| RESTRICT { $$ = new_node<declaration_specifier_n>(specifier_t::RESTRICT); }
+	| VOLATILE { $$ = new_node<declaration_specifier_n>(specifier_t::VOLATILE); }
+	| ATOMIC { $$ = new_node<declaration_specifier_n>(specifier_t::ATOMIC); }
 	;
 
-//function_specifier
-//	: INLINE { $$ = new declaration_specifier_n(specifier_t::INLINE); }
-//	| NORETURN { $$ = new declaration_specifier_n(specifier_t::NORETURN); }
-//	;
+function_specifier
+	: INLINE { $$ = new_node<declaration_specifier_n>(specifier_t::INLINE); }
+	| NORETURN { $$ = new_node<declaration_specifier_n>(specifier_t::NORETURN); }
+	;
 
 //alignment_specifier
 //	: ALIGNAS '(' type_name ')'
 //	| ALIGNAS '(' constant_expression ')'
 //	;
 
+attribute_specifier
+	: ATTRIBUTE '(' '(' attribute_list ')' ')' { $$ = $4; }
+	;
+
+attribute_list
+	: attribute {
+	  $$ = new_node<attribute_specifier_n>();
+	  $$->add_attribute($1);
+	}
+	| attribute_list ',' attribute {
+	  $$ = $1;
+	  $$->add_attribute($3);
+	}
+	;
+
+attribute
+	: attribute_name { $$ = $1; }
+	| attribute_arguments ')' { $$ = $1; }
+	;
+
+attribute_name
+	: IDENTIFIER { $$ = new_node<attribute_n>($1); }
+	;
+
+attribute_arguments
+	: attribute_name '(' STRING_LITERAL {
+	  $$ = $1;
+	  $$->add_argument($3);
+	}
+	| attribute_arguments ',' STRING_LITERAL {
+	  $$ = $1;
+	  $$->add_argument($3);
+	}
+	;
+
 declarator
-	: pointer direct_declarator { $$ = new declarator_n($1, $2); }
-	| direct_declarator { $$ = new declarator_n($1); }
+	: pointer direct_declarator { $$ = new_node<declarator_n>($1, $2); }
+	| direct_declarator { $$ = new_node<declarator_n>($1); }
 	;
 
 direct_declarator
 	: IDENTIFIER {
-	  $$ = new direct_declarator_n();
-	  identifier_n* id = new identifier_n($1);
-	  direct_declarator_item_n* item = new direct_declarator_item_n(id);
+	  $$ = new_node<direct_declarator_n>();
+	  identifier_n* id = new_node<identifier_n>($1, @1);
+	  direct_declarator_item_n* item = new_node<direct_declarator_item_n>(id);
 	  $$->add_child(item);
 	}
 //	| '(' declarator ')'
@@ -514,11 +684,13 @@ direct_declarator
 //	| direct_declarator '[' assignment_expression ']'
 	| direct_declarator '(' parameter_type_list ')' {
 	  $$ = $1;
-	  direct_declarator_item_n* item = new direct_declarator_item_n($3);
+	  direct_declarator_item_n* item = new_node<direct_declarator_item_n>($3);
 	  $$->add_child(item);
 	}
 	| direct_declarator '(' ')' {
 	  $$ = $1;
+	  direct_declarator_item_n* item = new_node<direct_declarator_item_n>(new_node<parameter_list_n>());
+	  $$->add_child(item);
   }
 //	| direct_declarator '(' identifier_list ')'
 	;
@@ -529,7 +701,7 @@ pointer
 	  $$->add_child_front($2);
 	}
 	| '*' type_qualifier_list {
-	  $$ = new pointer_n();
+	  $$ = new_node<pointer_n>();
 	  $$->add_child_front($2);
 	}
 	| '*' pointer {
@@ -537,7 +709,7 @@ pointer
 	  $$->add_child_front(nullptr);
 	}
 	| '*' {
-	  $$ = new pointer_n();
+	  $$ = new_node<pointer_n>();
 	  $$->add_child_front(nullptr);
 	}
 	;
@@ -545,7 +717,7 @@ pointer
 type_qualifier_list
 	: type_qualifier {
 	  assert($1->is_type_qualifier());
-	  $$ = new declaration_specifiers_n();
+	  $$ = new_node<declaration_specifiers_n>();
 	  $$->add_child($1);
 	}
 	| type_qualifier_list type_qualifier {
@@ -568,7 +740,7 @@ parameter_type_list
 	;
 
 parameter_list
-	: parameter_declaration { $$ = new parameter_list_n(); $$->add_child($1); }
+	: parameter_declaration { $$ = new_node<parameter_list_n>(); $$->add_child($1); }
 	| parameter_list ',' parameter_declaration {
     $$ = $1;
     $$->add_child($3);
@@ -576,9 +748,9 @@ parameter_list
 	;
 
 parameter_declaration
-	: declaration_specifiers declarator { $$ = new parameter_declaration_n($1, $2); }
+	: declaration_specifiers declarator { $$ = new_node<parameter_declaration_n>($1, $2); }
 //	| declaration_specifiers abstract_declarator
-	| declaration_specifiers { $$ = new parameter_declaration_n($1); }
+	| declaration_specifiers { $$ = new_node<parameter_declaration_n>($1); }
 	;
 
 //identifier_list
@@ -586,10 +758,11 @@ parameter_declaration
 //	| identifier_list ',' IDENTIFIER
 //	;
 
-//type_name
+type_name
 //	: specifier_qualifier_list abstract_declarator
-//	| specifier_qualifier_list
-//	;
+	: specifier_qualifier_list pointer { $$ = new_node<type_name_n>($1, $2); }	/* the only abstract_declarator yet */
+	| specifier_qualifier_list { $$ = new_node<type_name_n>($1); }
+	;
 
 //abstract_declarator
 //	: pointer direct_abstract_declarator
@@ -624,7 +797,7 @@ parameter_declaration
 //initializer
 //	: '{' initializer_list '}'
 //	| '{' initializer_list ',' '}'
-//	: assignment_expression { $$ = new initializer_n(); }
+//	: assignment_expression { $$ = new_node<initializer_n>(); }
 //	;
 
 //initializer_list
@@ -653,28 +826,28 @@ parameter_declaration
 //	;
 
 statement
-//	: labeled_statement { $$ = new statement_n(); }
-	: compound_statement { $$ = new statement_n($1); }
-	| expression_statement { $$ = new statement_n($1); }
-	| selection_statement { $$ = new statement_n($1); }
-	| iteration_statement { $$ = new statement_n($1); }
-	| jump_statement { $$ = new statement_n($1); }
+	: labeled_statement { $$ = new_node<statement_n>($1); }
+	| compound_statement { $$ = new_node<statement_n>($1); }
+	| expression_statement { $$ = new_node<statement_n>($1); }
+	| selection_statement { $$ = new_node<statement_n>($1); }
+	| iteration_statement { $$ = new_node<statement_n>($1); }
+	| jump_statement { $$ = new_node<statement_n>($1); }
 	;
 
-//labeled_statement
+labeled_statement
 //	: IDENTIFIER ':' statement
-//	| CASE constant_expression ':' statement
-//	| DEFAULT ':' statement
-//	;
+	: CASE constant_expression ':' statement { $$ = new_node<labeled_statement_n>($2, $4); }
+	| DEFAULT ':' statement { $$ = new_node<labeled_statement_n>($3); }
+	;
 
 compound_statement
-	: '{' '}' { $$ = new compound_statement_n(); }
+	: '{' '}' { $$ = new_node<compound_statement_n>(); }
   | '{'  block_item_list '}' { $$ = $2; }
 	;
 
 block_item_list
 	: block_item {
-	  $$ = new compound_statement_n();
+	  $$ = new_node<compound_statement_n>();
 	  $$->add_child($1);
 	}
 	| block_item_list block_item {
@@ -684,23 +857,38 @@ block_item_list
 	;
 
 block_item
-	: declaration { $$ = new block_item_n($1); }
-	| statement { $$ = new block_item_n($1); }
+	: declaration { $$ = new_node<block_item_n>($1); }
+	| statement { $$ = new_node<block_item_n>($1); }
+	| fp_pragma { $$ = new_node<block_item_n>($1); }
+	;
+
+fp_pragma
+	: FP_PRAGMA {
+	  $$ = new_node<fp_pragma_n>();
+	  bool is_valid = $$->parse_pragma($1);
+	  free($1);
+	  if (!is_valid) {
+	    yyerror(&@1, context, "malformed fp pragma");
+	    YYERROR;
+	  }
+	}
 	;
 
 expression_statement
-	: ';' { $$ = new expression_n(); }
+	: ';' { $$ = new_node<expression_n>(); }
 	| expression ';' { $$ = $1; }
 	;
 
 selection_statement
 	: IF '(' expression ')' statement ELSE statement {
-	  $$ = new selection_statement_n($3, $5, $7);
+	  $$ = new_node<selection_statement_n>($3, $5, $7);
 	}
 	| IF '(' expression ')' statement {
-	  $$ = new selection_statement_n(selection_statement_n::IF_THEN, $3, $5);
+	  $$ = new_node<selection_statement_n>(selection_statement_n::IF_THEN, $3, $5);
+	}
+	| SWITCH '(' expression ')' statement {
+	  $$ = new_node<selection_statement_n>(selection_statement_n::SWITCH, $3, $5);
 	}
-//	| SWITCH '(' expression ')' statement
 	;
 
 iteration_statement
@@ -722,36 +910,54 @@ iteration_statement
 	| FOR '(' declaration expression_statement expression ')' statement {
 	  $$ = iteration_statement_n::mk_for_iteration_statement($3, $4, $5, $7);
 	}
+	| LOOP_PRAGMA iteration_statement {
+	  $$ = $2;
+	  bool is_valid = $$->get_loop_hints().parse_pragma($1);
+	  free($1);
+	  if (!is_valid) {
+	    yyerror(&@1, context, "malformed loop pragma");
+	    YYERROR;
+	  }
+	}
 	;
 
 jump_statement
 //	: GOTO IDENTIFIER ';'
-//	| CONTINUE ';'
-//	| BREAK ';'
-	: RETURN ';' { $$ = new jump_statement_n(jump_statement_n::RETURN); }
+	: CONTINUE ';' { $$ = new_node<jump_statement_n>(jump_statement_n::CONTINUE); }
+	| BREAK ';' { $$ = new_node<jump_statement_n>(jump_statement_n::BREAK); }
+	| RETURN ';' { $$ = new_node<jump_statement_n>(jump_statement_n::RETURN); }
 	| RETURN expression ';' {
-	  $$ = new jump_statement_n(jump_statement_n::RETURN, $2);
+	  $$ = new_node<jump_statement_n>(jump_statement_n::RETURN, $2);
 	}
 	;
 
 translation_unit
 	: external_declaration {
-	  assert(*root != nullptr);
-	  $$ = *root;
+	  assert(context->root != nullptr);
+	  $$ = context->root;
 	  $$->add_child($1);
+	  handle_declaration(context, $1, @1);
+	}
+	| translation_unit external_declaration {
+	  $$ = $1;
+	  $$->add_child($2);
+	  handle_declaration(context, $2, @2);
 	}
-	| translation_unit external_declaration { $$ = $1; $$->add_child($2); }
 	;
 
 external_declaration
-	: function_definition { $$ = new external_declaration_n($1); }
-	| declaration { $$ = new external_declaration_n($1); }
+	: function_definition { $$ = new_node<external_declaration_n>($1); }
+	| declaration { $$ = new_node<external_declaration_n>($1); }
+	| fp_pragma { $$ = new_node<external_declaration_n>($1); }
 	;
 
 function_definition
 //	: declaration_specifiers declarator declaration_list compound_statement
 	: declaration_specifiers declarator compound_statement {
-    $$ = new function_definition_n($1, $2, $3);
+    $$ = new_node<function_definition_n>($1, $2, $3);
+  }
+	| declaration_specifiers declarator LAZY_BODY {
+    $$ = new_node<function_definition_n>($1, $2, $3);
   }
 	;
 
@@ -762,9 +968,178 @@ function_definition
 
 %%
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-void yyerror(translation_unit_n **root, const char *s)
+static void yyerror(source_range_t const* range, parse_context_t* context, const char *s)
 {
+	if (context->on_syntax_error != nullptr && *context->on_syntax_error) {
+		(*context->on_syntax_error)(s, *range);
+		return;
+	}
+	TRACE(TRACE_PARSER, TRACE_INFO, "syntax error at %zu: %s", range->begin, s);
 	fflush(stdout);
 	fprintf(stderr, "*** %s\n", s);
 }
+
+static void handle_declaration(parse_context_t* context,
+                               external_declaration_n* external_declaration,
+                               source_range_t const& range)
+{
+	TRACE(TRACE_PARSER, TRACE_DEBUG, "declaration at %zu-%zu", range.begin, range.end);
+	(*context->on_declaration)(external_declaration, range);
+}
+
+// the tokens whose text the scanner allocates and the grammar frees
+static bool is_pragma(int token)
+{
+	return token == LOOP_PRAGMA || token == FP_PRAGMA;
+}
+
+// the tokens the scanner returns with a text in yylval
+static bool has_text(int token)
+{
+	return token == IDENTIFIER || token == I_CONSTANT || token == F_CONSTANT ||
+	       token == STRING_LITERAL || is_pragma(token);
+}
+
+// Scans the tokens of a function body whose '{' was just scanned into value
+// and range, up to the matching '}'. Returns false if the input ends first,
+// with what there was.
+static bool skim_function_body(lexer_t& lexer, YYSTYPE& value, source_range_t& range, lazy_body_t& body)
+{
+	int depth = 0;
+	int token = '{';
+	for (;;) {
+		size_t text = body.texts.size();
+		if (has_text(token)) {
+			body.texts += value.lex_val;
+			body.texts += '\0';
+			if (is_pragma(token)) {
+				free(value.lex_val);
+			}
+		}
+		body.tokens.push_back({token, text, range});
+		if (token == '{') {
+			depth++;
+		}
+		else if (token == '}' && --depth == 0) {
+			return true;
+		}
+		else if (token == YYEOF) {
+			return false;
+		}
+		token = lexer.lex(&value, &range);
+	}
+}
+
+// Pushes the tokens [first, last) of body, the values pointing into it
+static int push_tokens(yypstate* ps, parse_context_t* context, lazy_body_t const& body, size_t first, size_t last)
+{
+	int status = YYPUSH_MORE;
+	for (size_t i = first;i < last && status == YYPUSH_MORE;i++) {
+		lazy_body_t::token_t const& token = body.tokens[i];
+		YYSTYPE value;
+		if (has_text(token.kind)) {
+			char const* text = body.texts.c_str() + token.text;
+			// the grammar frees the text of a pragma
+			value.lex_val = is_pragma(token.kind) ? strdup(text) : (char*)text;
+		}
+		source_range_t range = token.range;
+		status = yypush_parse(ps, token.kind, &value, &range, context);
+	}
+	return status;
+}
+
+int parse_translation_unit(lexer_t& lexer,
+                           translation_unit_n* root,
+                           declaration_handler_t const& on_declaration,
+                           syntax_error_handler_t const& on_syntax_error,
+                           bool is_lazy)
+{
+	parse_context_t context = {root, &on_declaration, &on_syntax_error, nullptr};
+	lexer.set_error_handler([&](char const* s, source_range_t const& range) {
+		yyerror(&range, &context, s);
+	});
+	yypstate* ps = yypstate_new();
+	YYSTYPE value;
+	// the end of the input is located at the last token
+	source_range_t range = {0, 0};
+	// A '{' opens a function body when it follows the ')' of a declarator at
+	// file scope, in a declaration with no initializer so far. Typedef names
+	// are not told apart from identifiers, so the tokens of a body do not
+	// depend on what it declares.
+	int depth = 0;
+	int prev_token = 0;
+	bool has_initializer = false;
+	int status;
+	do {
+		int token = lexer.lex(&value, &range);
+		if (is_lazy && token == '{' && depth == 0 && prev_token == ')' && !has_initializer) {
+			lazy_body_t* body = new lazy_body_t;
+			if (skim_function_body(lexer, value, range, *body)) {
+				STATS_INC("parse.lazy_bodies");
+				TRACE(TRACE_PARSER, TRACE_DEBUG, "skimmed a body of %zu tokens at %zu",
+				      body->tokens.size(), body->tokens.front().range.begin);
+				value.lazy_body = body;
+				range = {body->tokens.front().range.begin, body->tokens.back().range.end};
+				status = yypush_parse(ps, LAZY_BODY, &value, &range, &context);
+				prev_token = '}';
+				continue;
+			}
+			// the input ends in the body, it gets the error it would eagerly
+			status = push_tokens(ps, &context, *body, 0, body->tokens.size());
+			delete body;
+			break;
+		}
+		if (token == '(' || token == '{') {
+			depth++;
+		}
+		else if (token == ')' || token == '}') {
+			depth--;
+		}
+		else if (token == '=' && depth == 0) {
+			has_initializer = true;
+		}
+		else if (token == ';' && depth == 0) {
+			has_initializer = false;
+		}
+		prev_token = token;
+		status = yypush_parse(ps, token, &value, &range, &context);
+	} while (status == YYPUSH_MORE);
+	yypstate_delete(ps);
+	lexer.set_error_handler(nullptr);
+	return status;
+}
+
+compound_statement_n* parse_function_body(lazy_body_t const& body, syntax_error_handler_t const& on_syntax_error)
+{
+	TRACE(TRACE_PARSER, TRACE_DEBUG, "parsing the body at %zu", body.tokens.front().range.begin);
+	parse_context_t context = {nullptr, nullptr, &on_syntax_error, nullptr};
+	yypstate* ps = yypstate_new();
+	source_range_t range = {body.tokens.front().range.begin, body.tokens.front().range.begin};
+	int status = yypush_parse(ps, FUNCTION_BODY, nullptr, &range, &context);
+	if (status == YYPUSH_MORE) {
+		status = push_tokens(ps, &context, body, 0, body.tokens.size());
+	}
+	if (status == YYPUSH_MORE) {
+		range = {body.tokens.back().range.end, body.tokens.back().range.end};
+		status = yypush_parse(ps, YYEOF, nullptr, &range, &context);
+	}
+	yypstate_delete(ps);
+	return status == 0 ? context.body : nullptr;
+}
+
+void stats_count_token(int token)
+{
+#ifndef NO_STATS
+	// one counter per token kind, named after the token in the grammar
+	static uint64_t* counters[YYNTOKENS];
+	int kind = YYTRANSLATE(token);
+	if (counters[kind] == nullptr) {
+		counters[kind] = stats_t::get_counter(string("lex.tokens.") + yytname[kind]);
+	}
+	(*counters[kind])++;
+	STATS_INC("lex.tokens");
+#endif
+}
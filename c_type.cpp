@@ -1,4 +1,6 @@
 #include <map>
+#include <mutex>
+#include <unordered_set>
 
 #include "c_type.h"
 
@@ -13,12 +15,49 @@ static const map<c_type_t::base_type_t, string> base_type_to_str_map = {
   {c_type_t::FLOAT, "float"},
   {c_type_t::DOUBLE, "double"},
   {c_type_t::LONG_DOUBLE, "long double"},
+  {c_type_t::POINTER, "pointer"},
+  {c_type_t::FUNCTION, "function"},
 };
 
+static string
+qualifiers_to_string(bool is_const, bool is_volatile, bool is_restrict, bool is_atomic)
+{
+  string ret = "";
+  if (is_atomic) {
+    ret += "_Atomic ";
+  }
+  if (is_const) {
+    ret += "const ";
+  }
+  if (is_volatile) {
+    ret += "volatile ";
+  }
+  if (is_restrict) {
+    ret += "restrict ";
+  }
+  return ret;
+}
+
 string
 c_type_t::c_type_to_string() const
 {
   string ret = "";
+  if (this->is_pointer()) {
+    ret += this->get_pointee_type()->c_type_to_string() + "* ";
+    return ret + qualifiers_to_string(this->m_is_const, this->m_is_volatile,
+                                    this->m_is_restrict, this->m_is_atomic);
+  }
+  if (this->is_function()) {
+    ret += this->get_return_type()->c_type_to_string() + "(";
+    for (size_t i = 0;i < this->m_param_types.size();i++) {
+      ret += (i == 0 ? "" : ", ") + this->m_param_types[i]->c_type_to_string();
+    }
+    if (this->m_is_vararg) {
+      ret += this->m_param_types.empty() ? "..." : ", ...";
+    }
+    ret += ") ";
+    return ret;
+  }
   if (this->m_is_signed) {
     ret += "signed ";
   }
@@ -26,10 +65,8 @@ c_type_t::c_type_to_string() const
     ret += "unsigned ";
   }
   ret += c_type_t::base_type_to_string(this->m_base_type) + " ";
-  if (this->m_is_const) {
-    ret += "const ";
-  }
-  return ret;
+  return ret + qualifiers_to_string(this->m_is_const, this->m_is_volatile,
+                                    this->m_is_restrict, this->m_is_atomic);
 }
 
 string
@@ -48,3 +85,190 @@ c_type_t::base_type_can_have_sign_keywords(c_type_t::base_type_t base_type)
          base_type == c_type_t::LONG_LONG_INT;
 }
 
+
+bool
+c_type_t::is_same_type(c_type_t const* other) const
+{
+  if (this == other) {
+    return true;
+  }
+  if (this->m_base_type != other->m_base_type) {
+    return false;
+  }
+  if (this->is_pointer()) {
+    return this->get_pointee_type()->is_same_type(other->get_pointee_type());
+  }
+  if (this->is_function()) {
+    if (!this->get_return_type()->is_same_type(other->get_return_type()) ||
+        this->m_is_vararg != other->m_is_vararg ||
+        this->m_param_types.size() != other->m_param_types.size()) {
+      return false;
+    }
+    for (size_t i = 0;i < this->m_param_types.size();i++) {
+      if (!this->m_param_types[i]->is_same_type(other->m_param_types[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return this->is_signed_integer() == other->is_signed_integer();
+}
+
+size_t
+c_type_t::hash_t::operator()(c_type_t const* c_type) const
+{
+  size_t h = hash<c_type_t const*>()(c_type->m_derived_from);
+  h = h * 31 + c_type->m_base_type;
+  h = h * 31 + (c_type->m_is_const | c_type->m_is_volatile << 1 | c_type->m_is_restrict << 2 |
+                c_type->m_is_atomic << 3 | c_type->m_is_signed << 4 | c_type->m_is_unsigned << 5 |
+                c_type->m_is_vararg << 6);
+  for (auto const& param_type : c_type->m_param_types) {
+    h = h * 31 + hash<c_type_t const*>()(param_type);
+  }
+  return h;
+}
+
+// The types a type is made of are interned first, so comparing their
+// addresses is enough
+bool
+c_type_t::equal_t::operator()(c_type_t const* a, c_type_t const* b) const
+{
+  return a->m_base_type == b->m_base_type &&
+         a->m_is_const == b->m_is_const &&
+         a->m_is_volatile == b->m_is_volatile &&
+         a->m_is_restrict == b->m_is_restrict &&
+         a->m_is_atomic == b->m_is_atomic &&
+         a->m_is_signed == b->m_is_signed &&
+         a->m_is_unsigned == b->m_is_unsigned &&
+         a->m_derived_from == b->m_derived_from &&
+         a->m_param_types == b->m_param_types &&
+         a->m_is_vararg == b->m_is_vararg;
+}
+
+c_type_t const*
+c_type_t::intern(c_type_t const& c_type)
+{
+  static mutex types_mutex;
+  static unordered_set<c_type_t const*, hash_t, equal_t> types;
+  lock_guard<mutex> lock(types_mutex);
+  auto it = types.find(&c_type);
+  if (it != types.end()) {
+    return *it;
+  }
+  STATS_INC("types.c_types");
+  STATS_ADD("types.c_type_bytes", sizeof(c_type_t));
+  c_type_t const* ret = new c_type_t(c_type);
+  types.insert(ret);
+  return ret;
+}
+
+c_type_t const*
+c_type_t::mk_base_type(base_type_t base_type, bool is_const, bool is_signed, bool is_unsigned)
+{
+  assert(!is_signed || !is_unsigned);
+  c_type_t c_type(base_type, nullptr);
+  c_type.m_is_const = is_const;
+  c_type.m_is_signed = is_signed;
+  c_type.m_is_unsigned = is_unsigned;
+  return intern(c_type);
+}
+
+c_type_t const*
+c_type_t::mk_pointer(c_type_t const* pointee)
+{
+  return intern(c_type_t(POINTER, pointee));
+}
+
+c_type_t const*
+c_type_t::mk_qualified(c_type_t const* c_type,
+                       bool is_const,
+                       bool is_volatile,
+                       bool is_restrict,
+                       bool is_atomic)
+{
+  assert(!is_restrict || c_type->is_pointer());
+  assert(!is_atomic || c_type->is_scalar());
+  if ((!is_const || c_type->m_is_const) && (!is_volatile || c_type->m_is_volatile) &&
+      (!is_restrict || c_type->m_is_restrict) && (!is_atomic || c_type->m_is_atomic)) {
+    return c_type;
+  }
+  c_type_t ret(*c_type);
+  ret.m_is_const = ret.m_is_const || is_const;
+  ret.m_is_volatile = ret.m_is_volatile || is_volatile;
+  ret.m_is_restrict = ret.m_is_restrict || is_restrict;
+  ret.m_is_atomic = ret.m_is_atomic || is_atomic;
+  return intern(ret);
+}
+
+c_type_t const*
+c_type_t::mk_function(c_type_t const* return_type,
+                      vector<c_type_t const*> const& param_types,
+                      bool is_vararg)
+{
+  c_type_t ret(FUNCTION, return_type);
+  ret.m_param_types = param_types;
+  ret.m_is_vararg = is_vararg;
+  return intern(ret);
+}
+
+c_type_t const*
+c_type_t::get_int_type()
+{
+  static c_type_t const* const int_type = mk_base_type(INT, false, false, false);
+  return int_type;
+}
+
+c_type_t const*
+c_type_t::get_long_type()
+{
+  static c_type_t const* const long_type = mk_base_type(LONG_INT, false, false, false);
+  return long_type;
+}
+
+c_type_t const*
+c_type_t::get_double_type()
+{
+  static c_type_t const* const double_type = mk_base_type(DOUBLE, false, false, false);
+  return double_type;
+}
+
+c_type_t const*
+c_type_t::get_void_type()
+{
+  static c_type_t const* const void_type = mk_base_type(VOID, false, false, false);
+  return void_type;
+}
+
+c_type_t const*
+c_type_t::integer_promotion(c_type_t const* c_type)
+{
+  if (c_type->is_integer() && c_type->get_base_type() < INT) {
+    return c_type_t::get_int_type();
+  }
+  return c_type;
+}
+
+c_type_t const*
+c_type_t::usual_arithmetic_conversion(c_type_t const* a, c_type_t const* b)
+{
+  assert(a->is_arithmetic() && b->is_arithmetic());
+  if (a->is_floating() || b->is_floating()) {
+    if (!b->is_floating() || (a->is_floating() && a->get_base_type() >= b->get_base_type())) {
+      return a;
+    }
+    return b;
+  }
+  a = c_type_t::integer_promotion(a);
+  b = c_type_t::integer_promotion(b);
+  if (a->get_base_type() == b->get_base_type()) {
+    return a->is_signed_integer() ? b : a;
+  }
+  c_type_t const* higher = a->get_base_type() > b->get_base_type() ? a : b;
+  c_type_t const* lower = higher == a ? b : a;
+  if (higher->is_signed_integer() && !lower->is_signed_integer() &&
+      higher->get_base_type() == LONG_LONG_INT && lower->get_base_type() == LONG_INT) {
+    // long and long long have the same width, so the signed one cannot hold all values
+    return c_type_t::mk_base_type(LONG_LONG_INT, false, false, true);
+  }
+  return higher;
+}
@@ -2,9 +2,15 @@
 
 #include <assert.h>
 #include <string>
+#include <vector>
+
+#include "stats.h"
 
 using namespace std;
 
+// Types are made through the mk_ functions and never change afterwards.
+// Equal types are a single instance, so there are as many as the unit has
+// distinct types however long it is.
 class c_type_t
 {
 public:
@@ -21,29 +27,100 @@ public:
     FLOAT,
     DOUBLE,
     LONG_DOUBLE,
+    POINTER,
+    FUNCTION,
   };
 
-  c_type_t(base_type_t base_type,
-           bool is_const,
-           bool is_signed,
-           bool is_unsigned) :
-    m_base_type(base_type),
-    m_is_const(is_const),
-    m_is_signed(is_signed),
-    m_is_unsigned(is_unsigned)
+  string c_type_to_string() const;
+
+  base_type_t get_base_type() const { return this->m_base_type; }
+  bool get_is_const() const { return this->m_is_const; }
+  bool get_is_volatile() const { return this->m_is_volatile; }
+  // only pointers can be restrict-qualified
+  bool get_is_restrict() const { return this->m_is_restrict; }
+  // every access to an _Atomic object is atomic, sequentially consistent
+  // unless an atomic_*_explicit function says otherwise
+  bool get_is_atomic() const { return this->m_is_atomic; }
+  bool is_qualified() const
+  {
+    return this->m_is_const || this->m_is_volatile || this->m_is_restrict || this->m_is_atomic;
+  }
+  bool is_void() const { return this->m_base_type == VOID; }
+  bool is_pointer() const { return this->m_base_type == POINTER; }
+  bool is_function() const { return this->m_base_type == FUNCTION; }
+  bool is_integer() const { return this->m_base_type >= BOOL && this->m_base_type <= LONG_LONG_INT; }
+  bool is_floating() const { return this->m_base_type >= FLOAT && this->m_base_type <= LONG_DOUBLE; }
+  bool is_arithmetic() const { return this->is_integer() || this->is_floating(); }
+  bool is_scalar() const { return this->is_arithmetic() || this->is_pointer(); }
+  // plain char is treated as signed
+  bool is_signed_integer() const
+  {
+    return this->is_integer() && this->m_base_type != BOOL && !this->m_is_unsigned;
+  }
+  // Arithmetic in the type overflowing is undefined (C11 6.5p5): the signed
+  // integers from int up, the narrower ones being promoted to int first
+  bool has_undefined_overflow() const
+  {
+    return this->is_signed_integer() && this->m_base_type >= INT;
+  }
+  c_type_t const* get_pointee_type() const { assert(this->is_pointer()); return this->m_derived_from; }
+  c_type_t const* get_return_type() const { assert(this->is_function()); return this->m_derived_from; }
+  vector<c_type_t const*> const& get_param_types() const
   {
-    assert(!is_signed || !is_unsigned);
-    assert(!is_const || base_type_can_have_sign_keywords(base_type));
+    assert(this->is_function());
+    return this->m_param_types;
   }
+  bool get_is_vararg() const { assert(this->is_function()); return this->m_is_vararg; }
+  bool is_same_type(c_type_t const* other) const;
 
-  string c_type_to_string() const;
+  static c_type_t const* mk_base_type(base_type_t base_type, bool is_const, bool is_signed, bool is_unsigned);
+  static c_type_t const* mk_pointer(c_type_t const* pointee);
+  // c_type with the given qualifiers added to its own, c_type itself if it
+  // already has them
+  static c_type_t const* mk_qualified(c_type_t const* c_type,
+                                      bool is_const,
+                                      bool is_volatile,
+                                      bool is_restrict,
+                                      bool is_atomic);
+  static c_type_t const* mk_function(c_type_t const* return_type,
+                               vector<c_type_t const*> const& param_types,
+                               bool is_vararg);
+  static c_type_t const* get_int_type();
+  static c_type_t const* get_long_type();
+  static c_type_t const* get_double_type();
+  static c_type_t const* get_void_type();
+  static c_type_t const* integer_promotion(c_type_t const* c_type);
+  static c_type_t const* usual_arithmetic_conversion(c_type_t const* a, c_type_t const* b);
 
   static string base_type_to_string(base_type_t base_type);
   static bool base_type_can_have_sign_keywords(base_type_t base_type);
 private:
+  struct hash_t
+  {
+    size_t operator()(c_type_t const* c_type) const;
+  };
+  struct equal_t
+  {
+    bool operator()(c_type_t const* a, c_type_t const* b) const;
+  };
+
+  c_type_t(base_type_t base_type, c_type_t const* derived_from) :
+    m_base_type(base_type),
+    m_derived_from(derived_from)
+  { }
+
+  // The instance equal to c_type, a copy of it if there is none yet
+  static c_type_t const* intern(c_type_t const& c_type);
+
   base_type_t m_base_type = NO_TYPE;
   bool m_is_const = false;
+  bool m_is_volatile = false;
+  bool m_is_restrict = false;
+  bool m_is_atomic = false;
   bool m_is_signed = false;
   bool m_is_unsigned = false;
+  // pointee type for POINTER, return type for FUNCTION
+  c_type_t const* m_derived_from = nullptr;
+  vector<c_type_t const*> m_param_types;
+  bool m_is_vararg = false;
 };
-
@@ -3,13 +3,165 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "ast.h"
-#include "c.tab.hpp"
-#include "lex.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <unistd.h>
+
+#include "compiler.h"
+#include "diagnostics.h"
+#include "llvm_codegen.h"
+#include "llvm_lto.h"
+#include "llvm_optimizer.h"
+#include "llvm_target.h"
+#include "lsp.h"
+#include "stats.h"
+#include "trace.h"
+
+// Number of LLVM contexts shared by all the inputs of a batch. Two are enough
+// to overlap writing file N (on the writer thread) with compiling file N+1.
+#define CONTEXT_POOL_SIZE 2
+
+using namespace std;
 
 static void usage()
 {
-  printf("Usage: cc <prog.c>\n");
+  printf("Usage: cc <prog.c|->... [--show-ast] [-O<0-3>] [-Rpass=<regex>] [-Rpass-missed=<regex>]\n"
+         "          [--report-tail-calls] [--branchless=aggressive|auto|off] [--time-sema] [--stats[=text|json]]\n"
+         "          [--lazy-bodies] [--signatures-only] [--stream] [--trace=<category>[,<category>]...[:<1-3>]]\n"
+         "          [--profile-generate[=<file>]] [--profile-use=<file>]\n"
+         "          [--target=<triple>] [-march=<cpu>|native] [-mcpu=<cpu>|native] [-mattr=<+feature,-feature>]\n"
+         "          [-ftls-model=<global-dynamic|local-dynamic|initial-exec|local-exec>] [-fpic|-fPIC|-fno-pic]\n"
+         "          [-ffast-math] [-funsafe-math-optimizations] [-ffinite-math-only] [-ffp-contract=off|on|fast]\n"
+         "          [-fwrapv|-ftrapv]\n"
+         "          [-flto] [-o <file>] [--export=<symbol>]...\n"
+         "       cc --link-lto <unit.bc>... [-o <file>] [--export=<symbol>]... [-O<0-3>]\n"
+         "       cc @<files.rsp> [options]\n"
+         "       cc --lsp\n");
+}
+
+// Background thread that prints finished modules to their output files so that
+// the next translation unit can be compiled meanwhile. A module is always
+// written (and destroyed) before its context is handed out again.
+class module_writer_t
+{
+public:
+  module_writer_t() : m_thread(&module_writer_t::run, this) { }
+  ~module_writer_t()
+  {
+    {
+      lock_guard<mutex> lock(m_mutex);
+      m_done = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+  }
+
+  void enqueue(size_t ctx_idx, unique_ptr<llvm::Module> module, string output_filename)
+  {
+    {
+      lock_guard<mutex> lock(m_mutex);
+      m_busy[ctx_idx] = true;
+      m_queue.push_back({ctx_idx, std::move(module), output_filename});
+    }
+    m_cv.notify_all();
+  }
+  void wait_for_ctx(size_t ctx_idx)
+  {
+    unique_lock<mutex> lock(m_mutex);
+    m_cv.wait(lock, [&] { return !m_busy[ctx_idx]; });
+  }
+  bool get_has_failed() const { return this->m_has_failed; }
+private:
+  struct job_t
+  {
+    size_t ctx_idx;
+    unique_ptr<llvm::Module> module;
+    string output_filename;
+  };
+
+  void run()
+  {
+    for (;;) {
+      job_t job;
+      {
+        unique_lock<mutex> lock(m_mutex);
+        m_cv.wait(lock, [&] { return m_done || !m_queue.empty(); });
+        if (m_queue.empty()) {
+          return;
+        }
+        job = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      if (!llvm_write_module(*job.module, job.output_filename)) {
+        m_has_failed = true;
+      }
+      job.module.reset();
+      {
+        lock_guard<mutex> lock(m_mutex);
+        m_busy[job.ctx_idx] = false;
+      }
+      m_cv.notify_all();
+    }
+  }
+
+  mutex m_mutex;
+  condition_variable m_cv;
+  deque<job_t> m_queue;
+  bool m_busy[CONTEXT_POOL_SIZE] = { };
+  bool m_done = false;
+  bool m_has_failed = false;
+  thread m_thread;
+};
+
+// Expands "@files.rsp" into the whitespace separated file names it lists
+static bool read_response_file(char const* rsp_filename, vector<string>& filenames)
+{
+  ifstream rsp(rsp_filename);
+  if (!rsp) {
+    cout << "Cannot open response file: " << rsp_filename << endl;
+    return false;
+  }
+  string filename;
+  while (rsp >> filename) {
+    filenames.push_back(filename);
+  }
+  return true;
+}
+
+static void print_stats(string const& format)
+{
+  if (format == "json") {
+    stats_t::print_json(stderr);
+  }
+  else if (format == "text") {
+    stats_t::print_text(stderr);
+  }
+}
+
+// Internalizes and optimizes the merged program, then writes it
+static bool finish_lto(llvm_lto_t& lto,
+                       set<string> const& exported,
+                       unsigned opt_level,
+                       llvm::TargetMachine* target_machine,
+                       string const& output_filename)
+{
+  lto.internalize(exported);
+  unique_ptr<llvm::Module> module = lto.release_module();
+  llvm_optimizer_t optimizer(opt_level, target_machine, llvm_optimizer_t::LTO);
+  optimizer.optimize(*module);
+  count_ir_stats(*module, "lto");
+  return llvm_write_module(*module, output_filename);
+}
+
+static double elapsed_ms(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
 }
 
 int
@@ -19,27 +171,316 @@ main(int argc, char **argv)
     usage();
     exit(1);
   }
-  char const *filename = argv[1];
-  yyin = fopen(filename, "r");
-  assert(yyin);
+  if (strcmp(argv[1], "--lsp") == 0) {
+    // The protocol owns stdout, anything else printed goes to stderr
+    FILE* out = fdopen(dup(STDOUT_FILENO), "w");
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    lsp_server_t server;
+    return server.run(stdin, out);
+  }
 
+  vector<string> filenames;
   bool show_ast = false;
-  for (int i = 2;i < argc;i++) {
+  bool is_batch = false;
+  bool time_sema = false;
+  // function bodies are skipped and parsed when sema gets to them
+  bool is_lazy = false;
+  // only declarations and function signatures are checked, nothing is written
+  bool is_signatures_only = false;
+  // the nodes of each external declaration are freed once it is lowered
+  bool is_streaming = false;
+  unsigned trace_categories = 0;
+  unsigned trace_level = 0;
+  string stats_format;
+  unsigned opt_level = 0;
+  string passed_remarks_regex;
+  string missed_remarks_regex;
+  llvm_codegen_options_t codegen_options;
+  profile_data_t profile;
+  string target_triple;
+  string target_cpu;
+  string target_features;
+  bool is_lto = false;
+  bool is_link_lto = false;
+  string output_filename;
+  set<string> exported;
+  for (int i = 1;i < argc;i++) {
     if (strcmp(argv[i], "--show-ast") == 0) {
       show_ast = true;
     }
+    else if (strcmp(argv[i], "--report-tail-calls") == 0) {
+      codegen_options.report_tail_calls = true;
+    }
+    else if (strcmp(argv[i], "--branchless=aggressive") == 0) {
+      codegen_options.branchless = branchless_t::AGGRESSIVE;
+    }
+    else if (strcmp(argv[i], "--branchless=auto") == 0) {
+      codegen_options.branchless = branchless_t::AUTO;
+    }
+    else if (strcmp(argv[i], "--branchless=off") == 0) {
+      codegen_options.branchless = branchless_t::OFF;
+    }
+    else if (strcmp(argv[i], "--time-sema") == 0) {
+      time_sema = true;
+    }
+    else if (strncmp(argv[i], "--trace=", 8) == 0) {
+      if (!trace_t::parse_spec(argv[i] + 8, trace_categories, trace_level)) {
+        cout << "Invalid trace: " << argv[i] + 8 << endl;
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "--lazy-bodies") == 0) {
+      is_lazy = true;
+    }
+    else if (strcmp(argv[i], "--signatures-only") == 0) {
+      is_lazy = true;
+      is_signatures_only = true;
+    }
+    else if (strcmp(argv[i], "--stream") == 0) {
+      is_streaming = true;
+    }
+    else if (strcmp(argv[i], "--stats") == 0) {
+      stats_format = "text";
+    }
+    else if (strcmp(argv[i], "--stats=text") == 0 || strcmp(argv[i], "--stats=json") == 0) {
+      stats_format = argv[i] + 8;
+    }
+    else if (strcmp(argv[i], "--profile-generate") == 0) {
+      codegen_options.profile_generate_file = "default.ccprof";
+    }
+    else if (strncmp(argv[i], "--profile-generate=", 19) == 0) {
+      codegen_options.profile_generate_file = argv[i] + 19;
+    }
+    else if (strncmp(argv[i], "--profile-use=", 14) == 0) {
+      if (!profile.read(argv[i] + 14)) {
+        exit(1);
+      }
+      codegen_options.profile_use = &profile;
+    }
+    else if (strncmp(argv[i], "-O", 2) == 0 && strlen(argv[i]) == 3 &&
+             argv[i][2] >= '0' && argv[i][2] <= '3') {
+      opt_level = argv[i][2] - '0';
+    }
+    else if (strncmp(argv[i], "-ftls-model=", 12) == 0) {
+      if (!llvm_codegen_t::get_tls_model(argv[i] + 12, codegen_options.tls_model)) {
+        cout << "Invalid TLS model: " << argv[i] + 12 << endl;
+        exit(1);
+      }
+    }
+    else if (strcmp(argv[i], "-fpic") == 0 || strcmp(argv[i], "-fPIC") == 0) {
+      codegen_options.is_pic = true;
+    }
+    else if (strcmp(argv[i], "-fno-pic") == 0 || strcmp(argv[i], "-fno-PIC") == 0) {
+      codegen_options.is_pic = false;
+    }
+    else if (strcmp(argv[i], "-ffast-math") == 0) {
+      codegen_options.fp_mode.flags.setFast();
+      codegen_options.fp_mode.flags.setAllowContract(false);
+      codegen_options.fp_mode.contract = fp_contract_t::FAST;
+    }
+    else if (strcmp(argv[i], "-funsafe-math-optimizations") == 0) {
+      codegen_options.fp_mode.flags.setAllowReassoc();
+      codegen_options.fp_mode.flags.setNoSignedZeros();
+      codegen_options.fp_mode.flags.setAllowReciprocal();
+      codegen_options.fp_mode.flags.setApproxFunc();
+    }
+    else if (strcmp(argv[i], "-ffinite-math-only") == 0) {
+      codegen_options.fp_mode.flags.setNoNaNs();
+      codegen_options.fp_mode.flags.setNoInfs();
+    }
+    else if (strcmp(argv[i], "-ffp-contract=off") == 0) {
+      codegen_options.fp_mode.contract = fp_contract_t::OFF;
+    }
+    else if (strcmp(argv[i], "-ffp-contract=on") == 0) {
+      codegen_options.fp_mode.contract = fp_contract_t::ON;
+    }
+    else if (strcmp(argv[i], "-ffp-contract=fast") == 0) {
+      codegen_options.fp_mode.contract = fp_contract_t::FAST;
+    }
+    else if (strcmp(argv[i], "-fwrapv") == 0) {
+      codegen_options.signed_overflow = signed_overflow_t::WRAP;
+    }
+    else if (strcmp(argv[i], "-ftrapv") == 0) {
+      codegen_options.signed_overflow = signed_overflow_t::TRAP;
+    }
+    else if (strcmp(argv[i], "-flto") == 0) {
+      is_lto = true;
+    }
+    else if (strcmp(argv[i], "--link-lto") == 0) {
+      is_link_lto = true;
+    }
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output_filename = argv[++i];
+    }
+    else if (strncmp(argv[i], "--export=", 9) == 0) {
+      exported.insert(argv[i] + 9);
+    }
+    else if (strncmp(argv[i], "--target=", 9) == 0) {
+      target_triple = argv[i] + 9;
+    }
+    else if (strncmp(argv[i], "-march=", 7) == 0 || strncmp(argv[i], "-mcpu=", 6) == 0) {
+      target_cpu = strchr(argv[i], '=') + 1;
+    }
+    else if (strncmp(argv[i], "-mattr=", 7) == 0) {
+      target_features = argv[i] + 7;
+    }
+    else if (strncmp(argv[i], "-Rpass=", 7) == 0) {
+      passed_remarks_regex = argv[i] + 7;
+    }
+    else if (strncmp(argv[i], "-Rpass-missed=", 14) == 0) {
+      missed_remarks_regex = argv[i] + 14;
+    }
+    else if (argv[i][0] == '@') {
+      if (!read_response_file(argv[i] + 1, filenames)) {
+        exit(1);
+      }
+      is_batch = true;
+    }
+    else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) {
+      // "-" reads the program from stdin
+      filenames.push_back(argv[i]);
+    }
     else {
       std::cout << "Invalid arg: " << argv[i] << std::endl;
       exit(1);
     }
   }
+  if (filenames.empty()) {
+    usage();
+    exit(1);
+  }
+  if (!codegen_options.profile_generate_file.empty() && codegen_options.profile_use) {
+    cout << "--profile-generate and --profile-use are exclusive" << endl;
+    exit(1);
+  }
+  if (is_streaming && show_ast) {
+    cout << "--stream and --show-ast are exclusive" << endl;
+    exit(1);
+  }
+  if (is_lto && is_link_lto) {
+    cout << "-flto and --link-lto are exclusive" << endl;
+    exit(1);
+  }
+  if (!output_filename.empty() && !is_lto && !is_link_lto && filenames.size() > 1) {
+    cout << "-o with several inputs needs -flto or --link-lto" << endl;
+    exit(1);
+  }
+  if (is_link_lto && output_filename.empty()) {
+    output_filename = "a.out.ll";
+  }
+  is_batch = is_batch || filenames.size() > 1;
+  if (trace_categories != 0) {
+    trace_t::start(trace_categories, trace_level, stderr);
+  }
 
-  translation_unit_n *root = new translation_unit_n(filename);
-  int ret = yyparse(&root);
-  if (show_ast) {
-    std::cout << root->to_string_ast() << "\n\n";
+  llvm::LLVMContext ctx_pool[CONTEXT_POOL_SIZE];
+  for (size_t i = 0;i < CONTEXT_POOL_SIZE;i++) {
+    if (!llvm_set_remark_filters(ctx_pool[i], passed_remarks_regex, missed_remarks_regex)) {
+      cout << "Invalid remark regex" << endl;
+      exit(1);
+    }
+  }
+  string target_error;
+  unique_ptr<llvm_target_t> target = llvm_target_t::create(target_triple,
+                                                           target_cpu,
+                                                           target_features,
+                                                           codegen_options.is_pic,
+                                                           target_error);
+  if (!target) {
+    cout << target_error << endl;
+    exit(1);
+  }
+  codegen_options.target = target.get();
+  if (is_link_lto) {
+    llvm_lto_t lto(ctx_pool[0], output_filename);
+    for (auto const& filename : filenames) {
+      if (!lto.add_file(filename)) {
+        exit(1);
+      }
+    }
+    bool is_linked = finish_lto(lto, exported, opt_level, target->get_target_machine(), output_filename);
+    trace_t::stop();
+    print_stats(stats_format);
+    return is_linked ? 0 : 1;
+  }
+  // -flto with -o links the units in-process, in the first context
+  unique_ptr<llvm_lto_t> lto;
+  if (is_lto && !output_filename.empty()) {
+    lto = make_unique<llvm_lto_t>(ctx_pool[0], output_filename);
+  }
+  llvm_optimizer_t optimizer(opt_level,
+                             target->get_target_machine(),
+                             is_lto ? llvm_optimizer_t::LTO_PRE_LINK : llvm_optimizer_t::PER_MODULE);
+  module_writer_t writer;
+  bool has_failed = false;
+  size_t total_bytes = 0;
+  auto batch_start = chrono::steady_clock::now();
+  compile_options_t compile_options;
+  compile_options.codegen = codegen_options;
+  compile_options.optimizer = &optimizer;
+  compile_options.is_lazy = is_lazy;
+  compile_options.is_signatures_only = is_signatures_only;
+  compile_options.is_streaming = is_streaming;
+  compile_options.dumps_ast = show_ast;
+  for (size_t i = 0;i < filenames.size();i++) {
+    char const *filename = filenames[i].c_str();
+    bool is_stdin = filenames[i] == "-";
+    FILE* input = is_stdin ? stdin : fopen(filename, "r");
+    if (!input) {
+      cout << "Cannot open input file: " << filename << endl;
+      has_failed = true;
+      continue;
+    }
+    auto file_start = chrono::steady_clock::now();
+    size_t ctx_idx = lto ? 0 : i % CONTEXT_POOL_SIZE;
+    string stem = is_stdin ? "stdin" : filenames[i].substr(0, filenames[i].size() - 2);
+    string unit_output_filename = is_lto ? stem + ".bc" :
+                                  !output_filename.empty() ? output_filename : stem + ".ll";
+    diagnostics_t diagnostics;
+    writer.wait_for_ctx(ctx_idx);
+    compile_result_t result = compile_translation_unit(ctx_pool[ctx_idx], input, filename, compile_options, diagnostics);
+    if (!is_stdin) {
+      fclose(input);
+    }
+    if (show_ast) {
+      std::cout << result.ast << "\n\n";
+    }
+    printf("retv = %d\n", result.parse_status);
+    if (time_sema) {
+      printf("sema: %s: %zu nodes (%zu expressions) in %.3f ms (%.1f ns/node)\n",
+             filename, result.num_nodes, result.num_expressions, result.sema_ms,
+             result.num_nodes ? result.sema_ms * 1e6 / result.num_nodes : 0.0);
+    }
+    if (result.module) {
+      if (lto) {
+        has_failed = !lto->add_module(std::move(result.module)) || has_failed;
+      }
+      else {
+        writer.enqueue(ctx_idx, std::move(result.module), unit_output_filename);
+      }
+    }
+    else if (result.has_error) {
+      has_failed = true;
+    }
+    total_bytes += result.num_bytes;
+    if (is_batch) {
+      double ms = elapsed_ms(file_start);
+      printf("%s: %zu bytes in %.3f ms (%.1f KB/s)\n",
+             filename, result.num_bytes, ms, result.num_bytes / 1024.0 / (ms / 1000.0));
+    }
+  }
+  for (size_t i = 0;i < CONTEXT_POOL_SIZE;i++) {
+    writer.wait_for_ctx(i);
+  }
+  if (lto && !has_failed) {
+    has_failed = !finish_lto(*lto, exported, opt_level, target->get_target_machine(), output_filename);
+  }
+  if (is_batch) {
+    double ms = elapsed_ms(batch_start);
+    printf("total: %zu files, %zu bytes in %.3f ms (%.1f KB/s)\n",
+           filenames.size(), total_bytes, ms, total_bytes / 1024.0 / (ms / 1000.0));
   }
-  printf("retv = %d\n", ret);
-  root->llvm_codegen();
-  exit(0);
+  trace_t::stop();
+  print_stats(stats_format);
+  return has_failed || writer.get_has_failed() ? 1 : 0;
 }
@@ -0,0 +1,130 @@
+#include <chrono>
+
+#include "ast.h"
+#include "compiler.h"
+#include "lex.h"
+#include "parse.h"
+#include "sema.h"
+#include "stats.h"
+
+using namespace std;
+
+static double elapsed_ms(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void
+count_ir_stats(llvm::Module const& module, string const& phase)
+{
+#ifndef NO_STATS
+  uint64_t* num_functions = stats_t::get_counter("ir." + phase + ".functions");
+  uint64_t* num_blocks = stats_t::get_counter("ir." + phase + ".blocks");
+  uint64_t* num_insts = stats_t::get_counter("ir." + phase + ".instructions");
+  uint64_t* max_blocks = stats_t::get_counter("ir." + phase + ".max_function_blocks");
+  uint64_t* max_insts = stats_t::get_counter("ir." + phase + ".max_function_instructions");
+  for (llvm::Function const& function : module) {
+    if (function.isDeclaration()) {
+      continue;
+    }
+    uint64_t function_insts = function.getInstructionCount();
+    (*num_functions)++;
+    *num_blocks += function.size();
+    *num_insts += function_insts;
+    *max_blocks = max(*max_blocks, (uint64_t)function.size());
+    *max_insts = max(*max_insts, function_insts);
+  }
+#endif
+}
+
+compile_result_t
+compile_translation_unit(llvm::LLVMContext& ctx,
+                         FILE* input,
+                         string const& filename,
+                         compile_options_t const& options,
+                         diagnostics_t& diagnostics)
+{
+  compile_result_t result;
+  size_t num_errors = diagnostics.get_num_errors();
+  lexer_t lexer(input);
+  unique_ptr<translation_unit_n> root(new translation_unit_n(filename, ""));
+  // errors are reported as they come, located with the lines read so far
+  diagnostics.set_filename(filename);
+  diagnostics.set_line_starts(&lexer.get_line_starts());
+  sema_t sema;
+  sema.set_diagnostics(&diagnostics);
+  sema.set_analyzes_bodies(!options.is_signatures_only);
+  sema.start_unit(root.get());
+  llvm_codegen_t cg(ctx, filename, sema, options.codegen);
+  // Every node of the unit goes in arena, which frees them once they are
+  // lowered. With is_streaming, only the symbol table, the types and the
+  // module outlive a declaration, and memory is bounded by the largest
+  // declaration rather than by the unit.
+  node_arena_t arena;
+  node_arena_t* outer_arena = node_arena_t::get_thread_arena();
+  node_arena_t::set_thread_arena(&arena);
+  result.parse_status = parse_translation_unit(lexer, root.get(), [&](external_declaration_n* external_declaration, source_range_t const&) {
+    auto sema_start = chrono::steady_clock::now();
+    sema.analyze(external_declaration);
+    result.sema_ms += elapsed_ms(sema_start);
+    if (!sema.get_has_error() && !options.is_signatures_only) {
+      external_declaration->llvm_codegen(cg);
+    }
+    if (options.is_streaming) {
+      root->clear();
+      sema.release_declarations();
+      arena.release();
+    }
+  }, [&](string const& msg, source_range_t const& range) {
+    diagnostics.error(&range, msg);
+  }, options.is_lazy);
+  result.num_bytes = lexer.get_num_bytes();
+  result.num_nodes = sema.get_num_nodes();
+  result.num_expressions = sema.get_num_expressions();
+  STATS_ADD("sema.nodes", result.num_nodes);
+  STATS_ADD("sema.expressions", result.num_expressions);
+  if (options.dumps_ast && !options.is_streaming) {
+    result.ast = root->to_string_ast();
+  }
+  if (result.parse_status == 0 && !sema.get_has_error() && !options.is_signatures_only) {
+    result.module = cg.finish();
+  }
+  result.has_error = result.parse_status != 0 || diagnostics.get_num_errors() > num_errors ||
+                     (!result.module && !options.is_signatures_only);
+  if (result.has_error) {
+    result.module.reset();
+  }
+  if (result.module) {
+    count_ir_stats(*result.module, "codegen");
+    if (options.optimizer) {
+      options.optimizer->optimize(*result.module);
+      count_ir_stats(*result.module, "opt");
+    }
+  }
+  root->clear();
+  arena.release();
+  node_arena_t::set_thread_arena(outer_arena);
+  diagnostics.set_line_starts(nullptr);
+  return result;
+}
+
+compile_result_t
+compile_translation_unit(llvm::LLVMContext& ctx,
+                         llvm::StringRef source,
+                         string const& filename,
+                         compile_options_t const& options,
+                         diagnostics_t& diagnostics)
+{
+  // a stream over the bytes, without a copy or a file
+  FILE* input = fmemopen((void*)(source.empty() ? "" : source.data()), source.size(), "r");
+  if (input == nullptr) {
+    compile_result_t result;
+    diagnostics.set_filename(filename);
+    diagnostics.error(nullptr, "cannot read the source");
+    result.has_error = true;
+    return result;
+  }
+  compile_result_t result = compile_translation_unit(ctx, input, filename, options, diagnostics);
+  fclose(input);
+  return result;
+}
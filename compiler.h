@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include "diagnostics.h"
+#include "llvm_codegen.h"
+#include "llvm_optimizer.h"
+
+using namespace std;
+
+// The compiler as a library, what cc runs for each of its inputs. A call
+// reads one translation unit and returns its module, it keeps no state
+// between calls, creates no file and prints nothing: errors, warnings and
+// the notes of report_tail_calls go to diagnostics. Calls in different
+// threads may run at once as long as each thread has its own ctx,
+// optimizer and target, which LLVM does not synchronize. Build libcc with
+// -DNO_STATS (make lib does), the --stats counters are shared by the whole
+// process.
+struct compile_options_t
+{
+  llvm_codegen_options_t codegen;
+  // pipeline run over the module, nullptr to leave it as lowered
+  llvm_optimizer_t* optimizer = nullptr;
+  // function bodies are skipped and parsed when sema gets to them
+  bool is_lazy = false;
+  // only declarations and function signatures are checked, no module is made
+  bool is_signatures_only = false;
+  // the nodes of each external declaration are freed once it is lowered
+  // rather than with the unit
+  bool is_streaming = false;
+  // the unit is printed into compile_result_t::ast, before it is freed
+  bool dumps_ast = false;
+};
+
+struct compile_result_t
+{
+  // nullptr if the unit has an error, and with is_signatures_only
+  unique_ptr<llvm::Module> module;
+  bool has_error = false;
+  // 0 if the unit parsed, like yyparse
+  int parse_status = 0;
+  size_t num_bytes = 0;
+  // nodes and expressions sema went through, and its time
+  size_t num_nodes = 0;
+  size_t num_expressions = 0;
+  double sema_ms = 0;
+  // with dumps_ast, empty with is_streaming
+  string ast;
+};
+
+// Compiles the unit read from input into a module of ctx. Each declaration
+// goes through sema and codegen as soon as it is parsed, which overlaps them
+// with reading the rest of a pipe. filename names the module and locates
+// the diagnostics.
+compile_result_t compile_translation_unit(llvm::LLVMContext& ctx,
+                                          FILE* input,
+                                          string const& filename,
+                                          compile_options_t const& options,
+                                          diagnostics_t& diagnostics);
+// Compiles the unit in source, which is read where it is
+compile_result_t compile_translation_unit(llvm::LLVMContext& ctx,
+                                          llvm::StringRef source,
+                                          string const& filename,
+                                          compile_options_t const& options,
+                                          diagnostics_t& diagnostics);
+
+// Counts the functions, blocks and instructions of module after phase, for
+// --stats
+void count_ir_stats(llvm::Module const& module, string const& phase);
@@ -0,0 +1,60 @@
+#include <algorithm>
+
+#include "diagnostics.h"
+
+using namespace std;
+
+void
+diagnostics_t::report(severity_t severity, source_range_t const* range, string const& message)
+{
+  if (severity == ERROR) {
+    this->m_num_errors++;
+  }
+  diagnostic_t diagnostic = {severity, range, message};
+  if (this->m_handler) {
+    this->m_handler(diagnostic);
+  }
+  else {
+    this->print(stderr, diagnostic);
+  }
+}
+
+char const*
+diagnostics_t::severity_to_string(severity_t severity)
+{
+  switch (severity) {
+    case NOTE: return "note";
+    case WARNING: return "warning";
+    case ERROR: return "error";
+  }
+  NOT_REACHED();
+}
+
+bool
+diagnostics_t::get_line_column(size_t offset, size_t& line, size_t& column) const
+{
+  if (this->m_line_starts == nullptr) {
+    return false;
+  }
+  auto it = upper_bound(this->m_line_starts->begin(), this->m_line_starts->end(), offset);
+  size_t line_start = it == this->m_line_starts->begin() ? 0 : *(it - 1);
+  line = it - this->m_line_starts->begin() + 1;
+  column = offset - line_start + 1;
+  return true;
+}
+
+void
+diagnostics_t::print(FILE* out, diagnostic_t const& diagnostic) const
+{
+  string location = this->m_filename;
+  size_t line;
+  size_t column;
+  if (diagnostic.range != nullptr && this->get_line_column(diagnostic.range->begin, line, column)) {
+    location += ":" + to_string(line) + ":" + to_string(column);
+  }
+  // stdout may hold output printed before the diagnostic
+  fflush(stdout);
+  fprintf(out, "%s%s%s: %s\n",
+          location.c_str(), location.empty() ? "" : ": ",
+          severity_to_string(diagnostic.severity), diagnostic.message.c_str());
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+
+using namespace std;
+
+// Collects the errors and warnings of a translation unit, each with the
+// bytes of the source it is about. Sema and codegen report through one
+// instead of printing. Without a handler they are printed to stderr as they
+// come, as "file:line:col: error: message".
+class diagnostics_t
+{
+public:
+  enum severity_t
+  {
+    NOTE,
+    WARNING,
+    ERROR,
+  };
+
+  struct diagnostic_t
+  {
+    severity_t severity;
+    // nullptr if the diagnostic has no location
+    source_range_t const* range;
+    string message;
+  };
+
+  void set_filename(string const& filename) { this->m_filename = filename; }
+  // Offsets of the first byte of each line but the first, for printing
+  // line and column numbers. The vector may grow while it is set.
+  void set_line_starts(vector<size_t> const* line_starts) { this->m_line_starts = line_starts; }
+  // The diagnostics go to handler instead of stderr
+  void set_handler(function<void(diagnostic_t const&)> const& handler) { this->m_handler = handler; }
+
+  void report(severity_t severity, source_range_t const* range, string const& message);
+  void error(source_range_t const* range, string const& message) { this->report(ERROR, range, message); }
+  void warning(source_range_t const* range, string const& message) { this->report(WARNING, range, message); }
+  size_t get_num_errors() const { return this->m_num_errors; }
+  // Line and column of the byte at offset, from 1 and columns in bytes.
+  // Returns false if the line starts are not set.
+  bool get_line_column(size_t offset, size_t& line, size_t& column) const;
+
+  static char const* severity_to_string(severity_t severity);
+private:
+  void print(FILE* out, diagnostic_t const& diagnostic) const;
+
+  string m_filename;
+  vector<size_t> const* m_line_starts = nullptr;
+  function<void(diagnostic_t const&)> m_handler;
+  size_t m_num_errors = 0;
+};
@@ -0,0 +1,36 @@
+int printf(const char *fmt, ...);
+
+// every ++ and += is a single atomicrmw
+_Atomic long hits;
+// floating point atomics go through an integer of the same width
+_Atomic double total;
+_Atomic(int *) cursor;
+
+// a compare-and-swap loop, a failed exchange stores the value found in seen
+int bump_max(_Atomic int *max, int v)
+{
+  int seen;
+  seen = atomic_load_explicit(max, memory_order_relaxed);
+  while (seen < v && !atomic_compare_exchange_weak(max, &seen, v)) {
+  }
+  return seen;
+}
+
+int main()
+{
+  _Atomic int max;
+  int slot;
+  int i;
+  atomic_init(&max, 0);
+  for (i = 0;i < 10;i++) {
+    hits++;
+    hits += 2;
+    total += 0.5;
+    bump_max(&max, i % 7);
+  }
+  atomic_store_explicit(&cursor, &slot, memory_order_release);
+  atomic_thread_fence(memory_order_seq_cst);
+  printf("%ld %f %d %d %d\n", hits, total, max,
+         atomic_load_explicit(&cursor, memory_order_acquire) == &slot, atomic_is_lock_free(&hits));
+  return 0;
+}
@@ -0,0 +1,71 @@
+int printf(const char *fmt, ...);
+void *malloc(unsigned long n);
+
+// with -ffast-math, the sum may be reassociated into several partial sums,
+// so the loop vectorizes
+double dot(int n, double const *restrict x, double const *restrict y)
+{
+  double s;
+  int i;
+  s = 0.0;
+  for (i = 0;i < n;i++) {
+    s += x[i] * y[i];
+  }
+  return s;
+}
+
+// the same reduction, fast whatever the command line says
+double dot_fast(int n, double const *restrict x, double const *restrict y)
+{
+#pragma cc fp fast(on)
+  double s;
+  int i;
+  s = 0.0;
+  for (i = 0;i < n;i++) {
+    s += x[i] * y[i];
+  }
+  return s;
+}
+
+// a * b + c rounds once, llvm.fmuladd, where the target has an FMA
+#pragma STDC FP_CONTRACT ON
+double mul_add(double a, double b, double c)
+{
+  return a * b + c;
+}
+#pragma STDC FP_CONTRACT DEFAULT
+
+// Kahan summation only works if every operation rounds as written
+#pragma cc fp reassoc(off) contract(off)
+double kahan_sum(int n, double const *x)
+{
+  double s;
+  double c;
+  double y;
+  double t;
+  int i;
+  s = 0.0;
+  c = 0.0;
+  for (i = 0;i < n;i++) {
+    y = x[i] - c;
+    t = s + y;
+    c = (t - s) - y;
+    s = t;
+  }
+  return s;
+}
+
+int main()
+{
+  double *x;
+  double *y;
+  int i;
+  x = malloc(8 * 64);
+  y = malloc(8 * 64);
+  for (i = 0;i < 64;i++) {
+    x[i] = i;
+    y[i] = 0.5;
+  }
+  printf("%f %f %f %f\n", dot(64, x, y), dot_fast(64, x, y), mul_add(2.0, 3.0, 1.0), kahan_sum(64, x));
+  return 0;
+}
@@ -0,0 +1,46 @@
+int printf(const char *fmt, ...);
+
+int sum_to(int n)
+{
+  int s;
+  int i;
+  s = 0;
+#pragma cc loop vectorize(4) interleave(2)
+  for (i = 0;i < n;i++) {
+    s += i ^ 13;
+  }
+  return s;
+}
+
+int count_down(int n)
+{
+  int steps;
+  steps = 0;
+  #pragma cc loop unroll(4)
+  while (n > 0) {
+    n = n - 3;
+    steps++;
+    if (steps > 1000)
+      break;
+  }
+  return steps;
+}
+
+int collatz(int n)
+{
+  int k;
+  k = 0;
+#pragma   cc loop unroll(disable)
+  do {
+    if (n % 2 == 0) { n = n / 2; continue; }
+    n = 3 * n + 1;
+    k++;
+  } while (n != 1);
+  return k;
+}
+
+int main()
+{
+  printf("%d %d %d\n", sum_to(100), count_down(10), collatz(27));
+  return 0;
+}
@@ -0,0 +1,31 @@
+int printf(const char *fmt, ...);
+
+int classify(int x)
+{
+  switch (x % 4) {
+    case 0: return 10;
+    case 1: return 20;
+    default: break;
+  }
+  return x > 5 && x < 1000 ? 1 : 0;
+}
+
+static int rare(int x)
+{
+  return x * 3;
+}
+
+int main()
+{
+  int i;
+  int total;
+  total = 0;
+  for (i = 0;i < 1000;i++) {
+    if (i == 500)
+      total += rare(i);
+    else
+      total += classify(i);
+  }
+  printf("%d\n", total);
+  return 0;
+}
@@ -0,0 +1,56 @@
+int printf(const char *fmt, ...);
+void *malloc(unsigned long n);
+
+// loads of it are marked invariant, and the global is emitted as constant
+const int zero;
+// every access is a volatile load or store
+volatile int events;
+
+// x and y are noalias, so the loop vectorizes without a runtime overlap check
+void scale_add(int n, double a, double const *restrict x, double *restrict y)
+{
+  int i;
+  for (i = 0;i < n;i++) {
+    y[i] = a * x[i] + y[i];
+  }
+}
+
+// the int and the double stores carry different TBAA types, so the load of
+// *count need not be repeated after the store to *total
+int accumulate(int *count, double *total, double v)
+{
+  *total = *total + v;
+  events++;
+  return *count + 1;
+}
+
+void swap(int *a, int *b)
+{
+  int t;
+  t = *a;
+  *a = *b;
+  *b = t;
+}
+
+int main()
+{
+  double *x;
+  double *y;
+  int a;
+  int b;
+  int i;
+  int n;
+  x = malloc(8 * 16);
+  y = malloc(8 * 16);
+  for (i = 0;i < 16;i++) {
+    x[i] = i;
+    *(y + i) = 1.0;
+  }
+  scale_add(16, 2.0, x, y);
+  a = 1;
+  b = 2;
+  swap(&a, &b);
+  n = accumulate(&a, y, 1.0) + zero;
+  printf("%f %f %d %d %d %d\n", y[0], y[15], a, b, n, events);
+  return 0;
+}
@@ -0,0 +1,73 @@
+int printf(const char *fmt, ...);
+_Noreturn void exit(int status);
+
+static int counter;
+extern int shared;
+int shared;
+
+static int square(int x)
+{
+  return x * x;
+}
+
+inline int cube(int x)
+{
+  return x * x * x;
+}
+
+extern inline int twice(int x)
+{
+  return x + x;
+}
+
+inline int half(int x);
+int half(int x)
+{
+  return x / 2;
+}
+
+static int peek(void)
+{
+  return counter;
+}
+
+int next_id(void)
+{
+  static int id;
+  id++;
+  return id;
+}
+
+_Noreturn static void fail(int code)
+{
+  printf("fail %d\n", code);
+  exit(code);
+}
+
+int apply(int f(int), int x)
+{
+  return f(x);
+}
+
+static int negate(int x)
+{
+  return -x;
+}
+
+int main()
+{
+  register int i;
+  auto int total;
+  total = 0;
+  for (i = 0;i < 4;i++) {
+    total += square(i) + cube(i) + twice(i) + half(i);
+  }
+  counter = total;
+  next_id();
+  next_id();
+  shared = next_id();
+  printf("%d %d %d %d\n", total, peek(), shared, apply(negate, 5));
+  if (total != 64)
+    fail(3);
+  return 0;
+}
@@ -0,0 +1,40 @@
+int next_state(int state, int c)
+{
+	switch (state) {
+	case 0:
+		if (c == '/')
+			return 1;
+		return 0;
+	case 1:
+		if (c == '*')
+			return 2;
+	case 2:
+		if (c == '*')
+			return 3;
+		return 2;
+	case 3:
+		if (c == '/')
+			return 0;
+		return 2;
+	default:
+		break;
+	}
+	return -1;
+}
+
+int count_ops(int n)
+{
+	int ops;
+	ops = 0;
+	while (n > 0) {
+		switch (__builtin_expect(n % 8, 0)) {
+		case 0: ops += 4; break;
+		case 1:
+		case 2: ops += 2; break;
+		case 5: n = n-1; continue;
+		default: ops++;
+		}
+		n = n-1;
+	}
+	return ops;
+}
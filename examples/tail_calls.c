@@ -0,0 +1,58 @@
+int printf(const char *fmt, ...);
+
+long factorial(int n)
+{
+  if (n <= 1)
+    return 1;
+  return n * factorial(n - 1);
+}
+
+int sum(int n)
+{
+  if (n == 0)
+    return 0;
+  return sum(n - 1) + n;
+}
+
+int gcd(int a, int b)
+{
+  if (b == 0)
+    return a;
+  return gcd(b, a % b);
+}
+
+int countdown_steps;
+void countdown(int n)
+{
+  if (n == 0)
+    return;
+  countdown_steps++;
+  countdown(n - 1);
+}
+
+int fib(int n)
+{
+  if (n < 2)
+    return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+int twice(int a, int b)
+{
+  return gcd(a, b);
+}
+
+double halve(double x, int n)
+{
+  if (n == 0)
+    return x;
+  return halve(x / 2, n - 1);
+}
+
+int main()
+{
+  countdown(1000000);
+  printf("%ld %d %d %d %d %d %f\n", factorial(20), sum(1000000), gcd(1071, 462),
+         countdown_steps, fib(20), twice(12, 18), halve(1024.0, 10));
+  return 0;
+}
@@ -0,0 +1,25 @@
+int printf(const char *fmt, ...);
+
+__attribute__((target_clones("avx2", "sse4.2", "default")))
+int dot(int n)
+{
+  int s;
+  int i;
+  s = 0;
+  for (i = 0;i < n;i++) {
+    s += i * (i ^ 7);
+  }
+  return s;
+}
+
+__attribute__((target("avx2,no-bmi")))
+int twice(int x)
+{
+  return x + x;
+}
+
+int main()
+{
+  printf("%d %d\n", dot(1000), twice(21));
+  return 0;
+}
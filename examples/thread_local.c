@@ -0,0 +1,43 @@
+int printf(const char *fmt, ...);
+int pthread_create(long *thread, void *attr, void *start, void *arg);
+int pthread_join(long thread, void *ret);
+
+// defined here, so an executable reaches it at a fixed offset from the
+// thread pointer (local-exec) and -fpic code with __tls_get_addr
+_Thread_local long calls;
+// -fpic code only needs the offset within the library's block (local-dynamic)
+static _Thread_local int depth;
+// forced to initial-exec even with -fpic
+__attribute__((tls_model("initial-exec"))) _Thread_local int errors;
+_Atomic long total;
+
+int next_id()
+{
+  static _Thread_local int id;
+  calls++;
+  return ++id;
+}
+
+void *worker(void *arg)
+{
+  int i;
+  int id;
+  for (i = 0;i < 1000;i++) {
+    depth += 2;
+    id = next_id();
+  }
+  total += calls + depth + id;
+  return 0;
+}
+
+int main()
+{
+  long t1;
+  long t2;
+  pthread_create(&t1, 0, worker, 0);
+  pthread_create(&t2, 0, worker, 0);
+  pthread_join(t1, 0);
+  pthread_join(t2, 0);
+  printf("%ld %ld %d %d\n", total, calls, next_id(), errors);
+  return 0;
+}
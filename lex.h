@@ -2,7 +2,60 @@
 
 #include <stdio.h>
 
-// stuff from flex that bison needs to know about:
-extern "C" int yylex();
-extern "C" FILE *yyin;
+#include <functional>
+#include <vector>
 
+#include "ast.h"
+
+using namespace std;
+
+// the value of a token, defined by the parser
+union YYSTYPE;
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+
+// The flex scanner of one input. Every lexer has a state of its own, so
+// several threads can each scan an input at once.
+class lexer_t
+{
+public:
+  // Bytes and lines read so far, which the scanner actions update
+  struct state_t
+  {
+    // bytes read from the input
+    size_t num_bytes = 0;
+    // offset in the input of the next byte to scan, the token locations
+    // start from it
+    size_t offset = 0;
+    // offsets in the input of the first byte of every line but the first
+    vector<size_t> line_starts;
+    function<void(char const*, source_range_t const&)> on_error;
+  };
+
+  // Scans input, with read() so that the tokens of a pipe are scanned as
+  // they are written, or with fread() if it has no descriptor (fmemopen()).
+  // input stays open.
+  explicit lexer_t(FILE* input);
+  ~lexer_t();
+  lexer_t(lexer_t const&) = delete;
+  lexer_t& operator=(lexer_t const&) = delete;
+
+  // Scans the next token into value and range, 0 at the end of the input.
+  // A token text in value lives in the scanner buffer until the next call.
+  int lex(YYSTYPE* value, source_range_t* range);
+  size_t get_num_bytes() const { return this->m_state.num_bytes; }
+  // Offsets of the first byte of every line but the first, among the bytes
+  // read so far. The vector grows as the scanning goes.
+  vector<size_t> const& get_line_starts() const { return this->m_state.line_starts; }
+  // The syntax errors the scanner finds (an unterminated comment) go to
+  // handler, with the token being scanned
+  void set_error_handler(function<void(char const*, source_range_t const&)> const& handler)
+  {
+    this->m_state.on_error = handler;
+  }
+private:
+  yyscan_t m_scanner;
+  state_t m_state;
+};
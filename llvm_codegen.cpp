@@ -1,32 +1,2578 @@
+#include <algorithm>
 #include <memory>
 
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Verifier.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 #include "ast.h"
+#include "common.h"
+#include "llvm_codegen.h"
+#include "sema.h"
+#include "stack_space.h"
+#include "stats.h"
+#include "trace.h"
 
 using namespace std;
 
-static unique_ptr<llvm::LLVMContext> g_ctx;
-static unique_ptr<llvm::Module> g_module;
-static unique_ptr<llvm::IRBuilder<>> g_builder;
+// Branch weights given to the expected (resp. any other) successor of a
+// switch whose controlling expression is wrapped in __builtin_expect. These
+// are the values llvm's LowerExpectIntrinsic pass uses.
+#define LIKELY_BRANCH_WEIGHT 2000
+#define UNLIKELY_BRANCH_WEIGHT 1
+// Most instructions the operands of &&, || and ?: that C may skip can take
+// for them to be evaluated unconditionally instead, by --branchless mode
+#define BRANCHLESS_AUTO_MAX_INSTS 4
+#define BRANCHLESS_AGGRESSIVE_MAX_INSTS 32
 
 void
-translation_unit_n::llvm_codegen() const
+llvm_codegen_t::error(string const& msg)
 {
-  g_ctx = make_unique<llvm::LLVMContext>();
-  g_module = make_unique<llvm::Module>(this->get_filename(), *g_ctx);
-  g_builder = make_unique<llvm::IRBuilder<>>(*g_ctx);
+  this->m_sema.get_diagnostics().error(nullptr, msg);
+  this->m_has_error = true;
+}
+
+bool
+llvm_codegen_t::lookup_symbol(string const& name, llvm_value_t& addr) const
+{
+  STATS_INC("codegen.symbols.lookups");
+  uint64_t num_probes = 0;
+  bool is_found = false;
+  for (auto it = this->m_symbol_scopes.rbegin();it != this->m_symbol_scopes.rend() && !is_found;it++) {
+    num_probes++;
+    map<string, llvm_value_t> const& scope = this->m_scopes[*it];
+    auto sym = scope.find(name);
+    if (sym != scope.end()) {
+      addr = sym->second;
+      is_found = true;
+    }
+  }
+  STATS_ADD("codegen.symbols.probes", num_probes);
+  STATS_MAX("codegen.symbols.max_probes", num_probes);
+  return is_found;
+}
+
+// long double as the C ABI of triple has it: the x87 80 bit format on x86,
+// IEEE quad on most 64 bit targets, the double-double pair on PowerPC and a
+// plain double elsewhere, Windows and Apple ARM among them
+static llvm::Type*
+get_long_double_type(llvm::LLVMContext& ctx, llvm::Triple const& triple)
+{
+  switch (triple.getArch()) {
+    case llvm::Triple::x86:
+    case llvm::Triple::x86_64: {
+      if (triple.isWindowsMSVCEnvironment()) {
+        return llvm::Type::getDoubleTy(ctx);
+      }
+      if (triple.isAndroid() && triple.getArch() == llvm::Triple::x86_64) {
+        return llvm::Type::getFP128Ty(ctx);
+      }
+      return llvm::Type::getX86_FP80Ty(ctx);
+    }
+    case llvm::Triple::aarch64:
+    case llvm::Triple::aarch64_be: {
+      if (triple.isOSDarwin() || triple.isOSWindows()) {
+        return llvm::Type::getDoubleTy(ctx);
+      }
+      return llvm::Type::getFP128Ty(ctx);
+    }
+    case llvm::Triple::riscv32:
+    case llvm::Triple::riscv64:
+    case llvm::Triple::mips64:
+    case llvm::Triple::mips64el:
+    case llvm::Triple::sparcv9:
+    case llvm::Triple::systemz:
+    case llvm::Triple::wasm32:
+    case llvm::Triple::wasm64: {
+      return llvm::Type::getFP128Ty(ctx);
+    }
+    case llvm::Triple::ppc:
+    case llvm::Triple::ppcle:
+    case llvm::Triple::ppc64:
+    case llvm::Triple::ppc64le: {
+      if (triple.isOSAIX()) {
+        return llvm::Type::getDoubleTy(ctx);
+      }
+      return llvm::Type::getPPC_FP128Ty(ctx);
+    }
+    default: {
+      return llvm::Type::getDoubleTy(ctx);
+    }
+  }
+}
+
+llvm::Type*
+llvm_codegen_t::get_llvm_type(c_type_t const* c_type)
+{
+  switch (c_type->get_base_type()) {
+    case c_type_t::VOID: return llvm::Type::getVoidTy(this->m_ctx);
+    case c_type_t::BOOL: return llvm::Type::getInt1Ty(this->m_ctx);
+    case c_type_t::CHAR: return llvm::Type::getInt8Ty(this->m_ctx);
+    case c_type_t::SHORT: return llvm::Type::getInt16Ty(this->m_ctx);
+    case c_type_t::INT: return llvm::Type::getInt32Ty(this->m_ctx);
+    case c_type_t::LONG_INT: return llvm::Type::getInt64Ty(this->m_ctx);
+    case c_type_t::LONG_LONG_INT: return llvm::Type::getInt64Ty(this->m_ctx);
+    case c_type_t::FLOAT: return llvm::Type::getFloatTy(this->m_ctx);
+    case c_type_t::DOUBLE: return llvm::Type::getDoubleTy(this->m_ctx);
+    case c_type_t::LONG_DOUBLE: {
+      if (this->m_long_double_type == nullptr) {
+        // a module without a target is for the host
+        string triple = this->m_module->getTargetTriple();
+        this->m_long_double_type =
+          get_long_double_type(this->m_ctx, llvm::Triple(triple.empty() ? llvm::sys::getDefaultTargetTriple() : triple));
+      }
+      return this->m_long_double_type;
+    }
+    case c_type_t::POINTER: {
+      c_type_t const* pointee = c_type->get_pointee_type();
+      if (pointee->is_void()) {
+        return llvm::Type::getInt8PtrTy(this->m_ctx);
+      }
+      return this->get_llvm_type(pointee)->getPointerTo();
+    }
+    case c_type_t::FUNCTION: return this->get_llvm_function_type(c_type);
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+llvm::FunctionType*
+llvm_codegen_t::get_llvm_function_type(c_type_t const* c_type)
+{
+  vector<llvm::Type*> param_types;
+  for (auto const& param_type : c_type->get_param_types()) {
+    param_types.push_back(this->get_llvm_type(param_type));
+  }
+  return llvm::FunctionType::get(this->get_llvm_type(c_type->get_return_type()),
+                                 param_types,
+                                 c_type->get_is_vararg());
+}
+
+llvm::Value*
+llvm_codegen_t::load(llvm_value_t lvalue, string const& name)
+{
+  c_type_t const* c_type = lvalue.c_type;
+  llvm::LoadInst* load = this->m_builder.CreateLoad(this->get_llvm_type(c_type), lvalue.value, name);
+  load->setVolatile(c_type->get_is_volatile());
+  if (c_type->get_is_atomic()) {
+    load->setAtomic(llvm::AtomicOrdering::SequentiallyConsistent);
+  }
+  if (!llvm::isa<llvm::AllocaInst>(lvalue.value)) {
+    load->setMetadata(llvm::LLVMContext::MD_tbaa, this->get_tbaa_tag(c_type));
+  }
+  // a const object with static storage keeps its value for the whole run,
+  // storing to it is undefined. Through a pointer to const it may not.
+  if (c_type->get_is_const() && !c_type->get_is_volatile() && llvm::isa<llvm::GlobalVariable>(lvalue.value)) {
+    load->setMetadata(llvm::LLVMContext::MD_invariant_load, llvm::MDNode::get(this->m_ctx, {}));
+  }
+  return load;
+}
+
+llvm::StoreInst*
+llvm_codegen_t::store(llvm::Value* value, llvm_value_t lvalue)
+{
+  llvm::StoreInst* store = this->m_builder.CreateStore(value, lvalue.value);
+  store->setVolatile(lvalue.c_type->get_is_volatile());
+  if (lvalue.c_type->get_is_atomic()) {
+    store->setAtomic(llvm::AtomicOrdering::SequentiallyConsistent);
+  }
+  if (!llvm::isa<llvm::AllocaInst>(lvalue.value)) {
+    store->setMetadata(llvm::LLVMContext::MD_tbaa, this->get_tbaa_tag(lvalue.c_type));
+  }
+  return store;
+}
+
+llvm::IntegerType*
+llvm_codegen_t::get_atomic_int_type(c_type_t const* c_type)
+{
+  if (c_type->is_pointer()) {
+    return this->m_module->getDataLayout().getIntPtrType(this->m_ctx);
+  }
+  if (c_type->is_floating()) {
+    return llvm::IntegerType::get(this->m_ctx, this->get_llvm_type(c_type)->getPrimitiveSizeInBits());
+  }
+  return nullptr;
+}
+
+// Values as the integers of the same width atomic accesses use, and back
+static llvm::Value*
+to_atomic_int(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::IntegerType* int_type)
+{
+  if (value->getType()->isPointerTy()) {
+    return builder.CreatePtrToInt(value, int_type);
+  }
+  return builder.CreateBitCast(value, int_type);
+}
+
+static llvm::Value*
+from_atomic_int(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::Type* type)
+{
+  if (type->isPointerTy()) {
+    return builder.CreateIntToPtr(value, type);
+  }
+  return builder.CreateBitCast(value, type);
+}
+
+llvm::Value*
+llvm_codegen_t::atomic_rmw(llvm::AtomicRMWInst::BinOp op,
+                           llvm_value_t lvalue,
+                           llvm::Value* value,
+                           llvm::AtomicOrdering ordering)
+{
+  c_type_t const* c_type = lvalue.c_type;
+  llvm::Value* addr = lvalue.value;
+  bool is_fp_op = op == llvm::AtomicRMWInst::FAdd || op == llvm::AtomicRMWInst::FSub;
+  llvm::IntegerType* int_type = is_fp_op ? nullptr : this->get_atomic_int_type(c_type);
+  if (int_type != nullptr) {
+    addr = this->m_builder.CreateBitCast(addr, int_type->getPointerTo());
+    value = to_atomic_int(this->m_builder, value, int_type);
+  }
+  llvm::AtomicRMWInst* rmw = this->m_builder.CreateAtomicRMW(op, addr, value, llvm::MaybeAlign(), ordering);
+  rmw->setVolatile(c_type->get_is_volatile());
+  if (int_type != nullptr) {
+    return from_atomic_int(this->m_builder, rmw, this->get_llvm_type(c_type));
+  }
+  return rmw;
+}
+
+llvm::Value*
+llvm_codegen_t::atomic_cmpxchg(llvm_value_t lvalue,
+                               llvm::Value* expected,
+                               llvm::Value* desired,
+                               llvm::AtomicOrdering success_ordering,
+                               llvm::AtomicOrdering failure_ordering,
+                               bool is_weak,
+                               llvm::Value*& is_success)
+{
+  c_type_t const* c_type = lvalue.c_type;
+  llvm::Value* addr = lvalue.value;
+  llvm::IntegerType* int_type = this->get_atomic_int_type(c_type);
+  if (int_type != nullptr) {
+    addr = this->m_builder.CreateBitCast(addr, int_type->getPointerTo());
+    expected = to_atomic_int(this->m_builder, expected, int_type);
+    desired = to_atomic_int(this->m_builder, desired, int_type);
+  }
+  llvm::AtomicCmpXchgInst* cmpxchg = this->m_builder.CreateAtomicCmpXchg(addr,
+                                                                        expected,
+                                                                        desired,
+                                                                        llvm::MaybeAlign(),
+                                                                        success_ordering,
+                                                                        failure_ordering);
+  cmpxchg->setWeak(is_weak);
+  cmpxchg->setVolatile(c_type->get_is_volatile());
+  is_success = this->m_builder.CreateExtractValue(cmpxchg, 1);
+  llvm::Value* old_value = this->m_builder.CreateExtractValue(cmpxchg, 0);
+  if (int_type != nullptr) {
+    return from_atomic_int(this->m_builder, old_value, this->get_llvm_type(c_type));
+  }
+  return old_value;
+}
+
+// The type nodes are those clang uses, so that modules of both agree when
+// linked together. Signed and unsigned variants share a node since C lets
+// them alias (C11 6.5p7), and char, which may alias anything, is the
+// parent of every other type.
+llvm::MDNode*
+llvm_codegen_t::get_tbaa_tag(c_type_t const* c_type)
+{
+  llvm::MDBuilder md_builder(this->m_ctx);
+  if (this->m_tbaa_root == nullptr) {
+    this->m_tbaa_root = md_builder.createTBAARoot("Simple C/C++ TBAA");
+  }
+  auto get_type_node = [&](string const& name, llvm::MDNode* parent) {
+    llvm::MDNode*& node = this->m_tbaa_types[name];
+    if (node == nullptr) {
+      node = md_builder.createTBAAScalarTypeNode(name, parent);
+    }
+    return node;
+  };
+  llvm::MDNode* char_node = get_type_node("omnipotent char", this->m_tbaa_root);
+  string name;
+  switch (c_type->get_base_type()) {
+    case c_type_t::CHAR: return md_builder.createTBAAStructTagNode(char_node, char_node, 0);
+    case c_type_t::BOOL: name = "_Bool"; break;
+    case c_type_t::SHORT: name = "short"; break;
+    case c_type_t::INT: name = "int"; break;
+    case c_type_t::LONG_INT: name = "long"; break;
+    case c_type_t::LONG_LONG_INT: name = "long long"; break;
+    case c_type_t::FLOAT: name = "float"; break;
+    case c_type_t::DOUBLE: name = "double"; break;
+    case c_type_t::LONG_DOUBLE: name = "long double"; break;
+    case c_type_t::POINTER: name = "any pointer"; break;
+    default: {
+      NOT_REACHED();
+    }
+  }
+  llvm::MDNode* type_node = get_type_node(name, char_node);
+  return md_builder.createTBAAStructTagNode(type_node, type_node, 0);
+}
+
+llvm::Value*
+llvm_codegen_t::convert(llvm_value_t v, c_type_t const* to)
+{
+  c_type_t const* from = v.c_type;
+  if (to->is_void()) {
+    return nullptr;
+  }
+  if (from->is_void()) {
+    this->error("void value not ignored as it ought to be");
+    return llvm::UndefValue::get(this->get_llvm_type(to));
+  }
+  llvm::Type* to_llvm_type = this->get_llvm_type(to);
+  if (to->get_base_type() == c_type_t::BOOL) {
+    return this->convert_to_i1(v);
+  }
+  if (v.value->getType() == to_llvm_type) {
+    return v.value;
+  }
+  if (from->is_integer() && to->is_integer()) {
+    return this->m_builder.CreateIntCast(v.value, to_llvm_type, from->is_signed_integer());
+  }
+  if (from->is_integer() && to->is_floating()) {
+    if (from->is_signed_integer()) {
+      return this->m_builder.CreateSIToFP(v.value, to_llvm_type);
+    }
+    return this->m_builder.CreateUIToFP(v.value, to_llvm_type);
+  }
+  if (from->is_floating() && to->is_integer()) {
+    if (to->is_signed_integer()) {
+      return this->m_builder.CreateFPToSI(v.value, to_llvm_type);
+    }
+    return this->m_builder.CreateFPToUI(v.value, to_llvm_type);
+  }
+  if (from->is_floating() && to->is_floating()) {
+    return this->m_builder.CreateFPCast(v.value, to_llvm_type);
+  }
+  if (from->is_pointer() && to->is_pointer()) {
+    return this->m_builder.CreatePointerCast(v.value, to_llvm_type);
+  }
+  if (from->is_pointer() && to->is_integer()) {
+    return this->m_builder.CreatePtrToInt(v.value, to_llvm_type);
+  }
+  if (from->is_integer() && to->is_pointer()) {
+    return this->m_builder.CreateIntToPtr(v.value, to_llvm_type);
+  }
+  this->error("invalid conversion from " + from->c_type_to_string() +
+              "to " + to->c_type_to_string());
+  return llvm::UndefValue::get(to_llvm_type);
+}
+
+llvm::Value*
+llvm_codegen_t::convert_to_i1(llvm_value_t v)
+{
+  if (v.c_type->is_integer()) {
+    if (v.value->getType()->isIntegerTy(1)) {
+      return v.value;
+    }
+    return this->m_builder.CreateICmpNE(v.value, llvm::ConstantInt::get(v.value->getType(), 0));
+  }
+  if (v.c_type->is_floating()) {
+    return this->m_builder.CreateFCmpUNE(v.value, llvm::ConstantFP::get(v.value->getType(), 0.0));
+  }
+  if (v.c_type->is_pointer()) {
+    return this->m_builder.CreateIsNotNull(v.value);
+  }
+  this->error("scalar value required in condition, found " + v.c_type->c_type_to_string());
+  return llvm::UndefValue::get(llvm::Type::getInt1Ty(this->m_ctx));
+}
+
+llvm::Value*
+llvm_codegen_t::rvalue_llvm_codegen(expression_n const* e)
+{
+  return this->convert(e->llvm_codegen(*this), this->m_sema.get_converted_type(e));
+}
+
+llvm::Value*
+llvm_codegen_t::create_signed_arith(llvm::Instruction::BinaryOps op, llvm::Value* l, llvm::Value* r)
+{
+  signed_overflow_t signed_overflow = this->m_options.signed_overflow;
+  if (signed_overflow == signed_overflow_t::WRAP) {
+    return this->m_builder.CreateBinOp(op, l, r);
+  }
+  if (signed_overflow == signed_overflow_t::UNDEFINED || op == llvm::Instruction::Shl) {
+    llvm::Value* value = this->m_builder.CreateBinOp(op, l, r);
+    if (llvm::BinaryOperator* inst = llvm::dyn_cast<llvm::BinaryOperator>(value)) {
+      inst->setHasNoSignedWrap();
+      // a shift is only defined if a nonnegative value stays representable,
+      // which shifts no set bit out
+      if (op == llvm::Instruction::Shl) {
+        inst->setHasNoUnsignedWrap();
+      }
+    }
+    STATS_INC("codegen.overflow.nsw");
+    return value;
+  }
+  // constant operands fold, so that case labels and the like stay constant
+  // expressions, unless they overflow and have to trap when run
+  llvm::ConstantInt* l_const = llvm::dyn_cast<llvm::ConstantInt>(l);
+  llvm::ConstantInt* r_const = llvm::dyn_cast<llvm::ConstantInt>(r);
+  bool is_overflow = false;
+  llvm::APInt folded;
+  llvm::Intrinsic::ID id;
+  switch (op) {
+    case llvm::Instruction::Add: {
+      id = llvm::Intrinsic::sadd_with_overflow;
+      if (l_const && r_const) {
+        folded = l_const->getValue().sadd_ov(r_const->getValue(), is_overflow);
+      }
+      break;
+    }
+    case llvm::Instruction::Sub: {
+      id = llvm::Intrinsic::ssub_with_overflow;
+      if (l_const && r_const) {
+        folded = l_const->getValue().ssub_ov(r_const->getValue(), is_overflow);
+      }
+      break;
+    }
+    case llvm::Instruction::Mul: {
+      id = llvm::Intrinsic::smul_with_overflow;
+      if (l_const && r_const) {
+        folded = l_const->getValue().smul_ov(r_const->getValue(), is_overflow);
+      }
+      break;
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+  if (l_const && r_const && !is_overflow) {
+    return llvm::ConstantInt::get(this->m_ctx, folded);
+  }
+  llvm::Value* result = this->m_builder.CreateBinaryIntrinsic(id, l, r);
+  llvm::Value* overflow = this->m_builder.CreateExtractValue(result, 1);
+  if (this->m_trap_bb == nullptr) {
+    // a single cold block per function, which the checks share and
+    // end_function() puts last
+    this->m_trap_bb = this->create_block("trap");
+    llvm::IRBuilder<> trap_builder(this->m_trap_bb);
+    trap_builder.CreateCall(llvm::Intrinsic::getDeclaration(this->m_module.get(), llvm::Intrinsic::trap));
+    trap_builder.CreateUnreachable();
+  }
+  llvm::BasicBlock* cont_bb = this->create_block("overflow.cont");
+  llvm::BranchInst* br = this->m_builder.CreateCondBr(overflow, this->m_trap_bb, cont_bb);
+  br->setMetadata(llvm::LLVMContext::MD_prof,
+                  llvm::MDBuilder(this->m_ctx).createBranchWeights(UNLIKELY_BRANCH_WEIGHT, LIKELY_BRANCH_WEIGHT));
+  this->start_block(cont_bb);
+  STATS_INC("codegen.overflow.checks");
+  return this->m_builder.CreateExtractValue(result, 0);
+}
+
+llvm::Value*
+llvm_codegen_t::create_pointer_add(llvm::Type* elem_type, llvm::Value* base, llvm::Value* offset)
+{
+  if (this->m_options.signed_overflow == signed_overflow_t::WRAP) {
+    return this->m_builder.CreateGEP(elem_type, base, offset);
+  }
+  return this->m_builder.CreateInBoundsGEP(elem_type, base, offset);
+}
+
+llvm::Function*
+llvm_codegen_t::declare_function(string const& name,
+                                 c_type_t const* c_type,
+                                 declaration_specifiers_n const* decl_specs)
+{
+  llvm::FunctionType* function_type = this->get_llvm_function_type(c_type);
+  llvm::Function* function = this->m_module->getFunction(name);
+  bool is_static = decl_specs->has_specifier(specifier_t::STATIC);
+  bool is_inline = decl_specs->has_specifier(specifier_t::INLINE);
+  if (function == nullptr) {
+    function = llvm::Function::Create(function_type,
+                                      is_static ? llvm::Function::InternalLinkage :
+                                                  llvm::Function::ExternalLinkage,
+                                      name,
+                                      *this->m_module);
+  }
+  else if (function->getFunctionType() != function_type) {
+    this->error("conflicting types for " + name);
+  }
+  else if (is_static && !function->hasLocalLinkage()) {
+    this->error("static declaration of " + name + " follows non-static declaration");
+  }
+  if (is_static && !this->is_global_scope()) {
+    this->error("function " + name + " declared in block scope cannot have static storage class");
+  }
+  if (is_inline) {
+    function->addFnAttr(llvm::Attribute::InlineHint);
+  }
+  if (decl_specs->has_specifier(specifier_t::NORETURN)) {
+    function->addFnAttr(llvm::Attribute::NoReturn);
+  }
+  // the object a restrict pointer parameter points to is only accessed
+  // through it while the function runs (C11 6.7.3.1)
+  for (size_t i = 0;i < c_type->get_param_types().size();i++) {
+    if (c_type->get_param_types()[i]->get_is_restrict()) {
+      function->addParamAttr(i, llvm::Attribute::NoAlias);
+    }
+  }
+  if (attribute_n const* target_attribute = decl_specs->get_attribute("target")) {
+    this->apply_target_attribute(function, target_attribute);
+  }
+  if (this->is_global_scope() && (!is_inline || decl_specs->has_specifier(specifier_t::EXTERN))) {
+    this->m_externally_defined_functions.insert(name);
+  }
+  this->add_symbol(name, {function, c_type});
+  return function;
+}
+
+void
+llvm_codegen_t::begin_function(llvm::Function* function, c_type_t const* c_type)
+{
+  this->m_cur_function = function;
+  this->m_cur_function_type = c_type;
+  this->m_num_tail_calls = 0;
+  this->m_trap_bb = nullptr;
+  // the body starts in the mode of the file scope pragmas before it
+  this->set_fp_mode(this->m_fp_mode);
+  this->m_function_fp_flags = this->m_fp_mode.flags;
+  if (this->m_options.target && !function->hasFnAttribute("target-features") &&
+      !function->hasFnAttribute("target-cpu")) {
+    this->m_options.target->add_function_attributes(*function);
+  }
+  this->m_builder.SetInsertPoint(llvm::BasicBlock::Create(this->m_ctx, "entry", function));
+  if (this->is_profiling()) {
+    this->begin_function_profile();
+  }
+}
+
+void
+llvm_codegen_t::end_function()
+{
+  llvm::Function* function = this->m_cur_function;
+  if (this->m_builder.GetInsertBlock()->getTerminator() == nullptr) {
+    // falling off the end of a function returns 0 for main and an unspecified value otherwise
+    llvm::Type* ret_type = function->getReturnType();
+    if (ret_type->isVoidTy()) {
+      this->m_builder.CreateRetVoid();
+    }
+    else {
+      this->m_builder.CreateRet(llvm::Constant::getNullValue(ret_type));
+    }
+  }
+  if (this->is_profiling()) {
+    this->end_function_profile();
+  }
+  this->add_fp_attributes(function);
+  if (this->m_trap_bb) {
+    this->m_trap_bb->insertInto(function);
+  }
+  llvm::EliminateUnreachableBlocks(*function);
+  TRACE(TRACE_CODEGEN, TRACE_DEBUG, "lowered %s, %zu blocks",
+        function->getName().str().c_str(), function->size());
+  if (!this->m_has_error && llvm::verifyFunction(*function, &llvm::errs())) {
+    this->error("invalid IR generated for " + function->getName().str());
+  }
+  this->m_builder.ClearInsertionPoint();
+  this->m_cur_function = nullptr;
+  this->m_cur_function_type = nullptr;
+  this->m_tail_recursion = nullptr;
+}
+
+void
+llvm_codegen_t::set_fp_mode(fp_mode_t const& fp_mode)
+{
+  this->m_fp_mode = fp_mode;
+  llvm::FastMathFlags flags = fp_mode.flags;
+  flags.setAllowContract(fp_mode.contract == fp_contract_t::FAST);
+  this->m_builder.setFastMathFlags(flags);
+  if (this->m_cur_function) {
+    this->m_function_fp_flags &= fp_mode.flags;
+  }
+}
+
+void
+llvm_codegen_t::add_fp_attributes(llvm::Function* function)
+{
+  // the attributes hold for the whole function, so a flag a pragma turned
+  // off in one of its blocks is left out
+  llvm::FastMathFlags flags = this->m_function_fp_flags;
+  if (flags.noNaNs()) {
+    function->addFnAttr("no-nans-fp-math", "true");
+  }
+  if (flags.noInfs()) {
+    function->addFnAttr("no-infs-fp-math", "true");
+  }
+  if (flags.noSignedZeros()) {
+    function->addFnAttr("no-signed-zeros-fp-math", "true");
+  }
+  if (flags.approxFunc()) {
+    function->addFnAttr("approx-func-fp-math", "true");
+  }
+  if (flags.allowReassoc() && flags.noSignedZeros() && flags.allowReciprocal() && flags.approxFunc()) {
+    function->addFnAttr("unsafe-fp-math", "true");
+  }
+}
+
+llvm::AllocaInst*
+llvm_codegen_t::create_entry_alloca(llvm::Type* type, string const& name)
+{
+  llvm::BasicBlock& entry = this->m_cur_function->getEntryBlock();
+  llvm::IRBuilder<> entry_builder(&entry, entry.begin());
+  return entry_builder.CreateAlloca(type, nullptr, name);
+}
+
+llvm::BasicBlock*
+llvm_codegen_t::create_block(string const& name)
+{
+  return llvm::BasicBlock::Create(this->m_ctx, name);
+}
+
+void
+llvm_codegen_t::start_block(llvm::BasicBlock* bb)
+{
+  if (bb->getParent() == nullptr) {
+    bb->insertInto(this->m_cur_function);
+  }
+  this->m_builder.SetInsertPoint(bb);
+}
+
+void
+llvm_codegen_t::emit_branch(llvm::BasicBlock* bb)
+{
+  if (this->m_builder.GetInsertBlock()->getTerminator() == nullptr) {
+    this->m_builder.CreateBr(bb);
+  }
+}
+
+void
+llvm_codegen_t::ensure_insertion_block()
+{
+  if (this->m_builder.GetInsertBlock()->getTerminator() != nullptr) {
+    this->start_block(this->create_block("unreachable"));
+  }
+}
+
+llvm::BasicBlock*
+llvm_codegen_t::get_break_target() const
+{
+  return this->m_jump_targets.empty() ? nullptr : this->m_jump_targets.back().break_bb;
+}
+
+llvm::BasicBlock*
+llvm_codegen_t::get_continue_target() const
+{
+  return this->m_jump_targets.empty() ? nullptr : this->m_jump_targets.back().continue_bb;
+}
+
+llvm::Constant*
+llvm_codegen_t::get_string_literal(size_t id)
+{
+  string_pool_t const& pool = this->m_sema.get_string_pool();
+  if (this->m_string_globals.size() < pool.size()) {
+    this->m_string_globals.resize(pool.size(), nullptr);
+  }
+  llvm::GlobalVariable*& global = this->m_string_globals[id];
+  if (global == nullptr) {
+    // private unnamed_addr lets the linker merge equal literals of other
+    // modules too
+    llvm::Constant* value = llvm::ConstantDataArray::getString(this->m_ctx, pool.get(id));
+    global = new llvm::GlobalVariable(*this->m_module,
+                                      value->getType(),
+                                      true,
+                                      llvm::GlobalValue::PrivateLinkage,
+                                      value,
+                                      ".str");
+    global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    global->setAlignment(llvm::Align(1));
+  }
+  llvm::Constant* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(this->m_ctx), 0);
+  return llvm::ConstantExpr::getInBoundsGetElementPtr(global->getValueType(), global,
+                                                      llvm::ArrayRef<llvm::Constant*>({zero, zero}));
+}
+
+void
+llvm_codegen_t::finish_module_strings()
+{
+  string_pool_t const& pool = this->m_sema.get_string_pool();
+  vector<size_t> ids;
+  for (size_t id = 0;id < this->m_string_globals.size();id++) {
+    if (this->m_string_globals[id] != nullptr) {
+      ids.push_back(id);
+    }
+  }
+  vector<string_pool_t::tail_t> tails = pool.merge_tails(ids);
+  llvm::Type* i64_type = llvm::Type::getInt64Ty(this->m_ctx);
+  size_t num_bytes = 0;
+  for (size_t i = 0;i < ids.size();i++) {
+    llvm::GlobalVariable* global = this->m_string_globals[ids[i]];
+    if (tails[i].owner == ids[i]) {
+      STATS_INC("strings.emitted");
+      num_bytes += pool.get(ids[i]).size() + 1;
+      continue;
+    }
+    STATS_INC("strings.tail_merged");
+    llvm::GlobalVariable* owner = this->m_string_globals[tails[i].owner];
+    llvm::Constant* indexes[] = {llvm::ConstantInt::get(i64_type, 0),
+                                 llvm::ConstantInt::get(i64_type, tails[i].offset)};
+    llvm::Constant* tail = llvm::ConstantExpr::getInBoundsGetElementPtr(owner->getValueType(), owner, indexes);
+    // the uses are all the pointer to the first char get_string_literal()
+    // returns
+    vector<llvm::User*> users(global->user_begin(), global->user_end());
+    for (llvm::User* user : users) {
+      user->replaceAllUsesWith(tail);
+    }
+    global->removeDeadConstantUsers();
+    global->eraseFromParent();
+    this->m_string_globals[ids[i]] = nullptr;
+  }
+  STATS_ADD("strings.emitted_bytes", num_bytes);
+  // by deduplication and tail merging, literals codegen never reached count
+  // as saved too
+  STATS_ADD("strings.saved_bytes", pool.get_num_literal_bytes() - num_bytes);
+}
+
+// c_type is the one sema gave the constant, see constant_n::get_c_type()
+llvm_value_t
+constant_n::llvm_codegen(llvm_codegen_t& cg, c_type_t const* c_type) const
+{
+  string const& s = this->get_str();
+  switch (this->get_sort()) {
+    case constant_n::INTEGER_CONST: {
+      if (s.find('\'') != string::npos) {
+        // character constant, optionally prefixed by L, u or U
+        return {llvm::ConstantInt::get(cg.get_llvm_type(c_type), this->get_char_value(), true), c_type};
+      }
+      return {llvm::ConstantInt::get(cg.get_llvm_type(c_type), this->get_integer_value()), c_type};
+    }
+    case constant_n::FLOAT_CONST: {
+      string digits = s;
+      if (c_type->get_base_type() != c_type_t::DOUBLE) {
+        digits.pop_back();
+      }
+      return {llvm::ConstantFP::get(cg.get_llvm_type(c_type), digits), c_type};
+    }
+    default: {
+      // string literals come from the pool, see llvm_codegen_t::get_string_literal()
+      NOT_REACHED();
+    }
+  }
+}
+
+static bool
+is_comparison_op(expression_n::operation_kind_t op)
+{
+  return op == expression_n::OP_LT || op == expression_n::OP_GT ||
+         op == expression_n::OP_LTE || op == expression_n::OP_GTE ||
+         op == expression_n::OP_EQ || op == expression_n::OP_NEQ;
+}
+
+static llvm_value_t
+comparison_llvm_codegen(llvm_codegen_t& cg,
+                        expression_n::operation_kind_t op,
+                        llvm::Value* l,
+                        llvm::Value* r,
+                        c_type_t const* operand_type)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  llvm::CmpInst::Predicate pred;
+  bool is_float = operand_type->is_floating();
+  bool is_signed = operand_type->is_signed_integer();
+  switch (op) {
+    case expression_n::OP_LT: {
+      pred = is_float ? llvm::CmpInst::FCMP_OLT : is_signed ? llvm::CmpInst::ICMP_SLT : llvm::CmpInst::ICMP_ULT;
+      break;
+    }
+    case expression_n::OP_GT: {
+      pred = is_float ? llvm::CmpInst::FCMP_OGT : is_signed ? llvm::CmpInst::ICMP_SGT : llvm::CmpInst::ICMP_UGT;
+      break;
+    }
+    case expression_n::OP_LTE: {
+      pred = is_float ? llvm::CmpInst::FCMP_OLE : is_signed ? llvm::CmpInst::ICMP_SLE : llvm::CmpInst::ICMP_ULE;
+      break;
+    }
+    case expression_n::OP_GTE: {
+      pred = is_float ? llvm::CmpInst::FCMP_OGE : is_signed ? llvm::CmpInst::ICMP_SGE : llvm::CmpInst::ICMP_UGE;
+      break;
+    }
+    case expression_n::OP_EQ: {
+      pred = is_float ? llvm::CmpInst::FCMP_OEQ : llvm::CmpInst::ICMP_EQ;
+      break;
+    }
+    case expression_n::OP_NEQ: {
+      pred = is_float ? llvm::CmpInst::FCMP_UNE : llvm::CmpInst::ICMP_NE;
+      break;
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+  llvm::Value* cmp = is_float ? builder.CreateFCmp(pred, l, r) : builder.CreateICmp(pred, l, r);
+  c_type_t const* int_type = c_type_t::get_int_type();
+  return {builder.CreateZExt(cmp, cg.get_llvm_type(int_type)), int_type};
+}
+
+// l + r or l - r as llvm.fmuladd if one of them is a product that nothing
+// else uses, that is one computed by this very expression, as
+// -ffp-contract=on allows. The target rounds once if it has a fused
+// multiply-add and twice otherwise. nullptr if neither operand fuses.
+static llvm::Value*
+fmuladd_llvm_codegen(llvm_codegen_t& cg, expression_n::operation_kind_t op, llvm::Value* l, llvm::Value* r)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  auto get_fusable_product = [](llvm::Value* v) -> llvm::BinaryOperator* {
+    llvm::BinaryOperator* mul = llvm::dyn_cast<llvm::BinaryOperator>(v);
+    return mul && mul->getOpcode() == llvm::Instruction::FMul && mul->use_empty() ? mul : nullptr;
+  };
+  bool is_sub = op == expression_n::OP_SUB;
+  llvm::BinaryOperator* mul = get_fusable_product(l);
+  llvm::Value* addend = r;
+  bool negates_product = false;
+  if (mul == nullptr) {
+    mul = get_fusable_product(r);
+    if (mul == nullptr) {
+      return nullptr;
+    }
+    addend = l;
+    negates_product = is_sub;
+  }
+  else if (is_sub) {
+    addend = builder.CreateFNeg(r);
+  }
+  llvm::Value* a = mul->getOperand(0);
+  llvm::Value* b = mul->getOperand(1);
+  if (negates_product) {
+    a = builder.CreateFNeg(a);
+  }
+  llvm::Function* fmuladd = llvm::Intrinsic::getDeclaration(&cg.get_module(),
+                                                            llvm::Intrinsic::fmuladd,
+                                                            {mul->getType()});
+  llvm::Value* ret = builder.CreateCall(fmuladd, {a, b, addend});
+  mul->eraseFromParent();
+  STATS_INC("codegen.fp.fmuladds");
+  return ret;
+}
+
+// Lowers the binary operators that evaluate both operands unconditionally.
+// l and r have already gone through the conversions sema chose for them.
+static llvm_value_t
+binary_op_llvm_codegen(llvm_codegen_t& cg,
+                       expression_n::operation_kind_t op,
+                       llvm::Value* l,
+                       c_type_t const* l_type,
+                       llvm::Value* r,
+                       c_type_t const* r_type)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+
+  // pointer arithmetic and comparison
+  if (op == expression_n::OP_ADD && r_type->is_pointer() && l_type->is_integer()) {
+    swap(l, r);
+    swap(l_type, r_type);
+  }
+  if ((op == expression_n::OP_ADD || op == expression_n::OP_SUB) &&
+      l_type->is_pointer() && r_type->is_integer()) {
+    llvm::Value* offset = op == expression_n::OP_SUB ? builder.CreateNeg(r) : r;
+    llvm::Type* elem_type = l->getType()->getPointerElementType();
+    return {cg.create_pointer_add(elem_type, l, offset), l_type};
+  }
+  if (op == expression_n::OP_SUB && l_type->is_pointer()) {
+    llvm::Type* elem_type = l->getType()->getPointerElementType();
+    return {builder.CreatePtrDiff(elem_type, l, r), c_type_t::get_long_type()};
+  }
+  if (is_comparison_op(op)) {
+    return comparison_llvm_codegen(cg, op, l, r, l_type);
+  }
 
+  bool is_float = l_type->is_floating();
+  bool is_signed = l_type->is_signed_integer();
+  if (l_type->has_undefined_overflow()) {
+    switch (op) {
+      case expression_n::OP_LSHIFT: return {cg.create_signed_arith(llvm::Instruction::Shl, l, r), l_type};
+      case expression_n::OP_MUL: return {cg.create_signed_arith(llvm::Instruction::Mul, l, r), l_type};
+      case expression_n::OP_ADD: return {cg.create_signed_arith(llvm::Instruction::Add, l, r), l_type};
+      case expression_n::OP_SUB: return {cg.create_signed_arith(llvm::Instruction::Sub, l, r), l_type};
+      default: {
+        break;
+      }
+    }
+  }
+  if (is_float && (op == expression_n::OP_ADD || op == expression_n::OP_SUB) &&
+      cg.get_fp_mode().contract == fp_contract_t::ON) {
+    if (llvm::Value* fused = fmuladd_llvm_codegen(cg, op, l, r)) {
+      return {fused, l_type};
+    }
+  }
+  switch (op) {
+    case expression_n::OP_LSHIFT: return {builder.CreateShl(l, r), l_type};
+    case expression_n::OP_RSHIFT: {
+      return {is_signed ? builder.CreateAShr(l, r) : builder.CreateLShr(l, r), l_type};
+    }
+    case expression_n::OP_MUL: {
+      return {is_float ? builder.CreateFMul(l, r) : builder.CreateMul(l, r), l_type};
+    }
+    case expression_n::OP_DIV: {
+      if (is_float) {
+        return {builder.CreateFDiv(l, r), l_type};
+      }
+      return {is_signed ? builder.CreateSDiv(l, r) : builder.CreateUDiv(l, r), l_type};
+    }
+    case expression_n::OP_MOD: {
+      return {is_signed ? builder.CreateSRem(l, r) : builder.CreateURem(l, r), l_type};
+    }
+    case expression_n::OP_ADD: {
+      return {is_float ? builder.CreateFAdd(l, r) : builder.CreateAdd(l, r), l_type};
+    }
+    case expression_n::OP_SUB: {
+      return {is_float ? builder.CreateFSub(l, r) : builder.CreateSub(l, r), l_type};
+    }
+    case expression_n::OP_BIT_AND: return {builder.CreateAnd(l, r), l_type};
+    case expression_n::OP_BIT_OR: return {builder.CreateOr(l, r), l_type};
+    case expression_n::OP_XOR: return {builder.CreateXor(l, r), l_type};
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+static expression_n::operation_kind_t
+compound_assignment_to_binary_op(expression_n::operation_kind_t op)
+{
+  switch (op) {
+    case expression_n::OP_MUL_ASSIGN: return expression_n::OP_MUL;
+    case expression_n::OP_DIV_ASSIGN: return expression_n::OP_DIV;
+    case expression_n::OP_MOD_ASSIGN: return expression_n::OP_MOD;
+    case expression_n::OP_ADD_ASSIGN: return expression_n::OP_ADD;
+    case expression_n::OP_SUB_ASSIGN: return expression_n::OP_SUB;
+    case expression_n::OP_LSHIFT_ASSIGN: return expression_n::OP_LSHIFT;
+    case expression_n::OP_RSHIFT_ASSIGN: return expression_n::OP_RSHIFT;
+    case expression_n::OP_BIT_AND_ASSIGN: return expression_n::OP_BIT_AND;
+    case expression_n::OP_XOR_ASSIGN: return expression_n::OP_XOR;
+    case expression_n::OP_BIT_OR_ASSIGN: return expression_n::OP_BIT_OR;
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+static llvm::AtomicOrdering
+get_atomic_ordering(memory_order_t order)
+{
+  switch (order) {
+    case memory_order_t::RELAXED: return llvm::AtomicOrdering::Monotonic;
+    // as in clang, no target gains from consume over acquire
+    case memory_order_t::CONSUME: return llvm::AtomicOrdering::Acquire;
+    case memory_order_t::ACQUIRE: return llvm::AtomicOrdering::Acquire;
+    case memory_order_t::RELEASE: return llvm::AtomicOrdering::Release;
+    case memory_order_t::ACQ_REL: return llvm::AtomicOrdering::AcquireRelease;
+    case memory_order_t::SEQ_CST: return llvm::AtomicOrdering::SequentiallyConsistent;
+  }
+  NOT_REACHED();
+}
+
+// offset elements of the type pointer_type points to, in bytes of the
+// integer type atomic accesses to pointers use
+static llvm::Value*
+pointer_offset_in_bytes(llvm_codegen_t& cg, c_type_t const* pointer_type, llvm::Value* offset)
+{
+  llvm::IntegerType* int_type = cg.get_atomic_int_type(pointer_type);
+  uint64_t elem_size = cg.get_module().getDataLayout().getTypeAllocSize(cg.get_llvm_type(pointer_type->get_pointee_type()));
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  return builder.CreateMul(builder.CreateIntCast(offset, int_type, true), llvm::ConstantInt::get(int_type, elem_size));
+}
+
+static llvm_value_t
+atomic_builtin_llvm_codegen(llvm_codegen_t& cg, expression_n const* e, atomic_builtin_t builtin)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  sema_t const& sema = cg.get_sema();
+  vector<expression_n*> const& args = e->get_child(1)->get_list();
+  c_type_t const* c_type = sema.get_type(e);
+  // the memory order argument i, seq_cst for the forms without one
+  auto get_ordering = [&](size_t i) {
+    if (i >= args.size()) {
+      return llvm::AtomicOrdering::SequentiallyConsistent;
+    }
+    return get_atomic_ordering(sema.get_memory_order(args[i]));
+  };
+  if (builtin == atomic_builtin_t::THREAD_FENCE || builtin == atomic_builtin_t::SIGNAL_FENCE) {
+    // a relaxed fence orders nothing
+    llvm::AtomicOrdering ordering = get_ordering(0);
+    if (ordering != llvm::AtomicOrdering::Monotonic) {
+      // a signal handler runs on the thread it interrupts
+      builder.CreateFence(ordering, builtin == atomic_builtin_t::SIGNAL_FENCE ? llvm::SyncScope::SingleThread :
+                                                                                llvm::SyncScope::System);
+    }
+    return {nullptr, c_type};
+  }
+
+  llvm_value_t object = {cg.rvalue_llvm_codegen(args[0]), sema.get_type(args[0])->get_pointee_type()};
+  switch (builtin) {
+    case atomic_builtin_t::INIT: {
+      // no other thread may access the object before it is initialized
+      cg.store(cg.rvalue_llvm_codegen(args[1]), object)->setAtomic(llvm::AtomicOrdering::NotAtomic);
+      return {nullptr, c_type};
+    }
+    case atomic_builtin_t::LOAD: {
+      llvm::LoadInst* load = llvm::cast<llvm::LoadInst>(cg.load(object));
+      load->setOrdering(get_ordering(1));
+      return {load, c_type};
+    }
+    case atomic_builtin_t::STORE: {
+      cg.store(cg.rvalue_llvm_codegen(args[1]), object)->setOrdering(get_ordering(2));
+      return {nullptr, c_type};
+    }
+    case atomic_builtin_t::EXCHANGE: {
+      llvm::Value* value = cg.rvalue_llvm_codegen(args[1]);
+      return {cg.atomic_rmw(llvm::AtomicRMWInst::Xchg, object, value, get_ordering(2)), c_type};
+    }
+    case atomic_builtin_t::COMPARE_EXCHANGE_STRONG:
+    case atomic_builtin_t::COMPARE_EXCHANGE_WEAK: {
+      llvm_value_t expected_lvalue = {cg.rvalue_llvm_codegen(args[1]), sema.get_type(args[1])->get_pointee_type()};
+      llvm::Value* desired = cg.rvalue_llvm_codegen(args[2]);
+      llvm::Value* is_success;
+      llvm::Value* old_value = cg.atomic_cmpxchg(object,
+                                                 cg.load(expected_lvalue),
+                                                 desired,
+                                                 get_ordering(3),
+                                                 get_ordering(4),
+                                                 builtin == atomic_builtin_t::COMPARE_EXCHANGE_WEAK,
+                                                 is_success);
+      // on failure the value found is stored in *expected
+      llvm::BasicBlock* store_bb = cg.create_block("cmpxchg.store_expected");
+      llvm::BasicBlock* end_bb = cg.create_block("cmpxchg.end");
+      builder.CreateCondBr(is_success, end_bb, store_bb);
+      cg.start_block(store_bb);
+      cg.store(old_value, expected_lvalue);
+      builder.CreateBr(end_bb);
+      cg.start_block(end_bb);
+      return {builder.CreateZExt(is_success, cg.get_llvm_type(c_type)), c_type};
+    }
+    case atomic_builtin_t::FETCH_ADD:
+    case atomic_builtin_t::FETCH_SUB:
+    case atomic_builtin_t::FETCH_OR:
+    case atomic_builtin_t::FETCH_XOR:
+    case atomic_builtin_t::FETCH_AND: {
+      llvm::Value* value = cg.rvalue_llvm_codegen(args[1]);
+      if (object.c_type->is_pointer()) {
+        value = pointer_offset_in_bytes(cg, object.c_type, value);
+      }
+      llvm::AtomicRMWInst::BinOp op;
+      switch (builtin) {
+        case atomic_builtin_t::FETCH_ADD: op = llvm::AtomicRMWInst::Add; break;
+        case atomic_builtin_t::FETCH_SUB: op = llvm::AtomicRMWInst::Sub; break;
+        case atomic_builtin_t::FETCH_OR: op = llvm::AtomicRMWInst::Or; break;
+        case atomic_builtin_t::FETCH_XOR: op = llvm::AtomicRMWInst::Xor; break;
+        default: op = llvm::AtomicRMWInst::And; break;
+      }
+      return {cg.atomic_rmw(op, object, value, get_ordering(2)), c_type};
+    }
+    case atomic_builtin_t::IS_LOCK_FREE: {
+      // every type sema lets be _Atomic is, whatever the object
+      return {llvm::ConstantInt::get(cg.get_llvm_type(c_type), 1), c_type};
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+static llvm_value_t
+function_call_llvm_codegen(llvm_codegen_t& cg, expression_n const* e)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  vector<expression_n*> const& args = e->get_child(1)->get_list();
+  bool is_explicit;
+  atomic_builtin_t atomic_builtin = e->get_atomic_builtin(is_explicit);
+  if (atomic_builtin != atomic_builtin_t::NONE) {
+    return atomic_builtin_llvm_codegen(cg, e, atomic_builtin);
+  }
+  if (e->is_builtin_expect_call()) {
+    // long __builtin_expect(long exp, long c)
+    llvm::Value* exp = cg.rvalue_llvm_codegen(args[0]);
+    llvm::Value* c = cg.rvalue_llvm_codegen(args[1]);
+    llvm::Function* expect = llvm::Intrinsic::getDeclaration(&cg.get_module(),
+                                                             llvm::Intrinsic::expect,
+                                                             {exp->getType()});
+    return {builder.CreateCall(expect, {exp, c}), c_type_t::get_long_type()};
+  }
+
+  llvm_value_t callee = e->get_child(0)->llvm_codegen(cg);
+  c_type_t const* function_type = callee.c_type->get_pointee_type();
+  vector<llvm::Value*> arg_values;
+  for (auto const& arg : args) {
+    // sema converted each argument to its parameter type, or applied the
+    // default argument promotions to the variable ones
+    arg_values.push_back(cg.rvalue_llvm_codegen(arg));
+  }
+  llvm::CallInst* call = builder.CreateCall(cg.get_llvm_function_type(function_type),
+                                            callee.value,
+                                            arg_values);
+  c_type_t const* ret_type = function_type->get_return_type();
+  return {ret_type->is_void() ? nullptr : call, ret_type};
+}
+
+static llvm_value_t
+inc_dec_llvm_codegen(llvm_codegen_t& cg, expression_n const* e)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  expression_n::operation_kind_t op = e->get_kind();
+  bool is_inc = op == expression_n::OP_PRE_INC || op == expression_n::OP_POST_INC;
+  bool is_post = op == expression_n::OP_POST_INC || op == expression_n::OP_POST_DEC;
+  llvm_value_t lvalue = e->get_child(0)->llvm_codegen_lvalue(cg);
+  c_type_t const* c_type = lvalue.c_type;
+  llvm::Type* llvm_type = cg.get_llvm_type(c_type);
+  bool is_atomic = c_type->get_is_atomic();
+  llvm::Value* old_value;
+  if (is_atomic) {
+    // a single atomicrmw adds or subtracts the one, the new value is
+    // computed from the old one as for any object
+    llvm::AtomicRMWInst::BinOp op = is_inc ? llvm::AtomicRMWInst::Add : llvm::AtomicRMWInst::Sub;
+    llvm::Value* one;
+    if (c_type->is_integer()) {
+      one = llvm::ConstantInt::get(llvm_type, 1);
+    }
+    else if (c_type->is_floating()) {
+      op = is_inc ? llvm::AtomicRMWInst::FAdd : llvm::AtomicRMWInst::FSub;
+      one = llvm::ConstantFP::get(llvm_type, 1.0);
+    }
+    else {
+      one = pointer_offset_in_bytes(cg, c_type, llvm::ConstantInt::get(llvm::Type::getInt64Ty(cg.get_ctx()), 1));
+    }
+    old_value = cg.atomic_rmw(op, lvalue, one, llvm::AtomicOrdering::SequentiallyConsistent);
+  }
+  else {
+    old_value = cg.load(lvalue);
+  }
+  llvm::Value* new_value;
+  if (c_type->is_integer()) {
+    llvm::Value* one = llvm::ConstantInt::get(llvm_type, 1);
+    // atomic arithmetic wraps around (C11 7.17.7.5p3)
+    if (c_type->has_undefined_overflow() && !is_atomic) {
+      new_value = cg.create_signed_arith(is_inc ? llvm::Instruction::Add : llvm::Instruction::Sub, old_value, one);
+    }
+    else {
+      new_value = is_inc ? builder.CreateAdd(old_value, one) : builder.CreateSub(old_value, one);
+    }
+  }
+  else if (c_type->is_floating()) {
+    llvm::Value* one = llvm::ConstantFP::get(llvm_type, 1.0);
+    new_value = is_inc ? builder.CreateFAdd(old_value, one) : builder.CreateFSub(old_value, one);
+  }
+  else {
+    assert(c_type->is_pointer());
+    llvm::Value* offset = llvm::ConstantInt::get(llvm::Type::getInt64Ty(cg.get_ctx()), is_inc ? 1 : -1, true);
+    new_value = cg.create_pointer_add(llvm_type->getPointerElementType(), old_value, offset);
+  }
+  if (!is_atomic) {
+    cg.store(new_value, lvalue);
+  }
+  return {is_post ? old_value : new_value, c_type};
+}
+
+// What an atomicrmw of op and value stored over old_value, computed like
+// it does: wrapping, on the integers of int_type if it is not nullptr
+static llvm::Value*
+get_atomic_rmw_result(llvm::IRBuilder<>& builder,
+                      llvm::AtomicRMWInst::BinOp op,
+                      llvm::IntegerType* int_type,
+                      llvm::Value* old_value,
+                      llvm::Value* value)
+{
+  if (op == llvm::AtomicRMWInst::FAdd) {
+    return builder.CreateFAdd(old_value, value);
+  }
+  if (op == llvm::AtomicRMWInst::FSub) {
+    return builder.CreateFSub(old_value, value);
+  }
+  llvm::Type* type = old_value->getType();
+  llvm::Value* old_int = int_type ? to_atomic_int(builder, old_value, int_type) : old_value;
+  llvm::Value* ret = nullptr;
+  switch (op) {
+    case llvm::AtomicRMWInst::Add: ret = builder.CreateAdd(old_int, value); break;
+    case llvm::AtomicRMWInst::Sub: ret = builder.CreateSub(old_int, value); break;
+    case llvm::AtomicRMWInst::And: ret = builder.CreateAnd(old_int, value); break;
+    case llvm::AtomicRMWInst::Or: ret = builder.CreateOr(old_int, value); break;
+    case llvm::AtomicRMWInst::Xor: ret = builder.CreateXor(old_int, value); break;
+    default: {
+      NOT_REACHED();
+    }
+  }
+  return int_type ? from_atomic_int(builder, ret, type) : ret;
+}
+
+// E1 op= E2 with an _Atomic E1 is a single atomic read-modify-write (C11
+// 6.5.16.2p3). That is an atomicrmw when op on the object's own type stores
+// what op on the types sema converted the operands to would, and a compare
+// exchange loop otherwise.
+static llvm_value_t
+atomic_compound_assignment_llvm_codegen(llvm_codegen_t& cg, expression_n const* e, llvm_value_t lvalue)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  sema_t const& sema = cg.get_sema();
+  expression_n::operation_kind_t op = compound_assignment_to_binary_op(e->get_kind());
+  c_type_t const* c_type = lvalue.c_type;
+  c_type_t const* l_type = sema.get_converted_type(e->get_child(0));
+  c_type_t const* r_type = sema.get_converted_type(e->get_child(1));
+  llvm::Value* r = cg.rvalue_llvm_codegen(e->get_child(1));
+  llvm::AtomicOrdering const seq_cst = llvm::AtomicOrdering::SequentiallyConsistent;
+  bool is_add_sub = op == expression_n::OP_ADD || op == expression_n::OP_SUB;
+  llvm::AtomicRMWInst::BinOp rmw_op = llvm::AtomicRMWInst::BAD_BINOP;
+  llvm::Value* rmw_value = nullptr;
+  // -ftrapv checks a signed + or - before the store, which takes the loop
+  bool is_trapping = is_add_sub && l_type->has_undefined_overflow() &&
+                     cg.get_options().signed_overflow == signed_overflow_t::TRAP;
+  if (c_type->is_integer() && l_type->is_integer() && !is_trapping) {
+    // wrapping add, sub and the bitwise ops give the same low bits whatever
+    // the width they are computed in
+    switch (op) {
+      case expression_n::OP_ADD: rmw_op = llvm::AtomicRMWInst::Add; break;
+      case expression_n::OP_SUB: rmw_op = llvm::AtomicRMWInst::Sub; break;
+      case expression_n::OP_BIT_AND: rmw_op = llvm::AtomicRMWInst::And; break;
+      case expression_n::OP_BIT_OR: rmw_op = llvm::AtomicRMWInst::Or; break;
+      case expression_n::OP_XOR: rmw_op = llvm::AtomicRMWInst::Xor; break;
+      default: break;
+    }
+    rmw_value = cg.convert({r, r_type}, c_type);
+  }
+  else if (c_type->is_floating() && is_add_sub && l_type->get_base_type() == c_type->get_base_type()) {
+    rmw_op = op == expression_n::OP_ADD ? llvm::AtomicRMWInst::FAdd : llvm::AtomicRMWInst::FSub;
+    rmw_value = cg.convert({r, r_type}, c_type);
+  }
+  else if (c_type->is_pointer() && is_add_sub) {
+    rmw_op = op == expression_n::OP_ADD ? llvm::AtomicRMWInst::Add : llvm::AtomicRMWInst::Sub;
+    rmw_value = pointer_offset_in_bytes(cg, c_type, r);
+  }
+  if (rmw_op != llvm::AtomicRMWInst::BAD_BINOP) {
+    llvm::Value* old_value = cg.atomic_rmw(rmw_op, lvalue, rmw_value, seq_cst);
+    // the value of the assignment is the one stored
+    llvm::IntegerType* int_type = cg.get_atomic_int_type(c_type);
+    return {get_atomic_rmw_result(builder, rmw_op, int_type, old_value, rmw_value), c_type};
+  }
+
+  // the compare exchange orders the accesses, the load only starts the loop
+  llvm::LoadInst* initial_value = llvm::cast<llvm::LoadInst>(cg.load(lvalue));
+  initial_value->setOrdering(llvm::AtomicOrdering::Monotonic);
+  llvm::BasicBlock* entry_bb = builder.GetInsertBlock();
+  llvm::BasicBlock* loop_bb = cg.create_block("atomic.op");
+  llvm::BasicBlock* end_bb = cg.create_block("atomic.end");
+  builder.CreateBr(loop_bb);
+  cg.start_block(loop_bb);
+  llvm::PHINode* old_value = builder.CreatePHI(cg.get_llvm_type(c_type), 2);
+  old_value->addIncoming(initial_value, entry_bb);
+  llvm_value_t result = binary_op_llvm_codegen(cg, op, cg.convert({old_value, c_type}, l_type), l_type, r, r_type);
+  llvm::Value* new_value = cg.convert(result, c_type);
+  llvm::Value* is_success;
+  llvm::Value* found_value = cg.atomic_cmpxchg(lvalue, old_value, new_value, seq_cst, seq_cst, false, is_success);
+  old_value->addIncoming(found_value, builder.GetInsertBlock());
+  builder.CreateCondBr(is_success, end_bb, loop_bb);
+  cg.start_block(end_bb);
+  return {new_value, c_type};
+}
+
+// What evaluating an operand that C lets the program skip would take
+struct speculation_cost_t
+{
+  // writes memory, calls a function or accesses a volatile or _Atomic object
+  bool has_side_effects = false;
+  // dereferences a pointer or divides integers
+  bool may_trap = false;
+  // may be poison, e.g. on overflow, which an and/or of it would spread
+  // even where the other operand decides the result
+  bool may_be_poison = false;
+  unsigned num_insts = 0;
+};
+
+// Adds the cost of e to cost, stopping early once it is over max_insts or
+// cannot be speculated anyway
+static void
+add_speculation_cost(llvm_codegen_t& cg, expression_n const* e, unsigned max_insts, speculation_cost_t& cost)
+{
+  if (cost.has_side_effects || cost.may_trap || cost.num_insts > max_insts) {
+    return;
+  }
+  sema_t const& sema = cg.get_sema();
+  c_type_t const* c_type = sema.get_type(e);
+  c_type_t const* converted_type = sema.get_converted_type(e);
+  if (c_type->is_floating() && !converted_type->is_floating()) {
+    cost.may_be_poison = true;
+  }
+  switch (e->get_kind()) {
+    case expression_n::OP_CONST: {
+      return;
+    }
+    case expression_n::OP_VAR: {
+      llvm_value_t addr;
+      if (c_type->get_is_volatile() || c_type->get_is_atomic()) {
+        cost.has_side_effects = true;
+      }
+      // locals end up in registers, globals take a load that cannot trap
+      else if (cg.lookup_symbol(e->get_identifier()->get_identifier_name(), addr) &&
+               llvm::isa<llvm::GlobalVariable>(addr.value)) {
+        cost.num_insts++;
+      }
+      return;
+    }
+    case expression_n::OP_ADDR: {
+      if (!e->get_child(0)->is_var()) {
+        cost.may_trap = true;
+      }
+      return;
+    }
+    case expression_n::OP_DEREF:
+    case expression_n::OP_SUBSCRIPT: {
+      cost.may_trap = true;
+      return;
+    }
+    case expression_n::OP_DIV:
+    case expression_n::OP_MOD: {
+      if (!c_type->is_floating()) {
+        cost.may_trap = true;
+        return;
+      }
+      cost.may_be_poison = true;
+      break;
+    }
+    case expression_n::OP_POS: {
+      // +x takes no instruction, so a chain of them, as long as the input
+      // makes it, is skipped in a loop rather than against the budget
+      expression_n const* operand = e->get_child(0);
+      while (operand->get_kind() == expression_n::OP_POS) {
+        operand = operand->get_child(0);
+      }
+      add_speculation_cost(cg, operand, max_insts, cost);
+      return;
+    }
+    case expression_n::OP_NEG:
+    case expression_n::OP_MUL:
+    case expression_n::OP_ADD:
+    case expression_n::OP_SUB: {
+      // the -ftrapv checks branch to a trap
+      if (c_type->has_undefined_overflow() && cg.get_options().signed_overflow == signed_overflow_t::TRAP) {
+        cost.may_trap = true;
+        return;
+      }
+      cost.may_be_poison = true;
+      break;
+    }
+    case expression_n::OP_LSHIFT:
+    case expression_n::OP_RSHIFT: {
+      cost.may_be_poison = true;
+      break;
+    }
+    case expression_n::OP_LT:
+    case expression_n::OP_GT:
+    case expression_n::OP_LTE:
+    case expression_n::OP_GTE:
+    case expression_n::OP_EQ:
+    case expression_n::OP_NEQ:
+    case expression_n::OP_LOGIC_NOT:
+    case expression_n::OP_LOGIC_AND:
+    case expression_n::OP_LOGIC_OR: {
+      // floating point comparisons may be poison under fast-math
+      for (auto const& child : e->get_list()) {
+        if (sema.get_type(child)->is_floating()) {
+          cost.may_be_poison = true;
+        }
+      }
+      break;
+    }
+    case expression_n::OP_COMPLEMENT:
+    case expression_n::OP_BIT_AND:
+    case expression_n::OP_BIT_OR:
+    case expression_n::OP_XOR:
+    case expression_n::OP_CONDITIONAL:
+    case expression_n::OP_COMMA: {
+      break;
+    }
+    default: {
+      cost.has_side_effects = true;
+      return;
+    }
+  }
+  cost.num_insts++;
+  for (auto const& child : e->get_list()) {
+    add_speculation_cost(cg, child, max_insts, cost);
+  }
+}
+
+// Whether the operands of e that C may skip can be evaluated unconditionally
+// so that e is lowered without branches. Counts the choice and its reason.
+static bool
+is_branchless(llvm_codegen_t& cg, expression_n const* e, speculation_cost_t& cost)
+{
+  branchless_t branchless = cg.get_options().branchless;
+  if (branchless == branchless_t::OFF) {
+    return false;
+  }
+  unsigned max_insts = branchless == branchless_t::AGGRESSIVE ? BRANCHLESS_AGGRESSIVE_MAX_INSTS :
+                                                                 BRANCHLESS_AUTO_MAX_INSTS;
+  // the operands after the first one are the skipped ones
+  for (size_t i = 1;i < e->get_size();i++) {
+    speculation_cost_t operand_cost;
+    add_speculation_cost(cg, e->get_child(i), max_insts, operand_cost);
+    cost.has_side_effects |= operand_cost.has_side_effects;
+    cost.may_trap |= operand_cost.may_trap;
+    cost.may_be_poison |= operand_cost.may_be_poison;
+    cost.num_insts += operand_cost.num_insts;
+  }
+  if (cost.has_side_effects) {
+    STATS_INC("codegen.branchless.rejected.side_effects");
+    return false;
+  }
+  if (cost.may_trap) {
+    STATS_INC("codegen.branchless.rejected.may_trap");
+    return false;
+  }
+  if (cost.num_insts > max_insts) {
+    STATS_INC("codegen.branchless.rejected.too_expensive");
+    return false;
+  }
+  return true;
+}
+
+static llvm_value_t
+logical_op_llvm_codegen(llvm_codegen_t& cg, expression_n const* e)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  bool is_and = e->get_kind() == expression_n::OP_LOGIC_AND;
+  c_type_t const* int_type = c_type_t::get_int_type();
+  speculation_cost_t cost;
+  if (is_branchless(cg, e, cost)) {
+    llvm::Value* l = cg.convert_to_i1(e->get_child(0)->llvm_codegen(cg));
+    llvm::Value* r = cg.convert_to_i1(e->get_child(1)->llvm_codegen(cg));
+    if (cg.get_sema().get_type(e->get_child(1))->is_floating()) {
+      cost.may_be_poison = true;
+    }
+    llvm::Value* value;
+    // a select only takes r when l does not decide, an and/or would be
+    // poison whenever r is
+    if (cost.may_be_poison) {
+      STATS_INC("codegen.branchless.logical_select");
+      value = is_and ? builder.CreateSelect(l, r, builder.getFalse()) :
+                       builder.CreateSelect(l, builder.getTrue(), r);
+    }
+    else {
+      STATS_INC("codegen.branchless.logical_bitwise");
+      value = is_and ? builder.CreateAnd(l, r) : builder.CreateOr(l, r);
+    }
+    return {builder.CreateZExt(value, cg.get_llvm_type(int_type)), int_type};
+  }
+  STATS_INC("codegen.branchless.logical_short_circuit");
+  llvm::Value* l = cg.convert_to_i1(e->get_child(0)->llvm_codegen(cg));
+  llvm::BasicBlock* lhs_bb = builder.GetInsertBlock();
+  llvm::BasicBlock* rhs_bb = cg.create_block(is_and ? "land.rhs" : "lor.rhs");
+  llvm::BasicBlock* end_bb = cg.create_block(is_and ? "land.end" : "lor.end");
+  if (is_and) {
+    cg.create_cond_br(l, rhs_bb, end_bb);
+  }
+  else {
+    cg.create_cond_br(l, end_bb, rhs_bb);
+  }
+  cg.start_block(rhs_bb);
+  llvm::Value* r = cg.convert_to_i1(e->get_child(1)->llvm_codegen(cg));
+  llvm::BasicBlock* rhs_end_bb = builder.GetInsertBlock();
+  builder.CreateBr(end_bb);
+  cg.start_block(end_bb);
+  llvm::PHINode* phi = builder.CreatePHI(builder.getInt1Ty(), 2);
+  phi->addIncoming(is_and ? builder.getFalse() : builder.getTrue(), lhs_bb);
+  phi->addIncoming(r, rhs_end_bb);
+  return {builder.CreateZExt(phi, cg.get_llvm_type(int_type)), int_type};
+}
+
+static llvm_value_t
+conditional_llvm_codegen(llvm_codegen_t& cg, expression_n const* e)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  c_type_t const* c_type = cg.get_sema().get_type(e);
+  speculation_cost_t cost;
+  if (!c_type->is_void() && is_branchless(cg, e, cost)) {
+    STATS_INC("codegen.branchless.conditional_select");
+    llvm::Value* cond = cg.convert_to_i1(e->get_child(0)->llvm_codegen(cg));
+    llvm::Value* tv = cg.rvalue_llvm_codegen(e->get_child(1));
+    llvm::Value* fv = cg.rvalue_llvm_codegen(e->get_child(2));
+    return {builder.CreateSelect(cond, tv, fv), c_type};
+  }
+  STATS_INC("codegen.branchless.conditional_branch");
+  llvm::Value* cond = cg.convert_to_i1(e->get_child(0)->llvm_codegen(cg));
+  llvm::BasicBlock* true_bb = cg.create_block("cond.true");
+  llvm::BasicBlock* false_bb = cg.create_block("cond.false");
+  llvm::BasicBlock* end_bb = cg.create_block("cond.end");
+  cg.create_cond_br(cond, true_bb, false_bb);
+  cg.start_block(true_bb);
+  llvm::Value* tv = cg.rvalue_llvm_codegen(e->get_child(1));
+  llvm::BasicBlock* true_end_bb = builder.GetInsertBlock();
+  builder.CreateBr(end_bb);
+  cg.start_block(false_bb);
+  llvm::Value* fv = cg.rvalue_llvm_codegen(e->get_child(2));
+  llvm::BasicBlock* false_end_bb = builder.GetInsertBlock();
+  builder.CreateBr(end_bb);
+
+  cg.start_block(end_bb);
+  if (c_type->is_void()) {
+    return {nullptr, c_type};
+  }
+  llvm::PHINode* phi = builder.CreatePHI(cg.get_llvm_type(c_type), 2);
+  phi->addIncoming(tv, true_end_bb);
+  phi->addIncoming(fv, false_end_bb);
+  return {phi, c_type};
+}
+
+// sema has checked that the expression is an lvalue: a variable, *p or a[i]
+llvm_value_t
+expression_n::llvm_codegen_lvalue(llvm_codegen_t& cg) const
+{
+  sema_t const& sema = cg.get_sema();
+  switch (this->get_kind()) {
+    case expression_n::OP_VAR: {
+      llvm_value_t addr;
+      if (!cg.lookup_symbol(this->get_identifier()->get_identifier_name(), addr)) {
+        NOT_REACHED();
+      }
+      return addr;
+    }
+    case expression_n::OP_DEREF: {
+      return {cg.rvalue_llvm_codegen(this->get_child(0)), sema.get_type(this)};
+    }
+    case expression_n::OP_SUBSCRIPT: {
+      llvm::Value* l = cg.rvalue_llvm_codegen(this->get_child(0));
+      llvm::Value* r = cg.rvalue_llvm_codegen(this->get_child(1));
+      llvm_value_t addr = binary_op_llvm_codegen(cg,
+                                                 expression_n::OP_ADD,
+                                                 l,
+                                                 sema.get_converted_type(this->get_child(0)),
+                                                 r,
+                                                 sema.get_converted_type(this->get_child(1)));
+      return {addr.value, sema.get_type(this)};
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+llvm_value_t
+expression_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  if (!stack_space_t::has_space()) {
+    llvm_value_t ret;
+    if (!stack_space_t::run_on_new_stack([&]() { ret = this->llvm_codegen(cg); })) {
+      cg.error(stack_space_t::get_error());
+      // the module is dropped, lowering only goes on to a consistent end
+      c_type_t const* c_type = cg.get_sema().get_type(this);
+      ret = {c_type->is_void() ? nullptr : llvm::UndefValue::get(cg.get_llvm_type(c_type)), c_type};
+    }
+    return ret;
+  }
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  expr_info_t const& info = cg.get_sema().get_info(this);
+  switch (this->get_kind()) {
+    case expression_n::OP_EMPTY: {
+      return {nullptr, c_type_t::get_void_type()};
+    }
+    case expression_n::OP_VAR: {
+      string const& name = this->get_identifier()->get_identifier_name();
+      llvm_value_t addr;
+      if (!cg.lookup_symbol(name, addr)) {
+        // sema only lets the names <stdatomic.h> would define through
+        // undeclared
+        int constant;
+        if (!get_builtin_constant(name, constant)) {
+          NOT_REACHED();
+        }
+        return {llvm::ConstantInt::get(cg.get_llvm_type(info.c_type), constant), info.c_type};
+      }
+      if (info.category == expr_info_t::FUNCTION_DESIGNATOR) {
+        // function designators decay to function pointers
+        return {addr.value, info.c_type};
+      }
+      return {cg.load(addr, name), info.c_type};
+    }
+    case expression_n::OP_SUBSCRIPT:
+    case expression_n::OP_DEREF: {
+      if (info.category == expr_info_t::FUNCTION_DESIGNATOR) {
+        // *f is the function f points to, which decays back to f
+        return {cg.rvalue_llvm_codegen(this->get_child(0)), info.c_type};
+      }
+      return {cg.load(this->llvm_codegen_lvalue(cg)), info.c_type};
+    }
+    case expression_n::OP_ADDR: {
+      expression_n const* operand = this->get_child(0);
+      if (cg.get_sema().get_info(operand).category == expr_info_t::FUNCTION_DESIGNATOR) {
+        return {operand->llvm_codegen(cg).value, info.c_type};
+      }
+      return {operand->llvm_codegen_lvalue(cg).value, info.c_type};
+    }
+    case expression_n::OP_CONST: {
+      if (this->get_constant()->get_sort() == constant_n::STRING_LITERAL) {
+        return {cg.get_string_literal(cg.get_sema().get_string_id(this)), info.c_type};
+      }
+      return this->get_constant()->llvm_codegen(cg, info.c_type);
+    }
+    case expression_n::OP_COMMA: {
+      this->get_child(0)->llvm_codegen(cg);
+      return this->get_child(1)->llvm_codegen(cg);
+    }
+    case expression_n::OP_FUNC_CALL: {
+      return function_call_llvm_codegen(cg, this);
+    }
+    case expression_n::OP_POST_INC:
+    case expression_n::OP_POST_DEC:
+    case expression_n::OP_PRE_INC:
+    case expression_n::OP_PRE_DEC: {
+      return inc_dec_llvm_codegen(cg, this);
+    }
+    case expression_n::OP_POS:
+    case expression_n::OP_NEG:
+    case expression_n::OP_COMPLEMENT: {
+      llvm::Value* value = cg.rvalue_llvm_codegen(this->get_child(0));
+      if (this->get_kind() == expression_n::OP_NEG && info.c_type->has_undefined_overflow()) {
+        value = cg.create_signed_arith(llvm::Instruction::Sub, llvm::Constant::getNullValue(value->getType()), value);
+      }
+      else if (this->get_kind() == expression_n::OP_NEG) {
+        value = info.c_type->is_floating() ? builder.CreateFNeg(value) : builder.CreateNeg(value);
+      }
+      else if (this->get_kind() == expression_n::OP_COMPLEMENT) {
+        value = builder.CreateNot(value);
+      }
+      return {value, info.c_type};
+    }
+    case expression_n::OP_LOGIC_NOT: {
+      llvm::Value* value = cg.convert_to_i1(this->get_child(0)->llvm_codegen(cg));
+      c_type_t const* int_type = c_type_t::get_int_type();
+      return {builder.CreateZExt(builder.CreateNot(value), cg.get_llvm_type(int_type)), int_type};
+    }
+    case expression_n::OP_MUL:
+    case expression_n::OP_DIV:
+    case expression_n::OP_MOD:
+    case expression_n::OP_ADD:
+    case expression_n::OP_SUB:
+    case expression_n::OP_LSHIFT:
+    case expression_n::OP_RSHIFT:
+    case expression_n::OP_LT:
+    case expression_n::OP_GT:
+    case expression_n::OP_LTE:
+    case expression_n::OP_GTE:
+    case expression_n::OP_EQ:
+    case expression_n::OP_NEQ:
+    case expression_n::OP_BIT_AND:
+    case expression_n::OP_BIT_OR:
+    case expression_n::OP_XOR: {
+      sema_t const& sema = cg.get_sema();
+      llvm::Value* l = cg.rvalue_llvm_codegen(this->get_child(0));
+      llvm::Value* r = cg.rvalue_llvm_codegen(this->get_child(1));
+      return binary_op_llvm_codegen(cg,
+                                    this->get_kind(),
+                                    l,
+                                    sema.get_converted_type(this->get_child(0)),
+                                    r,
+                                    sema.get_converted_type(this->get_child(1)));
+    }
+    case expression_n::OP_LOGIC_AND:
+    case expression_n::OP_LOGIC_OR: {
+      return logical_op_llvm_codegen(cg, this);
+    }
+    case expression_n::OP_CONDITIONAL: {
+      return conditional_llvm_codegen(cg, this);
+    }
+    case expression_n::OP_ASSIGN: {
+      llvm_value_t lvalue = this->get_child(0)->llvm_codegen_lvalue(cg);
+      llvm::Value* value = cg.rvalue_llvm_codegen(this->get_child(1));
+      cg.store(value, lvalue);
+      return {value, lvalue.c_type};
+    }
+    case expression_n::OP_MUL_ASSIGN:
+    case expression_n::OP_DIV_ASSIGN:
+    case expression_n::OP_MOD_ASSIGN:
+    case expression_n::OP_ADD_ASSIGN:
+    case expression_n::OP_SUB_ASSIGN:
+    case expression_n::OP_LSHIFT_ASSIGN:
+    case expression_n::OP_RSHIFT_ASSIGN:
+    case expression_n::OP_BIT_AND_ASSIGN:
+    case expression_n::OP_XOR_ASSIGN:
+    case expression_n::OP_BIT_OR_ASSIGN: {
+      sema_t const& sema = cg.get_sema();
+      llvm_value_t lvalue = this->get_child(0)->llvm_codegen_lvalue(cg);
+      if (lvalue.c_type->get_is_atomic()) {
+        return atomic_compound_assignment_llvm_codegen(cg, this, lvalue);
+      }
+      llvm_value_t old_value = {cg.load(lvalue), lvalue.c_type};
+      c_type_t const* l_type = sema.get_converted_type(this->get_child(0));
+      llvm::Value* l = cg.convert(old_value, l_type);
+      llvm::Value* r = cg.rvalue_llvm_codegen(this->get_child(1));
+      llvm_value_t result = binary_op_llvm_codegen(cg,
+                                                   compound_assignment_to_binary_op(this->get_kind()),
+                                                   l,
+                                                   l_type,
+                                                   r,
+                                                   sema.get_converted_type(this->get_child(1)));
+      llvm::Value* value = cg.convert(result, lvalue.c_type);
+      cg.store(value, lvalue);
+      return {value, lvalue.c_type};
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+void
+selection_statement_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  if (this->get_selection_sort() == selection_statement_n::SWITCH) {
+    // __builtin_expect on the controlling expression becomes case weights
+    expression_n const* cond_expr = this->get_cond();
+    expression_n const* expected_expr = nullptr;
+    if (cond_expr->is_builtin_expect_call()) {
+      expected_expr = cond_expr->get_child(1)->get_child(1);
+      cond_expr = cond_expr->get_child(1)->get_child(0);
+    }
+    // both arguments of __builtin_expect are evaluated before the switch
+    // jumps, and only an integer constant names the expected case
+    llvm::Value* cond = cg.rvalue_llvm_codegen(cond_expr);
+    llvm::ConstantInt* expected_value = nullptr;
+    if (expected_expr) {
+      expected_value = llvm::dyn_cast<llvm::ConstantInt>(cg.rvalue_llvm_codegen(expected_expr));
+    }
+    llvm::BasicBlock* epilog_bb = cg.create_block("sw.epilog");
+    llvm::SwitchInst* switch_inst = builder.CreateSwitch(cond, epilog_bb);
+    cg.push_switch({switch_inst, false});
+    cg.push_jump_targets(epilog_bb, cg.get_continue_target());
+    // anything before the first case label is unreachable
+    cg.start_block(cg.create_block("sw.body"));
+    this->get_body()->llvm_codegen(cg);
+    cg.emit_branch(epilog_bb);
+    cg.pop_jump_targets();
+    cg.pop_switch();
+    // set before the profile, whose counts replace these weights when the
+    // function has some
+    if (expected_value && switch_inst->getMetadata(llvm::LLVMContext::MD_prof) == nullptr) {
+      vector<uint32_t> weights(switch_inst->getNumSuccessors(), UNLIKELY_BRANCH_WEIGHT);
+      weights[switch_inst->findCaseValue(expected_value)->getSuccessorIndex()] = LIKELY_BRANCH_WEIGHT;
+      switch_inst->setMetadata(llvm::LLVMContext::MD_prof,
+                               llvm::MDBuilder(cg.get_ctx()).createBranchWeights(weights));
+    }
+    cg.profile_switch(switch_inst);
+    cg.start_block(epilog_bb);
+    return;
+  }
+
+  llvm::Value* cond = cg.convert_to_i1(this->get_cond()->llvm_codegen(cg));
+  bool has_else_clause = this->get_selection_sort() == selection_statement_n::IF_THEN_ELSE;
+  llvm::BasicBlock* then_bb = cg.create_block("if.then");
+  llvm::BasicBlock* else_bb = has_else_clause ? cg.create_block("if.else") : nullptr;
+  llvm::BasicBlock* end_bb = cg.create_block("if.end");
+  cg.create_cond_br(cond, then_bb, has_else_clause ? else_bb : end_bb);
+  cg.start_block(then_bb);
+  this->get_body()->llvm_codegen(cg);
+  cg.emit_branch(end_bb);
+  if (has_else_clause) {
+    cg.start_block(else_bb);
+    this->get_else_body()->llvm_codegen(cg);
+    cg.emit_branch(end_bb);
+  }
+  cg.start_block(end_bb);
+}
+
+void
+labeled_statement_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  llvm_codegen_t::switch_ctx_t* switch_ctx = cg.get_cur_switch();
+  bool is_case = this->get_label_sort() == labeled_statement_n::CASE;
+  llvm::BasicBlock* bb = cg.create_block(is_case ? "sw.bb" : "sw.default");
+  cg.emit_branch(bb);
+  cg.start_block(bb);
+  assert(switch_ctx);
+  if (is_case) {
+    llvm::ConstantInt* value = llvm::dyn_cast<llvm::ConstantInt>(cg.rvalue_llvm_codegen(this->get_case_expr()));
+    if (value == nullptr) {
+      cg.error("case label does not reduce to an integer constant");
+    }
+    else if (switch_ctx->switch_inst->findCaseValue(value) !=
+             switch_ctx->switch_inst->case_default()) {
+      cg.error("duplicate case value " + to_string(value->getSExtValue()));
+    }
+    else {
+      switch_ctx->switch_inst->addCase(value, bb);
+    }
+  }
+  else if (switch_ctx->has_default) {
+    cg.error("multiple default labels in one switch");
+  }
+  else {
+    switch_ctx->has_default = true;
+    switch_ctx->switch_inst->setDefaultDest(bb);
+  }
+  this->get_body()->llvm_codegen(cg);
+}
+
+// Builds the self-referential llvm.loop metadata node carrying the hints
+static llvm::MDNode*
+loop_hints_to_metadata(llvm::LLVMContext& ctx, loop_hints_t const& hints)
+{
+  llvm::Type* i32_type = llvm::Type::getInt32Ty(ctx);
+  llvm::Type* i1_type = llvm::Type::getInt1Ty(ctx);
+  vector<llvm::Metadata*> ops;
+  auto add_hint = [&](string const& name, llvm::Type* type, uint64_t value) {
+    ops.push_back(llvm::MDNode::get(ctx, {
+      llvm::MDString::get(ctx, name),
+      llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(type, value))
+    }));
+  };
+  auto add_flag = [&](string const& name) {
+    ops.push_back(llvm::MDNode::get(ctx, {llvm::MDString::get(ctx, name)}));
+  };
+
+  ops.push_back(nullptr); // replaced by the node itself
+  if (hints.get_unroll() == loop_hints_t::HINT_DISABLE) {
+    add_flag("llvm.loop.unroll.disable");
+  }
+  else if (hints.get_unroll() == loop_hints_t::HINT_ENABLE) {
+    if (hints.get_unroll_full()) {
+      add_flag("llvm.loop.unroll.full");
+    }
+    else if (hints.get_unroll_count()) {
+      add_hint("llvm.loop.unroll.count", i32_type, hints.get_unroll_count());
+    }
+    else {
+      add_flag("llvm.loop.unroll.enable");
+    }
+  }
+  if (hints.get_vectorize() != loop_hints_t::HINT_DEFAULT) {
+    bool enable = hints.get_vectorize() == loop_hints_t::HINT_ENABLE;
+    add_hint("llvm.loop.vectorize.enable", i1_type, enable);
+    if (!enable) {
+      add_hint("llvm.loop.vectorize.width", i32_type, 1);
+    }
+    else if (hints.get_vectorize_width()) {
+      add_hint("llvm.loop.vectorize.width", i32_type, hints.get_vectorize_width());
+    }
+  }
+  if (hints.get_interleave_count()) {
+    add_hint("llvm.loop.interleave.count", i32_type, hints.get_interleave_count());
+  }
+  if (hints.get_distribute()) {
+    add_hint("llvm.loop.distribute.enable", i1_type, 1);
+  }
+  llvm::MDNode* loop_id = llvm::MDNode::getDistinct(ctx, ops);
+  loop_id->replaceOperandWith(0, loop_id);
+  return loop_id;
+}
+
+// Branches to true_bb if cond holds, an empty condition always holds
+static llvm::BranchInst*
+loop_cond_branch_llvm_codegen(llvm_codegen_t& cg,
+                              expression_n const* cond,
+                              llvm::BasicBlock* true_bb,
+                              llvm::BasicBlock* false_bb)
+{
+  if (cond->get_kind() == expression_n::OP_EMPTY) {
+    return cg.get_builder().CreateBr(true_bb);
+  }
+  return cg.create_cond_br(cg.convert_to_i1(cond->llvm_codegen(cg)), true_bb, false_bb);
+}
+
+// Loops are emitted in rotated form: a guard in the preheader tests the
+// condition once, and the latch re-tests it at the bottom of the body. This
+// is the shape the loop passes expect, the latch branch carries the hints.
+void
+iteration_statement_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  iteration_sort_t sort = this->get_iteration_sort();
+  llvm::BasicBlock* body_bb = cg.create_block("loop.body");
+  llvm::BasicBlock* latch_bb = cg.create_block("loop.latch");
+  llvm::BasicBlock* end_bb = cg.create_block("loop.end");
+
+  cg.push_scope();
+  if (sort == iteration_statement_n::FOR) {
+    this->get_init_expr()->llvm_codegen(cg);
+  }
+  else if (sort == iteration_statement_n::FOR_DECL) {
+    this->get_init_decl()->llvm_codegen(cg);
+  }
+  if (sort == iteration_statement_n::DO_WHILE) {
+    cg.emit_branch(body_bb);
+  }
+  else {
+    loop_cond_branch_llvm_codegen(cg, this->get_cond(), body_bb, end_bb);
+  }
+  cg.start_block(body_bb);
+  cg.push_jump_targets(end_bb, latch_bb);
+  this->get_body()->llvm_codegen(cg);
+  cg.pop_jump_targets();
+  cg.emit_branch(latch_bb);
+  cg.start_block(latch_bb);
+  if (this->iteration_statement_has_update_expr()) {
+    this->get_update_expr()->llvm_codegen(cg);
+  }
+  llvm::BranchInst* latch_br = loop_cond_branch_llvm_codegen(cg, this->get_cond(), body_bb, end_bb);
+  if (!this->get_loop_hints().empty()) {
+    latch_br->setMetadata(llvm::LLVMContext::MD_loop,
+                          loop_hints_to_metadata(cg.get_ctx(), this->get_loop_hints()));
+  }
+  cg.start_block(end_bb);
+  cg.pop_scope();
+}
+
+// acc op value, for the returns of a function with an accumulator
+static llvm::Value*
+accumulate_llvm_codegen(llvm_codegen_t& cg, llvm::Value* value)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  llvm_codegen_t::tail_recursion_ctx_t* tail_recursion = cg.get_tail_recursion();
+  llvm::Value* acc = builder.CreateLoad(value->getType(), tail_recursion->accumulator);
+  switch (tail_recursion->tre->get_accumulator_op()) {
+    case expression_n::OP_ADD: return builder.CreateAdd(acc, value);
+    case expression_n::OP_MUL: return builder.CreateMul(acc, value);
+    case expression_n::OP_BIT_AND: return builder.CreateAnd(acc, value);
+    case expression_n::OP_BIT_OR: return builder.CreateOr(acc, value);
+    case expression_n::OP_XOR: return builder.CreateXor(acc, value);
+    default: NOT_REACHED();
+  }
+  return nullptr;
+}
+
+// Lowers a recursive tail call as: compute the arguments (and fold the
+// pending operand into the accumulator), store them to the parameters and
+// branch back to the top of the body
+static void
+tail_recursion_llvm_codegen(llvm_codegen_t& cg, tail_recursion_t::tail_call_t const& tail_call)
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  llvm_codegen_t::tail_recursion_ctx_t* tail_recursion = cg.get_tail_recursion();
+  c_type_t const* function_type = cg.get_cur_function_type();
+  vector<llvm::Value*> arg_values;
+  for (auto const& arg : tail_call.call->get_child(1)->get_list()) {
+    arg_values.push_back(cg.rvalue_llvm_codegen(arg));
+  }
+  if (tail_call.kind == tail_recursion_t::ACCUMULATED_RECURSIVE_CALL) {
+    llvm::Value* operand = cg.convert(tail_call.operand->llvm_codegen(cg), function_type->get_return_type());
+    builder.CreateStore(accumulate_llvm_codegen(cg, operand), tail_recursion->accumulator);
+  }
+  for (size_t i = 0;i < arg_values.size();i++) {
+    builder.CreateStore(arg_values[i], tail_recursion->param_addrs[i]);
+  }
+  builder.CreateBr(tail_recursion->loop_bb);
+}
+
+// A call whose value is returned as is gets the tail marker, or musttail
+// when the callee has the same prototype so that the call is guaranteed to
+// reuse the frame. Neither is allowed once a callee may access the allocas
+// of the caller, i.e. when the function takes the address of a local.
+static void
+mark_tail_call(llvm_codegen_t& cg, expression_n const* e, llvm::Value* ret_value)
+{
+  llvm::BasicBlock* bb = cg.get_builder().GetInsertBlock();
+  if (e->get_kind() != expression_n::OP_FUNC_CALL || bb->empty() || cg.get_takes_local_address()) {
+    return;
+  }
+  llvm::CallInst* call = llvm::dyn_cast<llvm::CallInst>(&bb->back());
+  if (call == nullptr || (ret_value != nullptr && ret_value != call) ||
+      (call->getCalledFunction() && call->getCalledFunction()->isIntrinsic())) {
+    return;
+  }
+  llvm::Function* caller = cg.get_cur_function();
+  bool is_same_prototype = call->getFunctionType() == caller->getFunctionType() &&
+                           !caller->isVarArg() &&
+                           call->getCallingConv() == caller->getCallingConv();
+  call->setTailCallKind(is_same_prototype ? llvm::CallInst::TCK_MustTail : llvm::CallInst::TCK_Tail);
+  cg.count_tail_call();
+}
+
+void
+jump_statement_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  switch (this->get_jump_sort()) {
+    case jump_statement_n::CONTINUE:
+    case jump_statement_n::BREAK: {
+      bool is_break = this->get_jump_sort() == jump_statement_n::BREAK;
+      llvm::BasicBlock* target = is_break ? cg.get_break_target() : cg.get_continue_target();
+      if (target == nullptr) {
+        cg.error(is_break ? "break statement not within loop or switch" :
+                            "continue statement not within a loop");
+        return;
+      }
+      builder.CreateBr(target);
+      return;
+    }
+    case jump_statement_n::RETURN: {
+      c_type_t const* ret_type = cg.get_cur_function_type()->get_return_type();
+      if (this->get_expr_for_return() == nullptr) {
+        if (ret_type->is_void()) {
+          builder.CreateRetVoid();
+        }
+        else {
+          builder.CreateRet(llvm::UndefValue::get(cg.get_llvm_type(ret_type)));
+        }
+        return;
+      }
+      llvm_codegen_t::tail_recursion_ctx_t* tail_recursion = cg.get_tail_recursion();
+      if (tail_recursion) {
+        tail_recursion_t::tail_call_t tail_call = tail_recursion->tre->get_tail_call(this);
+        if (tail_call.kind != tail_recursion_t::NOT_TAIL_RECURSIVE) {
+          tail_recursion_llvm_codegen(cg, tail_call);
+          return;
+        }
+      }
+      if (ret_type->is_void()) {
+        this->get_expr_for_return()->llvm_codegen(cg);
+        mark_tail_call(cg, this->get_expr_for_return(), nullptr);
+        builder.CreateRetVoid();
+        return;
+      }
+      llvm::Value* ret_value = cg.rvalue_llvm_codegen(this->get_expr_for_return());
+      if (tail_recursion && tail_recursion->accumulator) {
+        ret_value = accumulate_llvm_codegen(cg, ret_value);
+      }
+      mark_tail_call(cg, this->get_expr_for_return(), ret_value);
+      builder.CreateRet(ret_value);
+      return;
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+void
+statement_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  if (!stack_space_t::has_space()) {
+    if (!stack_space_t::run_on_new_stack([&]() { this->llvm_codegen(cg); })) {
+      cg.error(stack_space_t::get_error());
+    }
+    return;
+  }
+  switch (this->m_statement_type) {
+    case statement_n::LABELED_STATEMENT: {
+      labeled_statement_n* labeled_statement =
+        dynamic_cast<labeled_statement_n*>(this->m_generic_statement);
+      labeled_statement->llvm_codegen(cg);
+      return;
+    }
+    case statement_n::COMPOUND_STATEMENT: {
+      compound_statement_n* compound_statement =
+        dynamic_cast<compound_statement_n*>(this->m_generic_statement);
+      compound_statement->llvm_codegen(cg);
+      return;
+    }
+    case statement_n::EXPRESSION: {
+      expression_n* expression = dynamic_cast<expression_n*>(this->m_generic_statement);
+      cg.ensure_insertion_block();
+      if (cg.get_tail_recursion()) {
+        tail_recursion_t::tail_call_t tail_call = cg.get_tail_recursion()->tre->get_tail_call(expression);
+        if (tail_call.kind != tail_recursion_t::NOT_TAIL_RECURSIVE) {
+          tail_recursion_llvm_codegen(cg, tail_call);
+          return;
+        }
+      }
+      expression->llvm_codegen(cg);
+      return;
+    }
+    case statement_n::SELECTION_STATEMENT: {
+      selection_statement_n* selection_statement =
+        dynamic_cast<selection_statement_n*>(this->m_generic_statement);
+      cg.ensure_insertion_block();
+      selection_statement->llvm_codegen(cg);
+      return;
+    }
+    case statement_n::ITERATION_STATEMENT: {
+      iteration_statement_n* iteration_statement =
+        dynamic_cast<iteration_statement_n*>(this->m_generic_statement);
+      cg.ensure_insertion_block();
+      iteration_statement->llvm_codegen(cg);
+      return;
+    }
+    case statement_n::JUMP_STATEMENT: {
+      jump_statement_n* jump_statement =
+        dynamic_cast<jump_statement_n*>(this->m_generic_statement);
+      cg.ensure_insertion_block();
+      jump_statement->llvm_codegen(cg);
+      return;
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+void
+block_item_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  if (this->m_declaration) {
+    this->m_declaration->llvm_codegen(cg);
+    return;
+  }
+  if (this->m_fp_pragma) {
+    this->m_fp_pragma->llvm_codegen(cg);
+    return;
+  }
+  assert(this->m_statement);
+  this->m_statement->llvm_codegen(cg);
+}
+
+void
+compound_statement_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  // a pragma in the block holds up to its end
+  fp_mode_t fp_mode = cg.get_fp_mode();
+  cg.push_scope();
+  for (auto const& block_item : this->get_list()) {
+    block_item->llvm_codegen(cg);
+  }
+  cg.pop_scope();
+  cg.set_fp_mode(fp_mode);
+}
+
+void
+fp_pragma_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  fp_mode_t fp_mode = cg.get_fp_mode();
+  llvm::FastMathFlags& flags = fp_mode.flags;
+  for (unsigned flag = 1;flag < FP_ALL;flag <<= 1) {
+    if (!(this->m_enabled_flags & flag) && !(this->m_disabled_flags & flag)) {
+      continue;
+    }
+    bool is_enabled = this->m_enabled_flags & flag;
+    switch (flag) {
+      case FP_REASSOC: flags.setAllowReassoc(is_enabled); break;
+      case FP_NNAN: flags.setNoNaNs(is_enabled); break;
+      case FP_NINF: flags.setNoInfs(is_enabled); break;
+      case FP_NSZ: flags.setNoSignedZeros(is_enabled); break;
+      case FP_ARCP: flags.setAllowReciprocal(is_enabled); break;
+      case FP_AFN: flags.setApproxFunc(is_enabled); break;
+      default: {
+        NOT_REACHED();
+      }
+    }
+  }
+  switch (this->m_contract) {
+    case CONTRACT_UNCHANGED: break;
+    case CONTRACT_DEFAULT: fp_mode.contract = cg.get_options().fp_mode.contract; break;
+    case CONTRACT_OFF: fp_mode.contract = fp_contract_t::OFF; break;
+    case CONTRACT_ON: fp_mode.contract = fp_contract_t::ON; break;
+    case CONTRACT_FAST: fp_mode.contract = fp_contract_t::FAST; break;
+  }
+  cg.set_fp_mode(fp_mode);
+}
+
+void
+declaration_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  c_type_t const* base_type = this->m_declaration_specifiers->declaration_specifiers_get_c_type();
+  if (this->m_init_declarator_list == nullptr) {
+    return;
+  }
+  for (auto const& init_declarator : this->m_init_declarator_list->get_list()) {
+    declarator_n const* declarator = init_declarator->get_declarator();
+    string const& name = declarator->get_identifier_name();
+    c_type_t const* c_type = declarator->get_c_type(base_type);
+    if (c_type->is_function()) {
+      cg.declare_function(name, c_type, this->m_declaration_specifiers);
+      continue;
+    }
+    bool is_static = this->m_declaration_specifiers->has_specifier(specifier_t::STATIC);
+    bool is_extern = this->m_declaration_specifiers->has_specifier(specifier_t::EXTERN);
+    bool is_thread_local = this->m_declaration_specifiers->has_specifier(specifier_t::THREAD_LOCAL);
+    if (!is_thread_local && this->m_declaration_specifiers->get_attribute("tls_model") != nullptr) {
+      cg.error("tls_model attribute on " + name + ", which is not _Thread_local");
+      continue;
+    }
+    llvm::Type* llvm_type = cg.get_llvm_type(c_type);
+    if (cg.is_global_scope() || is_extern) {
+      if (cg.is_global_scope() &&
+          (this->m_declaration_specifiers->has_specifier(specifier_t::AUTO) ||
+           this->m_declaration_specifiers->has_specifier(specifier_t::REGISTER))) {
+        cg.error("illegal storage class on file-scoped variable " + name);
+        continue;
+      }
+      // an extern declaration refers to the definition wherever it is, a
+      // file scope declaration without extern is a (tentative) definition
+      llvm::GlobalVariable* global = cg.get_module().getGlobalVariable(name, true);
+      if (global == nullptr) {
+        global = new llvm::GlobalVariable(cg.get_module(),
+                                          llvm_type,
+                                          false,
+                                          is_static ? llvm::GlobalValue::InternalLinkage :
+                                                      llvm::GlobalValue::ExternalLinkage,
+                                          nullptr,
+                                          name);
+      }
+      else if (global->getValueType() != llvm_type) {
+        cg.error("conflicting types for " + name);
+      }
+      else if (is_static && !global->hasLocalLinkage()) {
+        cg.error("static declaration of " + name + " follows non-static declaration");
+      }
+      else if (global->isThreadLocal() != is_thread_local) {
+        cg.error(string(is_thread_local ? "thread-local" : "non-thread-local") + " declaration of " + name +
+                 " follows " + (is_thread_local ? "non-thread-local" : "thread-local") + " declaration");
+      }
+      if (is_thread_local) {
+        cg.declare_thread_local(global, this->m_declaration_specifiers);
+      }
+      if (!is_extern && !global->hasInitializer()) {
+        global->setInitializer(llvm::Constant::getNullValue(llvm_type));
+      }
+      // a const object defined here keeps its initial value
+      if (global->hasInitializer() && c_type->get_is_const() && !c_type->get_is_volatile()) {
+        global->setConstant(true);
+      }
+      cg.add_symbol(name, {global, c_type});
+    }
+    else if (is_static) {
+      // block scope statics live in an internal global named after the function
+      string global_name = cg.get_cur_function()->getName().str() + "." + name;
+      llvm::GlobalVariable* global = new llvm::GlobalVariable(cg.get_module(),
+                                                              llvm_type,
+                                                              c_type->get_is_const() && !c_type->get_is_volatile(),
+                                                              llvm::GlobalValue::InternalLinkage,
+                                                              llvm::Constant::getNullValue(llvm_type),
+                                                              global_name);
+      if (is_thread_local) {
+        cg.declare_thread_local(global, this->m_declaration_specifiers);
+      }
+      cg.add_symbol(name, {global, c_type});
+    }
+    else {
+      cg.add_symbol(name, {cg.create_entry_alloca(llvm_type, name), c_type});
+    }
+  }
+}
+
+void
+function_definition_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  c_type_t const* base_type = this->m_declaration_specifiers->declaration_specifiers_get_c_type();
+  c_type_t const* c_type = this->m_declarator->get_c_type(base_type);
+  string const& name = this->m_declarator->get_identifier_name();
+  llvm::Function* function = cg.declare_function(name, c_type, this->m_declaration_specifiers);
+  if (!function->empty() || cg.is_multiversioned(function)) {
+    cg.error("redefinition of " + name);
+    return;
+  }
+  if (attribute_n const* clones_attribute = this->m_declaration_specifiers->get_attribute("target_clones")) {
+    vector<llvm::Function*> clones;
+    if (!cg.declare_target_clones(function, clones_attribute, clones)) {
+      return;
+    }
+    for (auto const& clone : clones) {
+      this->llvm_codegen_body(cg, clone, c_type);
+    }
+    return;
+  }
+  this->llvm_codegen_body(cg, function, c_type);
+}
+
+void
+function_definition_n::llvm_codegen_body(llvm_codegen_t& cg,
+                                         llvm::Function* function,
+                                         c_type_t const* c_type) const
+{
+  string const name = function->getName().str();
+  cg.begin_function(function, c_type);
+  cg.push_scope();
+  vector<parameter_declaration_n*> const& params = this->m_declarator->get_parameter_list()->get_list();
+  llvm::IRBuilder<>& builder = cg.get_builder();
+  bool takes_local_address = cg.get_sema().get_takes_local_address(this);
+  cg.set_takes_local_address(takes_local_address);
+  tail_recursion_t tre(this, c_type, takes_local_address);
+  llvm_codegen_t::tail_recursion_ctx_t tail_recursion = {&tre, nullptr, {}, nullptr};
+  auto arg_it = function->arg_begin();
+  for (size_t i = 0;i < c_type->get_param_types().size();i++, arg_it++) {
+    if (params[i]->get_declarator() == nullptr) {
+      continue;
+    }
+    string const& param_name = params[i]->get_declarator()->get_identifier_name();
+    c_type_t const* param_type = c_type->get_param_types()[i];
+    arg_it->setName(param_name);
+    llvm::AllocaInst* addr = cg.create_entry_alloca(arg_it->getType(), param_name + ".addr");
+    builder.CreateStore(&*arg_it, addr);
+    cg.add_symbol(param_name, {addr, param_type});
+    tail_recursion.param_addrs.push_back(addr);
+  }
+  if (tre.is_eliminable()) {
+    if (tre.get_accumulator_op() != expression_n::OP_EMPTY) {
+      llvm::Type* ret_type = function->getReturnType();
+      tail_recursion.accumulator = cg.create_entry_alloca(ret_type, "accumulator");
+      builder.CreateStore(llvm::ConstantInt::get(ret_type, tre.get_accumulator_identity(tre.get_accumulator_op()), true),
+                          tail_recursion.accumulator);
+    }
+    tail_recursion.loop_bb = cg.create_block("tailrecurse");
+    builder.CreateBr(tail_recursion.loop_bb);
+    cg.start_block(tail_recursion.loop_bb);
+    cg.set_tail_recursion(&tail_recursion);
+  }
+  this->get_compound_statement()->llvm_codegen(cg);
+  cg.pop_scope();
+  diagnostics_t& diagnostics = cg.get_sema().get_diagnostics();
+  if (cg.get_options().report_tail_calls && tre.is_eliminable()) {
+    string msg = "tail calls: " + name + ": " + to_string(tre.get_num_eliminated()) +
+                 " recursive call(s) turned into a loop";
+    if (tre.get_accumulator_op() != expression_n::OP_EMPTY) {
+      msg += string(" with a '") + tail_recursion_t::accumulator_op_to_string(tre.get_accumulator_op()) +
+             "' accumulator";
+    }
+    diagnostics.report(diagnostics_t::NOTE, nullptr, msg);
+  }
+  if (cg.get_options().report_tail_calls && cg.get_num_tail_calls() > 0) {
+    diagnostics.report(diagnostics_t::NOTE, nullptr,
+                       "tail calls: " + name + ": " + to_string(cg.get_num_tail_calls()) + " call(s) marked tail");
+  }
+  cg.end_function();
+}
+
+void
+external_declaration_n::llvm_codegen(llvm_codegen_t& cg) const
+{
+  if (this->m_function_definition) {
+    this->m_function_definition->llvm_codegen(cg);
+    return;
+  }
+  if (this->m_fp_pragma) {
+    this->m_fp_pragma->llvm_codegen(cg);
+    return;
+  }
+  assert(this->m_declaration);
+  this->m_declaration->llvm_codegen(cg);
+}
+
+enum memory_effect_t
+{
+  READ_NONE,
+  READ_ONLY,
+  READ_WRITE,
+};
+
+// What a function does to memory outside of its own stack frame, given the
+// current guess for each defined function. Accesses based on an alloca stay
+// in the frame. A callee given the address of a local accesses it through
+// an argument, which its own effect already accounts for.
+static memory_effect_t
+get_memory_effect(llvm::Function& function, map<llvm::Function*, memory_effect_t> const& effects)
+{
+  memory_effect_t effect = READ_NONE;
+  for (llvm::Instruction& inst : llvm::instructions(function)) {
+    if (auto* call = llvm::dyn_cast<llvm::CallBase>(&inst)) {
+      llvm::Function* callee = call->getCalledFunction();
+      if (callee == nullptr) {
+        return READ_WRITE;
+      }
+      auto callee_effect = effects.find(callee);
+      if (callee_effect != effects.end()) {
+        effect = max(effect, callee_effect->second);
+      }
+      else if (callee->onlyReadsMemory()) {
+        effect = max(effect, callee->doesNotAccessMemory() ? READ_NONE : READ_ONLY);
+      }
+      else {
+        return READ_WRITE;
+      }
+      continue;
+    }
+    if (!inst.mayReadOrWriteMemory()) {
+      continue;
+    }
+    // an atomic access orders the accesses of other threads, which
+    // readonly would let calls be reordered around
+    llvm::Value const* ptr = llvm::getLoadStorePointerOperand(&inst);
+    if (ptr == nullptr || inst.isVolatile() || inst.isAtomic()) {
+      return READ_WRITE;
+    }
+    llvm::Value const* object = llvm::getUnderlyingObject(ptr);
+    if (llvm::isa<llvm::AllocaInst>(object)) {
+      continue;
+    }
+    if (llvm::isa<llvm::StoreInst>(inst)) {
+      return READ_WRITE;
+    }
+    auto* global = llvm::dyn_cast<llvm::GlobalVariable>(object);
+    if (global == nullptr || !global->isConstant()) {
+      effect = READ_ONLY;
+    }
+  }
+  return effect;
+}
+
+// Infers what gcc spells __attribute__((const)) and ((pure)). Starting from
+// readnone for every definition and weakening to a fixed point handles
+// (mutually) recursive functions.
+static void
+infer_memory_attributes(llvm::Module& module)
+{
+  map<llvm::Function*, memory_effect_t> effects;
+  for (llvm::Function& function : module) {
+    if (!function.isDeclaration()) {
+      effects[&function] = READ_NONE;
+    }
+  }
+  bool is_changed = true;
+  while (is_changed) {
+    is_changed = false;
+    for (auto& function_effect : effects) {
+      memory_effect_t effect = get_memory_effect(*function_effect.first, effects);
+      if (effect != function_effect.second) {
+        function_effect.second = effect;
+        is_changed = true;
+      }
+    }
+  }
+  for (auto const& function_effect : effects) {
+    if (function_effect.second == READ_NONE) {
+      function_effect.first->addFnAttr(llvm::Attribute::ReadNone);
+    }
+    else if (function_effect.second == READ_ONLY) {
+      function_effect.first->addFnAttr(llvm::Attribute::ReadOnly);
+    }
+  }
+}
+
+void
+llvm_codegen_t::finish_module()
+{
+  for (llvm::Function& function : *this->m_module) {
+    // C99 6.7.4p7: if every file scope declaration says inline without
+    // extern, this is an inline definition and another unit may provide the
+    // external one. linkonce_odr lets the linker keep either.
+    if (!function.isDeclaration() && !function.hasLocalLinkage() &&
+        this->m_externally_defined_functions.count(function.getName().str()) == 0) {
+      function.setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+    }
+    // calls to _Noreturn functions are on cold paths
+    if (function.doesNotReturn()) {
+      for (llvm::User* user : function.users()) {
+        auto* call = llvm::dyn_cast<llvm::CallBase>(user);
+        if (call && call->getCalledFunction() == &function) {
+          call->setDoesNotReturn();
+          call->addFnAttr(llvm::Attribute::Cold);
+        }
+      }
+    }
+    // internal functions only ever called directly can use a faster convention
+    if (!function.isDeclaration() && function.hasLocalLinkage() &&
+        !function.hasAddressTaken() && !function.isVarArg()) {
+      function.setCallingConv(llvm::CallingConv::Fast);
+      for (llvm::User* user : function.users()) {
+        llvm::cast<llvm::CallBase>(user)->setCallingConv(llvm::CallingConv::Fast);
+      }
+    }
+  }
+  // musttail needs the caller and the callee to agree on the convention
+  for (llvm::Function& function : *this->m_module) {
+    for (llvm::Instruction& inst : llvm::instructions(function)) {
+      auto* call = llvm::dyn_cast<llvm::CallInst>(&inst);
+      if (call && call->isMustTailCall() && call->getCallingConv() != function.getCallingConv()) {
+        call->setTailCallKind(llvm::CallInst::TCK_Tail);
+      }
+    }
+  }
+  infer_memory_attributes(*this->m_module);
+}
+
+bool
+llvm_codegen_t::get_tls_model(string const& name, llvm::GlobalValue::ThreadLocalMode& mode)
+{
+  static pair<char const*, llvm::GlobalValue::ThreadLocalMode> const models[] = {
+    {"global-dynamic", llvm::GlobalValue::GeneralDynamicTLSModel},
+    {"local-dynamic", llvm::GlobalValue::LocalDynamicTLSModel},
+    {"initial-exec", llvm::GlobalValue::InitialExecTLSModel},
+    {"local-exec", llvm::GlobalValue::LocalExecTLSModel},
+  };
+  for (auto const& model : models) {
+    if (name == model.first) {
+      mode = model.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+llvm_codegen_t::declare_thread_local(llvm::GlobalVariable* global, declaration_specifiers_n const* decl_specs)
+{
+  llvm::GlobalValue::ThreadLocalMode mode = this->m_options.tls_model;
+  if (attribute_n const* attribute = decl_specs->get_attribute("tls_model")) {
+    if (attribute->get_arguments().size() != 1 || !get_tls_model(attribute->get_arguments()[0], mode)) {
+      this->error("tls_model of " + global->getName().str() +
+                  " is not one of global-dynamic, local-dynamic, initial-exec or local-exec");
+      return;
+    }
+  }
+  // the models are declared from the slowest to the fastest
+  if (!global->isThreadLocal() || global->getThreadLocalMode() < mode) {
+    global->setThreadLocalMode(mode);
+  }
+}
+
+void
+llvm_codegen_t::finish_module_thread_locals()
+{
+  for (llvm::GlobalVariable& global : this->m_module->globals()) {
+    if (!global.isThreadLocal()) {
+      continue;
+    }
+    // An executable reaches its own TLS block at a constant offset from the
+    // thread pointer and the one of a library it loads at startup through a
+    // GOT entry. A shared library only knows the offset within its own
+    // block, which is enough for what no other module can refer to.
+    llvm::GlobalValue::ThreadLocalMode mode;
+    if (this->m_options.is_pic) {
+      mode = global.hasLocalLinkage() ? llvm::GlobalValue::LocalDynamicTLSModel :
+                                        llvm::GlobalValue::GeneralDynamicTLSModel;
+    }
+    else {
+      mode = global.isDeclaration() ? llvm::GlobalValue::InitialExecTLSModel :
+                                      llvm::GlobalValue::LocalExecTLSModel;
+    }
+    if (global.getThreadLocalMode() < mode) {
+      global.setThreadLocalMode(mode);
+    }
+  }
+}
+
+unique_ptr<llvm::Module>
+translation_unit_n::llvm_codegen(llvm::LLVMContext& ctx,
+                                 sema_t const& sema,
+                                 llvm_codegen_options_t const& options) const
+{
+  llvm_codegen_t cg(ctx, this->get_filename(), sema, options);
+  for (auto const& external_declaration : this->get_list()) {
+    external_declaration->llvm_codegen(cg);
+  }
+  return cg.finish();
+}
+
+unique_ptr<llvm::Module>
+llvm_codegen_t::finish()
+{
+  if (this->get_has_error()) {
+    return nullptr;
+  }
+  this->finish_module_strings();
+  this->finish_module_target_clones();
+  this->finish_module_thread_locals();
+  this->finish_module();
+  this->finish_module_profile();
+  TRACE(TRACE_CODEGEN, TRACE_INFO, "finished %s, %zu functions",
+        this->m_module->getName().str().c_str(), this->m_module->size());
+  return this->release_module();
+}
+
+bool
+llvm_write_module(llvm::Module const& module, string const& output_filename)
+{
   error_code EC;
-  llvm::raw_fd_ostream fout(this->get_output_filename(), EC, llvm::sys::fs::OF_None);
+  llvm::raw_fd_ostream fout(output_filename, EC, llvm::sys::fs::OF_None);
   if (EC) {
     cout << "Error:\n" << EC.message() << "\n";
+    return false;
+  }
+  if (llvm::StringRef(output_filename).endswith(".bc")) {
+    llvm::WriteBitcodeToFile(module, fout);
   }
   else {
-    g_module->print(fout, nullptr);
+    module.print(fout, nullptr);
   }
+  return true;
 }
-
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include "c_type.h"
+#include "llvm_profile.h"
+#include "llvm_target.h"
+#include "stats.h"
+#include "tail_recursion.h"
+
+using namespace std;
+
+class sema_t;
+
+// An rvalue, or the address of an lvalue, along with its C type
+struct llvm_value_t
+{
+  llvm::Value* value;
+  c_type_t const* c_type;
+};
+
+// Lowering of &&, || and ?: whose skipped operands are safe to evaluate
+// anyway, set with --branchless=
+enum class branchless_t
+{
+  // always with branches, as written
+  OFF,
+  // with and, or and select when the skipped operands are a few instructions
+  AUTO,
+  // the same up to a few dozen instructions
+  AGGRESSIVE,
+};
+
+// What the overflow of signed integer arithmetic does, set with -fwrapv and
+// -ftrapv
+enum class signed_overflow_t
+{
+  // undefined as in C, the operations are nsw so that the optimizer can
+  // widen induction variables and count loop trips
+  UNDEFINED,
+  // wraps around, -fwrapv
+  WRAP,
+  // +, - and * check for it and branch to llvm.trap, -ftrapv
+  TRAP,
+};
+
+// Where a floating point multiplication and addition may be fused into one
+// operation that rounds once, set with -ffp-contract=
+enum class fp_contract_t
+{
+  // never, each one rounds as written
+  OFF,
+  // within an expression, through llvm.fmuladd
+  ON,
+  // anywhere the optimizer brings them together, the operations carry the
+  // contract flag
+  FAST,
+};
+
+// Floating point semantics of the operations being lowered, the command line
+// sets them for the unit and the fp pragmas for a block
+struct fp_mode_t
+{
+  // the fast-math flags but contract, which comes from contract
+  llvm::FastMathFlags flags;
+  fp_contract_t contract = fp_contract_t::OFF;
+};
+
+// Knobs of the lowering, set from the command line
+struct llvm_codegen_options_t
+{
+  // note which functions had tail calls eliminated or marked
+  bool report_tail_calls = false;
+  // profile file the instrumented program appends its counters to, empty
+  // when not instrumenting
+  string profile_generate_file;
+  // counters of earlier runs, turned into branch weights and entry counts
+  profile_data_t const* profile_use = nullptr;
+  // triple, data layout and per function CPU and features, nullptr to leave
+  // the module target independent
+  llvm_target_t const* target = nullptr;
+  // -ftls-model, the least efficient model a _Thread_local variable without
+  // a tls_model attribute gets
+  llvm::GlobalValue::ThreadLocalMode tls_model = llvm::GlobalValue::GeneralDynamicTLSModel;
+  // -fpic, the module goes into a shared library rather than an executable
+  bool is_pic = false;
+  branchless_t branchless = branchless_t::AUTO;
+  // -ffast-math and the like, strict IEEE semantics by default
+  fp_mode_t fp_mode;
+  signed_overflow_t signed_overflow = signed_overflow_t::UNDEFINED;
+};
+
+// State shared by the llvm_codegen() methods of the AST nodes while a
+// translation unit is lowered into a single module
+class llvm_codegen_t
+{
+public:
+  struct jump_targets_t
+  {
+    llvm::BasicBlock* break_bb;
+    llvm::BasicBlock* continue_bb;
+  };
+  struct switch_ctx_t
+  {
+    llvm::SwitchInst* switch_inst;
+    bool has_default;
+  };
+  // Function being lowered with its recursive tail calls turned into a loop
+  struct tail_recursion_ctx_t
+  {
+    tail_recursion_t const* tre;
+    llvm::BasicBlock* loop_bb;
+    vector<llvm::AllocaInst*> param_addrs;
+    // nullptr if the function needs no accumulator
+    llvm::AllocaInst* accumulator;
+  };
+
+  llvm_codegen_t(llvm::LLVMContext& ctx,
+                 string const& module_name,
+                 sema_t const& sema,
+                 llvm_codegen_options_t const& options) :
+    m_ctx(ctx),
+    m_module(make_unique<llvm::Module>(module_name, ctx)),
+    m_builder(ctx),
+    m_sema(sema),
+    m_options(options)
+  {
+    this->push_scope();
+    this->set_fp_mode(options.fp_mode);
+    if (options.target) {
+      options.target->configure_module(*this->m_module);
+    }
+  }
+
+  llvm::LLVMContext& get_ctx() { return this->m_ctx; }
+  llvm::Module& get_module() { return *this->m_module; }
+  llvm::IRBuilder<>& get_builder() { return this->m_builder; }
+  unique_ptr<llvm::Module> release_module() { return std::move(this->m_module); }
+  // Runs the whole unit steps once every external declaration has been
+  // lowered and releases the module, nullptr if an error was reported
+  unique_ptr<llvm::Module> finish();
+  // Linkage and attributes that depend on the whole translation unit
+  void finish_module();
+  // Points the string literals that are the tail of another one into it
+  void finish_module_strings();
+  // Emits the writer of the profile counters of the module
+  void finish_module_profile();
+  // Turns the functions with target_clones into ifuncs and emits their resolvers
+  void finish_module_target_clones();
+  // Moves the _Thread_local variables to the fastest TLS model that is safe
+  // for an executable, or for a shared library with -fpic
+  void finish_module_thread_locals();
+  // Model named by -ftls-model= or tls_model("..."), false if unknown
+  static bool get_tls_model(string const& name, llvm::GlobalValue::ThreadLocalMode& mode);
+  llvm_codegen_options_t const& get_options() const { return this->m_options; }
+  // types and implicit conversions of the expressions of the unit
+  sema_t const& get_sema() const { return this->m_sema; }
+
+  // Reports an error in the input, codegen goes on but the module is dropped
+  void error(string const& msg);
+  bool get_has_error() const { return this->m_has_error; }
+
+  void push_scope() { this->m_scopes.push_back(map<string, llvm_value_t>()); }
+  void pop_scope()
+  {
+    if (!this->m_scopes.back().empty()) {
+      this->m_symbol_scopes.pop_back();
+    }
+    this->m_scopes.pop_back();
+  }
+  bool is_global_scope() const { return this->m_scopes.size() == 1; }
+  void add_symbol(string const& name, llvm_value_t addr)
+  {
+    STATS_INC("codegen.symbols.inserts");
+    if (this->m_scopes.back().empty()) {
+      this->m_symbol_scopes.push_back(this->m_scopes.size() - 1);
+    }
+    this->m_scopes.back()[name] = addr;
+  }
+  bool lookup_symbol(string const& name, llvm_value_t& addr) const;
+
+  // Pointer to the first char of the string literal id of the pool of sema,
+  // its global is created on first use and shared by every use
+  llvm::Constant* get_string_literal(size_t id);
+
+  llvm::Type* get_llvm_type(c_type_t const* c_type);
+  llvm::FunctionType* get_llvm_function_type(c_type_t const* c_type);
+  // Loads and stores of the object lvalue designates. They are volatile
+  // if its type is, sequentially consistent atomics if it is _Atomic, and
+  // carry its type for TBAA unless the object is a local, which is
+  // promoted to a register anyway.
+  llvm::Value* load(llvm_value_t lvalue, string const& name = "");
+  llvm::StoreInst* store(llvm::Value* value, llvm_value_t lvalue);
+  // Atomic read-modify-write and compare exchange of the object lvalue
+  // designates, both return the value it had. Floating point and pointer
+  // objects are accessed as integers of their width, the only values
+  // cmpxchg and atomicrmw take in LLVM 14 besides those of fadd and fsub.
+  // An add or sub to a pointer takes a byte offset of the integer type.
+  llvm::Value* atomic_rmw(llvm::AtomicRMWInst::BinOp op,
+                          llvm_value_t lvalue,
+                          llvm::Value* value,
+                          llvm::AtomicOrdering ordering);
+  llvm::Value* atomic_cmpxchg(llvm_value_t lvalue,
+                              llvm::Value* expected,
+                              llvm::Value* desired,
+                              llvm::AtomicOrdering success_ordering,
+                              llvm::AtomicOrdering failure_ordering,
+                              bool is_weak,
+                              llvm::Value*& is_success);
+  // Integer type atomic_rmw() and atomic_cmpxchg() access an object of
+  // type c_type as, nullptr for an integer object, accessed as is
+  llvm::IntegerType* get_atomic_int_type(c_type_t const* c_type);
+  // TBAA access tag of an object of type c_type
+  llvm::MDNode* get_tbaa_tag(c_type_t const* c_type);
+  llvm::Value* convert(llvm_value_t v, c_type_t const* to);
+  // l op r in a type of c_type_t::has_undefined_overflow(), op being Add,
+  // Sub, Mul or Shl, as options.signed_overflow says
+  llvm::Value* create_signed_arith(llvm::Instruction::BinaryOps op, llvm::Value* l, llvm::Value* r);
+  // &base[offset], which C does not let go out of the object but with
+  // -fwrapv
+  llvm::Value* create_pointer_add(llvm::Type* elem_type, llvm::Value* base, llvm::Value* offset);
+  llvm::Value* convert_to_i1(llvm_value_t v);
+  // Value of e after the implicit conversion sema recorded for it
+  llvm::Value* rvalue_llvm_codegen(expression_n const* e);
+
+  // Applies the storage class and function specifiers of the declaration
+  llvm::Function* declare_function(string const& name,
+                                   c_type_t const* c_type,
+                                   declaration_specifiers_n const* decl_specs);
+  // One internal clone of function per target of __attribute__((target_clones)),
+  // the "default" one last. Their bodies are generated separately and the
+  // function is replaced by an ifunc when the module is finished.
+  bool declare_target_clones(llvm::Function* function,
+                             attribute_n const* attribute,
+                             vector<llvm::Function*>& clones);
+  // Makes global _Thread_local with the model of its tls_model attribute or
+  // of -ftls-model, or keeps the faster one of an earlier declaration
+  void declare_thread_local(llvm::GlobalVariable* global, declaration_specifiers_n const* decl_specs);
+  bool is_multiversioned(llvm::Function const* function) const;
+  void begin_function(llvm::Function* function, c_type_t const* c_type);
+  void end_function();
+  llvm::Function* get_cur_function() const { return this->m_cur_function; }
+  // Whether the callees of the current function may access its frame, see
+  // sema_t::get_takes_local_address()
+  void set_takes_local_address(bool takes_local_address) { this->m_takes_local_address = takes_local_address; }
+  bool get_takes_local_address() const { return this->m_takes_local_address; }
+  c_type_t const* get_cur_function_type() const { return this->m_cur_function_type; }
+  llvm::AllocaInst* create_entry_alloca(llvm::Type* type, string const& name);
+  // The mode the builder creates floating point operations in. At file
+  // scope, the mode the functions that follow start in.
+  fp_mode_t const& get_fp_mode() const { return this->m_fp_mode; }
+  void set_fp_mode(fp_mode_t const& fp_mode);
+
+  llvm::BasicBlock* create_block(string const& name);
+  // Makes bb the insertion block without branching to it
+  void start_block(llvm::BasicBlock* bb);
+  // Branches to bb unless the current block is already terminated
+  void emit_branch(llvm::BasicBlock* bb);
+  // Code following a jump goes into a fresh block that is later dropped as unreachable
+  void ensure_insertion_block();
+
+  void push_jump_targets(llvm::BasicBlock* break_bb, llvm::BasicBlock* continue_bb)
+  {
+    this->m_jump_targets.push_back({break_bb, continue_bb});
+  }
+  void pop_jump_targets() { this->m_jump_targets.pop_back(); }
+  llvm::BasicBlock* get_break_target() const;
+  llvm::BasicBlock* get_continue_target() const;
+
+  void push_switch(switch_ctx_t const& switch_ctx) { this->m_switches.push_back(switch_ctx); }
+  void pop_switch() { this->m_switches.pop_back(); }
+  switch_ctx_t* get_cur_switch() { return this->m_switches.empty() ? nullptr : &this->m_switches.back(); }
+
+  void set_tail_recursion(tail_recursion_ctx_t* tail_recursion) { this->m_tail_recursion = tail_recursion; }
+  tail_recursion_ctx_t* get_tail_recursion() const { return this->m_tail_recursion; }
+  void count_tail_call() { this->m_num_tail_calls++; }
+  size_t get_num_tail_calls() const { return this->m_num_tail_calls; }
+
+  // Every conditional branch and switch of the source goes through these so
+  // that its edges are counted (--profile-generate) or weighted (--profile-use)
+  llvm::BranchInst* create_cond_br(llvm::Value* cond, llvm::BasicBlock* true_bb, llvm::BasicBlock* false_bb);
+  // Called once all the cases of the switch are known
+  void profile_switch(llvm::SwitchInst* switch_inst);
+private:
+  struct profile_site_t
+  {
+    llvm::Instruction* inst;
+    size_t first_counter;
+  };
+  struct profiled_function_t
+  {
+    string name;
+    uint64_t hash;
+    llvm::GlobalVariable* counters;
+    size_t num_counters;
+  };
+
+  struct multiversioned_function_t
+  {
+    llvm::Function* function;
+    vector<llvm::Function*> clones;
+    // the feature of each clone, "default" for the last one
+    vector<string> features;
+  };
+
+  // __attribute__((target("avx2,arch=skylake,no-bmi")))
+  void apply_target_attribute(llvm::Function* function, attribute_n const* attribute);
+  // The "no-nans-fp-math" and other attributes of the fast-math flags
+  // every operation of the function had
+  void add_fp_attributes(llvm::Function* function);
+  bool is_profiling() const;
+  string get_profile_name() const;
+  size_t add_profile_site(unsigned kind, size_t num_counters);
+  void increment_profile_counter(llvm::Value* index);
+  void begin_function_profile();
+  void end_function_profile();
+
+  llvm::LLVMContext& m_ctx;
+  unique_ptr<llvm::Module> m_module;
+  llvm::IRBuilder<> m_builder;
+  sema_t const& m_sema;
+  bool m_has_error = false;
+  // what long double is on the target of the module, set on first use
+  llvm::Type* m_long_double_type = nullptr;
+  vector<map<string, llvm_value_t>> m_scopes;
+  // indexes of the scopes with symbols, the only ones lookups search
+  vector<size_t> m_symbol_scopes;
+  llvm::Function* m_cur_function = nullptr;
+  c_type_t const* m_cur_function_type = nullptr;
+  bool m_takes_local_address = false;
+  vector<jump_targets_t> m_jump_targets;
+  vector<switch_ctx_t> m_switches;
+  // functions with a file scope declaration that lacks inline or has extern
+  set<string> m_externally_defined_functions;
+  llvm_codegen_options_t m_options;
+  tail_recursion_ctx_t* m_tail_recursion = nullptr;
+  // calls marked tail or musttail in the current function
+  size_t m_num_tail_calls = 0;
+  fp_mode_t m_fp_mode;
+  // the flags of every mode the current function was lowered in
+  llvm::FastMathFlags m_function_fp_flags;
+  // block of the current function the -ftrapv checks branch to on
+  // overflow, nullptr until one needs it
+  llvm::BasicBlock* m_trap_bb = nullptr;
+  // counters, structural hash and instrumented sites of the current function
+  llvm::GlobalVariable* m_profile_counters = nullptr;
+  size_t m_num_profile_counters = 0;
+  uint64_t m_profile_hash = 0;
+  vector<profile_site_t> m_profile_sites;
+  vector<profiled_function_t> m_profiled_functions;
+  vector<multiversioned_function_t> m_multiversioned_functions;
+  // global of each string literal by pool id, nullptr until used
+  vector<llvm::GlobalVariable*> m_string_globals;
+  // TBAA type nodes by name, under the root of the unit
+  llvm::MDNode* m_tbaa_root = nullptr;
+  map<string, llvm::MDNode*> m_tbaa_types;
+};
+
+// Writes module to output_filename, as bitcode if the name ends in .bc and as
+// textual IR otherwise, returns false on failure
+bool llvm_write_module(llvm::Module const& module, string const& output_filename);
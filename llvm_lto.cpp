@@ -0,0 +1,44 @@
+#include <iostream>
+
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+
+#include "llvm_lto.h"
+
+using namespace std;
+
+bool
+llvm_lto_t::add_module(unique_ptr<llvm::Module> module)
+{
+  string name = module->getModuleIdentifier();
+  // linkInModule reports the conflicts through the diagnostic handler of the
+  // context and returns true on error
+  if (this->m_linker.linkInModule(std::move(module))) {
+    cout << "Cannot link " << name << endl;
+    return false;
+  }
+  return true;
+}
+
+bool
+llvm_lto_t::add_file(string const& filename)
+{
+  llvm::SMDiagnostic diag;
+  unique_ptr<llvm::Module> module = llvm::parseIRFile(filename, diag, this->m_module->getContext());
+  if (!module) {
+    diag.print("cc", llvm::errs());
+    return false;
+  }
+  return this->add_module(std::move(module));
+}
+
+void
+llvm_lto_t::internalize(set<string> const& exported)
+{
+  llvm::internalizeModule(*this->m_module, [&](llvm::GlobalValue const& value) {
+    string name = value.getName().str();
+    return name == "main" || exported.count(name) != 0;
+  });
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <set>
+#include <string>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+
+using namespace std;
+
+// Merges the modules of the units of a program, as compiled with -flto, into
+// one module so that calls across units can be inlined and specialized. All
+// the modules must live in the context given to the constructor.
+class llvm_lto_t
+{
+public:
+  llvm_lto_t(llvm::LLVMContext& ctx, string const& name) :
+    m_module(make_unique<llvm::Module>(name, ctx)),
+    m_linker(*m_module)
+  { }
+
+  // Returns false, after printing why, if the modules conflict (e.g. two
+  // external definitions of one symbol)
+  bool add_module(unique_ptr<llvm::Module> module);
+  // Reads a module written with -flto, bitcode or textual IR
+  bool add_file(string const& filename);
+  // Gives internal linkage to every definition but main and exported, which
+  // is what lets the optimizer drop, inline or specialize them freely
+  void internalize(set<string> const& exported);
+  unique_ptr<llvm::Module> release_module() { return std::move(this->m_module); }
+private:
+  unique_ptr<llvm::Module> m_module;
+  llvm::Linker m_linker;
+};
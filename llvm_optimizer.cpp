@@ -0,0 +1,119 @@
+#include <memory>
+
+#include "llvm/IR/DiagnosticHandler.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "llvm_optimizer.h"
+
+using namespace std;
+
+llvm_optimizer_t::llvm_optimizer_t(unsigned opt_level,
+                                   llvm::TargetMachine* target_machine,
+                                   phase_t phase) :
+  m_opt_level(opt_level),
+  m_pass_builder(target_machine)
+{
+  this->m_pass_builder.registerModuleAnalyses(this->m_mam);
+  this->m_pass_builder.registerCGSCCAnalyses(this->m_cgam);
+  this->m_pass_builder.registerFunctionAnalyses(this->m_fam);
+  this->m_pass_builder.registerLoopAnalyses(this->m_lam);
+  this->m_pass_builder.crossRegisterProxies(this->m_lam, this->m_fam, this->m_cgam, this->m_mam);
+
+  llvm::OptimizationLevel level;
+  switch (opt_level) {
+    case 0: level = llvm::OptimizationLevel::O0; break;
+    case 1: level = llvm::OptimizationLevel::O1; break;
+    case 2: level = llvm::OptimizationLevel::O2; break;
+    default: level = llvm::OptimizationLevel::O3; break;
+  }
+  if (opt_level == 0) {
+    this->m_mpm = this->m_pass_builder.buildO0DefaultPipeline(level, phase == LTO_PRE_LINK);
+  }
+  else if (phase == LTO_PRE_LINK) {
+    this->m_mpm = this->m_pass_builder.buildLTOPreLinkDefaultPipeline(level);
+  }
+  else if (phase == LTO) {
+    // full LTO, there is no ThinLTO summary
+    this->m_mpm = this->m_pass_builder.buildLTODefaultPipeline(level, nullptr);
+  }
+  else {
+    this->m_mpm = this->m_pass_builder.buildPerModuleDefaultPipeline(level);
+  }
+}
+
+void
+llvm_optimizer_t::optimize(llvm::Module& module)
+{
+  this->m_mpm.run(module, this->m_mam);
+  this->m_lam.clear();
+  this->m_fam.clear();
+  this->m_cgam.clear();
+  this->m_mam.clear();
+}
+
+// Passes only build the remarks this handler asks for
+class remark_handler_t : public llvm::DiagnosticHandler
+{
+public:
+  remark_handler_t(string const& passed_regex, string const& missed_regex) :
+    m_passed_regex(passed_regex),
+    m_missed_regex(missed_regex),
+    m_has_passed(!passed_regex.empty()),
+    m_has_missed(!missed_regex.empty())
+  { }
+
+  bool isPassedOptRemarkEnabled(llvm::StringRef pass_name) const override
+  {
+    return this->m_has_passed && this->m_passed_regex.match(pass_name);
+  }
+  bool isMissedOptRemarkEnabled(llvm::StringRef pass_name) const override
+  {
+    return this->m_has_missed && this->m_missed_regex.match(pass_name);
+  }
+  bool isAnalysisRemarkEnabled(llvm::StringRef) const override { return false; }
+  bool isAnyRemarkEnabled() const override { return this->m_has_passed || this->m_has_missed; }
+
+  // Failures to honor an explicit hint (e.g. a loop pragma) are warnings
+  // and are always reported
+  bool handleDiagnostics(llvm::DiagnosticInfo const& di) override
+  {
+    auto* remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&di);
+    if (remark == nullptr) {
+      return false;
+    }
+    if (!remark->isEnabled()) {
+      return true;
+    }
+    bool is_warning = remark->getSeverity() == llvm::DS_Warning;
+    llvm::errs() << (is_warning ? "warning: " : "remark: ")
+                 << remark->getFunction().getName() << ": " << remark->getMsg();
+    if (!is_warning && !remark->getPassName().empty()) {
+      char const* flag = remark->getKind() == llvm::DK_OptimizationRemark ? "-Rpass" :
+                         remark->getKind() == llvm::DK_OptimizationRemarkMissed ? "-Rpass-missed" :
+                         "-Rpass-analysis";
+      llvm::errs() << " [" << flag << "=" << remark->getPassName() << "]";
+    }
+    llvm::errs() << "\n";
+    return true;
+  }
+private:
+  llvm::Regex m_passed_regex;
+  llvm::Regex m_missed_regex;
+  bool m_has_passed;
+  bool m_has_missed;
+};
+
+bool
+llvm_set_remark_filters(llvm::LLVMContext& ctx,
+                        string const& passed_regex,
+                        string const& missed_regex)
+{
+  if ((!passed_regex.empty() && !llvm::Regex(passed_regex).isValid()) ||
+      (!missed_regex.empty() && !llvm::Regex(missed_regex).isValid())) {
+    return false;
+  }
+  ctx.setDiagnosticHandler(make_unique<remark_handler_t>(passed_regex, missed_regex));
+  return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace std;
+
+// The -O<level> pipeline. It is built once and run over every module of a
+// batch; cached analyses are dropped after each run. With a target machine
+// the passes see its cost model (vector width, available instructions).
+class llvm_optimizer_t
+{
+public:
+  enum phase_t
+  {
+    // a unit compiled on its own
+    PER_MODULE,
+    // a unit compiled with -flto, the IPO passes are left for the link
+    LTO_PRE_LINK,
+    // the whole program merged by llvm_lto_t
+    LTO,
+  };
+
+  llvm_optimizer_t(unsigned opt_level,
+                   llvm::TargetMachine* target_machine = nullptr,
+                   phase_t phase = PER_MODULE);
+
+  unsigned get_opt_level() const { return this->m_opt_level; }
+  void optimize(llvm::Module& module);
+private:
+  unsigned m_opt_level;
+  llvm::PassBuilder m_pass_builder;
+  llvm::LoopAnalysisManager m_lam;
+  llvm::FunctionAnalysisManager m_fam;
+  llvm::CGSCCAnalysisManager m_cgam;
+  llvm::ModuleAnalysisManager m_mam;
+  llvm::ModulePassManager m_mpm;
+};
+
+// Prints the optimization remarks of the passes whose name matches
+// passed_regex (resp. missed_regex) to stderr, like -Rpass/-Rpass-missed.
+// Returns false if one of the regexes is invalid.
+bool llvm_set_remark_filters(llvm::LLVMContext& ctx,
+                             string const& passed_regex,
+                             string const& missed_regex);
@@ -0,0 +1,300 @@
+#include <ctype.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include "common.h"
+#include "llvm_codegen.h"
+#include "llvm_profile.h"
+#include "sema.h"
+
+using namespace std;
+
+// Kinds of instrumented sites, mixed into the structural hash
+#define PROFILE_SITE_ENTRY 1
+#define PROFILE_SITE_BRANCH 2
+#define PROFILE_SITE_SWITCH 3
+
+bool
+profile_data_t::read(string const& filename)
+{
+  ifstream fin(filename);
+  if (!fin) {
+    cout << "Cannot open profile: " << filename << endl;
+    return false;
+  }
+  string name;
+  while (fin >> name) {
+    uint64_t hash;
+    size_t num_counters;
+    if (!(fin >> hex >> hash >> dec >> num_counters)) {
+      cout << "Malformed profile: " << filename << endl;
+      return false;
+    }
+    vector<uint64_t>& counts = this->m_counts[name][hash];
+    if (counts.empty()) {
+      counts.resize(num_counters);
+    }
+    else if (counts.size() != num_counters) {
+      cout << "Malformed profile: " << filename << endl;
+      return false;
+    }
+    for (size_t i = 0;i < num_counters;i++) {
+      uint64_t count;
+      if (!(fin >> count)) {
+        cout << "Malformed profile: " << filename << endl;
+        return false;
+      }
+      counts[i] += count;
+    }
+  }
+  return true;
+}
+
+vector<uint64_t> const*
+profile_data_t::lookup(string const& name, uint64_t hash) const
+{
+  auto function = this->m_counts.find(name);
+  if (function == this->m_counts.end()) {
+    return nullptr;
+  }
+  auto counts = function->second.find(hash);
+  return counts == function->second.end() ? nullptr : &counts->second;
+}
+
+// FNV-1a over the kinds and sizes of the sites, in the order of the walk
+static uint64_t
+hash_combine(uint64_t hash, uint64_t value)
+{
+  for (size_t i = 0;i < 8;i++) {
+    hash ^= (value >> (i * 8)) & 0xff;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+string
+llvm_codegen_t::get_profile_name() const
+{
+  // static functions of different units may share a name. The profile
+  // separates its fields with whitespace, which a path may hold.
+  string name = this->m_cur_function->getName().str();
+  if (this->m_cur_function->hasLocalLinkage()) {
+    string unit = this->m_module->getName().str();
+    replace_if(unit.begin(), unit.end(), [](char c) { return isspace((unsigned char)c) != 0; }, '_');
+    name = unit + ":" + name;
+  }
+  return name;
+}
+
+bool
+llvm_codegen_t::is_profiling() const
+{
+  return !this->m_options.profile_generate_file.empty() || this->m_options.profile_use != nullptr;
+}
+
+size_t
+llvm_codegen_t::add_profile_site(unsigned kind, size_t num_counters)
+{
+  size_t first_counter = this->m_num_profile_counters;
+  this->m_profile_hash = hash_combine(this->m_profile_hash, kind);
+  this->m_profile_hash = hash_combine(this->m_profile_hash, num_counters);
+  this->m_num_profile_counters += num_counters;
+  return first_counter;
+}
+
+void
+llvm_codegen_t::increment_profile_counter(llvm::Value* index)
+{
+  llvm::Type* i64_type = this->m_builder.getInt64Ty();
+  llvm::Value* addr = this->m_builder.CreateGEP(i64_type, this->m_profile_counters, index);
+  llvm::Value* count = this->m_builder.CreateLoad(i64_type, addr);
+  this->m_builder.CreateStore(this->m_builder.CreateAdd(count, this->m_builder.getInt64(1)), addr);
+}
+
+void
+llvm_codegen_t::begin_function_profile()
+{
+  this->m_num_profile_counters = 0;
+  this->m_profile_hash = 0xcbf29ce484222325ULL;
+  this->m_profile_sites.clear();
+  this->add_profile_site(PROFILE_SITE_ENTRY, 1);
+  if (!this->m_options.profile_generate_file.empty()) {
+    // the counters are laid out once their number is known, until then
+    // they are addressed through a placeholder
+    this->m_profile_counters = new llvm::GlobalVariable(*this->m_module,
+                                                        this->m_builder.getInt64Ty(),
+                                                        false,
+                                                        llvm::GlobalValue::PrivateLinkage,
+                                                        nullptr,
+                                                        "__cc_prof_placeholder");
+    this->increment_profile_counter(this->m_builder.getInt64(0));
+  }
+}
+
+llvm::BranchInst*
+llvm_codegen_t::create_cond_br(llvm::Value* cond, llvm::BasicBlock* true_bb, llvm::BasicBlock* false_bb)
+{
+  if (!this->is_profiling()) {
+    return this->m_builder.CreateCondBr(cond, true_bb, false_bb);
+  }
+  size_t first_counter = this->add_profile_site(PROFILE_SITE_BRANCH, 2);
+  if (!this->m_options.profile_generate_file.empty()) {
+    // counter first_counter counts the true edge, the next one the false edge
+    this->increment_profile_counter(this->m_builder.CreateSelect(cond,
+                                                                 this->m_builder.getInt64(first_counter),
+                                                                 this->m_builder.getInt64(first_counter + 1)));
+  }
+  llvm::BranchInst* br = this->m_builder.CreateCondBr(cond, true_bb, false_bb);
+  this->m_profile_sites.push_back({br, first_counter});
+  return br;
+}
+
+void
+llvm_codegen_t::profile_switch(llvm::SwitchInst* switch_inst)
+{
+  if (!this->is_profiling()) {
+    return;
+  }
+  size_t first_counter = this->add_profile_site(PROFILE_SITE_SWITCH, switch_inst->getNumSuccessors());
+  this->m_profile_sites.push_back({switch_inst, first_counter});
+  if (this->m_options.profile_generate_file.empty()) {
+    return;
+  }
+  // each edge goes through a block of its own that counts it
+  llvm::BasicBlock* saved_bb = this->m_builder.GetInsertBlock();
+  for (unsigned i = 0;i < switch_inst->getNumSuccessors();i++) {
+    this->start_block(this->create_block("sw.prof"));
+    this->increment_profile_counter(this->m_builder.getInt64(first_counter + i));
+    this->m_builder.CreateBr(switch_inst->getSuccessor(i));
+    switch_inst->setSuccessor(i, this->m_builder.GetInsertBlock());
+  }
+  this->m_builder.SetInsertPoint(saved_bb);
+}
+
+// Branch weights are 32 bits wide
+static vector<uint32_t>
+scale_branch_weights(vector<uint64_t> const& counts)
+{
+  uint64_t max_count = *max_element(counts.begin(), counts.end());
+  uint64_t scale = max_count / UINT32_MAX + 1;
+  vector<uint32_t> weights;
+  for (auto const& count : counts) {
+    weights.push_back(count / scale);
+  }
+  return weights;
+}
+
+void
+llvm_codegen_t::end_function_profile()
+{
+  if (!this->m_options.profile_generate_file.empty()) {
+    llvm::ArrayType* counters_type = llvm::ArrayType::get(this->m_builder.getInt64Ty(),
+                                                          this->m_num_profile_counters);
+    llvm::GlobalVariable* counters =
+      new llvm::GlobalVariable(*this->m_module,
+                               counters_type,
+                               false,
+                               llvm::GlobalValue::PrivateLinkage,
+                               llvm::Constant::getNullValue(counters_type),
+                               "__cc_prof_counters." + this->m_cur_function->getName());
+    this->m_profile_counters->replaceAllUsesWith(
+      llvm::ConstantExpr::getBitCast(counters, this->m_profile_counters->getType()));
+    this->m_profile_counters->eraseFromParent();
+    this->m_profile_counters = nullptr;
+    this->m_profiled_functions.push_back({this->get_profile_name(),
+                                          this->m_profile_hash,
+                                          counters,
+                                          this->m_num_profile_counters});
+    return;
+  }
+
+  profile_data_t const* profile = this->m_options.profile_use;
+  if (profile == nullptr) {
+    return;
+  }
+  string name = this->get_profile_name();
+  vector<uint64_t> const* counts = profile->lookup(name, this->m_profile_hash);
+  if (counts == nullptr) {
+    if (profile->has_function(name)) {
+      this->m_sema.get_diagnostics().warning(nullptr, "profile for " + name + " is out of date, ignored");
+    }
+    return;
+  }
+  assert(counts->size() == this->m_num_profile_counters);
+  this->m_cur_function->setEntryCount((*counts)[0]);
+  llvm::MDBuilder md_builder(this->m_ctx);
+  for (auto const& site : this->m_profile_sites) {
+    unsigned num_successors = site.inst->getNumSuccessors();
+    vector<uint64_t> site_counts(counts->begin() + site.first_counter,
+                                 counts->begin() + site.first_counter + num_successors);
+    if (*max_element(site_counts.begin(), site_counts.end()) == 0) {
+      continue;
+    }
+    site.inst->setMetadata(llvm::LLVMContext::MD_prof,
+                           md_builder.createBranchWeights(scale_branch_weights(site_counts)));
+  }
+}
+
+// The runtime of an instrumented module is a destructor that appends a
+// record per function to the profile file. It needs nothing but libc, so
+// the module works the same linked into a program or run by lli.
+void
+llvm_codegen_t::finish_module_profile()
+{
+  if (this->m_options.profile_generate_file.empty() || this->m_profiled_functions.empty()) {
+    return;
+  }
+  llvm::IRBuilder<>& builder = this->m_builder;
+  llvm::Type* i8_ptr_type = builder.getInt8PtrTy();
+  llvm::FunctionCallee fopen = this->m_module->getOrInsertFunction("fopen", i8_ptr_type, i8_ptr_type, i8_ptr_type);
+  llvm::FunctionCallee fclose = this->m_module->getOrInsertFunction("fclose", builder.getInt32Ty(), i8_ptr_type);
+  llvm::FunctionCallee fprintf =
+    this->m_module->getOrInsertFunction("fprintf",
+                                        llvm::FunctionType::get(builder.getInt32Ty(),
+                                                                {i8_ptr_type, i8_ptr_type},
+                                                                true));
+  llvm::Function* writer = llvm::Function::Create(llvm::FunctionType::get(builder.getVoidTy(), false),
+                                                  llvm::GlobalValue::InternalLinkage,
+                                                  "__cc_prof_write",
+                                                  *this->m_module);
+  llvm::BasicBlock* entry_bb = llvm::BasicBlock::Create(this->m_ctx, "entry", writer);
+  llvm::BasicBlock* write_bb = llvm::BasicBlock::Create(this->m_ctx, "write", writer);
+  llvm::BasicBlock* end_bb = llvm::BasicBlock::Create(this->m_ctx, "end", writer);
+  builder.SetInsertPoint(entry_bb);
+  llvm::Value* file = builder.CreateCall(fopen,
+                                         {builder.CreateGlobalStringPtr(this->m_options.profile_generate_file),
+                                          builder.CreateGlobalStringPtr("a")});
+  builder.CreateCondBr(builder.CreateIsNull(file), end_bb, write_bb);
+  builder.SetInsertPoint(write_bb);
+  for (auto const& function : this->m_profiled_functions) {
+    // the name goes in as an argument, a % in the path of a unit would be
+    // taken for a conversion in the format
+    string format = "%s %016llx %llu\n";
+    for (size_t i = 0;i < function.num_counters;i++) {
+      format += i ? " %llu" : "%llu";
+    }
+    format += "\n";
+    vector<llvm::Value*> args = {file,
+                                 builder.CreateGlobalStringPtr(format),
+                                 builder.CreateGlobalStringPtr(function.name),
+                                 builder.getInt64(function.hash),
+                                 builder.getInt64(function.num_counters)};
+    llvm::Type* counters_type = function.counters->getValueType();
+    for (size_t i = 0;i < function.num_counters;i++) {
+      llvm::Value* addr = builder.CreateConstInBoundsGEP2_64(counters_type, function.counters, 0, i);
+      args.push_back(builder.CreateLoad(builder.getInt64Ty(), addr));
+    }
+    builder.CreateCall(fprintf, args);
+  }
+  builder.CreateCall(fclose, {file});
+  builder.CreateBr(end_bb);
+  builder.SetInsertPoint(end_bb);
+  builder.CreateRetVoid();
+  builder.ClearInsertionPoint();
+  llvm::appendToGlobalDtors(*this->m_module, writer, 0);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Profile written by a program built with --profile-generate. It is a text
+// file of records, one per function and run:
+//   <function> <structural hash, 16 hex digits> <number of counters>
+//   <counter 0> <counter 1> ...
+// Counter 0 counts the calls of the function, the others the edges of its
+// branches and switches in the order llvm_codegen emits them.
+class profile_data_t
+{
+public:
+  // Sums the records of each function and hash, returns false if the file
+  // cannot be read or is malformed
+  bool read(string const& filename);
+  // nullptr if there is no record for this version of the function
+  vector<uint64_t> const* lookup(string const& name, uint64_t hash) const;
+  bool has_function(string const& name) const { return this->m_counts.count(name) != 0; }
+private:
+  map<string, map<uint64_t, vector<uint64_t>>> m_counts;
+};
@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <mutex>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/X86TargetParser.h"
+#include "llvm/Target/TargetOptions.h"
+
+#include "ast.h"
+#include "common.h"
+#include "llvm_codegen.h"
+#include "llvm_target.h"
+
+using namespace std;
+
+struct dispatchable_feature_t
+{
+  char const* name;
+  unsigned priority;
+};
+
+static const dispatchable_feature_t dispatchable_features[] = {
+#define X86_FEATURE(ENUM, STR)
+#define X86_FEATURE_COMPAT(ENUM, STR, PRIORITY) {STR, PRIORITY},
+#include "llvm/Support/X86TargetParser.def"
+};
+
+static string
+join_features(string const& a, string const& b)
+{
+  if (a.empty() || b.empty()) {
+    return a + b;
+  }
+  return a + "," + b;
+}
+
+unique_ptr<llvm_target_t>
+llvm_target_t::create(string const& triple, string const& cpu, string const& features, bool is_pic, string& error)
+{
+  // registering is not synchronized, the first call does it for every thread
+  static once_flag is_registered;
+  call_once(is_registered, []() {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+  });
+
+  string target_triple = triple.empty() ? llvm::sys::getDefaultTargetTriple() : llvm::Triple::normalize(triple);
+  string lookup_error;
+  llvm::Target const* target = llvm::TargetRegistry::lookupTarget(target_triple, lookup_error);
+  if (target == nullptr) {
+    error = "Unknown target " + target_triple + ": " + lookup_error;
+    return nullptr;
+  }
+  string target_cpu = cpu;
+  string target_features;
+  if (cpu == "native") {
+    // the host CPU name and features mean nothing to another architecture
+    llvm::Triple host_triple(llvm::sys::getProcessTriple());
+    if (llvm::Triple(target_triple).getArch() != host_triple.getArch()) {
+      error = "-march=native needs a target of the host architecture " + host_triple.getArchName().str()
+              + ", not " + target_triple;
+      return nullptr;
+    }
+    target_cpu = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> host_features;
+    if (llvm::sys::getHostCPUFeatures(host_features)) {
+      vector<string> host_feature_v;
+      for (auto const& feature : host_features) {
+        host_feature_v.push_back((feature.second ? "+" : "-") + feature.first().str());
+      }
+      // StringMap iteration order is unspecified, keep the attribute stable
+      sort(host_feature_v.begin(), host_feature_v.end());
+      for (auto const& feature : host_feature_v) {
+        target_features = join_features(target_features, feature);
+      }
+    }
+  }
+  target_features = join_features(target_features, features);
+  llvm::Reloc::Model reloc_model = is_pic ? llvm::Reloc::PIC_ : llvm::Reloc::Static;
+  if (!target_cpu.empty()) {
+    // checked on a generic machine first, LLVM only warns about unknown CPUs
+    unique_ptr<llvm::TargetMachine> generic_machine(target->createTargetMachine(target_triple, "", "",
+                                                                                llvm::TargetOptions(),
+                                                                                reloc_model));
+    if (!generic_machine->getMCSubtargetInfo()->isCPUStringValid(target_cpu)) {
+      error = "Unknown CPU " + target_cpu + " for target " + target_triple;
+      return nullptr;
+    }
+  }
+  llvm::TargetMachine* target_machine = target->createTargetMachine(target_triple,
+                                                                    target_cpu,
+                                                                    target_features,
+                                                                    llvm::TargetOptions(),
+                                                                    reloc_model);
+  if (target_machine == nullptr) {
+    error = "Cannot create a target machine for " + target_triple;
+    return nullptr;
+  }
+  return unique_ptr<llvm_target_t>(new llvm_target_t(target_machine, target_cpu, target_features));
+}
+
+bool
+llvm_target_t::is_x86() const
+{
+  return this->m_target_machine->getTargetTriple().isX86();
+}
+
+void
+llvm_target_t::configure_module(llvm::Module& module) const
+{
+  module.setTargetTriple(this->m_target_machine->getTargetTriple().str());
+  module.setDataLayout(this->m_target_machine->createDataLayout());
+  if (this->m_target_machine->isPositionIndependent()) {
+    module.setPICLevel(llvm::PICLevel::BigPIC);
+  }
+}
+
+void
+llvm_target_t::add_function_attributes(llvm::Function& function,
+                                       string const& cpu,
+                                       string const& extra_features) const
+{
+  string function_cpu = cpu.empty() ? this->m_cpu : cpu;
+  string function_features = join_features(this->m_features, extra_features);
+  if (!function_cpu.empty()) {
+    function.addFnAttr("target-cpu", function_cpu);
+  }
+  if (!function_features.empty()) {
+    function.addFnAttr("target-features", function_features);
+  }
+}
+
+bool
+llvm_target_t::is_dispatchable_feature(string const& name)
+{
+  for (auto const& feature : dispatchable_features) {
+    if (name == feature.name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+unsigned
+llvm_target_t::get_feature_priority(string const& name)
+{
+  for (auto const& feature : dispatchable_features) {
+    if (name == feature.name) {
+      return feature.priority;
+    }
+  }
+  NOT_REACHED();
+}
+
+uint64_t
+llvm_target_t::get_feature_mask(string const& name)
+{
+  return llvm::X86::getCpuSupportsMask({llvm::StringRef(name)});
+}
+
+// Splits the strings of a target or target_clones attribute at the commas,
+// gcc accepts both target_clones("avx2", "default") and ("avx2,default")
+static vector<string>
+split_attribute_arguments(attribute_n const* attribute)
+{
+  vector<string> ret;
+  for (auto const& argument : attribute->get_arguments()) {
+    size_t start = 0;
+    for (;;) {
+      size_t end = argument.find(',', start);
+      string item = argument.substr(start, end == string::npos ? string::npos : end - start);
+      if (!item.empty()) {
+        ret.push_back(item);
+      }
+      if (end == string::npos) {
+        break;
+      }
+      start = end + 1;
+    }
+  }
+  return ret;
+}
+
+void
+llvm_codegen_t::apply_target_attribute(llvm::Function* function, attribute_n const* attribute)
+{
+  llvm_target_t const* target = this->m_options.target;
+  if (target == nullptr) {
+    return;
+  }
+  string cpu;
+  string features;
+  for (auto const& item : split_attribute_arguments(attribute)) {
+    if (item.compare(0, 5, "arch=") == 0) {
+      cpu = item.substr(5);
+    }
+    else if (item.compare(0, 3, "no-") == 0) {
+      features = join_features(features, "-" + item.substr(3));
+    }
+    else {
+      features = join_features(features, "+" + item);
+    }
+  }
+  if (!cpu.empty() && !target->get_target_machine()->getMCSubtargetInfo()->isCPUStringValid(cpu)) {
+    this->error("unknown CPU " + cpu + " in target attribute of " + function->getName().str());
+    return;
+  }
+  target->add_function_attributes(*function, cpu, features);
+}
+
+bool
+llvm_codegen_t::declare_target_clones(llvm::Function* function,
+                                      attribute_n const* attribute,
+                                      vector<llvm::Function*>& clones)
+{
+  string name = function->getName().str();
+  llvm_target_t const* target = this->m_options.target;
+  if (target == nullptr || !target->is_x86()) {
+    this->error("target_clones of " + name + " needs an x86 target");
+    return false;
+  }
+  vector<string> features;
+  bool has_default = false;
+  for (auto const& item : split_attribute_arguments(attribute)) {
+    if (item == "default") {
+      has_default = true;
+    }
+    else if (!llvm_target_t::is_dispatchable_feature(item)) {
+      this->error("target_clones of " + name + ": cannot dispatch on " + item);
+      return false;
+    }
+    else if (find(features.begin(), features.end(), item) == features.end()) {
+      features.push_back(item);
+    }
+  }
+  if (!has_default) {
+    this->error("target_clones of " + name + " has no default version");
+    return false;
+  }
+  stable_sort(features.begin(), features.end(), [](string const& a, string const& b) {
+    return llvm_target_t::get_feature_priority(a) > llvm_target_t::get_feature_priority(b);
+  });
+  features.push_back("default");
+
+  multiversioned_function_t multiversioned = {function, {}, {}};
+  for (auto const& feature : features) {
+    llvm::Function* clone = llvm::Function::Create(function->getFunctionType(),
+                                                   llvm::Function::InternalLinkage,
+                                                   name + "." + feature,
+                                                   *this->m_module);
+    clone->copyAttributesFrom(function);
+    clone->setLinkage(llvm::Function::InternalLinkage);
+    target->add_function_attributes(*clone, "", feature == "default" ? "" : "+" + feature);
+    clones.push_back(clone);
+    multiversioned.clones.push_back(clone);
+    multiversioned.features.push_back(feature);
+  }
+  this->m_multiversioned_functions.push_back(multiversioned);
+  return true;
+}
+
+bool
+llvm_codegen_t::is_multiversioned(llvm::Function const* function) const
+{
+  for (auto const& multiversioned : this->m_multiversioned_functions) {
+    if (multiversioned.function == function) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The resolver runs once, when the dynamic loader binds the ifunc, and
+// returns the clone for the best feature the CPU has. It reads the same
+// __cpu_model data as __builtin_cpu_supports, from libgcc or compiler-rt.
+void
+llvm_codegen_t::finish_module_target_clones()
+{
+  if (this->m_multiversioned_functions.empty()) {
+    return;
+  }
+  llvm::Type* i32_type = llvm::Type::getInt32Ty(this->m_ctx);
+  llvm::Type* i64_type = llvm::Type::getInt64Ty(this->m_ctx);
+  llvm::StructType* cpu_model_type = llvm::StructType::get(this->m_ctx, {
+    i32_type, i32_type, i32_type, llvm::ArrayType::get(i32_type, 1)
+  });
+  llvm::Constant* cpu_model = this->m_module->getOrInsertGlobal("__cpu_model", cpu_model_type);
+  llvm::Constant* cpu_features2 = this->m_module->getOrInsertGlobal("__cpu_features2", i32_type);
+  llvm::FunctionCallee cpu_init = this->m_module->getOrInsertFunction("__cpu_indicator_init",
+                                                                      llvm::Type::getVoidTy(this->m_ctx));
+  for (auto const& multiversioned : this->m_multiversioned_functions) {
+    llvm::Function* function = multiversioned.function;
+    llvm::PointerType* function_ptr_type = function->getFunctionType()->getPointerTo();
+    llvm::Function* resolver = llvm::Function::Create(llvm::FunctionType::get(function_ptr_type, false),
+                                                      llvm::Function::InternalLinkage,
+                                                      function->getName() + ".resolver",
+                                                      *this->m_module);
+    this->m_builder.SetInsertPoint(llvm::BasicBlock::Create(this->m_ctx, "entry", resolver));
+    this->m_builder.CreateCall(cpu_init);
+    llvm::Value* features_addr = this->m_builder.CreateInBoundsGEP(cpu_model_type, cpu_model, {
+      this->m_builder.getInt32(0), this->m_builder.getInt32(3), this->m_builder.getInt32(0)
+    });
+    llvm::Value* features = this->m_builder.CreateLoad(i32_type, features_addr);
+    llvm::Value* features2 = this->m_builder.CreateLoad(i32_type, cpu_features2);
+    llvm::Value* cpu_mask = this->m_builder.CreateOr(this->m_builder.CreateZExt(features, i64_type),
+                                                     this->m_builder.CreateShl(this->m_builder.CreateZExt(features2, i64_type), 32),
+                                                     "cpu.features");
+    for (size_t i = 0;i < multiversioned.clones.size();i++) {
+      string const& feature = multiversioned.features[i];
+      if (feature == "default") {
+        this->m_builder.CreateRet(multiversioned.clones[i]);
+        break;
+      }
+      llvm::Value* mask = llvm::ConstantInt::get(i64_type, llvm_target_t::get_feature_mask(feature));
+      llvm::Value* has_feature = this->m_builder.CreateICmpEQ(this->m_builder.CreateAnd(cpu_mask, mask), mask);
+      llvm::BasicBlock* found_bb = llvm::BasicBlock::Create(this->m_ctx, "resolve." + feature, resolver);
+      llvm::BasicBlock* next_bb = llvm::BasicBlock::Create(this->m_ctx, "resolve.next", resolver);
+      this->m_builder.CreateCondBr(has_feature, found_bb, next_bb);
+      this->m_builder.SetInsertPoint(found_bb);
+      this->m_builder.CreateRet(multiversioned.clones[i]);
+      this->m_builder.SetInsertPoint(next_bb);
+    }
+    this->m_builder.ClearInsertionPoint();
+
+    llvm::GlobalIFunc* ifunc = llvm::GlobalIFunc::create(function->getFunctionType(),
+                                                         0,
+                                                         function->getLinkage(),
+                                                         "",
+                                                         resolver,
+                                                         this->m_module.get());
+    function->replaceAllUsesWith(ifunc);
+    ifunc->takeName(function);
+    function->eraseFromParent();
+  }
+  this->m_multiversioned_functions.clear();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace std;
+
+// The machine code is generated for, set with --target=, -march=/-mcpu= and
+// -mattr=. A CPU of "native" stands for the host CPU along with the features
+// the host reports, and is rejected for a target of another architecture.
+class llvm_target_t
+{
+public:
+  // Returns nullptr, with why in error, if the triple or the CPU is
+  // unknown. An empty triple is the host triple and an empty cpu the generic
+  // one. is_pic is -fpic, position independent code for a shared library,
+  // else the code is for an executable, like llvm_codegen_options_t has it.
+  static unique_ptr<llvm_target_t> create(string const& triple,
+                                          string const& cpu,
+                                          string const& features,
+                                          bool is_pic,
+                                          string& error);
+
+  llvm::TargetMachine* get_target_machine() const { return this->m_target_machine.get(); }
+  string const& get_cpu() const { return this->m_cpu; }
+  string const& get_features() const { return this->m_features; }
+  bool is_x86() const;
+  // Stamps the triple, data layout and PIC level, before any code is
+  // generated
+  void configure_module(llvm::Module& module) const;
+  // Sets target-cpu and target-features of function. extra_features, e.g.
+  // "+avx2,-bmi", are appended to the ones of the command line and cpu, if
+  // not empty, overrides the CPU of the command line.
+  void add_function_attributes(llvm::Function& function,
+                               string const& cpu = "",
+                               string const& extra_features = "") const;
+
+  // The features target_clones can dispatch on, which are the ones the x86
+  // runtime (__cpu_model) reports
+  static bool is_dispatchable_feature(string const& name);
+  // Clones of higher priority are tried first by the resolver
+  static unsigned get_feature_priority(string const& name);
+  // Bits of the feature in __cpu_model.features[0] | __cpu_features2 << 32
+  static uint64_t get_feature_mask(string const& name);
+private:
+  llvm_target_t(llvm::TargetMachine* target_machine, string const& cpu, string const& features) :
+    m_target_machine(target_machine),
+    m_cpu(cpu),
+    m_features(features)
+  { }
+
+  unique_ptr<llvm::TargetMachine> m_target_machine;
+  string m_cpu;
+  string m_features;
+};
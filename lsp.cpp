@@ -0,0 +1,528 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "lex.h"
+#include "lsp.h"
+#include "parse.h"
+
+using namespace std;
+
+// c_type_to_string() ends every type with a space
+static string
+type_to_string(c_type_t const* c_type)
+{
+  string ret = c_type->c_type_to_string();
+  while (!ret.empty() && ret.back() == ' ') {
+    ret.pop_back();
+  }
+  return ret;
+}
+
+void
+lsp_document_t::set_text(string const& text)
+{
+  this->m_text = "";
+  this->m_line_starts = {0};
+  this->m_declarations.clear();
+  this->m_global_scope = nullptr;
+  this->edit(0, 0, text);
+}
+
+void
+lsp_document_t::edit(size_t begin, size_t end, string const& text)
+{
+  ptrdiff_t delta = (ptrdiff_t)text.size() - (ptrdiff_t)(end - begin);
+  this->m_text.replace(begin, end - begin, text);
+
+  // the lines starting in (begin, end] are gone, the ones after move
+  auto first_line = upper_bound(this->m_line_starts.begin(), this->m_line_starts.end(), begin);
+  auto last_line = upper_bound(first_line, this->m_line_starts.end(), end);
+  for (auto it = last_line;it != this->m_line_starts.end();it++) {
+    *it += delta;
+  }
+  vector<size_t> new_lines;
+  for (size_t i = 0;i < text.size();i++) {
+    if (text[i] == '\n') {
+      new_lines.push_back(begin + i + 1);
+    }
+  }
+  first_line = this->m_line_starts.erase(first_line, last_line);
+  this->m_line_starts.insert(first_line, new_lines.begin(), new_lines.end());
+
+  // Reparses the declarations the edit touches, a declaration ending right
+  // where it starts included since the edit may extend its last token
+  size_t first = 0;
+  size_t last = this->m_declarations.size();
+  if (!this->m_declarations.empty()) {
+    first = this->find_declaration(begin);
+    if (first > 0 && this->m_declarations[first - 1].end == begin) {
+      first--;
+    }
+    last = this->find_declaration(end) + 1;
+  }
+  size_t parse_begin = first < last ? this->m_declarations[first].begin : 0;
+  size_t parse_end = first < last ? this->m_declarations[last - 1].end + delta : this->m_text.size();
+  vector<string> old_symbols = this->get_file_scope_symbols(first, last);
+  vector<lsp_declaration_t> declarations = this->parse(parse_begin, parse_end, true);
+  for (size_t i = last;i < this->m_declarations.size();i++) {
+    this->m_declarations[i].begin += delta;
+    this->m_declarations[i].end += delta;
+    this->m_declarations[i].base += delta;
+  }
+  size_t num_declarations = declarations.size();
+  this->m_declarations.erase(this->m_declarations.begin() + first, this->m_declarations.begin() + last);
+  this->m_declarations.insert(this->m_declarations.begin() + first,
+                              make_move_iterator(declarations.begin()),
+                              make_move_iterator(declarations.end()));
+  this->analyze(first, first + num_declarations, old_symbols);
+}
+
+// Start of the first line after offset that starts like a declaration, where
+// parsing resumes after a syntax error
+static size_t
+find_resync_offset(string const& text, size_t offset, size_t end)
+{
+  for (size_t i = offset;i < end;i++) {
+    if (text[i] == '\n' && i + 1 < end && (isalpha(text[i + 1]) || text[i + 1] == '_')) {
+      return i + 1;
+    }
+  }
+  return end;
+}
+
+vector<lsp_declaration_t>
+lsp_document_t::parse(size_t begin, size_t end, bool is_lazy)
+{
+  vector<lsp_declaration_t> ret;
+  size_t pos = begin;
+  while (pos < end) {
+    FILE* input = fmemopen((void*)(this->m_text.data() + pos), end - pos, "r");
+    lexer_t lexer(input);
+    unique_ptr<translation_unit_n> root(new translation_unit_n("-", "-"));
+    // the nodes the parser creates go in arena until it hands over a
+    // declaration, which takes them
+    unique_ptr<node_arena_t> arena = make_unique<node_arena_t>();
+    node_arena_t* outer_arena = node_arena_t::get_thread_arena();
+    node_arena_t::set_thread_arena(arena.get());
+    size_t next_begin = pos;
+    bool has_error = false;
+    string error_message;
+    source_range_t error_range;
+    parse_translation_unit(lexer,
+                           root.get(),
+                           [&](external_declaration_n* external_declaration, source_range_t const& range) {
+                             lsp_declaration_t declaration;
+                             declaration.begin = next_begin;
+                             declaration.end = pos + range.end;
+                             declaration.base = pos;
+                             declaration.range = range;
+                             declaration.arena = std::move(arena);
+                             declaration.external_declaration = external_declaration;
+                             next_begin = declaration.end;
+                             ret.push_back(std::move(declaration));
+                             arena = make_unique<node_arena_t>();
+                             node_arena_t::set_thread_arena(arena.get());
+                           },
+                           [&](string const& msg, source_range_t const& range) {
+                             if (!has_error) {
+                               has_error = true;
+                               error_message = msg;
+                               error_range = range;
+                             }
+                           },
+                           is_lazy);
+    fclose(input);
+    node_arena_t::set_thread_arena(outer_arena);
+    // the declarations live on in their arenas
+    root->clear();
+    if (!has_error) {
+      if (next_begin < end) {
+        // comments and whitespace after the last declaration
+        if (!ret.empty()) {
+          ret.back().end = end;
+        }
+        else {
+          lsp_declaration_t declaration;
+          declaration.begin = next_begin;
+          declaration.end = end;
+          declaration.base = pos;
+          declaration.range = {0, 0};
+          declaration.external_declaration = nullptr;
+          ret.push_back(std::move(declaration));
+        }
+      }
+      break;
+    }
+    // the text up to the next line that looks like a declaration makes one
+    // declaration that does not parse
+    size_t error_begin = max(pos + error_range.begin, next_begin);
+    size_t error_end = min(max(pos + error_range.end, error_begin), end);
+    lsp_declaration_t declaration;
+    declaration.begin = next_begin;
+    declaration.end = find_resync_offset(this->m_text, error_begin, end);
+    declaration.base = pos;
+    declaration.range = {next_begin - pos, declaration.end - pos};
+    // the nodes of what parsed before the error
+    declaration.arena = std::move(arena);
+    declaration.external_declaration = nullptr;
+    declaration.diagnostics.push_back({error_begin, error_end, error_message});
+    pos = declaration.end;
+    ret.push_back(std::move(declaration));
+  }
+  if (!is_lazy) {
+    return ret;
+  }
+
+  // each body goes in the arena of its declaration
+  vector<function_definition_n const*> functions;
+  vector<node_arena_t*> arenas;
+  for (auto const& declaration : ret) {
+    if (declaration.external_declaration && declaration.external_declaration->get_function_definition()) {
+      functions.push_back(declaration.external_declaration->get_function_definition());
+      arenas.push_back(declaration.arena.get());
+    }
+  }
+  function_definition_n::parse_bodies(functions, max(1u, thread::hardware_concurrency()), arenas);
+  // a function whose body does not parse is parsed again eagerly, for the
+  // location of the syntax error and the resync after it, and its first
+  // parse is freed with ret
+  vector<lsp_declaration_t> parsed;
+  for (auto& declaration : ret) {
+    function_definition_n const* function =
+      declaration.external_declaration ? declaration.external_declaration->get_function_definition() : nullptr;
+    if (function && function->get_compound_statement() == nullptr) {
+      for (auto& reparsed : this->parse(declaration.begin, declaration.end, false)) {
+        parsed.push_back(std::move(reparsed));
+      }
+    }
+    else {
+      parsed.push_back(std::move(declaration));
+    }
+  }
+  return parsed;
+}
+
+vector<string>
+lsp_document_t::get_file_scope_symbols(size_t first, size_t last) const
+{
+  vector<string> ret;
+  for (size_t i = first;i < last;i++) {
+    if (!this->m_declarations[i].sema) {
+      continue;
+    }
+    for (auto const& symbol : this->m_declarations[i].sema->get_file_scope_symbols()) {
+      ret.push_back(symbol.identifier->get_identifier_name() + " " + type_to_string(symbol.c_type));
+    }
+  }
+  return ret;
+}
+
+void
+lsp_document_t::analyze(size_t first, size_t last, vector<string> const& old_symbols)
+{
+  if (!this->m_global_scope || this->m_num_global_declarations > first) {
+    this->m_global_scope = make_unique<symbol_table_t>();
+    this->m_num_global_declarations = 0;
+  }
+  for (size_t i = this->m_num_global_declarations;i < first;i++) {
+    if (!this->m_declarations[i].sema) {
+      continue;
+    }
+    for (auto const& symbol : this->m_declarations[i].sema->get_file_scope_symbols()) {
+      this->m_global_scope->add_symbol(symbol.identifier->get_identifier_name(), symbol.c_type);
+    }
+  }
+  this->m_num_global_declarations = first;
+
+  // what the edited declarations and the ones after them declare goes in
+  // a scope of its own, leaving m_global_scope as it is
+  symbol_table_t file_scope(this->m_global_scope.get());
+  for (size_t i = first;i < last;i++) {
+    this->analyze(this->m_declarations[i], &file_scope);
+  }
+  if (this->get_file_scope_symbols(first, last) != old_symbols) {
+    // the declarations after the edited ones may resolve names differently
+    for (size_t i = last;i < this->m_declarations.size();i++) {
+      this->analyze(this->m_declarations[i], &file_scope);
+    }
+  }
+}
+
+void
+lsp_document_t::analyze(lsp_declaration_t& declaration, symbol_table_t* file_scope)
+{
+  if (declaration.external_declaration == nullptr) {
+    return;
+  }
+  declaration.diagnostics.clear();
+  declaration.sema = make_unique<sema_t>();
+  declaration.sema->set_records_symbols(true);
+  diagnostics_t diagnostics;
+  diagnostics.set_handler([&](diagnostics_t::diagnostic_t const& diagnostic) {
+    source_range_t range = diagnostic.range ? *diagnostic.range : declaration.range;
+    declaration.diagnostics.push_back({declaration.base + range.begin, declaration.base + range.end, diagnostic.message});
+  });
+  declaration.sema->set_diagnostics(&diagnostics);
+  declaration.sema->start_unit(file_scope);
+  declaration.sema->analyze(declaration.external_declaration);
+  declaration.sema->set_diagnostics(nullptr);
+}
+
+size_t
+lsp_document_t::find_declaration(size_t offset) const
+{
+  auto it = upper_bound(this->m_declarations.begin(), this->m_declarations.end(), offset,
+                        [](size_t offset, lsp_declaration_t const& declaration) {
+                          return offset < declaration.begin;
+                        });
+  return it == this->m_declarations.begin() ? 0 : it - this->m_declarations.begin() - 1;
+}
+
+size_t
+lsp_document_t::get_offset(size_t line, size_t character) const
+{
+  if (line >= this->m_line_starts.size()) {
+    return this->m_text.size();
+  }
+  size_t line_end = line + 1 < this->m_line_starts.size() ? this->m_line_starts[line + 1] : this->m_text.size();
+  return min(this->m_line_starts[line] + character, line_end);
+}
+
+llvm::json::Value
+lsp_document_t::get_position(size_t offset) const
+{
+  auto it = upper_bound(this->m_line_starts.begin(), this->m_line_starts.end(), offset);
+  size_t line = it - this->m_line_starts.begin() - 1;
+  return llvm::json::Object{{"line", (int64_t)line}, {"character", (int64_t)(offset - this->m_line_starts[line])}};
+}
+
+llvm::json::Value
+lsp_document_t::get_range(size_t begin, size_t end) const
+{
+  return llvm::json::Object{{"start", this->get_position(begin)}, {"end", this->get_position(end)}};
+}
+
+llvm::json::Array
+lsp_document_t::get_diagnostics() const
+{
+  llvm::json::Array ret;
+  for (auto const& declaration : this->m_declarations) {
+    for (auto const& diagnostic : declaration.diagnostics) {
+      ret.push_back(llvm::json::Object{{"range", this->get_range(diagnostic.begin, diagnostic.end)},
+                                       {"severity", 1},
+                                       {"source", "cc"},
+                                       {"message", llvm::json::fixUTF8(diagnostic.message)}});
+    }
+  }
+  return ret;
+}
+
+llvm::json::Array
+lsp_document_t::get_document_symbols() const
+{
+  // SymbolKind of the protocol
+  int const function_kind = 12;
+  int const variable_kind = 13;
+  llvm::json::Array ret;
+  for (auto const& declaration : this->m_declarations) {
+    if (!declaration.sema) {
+      continue;
+    }
+    for (auto const& symbol : declaration.sema->get_file_scope_symbols()) {
+      source_range_t name = symbol.identifier->get_range();
+      ret.push_back(llvm::json::Object{
+        {"name", symbol.identifier->get_identifier_name()},
+        {"detail", type_to_string(symbol.c_type)},
+        {"kind", symbol.c_type->is_function() ? function_kind : variable_kind},
+        {"range", this->get_range(declaration.base + declaration.range.begin, declaration.base + declaration.range.end)},
+        {"selectionRange", this->get_range(declaration.base + name.begin, declaration.base + name.end)},
+      });
+    }
+  }
+  return ret;
+}
+
+llvm::json::Value
+lsp_document_t::get_hover(size_t offset) const
+{
+  if (this->m_declarations.empty()) {
+    return nullptr;
+  }
+  lsp_declaration_t const& declaration = this->m_declarations[this->find_declaration(offset)];
+  if (!declaration.sema) {
+    return nullptr;
+  }
+  for (auto const& use : declaration.sema->get_symbol_uses()) {
+    source_range_t range = use.identifier->get_range();
+    if (declaration.base + range.begin <= offset && offset < declaration.base + range.end) {
+      return llvm::json::Object{
+        {"contents", llvm::json::Object{{"kind", "plaintext"},
+                                        {"value", use.identifier->get_identifier_name() + ": " +
+                                                  type_to_string(use.c_type)}}},
+        {"range", this->get_range(declaration.base + range.begin, declaration.base + range.end)},
+      };
+    }
+  }
+  return nullptr;
+}
+
+bool
+lsp_server_t::read_message(FILE* in, string& message)
+{
+  // headers, of which only Content-Length matters, then an empty line
+  size_t length = 0;
+  char line[256];
+  for (;;) {
+    if (fgets(line, sizeof(line), in) == nullptr) {
+      return false;
+    }
+    if (strcmp(line, "\r\n") == 0 || strcmp(line, "\n") == 0) {
+      break;
+    }
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      length = strtoull(line + 15, nullptr, 10);
+    }
+  }
+  message.resize(length);
+  return fread(&message[0], 1, length, in) == length;
+}
+
+void
+lsp_server_t::write_message(FILE* out, llvm::json::Value message)
+{
+  string body;
+  llvm::raw_string_ostream os(body);
+  os << message;
+  os.flush();
+  fprintf(out, "Content-Length: %zu\r\n\r\n", body.size());
+  fwrite(body.data(), 1, body.size(), out);
+  fflush(out);
+}
+
+void
+lsp_server_t::publish_diagnostics(FILE* out, string const& uri)
+{
+  auto it = this->m_documents.find(uri);
+  llvm::json::Array diagnostics = it == this->m_documents.end() ? llvm::json::Array() : it->second->get_diagnostics();
+  this->write_message(out, llvm::json::Object{
+    {"jsonrpc", "2.0"},
+    {"method", "textDocument/publishDiagnostics"},
+    {"params", llvm::json::Object{{"uri", uri}, {"diagnostics", std::move(diagnostics)}}},
+  });
+}
+
+static size_t
+get_json_offset(lsp_document_t const& document, llvm::json::Object const* position)
+{
+  if (position == nullptr) {
+    return 0;
+  }
+  return document.get_offset(position->getInteger("line").getValueOr(0),
+                             position->getInteger("character").getValueOr(0));
+}
+
+void
+lsp_server_t::handle(FILE* out, llvm::json::Object const& message)
+{
+  string method = message.getString("method").getValueOr("").str();
+  llvm::json::Value const* id = message.get("id");
+  llvm::json::Object const* params = message.getObject("params");
+  llvm::json::Object const* text_document = params ? params->getObject("textDocument") : nullptr;
+  string uri = text_document ? text_document->getString("uri").getValueOr("").str() : "";
+  lsp_document_t* document = nullptr;
+  if (this->m_documents.count(uri) != 0) {
+    document = this->m_documents[uri].get();
+  }
+
+  llvm::json::Value result = nullptr;
+  if (method == "initialize") {
+    // incremental sync, the client sends the edited ranges only
+    result = llvm::json::Object{
+      {"capabilities", llvm::json::Object{
+        {"textDocumentSync", llvm::json::Object{{"openClose", true}, {"change", 2}}},
+        {"documentSymbolProvider", true},
+        {"hoverProvider", true},
+      }},
+      {"serverInfo", llvm::json::Object{{"name", "cc"}}},
+    };
+  }
+  else if (method == "shutdown") {
+    this->m_is_shut_down = true;
+  }
+  else if (method == "exit") {
+    this->m_has_exited = true;
+    return;
+  }
+  else if (method == "textDocument/didOpen" && text_document) {
+    unique_ptr<lsp_document_t>& opened = this->m_documents[uri];
+    opened = make_unique<lsp_document_t>();
+    opened->set_text(text_document->getString("text").getValueOr("").str());
+    this->publish_diagnostics(out, uri);
+    return;
+  }
+  else if (method == "textDocument/didChange" && document) {
+    llvm::json::Array const* changes = params->getArray("contentChanges");
+    for (size_t i = 0;changes && i < changes->size();i++) {
+      llvm::json::Object const* change = (*changes)[i].getAsObject();
+      string text = change->getString("text").getValueOr("").str();
+      llvm::json::Object const* range = change->getObject("range");
+      if (range == nullptr) {
+        document->set_text(text);
+        continue;
+      }
+      size_t begin = get_json_offset(*document, range->getObject("start"));
+      size_t end = get_json_offset(*document, range->getObject("end"));
+      document->edit(begin, max(begin, end), text);
+    }
+    this->publish_diagnostics(out, uri);
+    return;
+  }
+  else if (method == "textDocument/didClose") {
+    this->m_documents.erase(uri);
+    this->publish_diagnostics(out, uri);
+    return;
+  }
+  else if (method == "textDocument/documentSymbol") {
+    result = document ? document->get_document_symbols() : llvm::json::Array();
+  }
+  else if (method == "textDocument/hover") {
+    if (document) {
+      result = document->get_hover(get_json_offset(*document, params->getObject("position")));
+    }
+  }
+  else if (id != nullptr) {
+    this->write_message(out, llvm::json::Object{
+      {"jsonrpc", "2.0"},
+      {"id", *id},
+      {"error", llvm::json::Object{{"code", -32601}, {"message", "unsupported method " + method}}},
+    });
+    return;
+  }
+  if (id != nullptr) {
+    this->write_message(out, llvm::json::Object{{"jsonrpc", "2.0"}, {"id", *id}, {"result", std::move(result)}});
+  }
+}
+
+int
+lsp_server_t::run(FILE* in, FILE* out)
+{
+  string body;
+  while (!this->m_has_exited && this->read_message(in, body)) {
+    llvm::Expected<llvm::json::Value> message = llvm::json::parse(body);
+    if (!message) {
+      llvm::consumeError(message.takeError());
+      continue;
+    }
+    if (llvm::json::Object const* object = message->getAsObject()) {
+      this->handle(out, *object);
+    }
+  }
+  // the protocol wants status 1 when exit comes without shutdown first
+  return this->m_has_exited && this->m_is_shut_down ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/JSON.h"
+
+#include "ast.h"
+#include "sema.h"
+#include "symbol_table.h"
+
+using namespace std;
+
+// What the server knows about one top level declaration of a document
+struct lsp_declaration_t
+{
+  struct diagnostic_t
+  {
+    size_t begin;
+    size_t end;
+    string message;
+  };
+
+  // Bytes of the document it owns. They run from the end of the previous
+  // declaration, comments and whitespace included, so the declarations of a
+  // document tile its text.
+  size_t begin;
+  size_t end;
+  // document offset where the parse it came from started, the locations of
+  // its nodes are relative to it
+  size_t base;
+  // the declaration itself, relative to base
+  source_range_t range;
+  // Owns the nodes parsed from its text, freed with it. Declared before
+  // sema, which points to them, so that it is destroyed after it.
+  unique_ptr<node_arena_t> arena;
+  // nullptr for text that does not parse, or has only comments
+  external_declaration_n* external_declaration;
+  // analysis of external_declaration on its own, nullptr without one
+  unique_ptr<sema_t> sema;
+  vector<diagnostic_t> diagnostics;
+};
+
+// An open document, kept parsed and analyzed a top level declaration at a
+// time. An edit only reparses the declarations it touches and reanalyzes
+// them; the declarations after them are reanalyzed too if the file scope
+// symbols the edited ones declare have changed.
+class lsp_document_t
+{
+public:
+  void set_text(string const& text);
+  // Replaces the bytes [begin, end) with text
+  void edit(size_t begin, size_t end, string const& text);
+
+  // LSP positions count lines and characters from 0, characters are taken
+  // to be bytes
+  size_t get_offset(size_t line, size_t character) const;
+  llvm::json::Value get_position(size_t offset) const;
+  llvm::json::Value get_range(size_t begin, size_t end) const;
+
+  llvm::json::Array get_diagnostics() const;
+  llvm::json::Array get_document_symbols() const;
+  // Type of the identifier at offset, null if there is none
+  llvm::json::Value get_hover(size_t offset) const;
+private:
+  // Parses the bytes [begin, end) of the text into declarations. With
+  // is_lazy the function bodies are skipped at first, then parsed on every
+  // core.
+  vector<lsp_declaration_t> parse(size_t begin, size_t end, bool is_lazy);
+  // Analyzes the declarations [first, last) that replaced ones declaring
+  // old_symbols at file scope, and the ones after them if what they declare
+  // differs
+  void analyze(size_t first, size_t last, vector<string> const& old_symbols);
+  // Analyzes declaration on its own, file_scope holding what the
+  // declarations before it declare
+  void analyze(lsp_declaration_t& declaration, symbol_table_t* file_scope);
+  vector<string> get_file_scope_symbols(size_t first, size_t last) const;
+  // index of the declaration owning offset
+  size_t find_declaration(size_t offset) const;
+
+  string m_text;
+  // offset of the first byte of each line
+  vector<size_t> m_line_starts;
+  vector<lsp_declaration_t> m_declarations;
+  // File scope symbols of the first m_num_global_declarations declarations.
+  // Edits tend to hit the same spot over and over, so it is only extended
+  // up to the first edited declaration, and rebuilt when an edit comes
+  // before that.
+  unique_ptr<symbol_table_t> m_global_scope;
+  size_t m_num_global_declarations = 0;
+};
+
+// Language server speaking LSP over a pair of streams: diagnostics, document
+// symbols and hover for the documents the client opens
+class lsp_server_t
+{
+public:
+  // Serves until the client sends exit, returns the exit status
+  int run(FILE* in, FILE* out);
+private:
+  // Returns false at the end of in
+  bool read_message(FILE* in, string& message);
+  void write_message(FILE* out, llvm::json::Value message);
+  // Handles a request or notification, the response if it needs one goes to out
+  void handle(FILE* out, llvm::json::Object const& message);
+  void publish_diagnostics(FILE* out, string const& uri);
+
+  map<string, unique_ptr<lsp_document_t>> m_documents;
+  bool m_is_shut_down = false;
+  bool m_has_exited = false;
+};
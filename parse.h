@@ -1,7 +1,39 @@
 #pragma once
 
+#include <functional>
+
 #include "ast.h"
+#include "lex.h"
+
+using namespace std;
+
+typedef function<void(external_declaration_n*, source_range_t const&)> declaration_handler_t;
+typedef function<void(string const&, source_range_t const&)> syntax_error_handler_t;
+
+// Parses the input of lexer into root with the push parser, one token at a
+// time as the scanner gets them. on_declaration is called with every
+// external declaration and the bytes it spans as soon as it is reduced (it
+// is already in root), so that a consumer can compile it while the rest of
+// the input is still arriving. Syntax errors go to on_syntax_error with the offending token,
+// or to stderr if there is none. Returns 0 on success like yyparse. Parses
+// with different lexers share no state and may run at once.
+//
+// With is_lazy, the body of a function definition is not parsed but skipped
+// by matching braces, and its tokens kept for when something asks for it
+// (see function_definition_n::get_compound_statement()).
+int parse_translation_unit(lexer_t& lexer,
+                           translation_unit_n* root,
+                           declaration_handler_t const& on_declaration,
+                           syntax_error_handler_t const& on_syntax_error = nullptr,
+                           bool is_lazy = false);
+
+// Parses a body parse_translation_unit() skipped, nullptr if it does not
+// parse. Its syntax errors go to on_syntax_error, located in the input of
+// the unit like those of parse_translation_unit(). It uses no global state but the --stats counters (see
+// node_counts_t), so several bodies can be parsed at once.
+compound_statement_n* parse_function_body(lazy_body_t const& body,
+                                          syntax_error_handler_t const& on_syntax_error = nullptr);
 
-// define yyerror function for parse errors
-void yyerror(translation_unit_n **root, const char *s);
+// counts the token the scanner returns, for --stats
+void stats_count_token(int token);
 
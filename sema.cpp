@@ -0,0 +1,1094 @@
+#include <limits.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "ast.h"
+#include "common.h"
+#include "sema.h"
+#include "stack_space.h"
+#include "stats.h"
+#include "trace.h"
+
+using namespace std;
+
+void
+sema_t::error(string const& msg)
+{
+  if (this->m_last_identifier) {
+    source_range_t range = this->m_last_identifier->get_range();
+    this->get_diagnostics().error(&range, msg);
+  }
+  else {
+    this->get_diagnostics().error(nullptr, msg);
+  }
+  this->m_has_error = true;
+}
+
+void
+sema_t::error(source_range_t const& range, string const& msg)
+{
+  this->get_diagnostics().error(&range, msg);
+  this->m_has_error = true;
+}
+
+void
+sema_t::declare(identifier_n const* identifier, c_type_t const* c_type)
+{
+  this->add_symbol(identifier->get_identifier_name(), c_type);
+  this->m_last_identifier = identifier;
+  TRACE(TRACE_TYPES, TRACE_DEBUG, "%s: %s",
+        identifier->get_identifier_name().c_str(), c_type->c_type_to_string().c_str());
+  if (!this->m_records_symbols) {
+    return;
+  }
+  this->m_symbol_uses.push_back({identifier, c_type});
+  if (this->is_global_scope()) {
+    this->m_file_scope_symbols.push_back({identifier, c_type});
+  }
+}
+
+void
+sema_t::add_expression(expression_n const* e, expr_info_t const& info)
+{
+  this->m_num_nodes++;
+  this->m_num_expressions++;
+  e->m_id = this->m_infos.size();
+  this->m_infos.push_back(info);
+}
+
+void
+sema_t::release_declarations()
+{
+  // an editor looks the recorded identifiers up later
+  assert(!this->m_records_symbols);
+  assert(this->m_scope == this->m_global_scope);
+  this->m_infos.clear();
+  this->m_string_ids.clear();
+  this->m_memory_orders.clear();
+  this->m_functions_taking_local_address.clear();
+  this->m_last_identifier = nullptr;
+}
+
+void
+sema_t::convert(expression_n const* e, c_type_t const* c_type)
+{
+  expr_info_t& info = this->m_infos[e->get_id()];
+  if (c_type->is_void()) {
+    info.converted_type = c_type;
+    return;
+  }
+  if (info.c_type->is_void()) {
+    this->error("void value not ignored as it ought to be");
+  }
+  else if (!info.c_type->is_scalar() || !c_type->is_scalar()) {
+    this->error("invalid conversion from " + info.c_type->c_type_to_string() +
+                "to " + c_type->c_type_to_string());
+  }
+  info.converted_type = c_type;
+}
+
+void
+sema_t::add_string_literal(expression_n const* e)
+{
+  string value;
+  if (!e->get_constant()->get_string_value(value)) {
+    this->error("wide string literals are not supported");
+    return;
+  }
+  this->m_string_ids[e] = this->m_string_pool.intern(value);
+}
+
+void
+sema_t::check_condition(expression_n const* e)
+{
+  c_type_t const* c_type = this->get_type(e);
+  if (!c_type->is_scalar()) {
+    this->error("scalar value required in condition, found " + c_type->c_type_to_string());
+  }
+}
+
+bool
+sema_t::is_global_symbol(string const& name) const
+{
+  symbol_table_t const* declaring_scope = this->m_scope->lookup_declaring_scope(name);
+  // the file scope may itself sit on the scope of the declarations before it
+  for (symbol_table_t const* scope = this->m_global_scope;scope != nullptr;scope = scope->get_prev_scope()) {
+    if (scope == declaring_scope) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+sema_t::push_scope()
+{
+  STATS_INC("sema.scopes");
+  this->m_scope = new symbol_table_t(this->m_scope);
+}
+
+void
+sema_t::pop_scope()
+{
+  assert(this->m_scope != this->m_global_scope);
+  symbol_table_t* scope = this->m_scope;
+  this->m_scope = scope->get_prev_scope();
+  delete scope;
+}
+
+void
+sema_t::start_unit(translation_unit_n const* translation_unit)
+{
+  this->start_unit(translation_unit->get_base_table());
+}
+
+void
+sema_t::start_unit(symbol_table_t* global_scope)
+{
+  this->m_global_scope = global_scope;
+  this->m_scope = this->m_global_scope;
+}
+
+bool
+sema_t::analyze(translation_unit_n const* translation_unit)
+{
+  this->start_unit(translation_unit);
+  for (auto const& external_declaration : translation_unit->get_list()) {
+    this->analyze(external_declaration);
+  }
+  return !this->m_has_error;
+}
+
+c_type_t const*
+constant_n::get_c_type() const
+{
+  string const& s = this->get_str();
+  switch (this->get_sort()) {
+    case constant_n::INTEGER_CONST: {
+      if (s.find('\'') != string::npos) {
+        // character constants have type int
+        return c_type_t::get_int_type();
+      }
+      size_t suffix_start = s.find_first_of("uUlL");
+      string suffix = suffix_start == string::npos ? "" : s.substr(suffix_start);
+      bool has_u = suffix.find_first_of("uU") != string::npos;
+      size_t num_l = count(suffix.begin(), suffix.end(), 'l') + count(suffix.begin(), suffix.end(), 'L');
+      bool is_decimal = s[0] != '0';
+      unsigned long long value = stoull(s.substr(0, suffix_start), nullptr, 0);
+      if (num_l == 0 && value <= (has_u || !is_decimal ? UINT32_MAX : INT32_MAX)) {
+        return c_type_t::mk_base_type(c_type_t::INT, false, false, has_u || value > INT32_MAX);
+      }
+      return c_type_t::mk_base_type(num_l == 2 ? c_type_t::LONG_LONG_INT : c_type_t::LONG_INT,
+                                    false,
+                                    false,
+                                    has_u || value > INT64_MAX);
+    }
+    case constant_n::FLOAT_CONST: {
+      char suffix = s.back();
+      if (suffix == 'f' || suffix == 'F') {
+        return c_type_t::mk_base_type(c_type_t::FLOAT, false, false, false);
+      }
+      if (suffix == 'l' || suffix == 'L') {
+        return c_type_t::mk_base_type(c_type_t::LONG_DOUBLE, false, false, false);
+      }
+      return c_type_t::get_double_type();
+    }
+    case constant_n::STRING_LITERAL: {
+      return c_type_t::mk_pointer(c_type_t::mk_base_type(c_type_t::CHAR, false, false, false));
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+static bool
+is_comparison_op(expression_n::operation_kind_t op)
+{
+  return op == expression_n::OP_LT || op == expression_n::OP_GT ||
+         op == expression_n::OP_LTE || op == expression_n::OP_GTE ||
+         op == expression_n::OP_EQ || op == expression_n::OP_NEQ;
+}
+
+static expression_n::operation_kind_t
+compound_assignment_to_binary_op(expression_n::operation_kind_t op)
+{
+  switch (op) {
+    case expression_n::OP_MUL_ASSIGN: return expression_n::OP_MUL;
+    case expression_n::OP_DIV_ASSIGN: return expression_n::OP_DIV;
+    case expression_n::OP_MOD_ASSIGN: return expression_n::OP_MOD;
+    case expression_n::OP_ADD_ASSIGN: return expression_n::OP_ADD;
+    case expression_n::OP_SUB_ASSIGN: return expression_n::OP_SUB;
+    case expression_n::OP_LSHIFT_ASSIGN: return expression_n::OP_LSHIFT;
+    case expression_n::OP_RSHIFT_ASSIGN: return expression_n::OP_RSHIFT;
+    case expression_n::OP_BIT_AND_ASSIGN: return expression_n::OP_BIT_AND;
+    case expression_n::OP_XOR_ASSIGN: return expression_n::OP_XOR;
+    case expression_n::OP_BIT_OR_ASSIGN: return expression_n::OP_BIT_OR;
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+// Types of the binary operators that evaluate both operands unconditionally:
+// what each operand is converted to and the type of the result. Returns an
+// error message if the operands are invalid, "" otherwise.
+static string
+binary_op_types(expression_n::operation_kind_t op,
+                c_type_t const* l,
+                c_type_t const* r,
+                c_type_t const*& l_to,
+                c_type_t const*& r_to,
+                c_type_t const*& result)
+{
+  c_type_t const* long_type = c_type_t::get_long_type();
+  auto invalid_operands = [&]() {
+    return "invalid operands to binary expression (" + l->c_type_to_string() +
+           "and " + r->c_type_to_string() + ")";
+  };
+  l_to = l;
+  r_to = r;
+
+  // pointer arithmetic and comparison
+  if (l->is_pointer() || r->is_pointer()) {
+    if (op == expression_n::OP_ADD && r->is_pointer() && l->is_integer()) {
+      l_to = long_type;
+      result = r;
+      return "";
+    }
+    if ((op == expression_n::OP_ADD || op == expression_n::OP_SUB) &&
+        l->is_pointer() && r->is_integer()) {
+      r_to = long_type;
+      result = l;
+      return "";
+    }
+    if (op == expression_n::OP_SUB && l->is_pointer() && r->is_pointer()) {
+      r_to = l;
+      result = long_type;
+      return "";
+    }
+    if (is_comparison_op(op) && l->is_scalar() && r->is_scalar()) {
+      l_to = r_to = l->is_pointer() ? l : r;
+      result = c_type_t::get_int_type();
+      return "";
+    }
+    return invalid_operands();
+  }
+  if (!l->is_arithmetic() || !r->is_arithmetic()) {
+    return invalid_operands();
+  }
+
+  if (op == expression_n::OP_LSHIFT || op == expression_n::OP_RSHIFT) {
+    if (!l->is_integer() || !r->is_integer()) {
+      return "invalid operands to shift expression";
+    }
+    l_to = r_to = result = c_type_t::integer_promotion(l);
+    return "";
+  }
+
+  l_to = r_to = result = c_type_t::usual_arithmetic_conversion(l, r);
+  if (is_comparison_op(op)) {
+    result = c_type_t::get_int_type();
+    return "";
+  }
+  if (result->is_floating() && (op == expression_n::OP_MOD || op == expression_n::OP_BIT_AND ||
+                                op == expression_n::OP_BIT_OR || op == expression_n::OP_XOR)) {
+    return "invalid operands of type " + result->c_type_to_string() + "to integer operation";
+  }
+  return "";
+}
+
+// Reports an error unless e designates an object that can be stored to
+static bool
+check_assignable(sema_t& sema, expression_n const* e)
+{
+  switch (sema.get_info(e).category) {
+    case expr_info_t::LVALUE: {
+      if (!sema.get_type(e)->get_is_const()) {
+        return true;
+      }
+      if (e->is_var()) {
+        sema.error("cannot assign to variable " + e->get_identifier()->get_identifier_name() +
+                   " with const-qualified type");
+      }
+      else {
+        sema.error("read-only location is not assignable");
+      }
+      return false;
+    }
+    case expr_info_t::FUNCTION_DESIGNATOR: {
+      sema.error(e->is_var() ? "function " + e->get_identifier()->get_identifier_name() + " is not assignable" :
+                               "function is not assignable");
+      return false;
+    }
+    default: {
+      sema.error("expression is not assignable");
+      return false;
+    }
+  }
+}
+
+// *p for a p of type pointer_type
+static void
+deref_analyze(sema_t& sema, c_type_t const* pointer_type, expr_info_t& info)
+{
+  c_type_t const* pointee_type = pointer_type->get_pointee_type();
+  if (pointee_type->is_function()) {
+    // *f is f again, a designator that decays to the pointer
+    info.c_type = pointer_type;
+    info.category = expr_info_t::FUNCTION_DESIGNATOR;
+    return;
+  }
+  info.category = expr_info_t::LVALUE;
+  if (pointee_type->is_void()) {
+    sema.error("dereferencing a void pointer");
+    info.c_type = c_type_t::get_int_type();
+    return;
+  }
+  info.c_type = pointee_type;
+}
+
+// Reads e, a memory order argument, which must be a constant
+static memory_order_t
+memory_order_analyze(sema_t& sema, expression_n const* e)
+{
+  unsigned long long value = ULLONG_MAX;
+  if (e->is_var()) {
+    string const& name = e->get_identifier()->get_identifier_name();
+    int constant;
+    if (sema.lookup_symbol(name) == nullptr && get_builtin_constant(name, constant)) {
+      value = constant;
+    }
+  }
+  else if (e->is_const() && e->get_constant()->get_sort() == constant_n::INTEGER_CONST &&
+           e->get_constant()->get_str().find('\'') == string::npos) {
+    value = e->get_constant()->get_integer_value();
+  }
+  if (value > (unsigned long long)memory_order_t::SEQ_CST) {
+    sema.error("memory order argument to atomic operation must be a memory_order constant");
+    value = (unsigned long long)memory_order_t::SEQ_CST;
+  }
+  sema.set_memory_order(e, (memory_order_t)value);
+  return (memory_order_t)value;
+}
+
+// The functions of <stdatomic.h> take a pointer to an _Atomic object, the
+// values to store in it converted to its type, and the memory orders of
+// their _explicit forms as constants
+static c_type_t const*
+atomic_builtin_analyze(sema_t& sema, expression_n const* e, atomic_builtin_t builtin, bool is_explicit)
+{
+  expression_n const* arg_list = e->get_child(1);
+  vector<expression_n*> const& args = arg_list->get_list();
+  c_type_t const* int_type = c_type_t::get_int_type();
+  c_type_t const* void_type = c_type_t::get_void_type();
+  // the builtins are not declared, their names get an entry for density only
+  sema.add_expression(e->get_child(0), {void_type, expr_info_t::RVALUE, nullptr});
+  for (auto const& arg : args) {
+    arg->analyze(sema);
+  }
+  sema.add_expression(arg_list, {void_type, expr_info_t::RVALUE, nullptr});
+
+  // arguments before the memory orders
+  size_t num_operands;
+  size_t num_orders = 1;
+  switch (builtin) {
+    case atomic_builtin_t::THREAD_FENCE:
+    case atomic_builtin_t::SIGNAL_FENCE: {
+      num_operands = 0;
+      break;
+    }
+    case atomic_builtin_t::LOAD:
+    case atomic_builtin_t::IS_LOCK_FREE: {
+      num_operands = 1;
+      break;
+    }
+    case atomic_builtin_t::COMPARE_EXCHANGE_STRONG:
+    case atomic_builtin_t::COMPARE_EXCHANGE_WEAK: {
+      num_operands = 3;
+      num_orders = 2;
+      break;
+    }
+    default: {
+      num_operands = 2;
+      break;
+    }
+  }
+  if (args.size() != num_operands + (is_explicit ? num_orders : 0)) {
+    sema.error("wrong number of arguments in function call");
+    return int_type;
+  }
+  vector<memory_order_t> orders;
+  for (size_t i = num_operands;i < args.size();i++) {
+    orders.push_back(memory_order_analyze(sema, args[i]));
+  }
+  if (num_operands == 0) {
+    return void_type;
+  }
+
+  c_type_t const* pointer_type = sema.get_type(args[0]);
+  if (!pointer_type->is_pointer() || !pointer_type->get_pointee_type()->get_is_atomic()) {
+    sema.error("address argument to atomic operation must be a pointer to _Atomic type (" +
+               pointer_type->c_type_to_string() + "invalid)");
+    return int_type;
+  }
+  c_type_t const* c_type = pointer_type->get_pointee_type();
+  if (c_type->get_is_const() && builtin != atomic_builtin_t::LOAD && builtin != atomic_builtin_t::IS_LOCK_FREE) {
+    sema.error("address argument to atomic operation must be a pointer to non-const _Atomic type (" +
+               pointer_type->c_type_to_string() + "invalid)");
+    return int_type;
+  }
+  // loads cannot release and stores cannot acquire, nor can a failed
+  // compare exchange, which only loads, release
+  bool is_order_valid = true;
+  c_type_t const* ret_type = c_type;
+  auto is_order = [&](size_t i, memory_order_t order) { return i < orders.size() && orders[i] == order; };
+  switch (builtin) {
+    case atomic_builtin_t::INIT: {
+      sema.convert(args[1], c_type);
+      return void_type;
+    }
+    case atomic_builtin_t::LOAD: {
+      is_order_valid = !is_order(0, memory_order_t::RELEASE) && !is_order(0, memory_order_t::ACQ_REL);
+      break;
+    }
+    case atomic_builtin_t::STORE: {
+      is_order_valid = !is_order(0, memory_order_t::CONSUME) && !is_order(0, memory_order_t::ACQUIRE) &&
+                       !is_order(0, memory_order_t::ACQ_REL);
+      sema.convert(args[1], c_type);
+      ret_type = void_type;
+      break;
+    }
+    case atomic_builtin_t::EXCHANGE: {
+      sema.convert(args[1], c_type);
+      break;
+    }
+    case atomic_builtin_t::COMPARE_EXCHANGE_STRONG:
+    case atomic_builtin_t::COMPARE_EXCHANGE_WEAK: {
+      c_type_t const* expected_type = sema.get_type(args[1]);
+      if (!expected_type->is_pointer() || !expected_type->get_pointee_type()->is_same_type(c_type)) {
+        sema.error("expected argument to atomic compare exchange must be a pointer to " +
+                   c_type->c_type_to_string() + "(" + expected_type->c_type_to_string() + "invalid)");
+      }
+      is_order_valid = !is_order(1, memory_order_t::RELEASE) && !is_order(1, memory_order_t::ACQ_REL);
+      sema.convert(args[2], c_type);
+      // a _Bool, which cc has no type for yet
+      ret_type = int_type;
+      break;
+    }
+    case atomic_builtin_t::FETCH_ADD:
+    case atomic_builtin_t::FETCH_SUB:
+    case atomic_builtin_t::FETCH_OR:
+    case atomic_builtin_t::FETCH_XOR:
+    case atomic_builtin_t::FETCH_AND: {
+      bool is_add_sub = builtin == atomic_builtin_t::FETCH_ADD || builtin == atomic_builtin_t::FETCH_SUB;
+      if (c_type->is_integer()) {
+        sema.convert(args[1], c_type);
+      }
+      else if (is_add_sub && c_type->is_pointer() && !c_type->get_pointee_type()->is_void() &&
+               !c_type->get_pointee_type()->is_function()) {
+        // the offset is in elements, as in pointer arithmetic
+        sema.convert(args[1], c_type_t::get_long_type());
+      }
+      else {
+        sema.error(string("address argument to atomic operation must be a pointer to atomic integer") +
+                   (is_add_sub ? " or pointer (" : " (") + pointer_type->c_type_to_string() + "invalid)");
+      }
+      break;
+    }
+    case atomic_builtin_t::IS_LOCK_FREE: {
+      return int_type;
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+  if (!is_order_valid) {
+    sema.error("memory order argument to atomic operation is invalid");
+  }
+  return ret_type;
+}
+
+static c_type_t const*
+function_call_analyze(sema_t& sema, expression_n const* e)
+{
+  expression_n const* arg_list = e->get_child(1);
+  vector<expression_n*> const& args = arg_list->get_list();
+  bool is_explicit;
+  atomic_builtin_t atomic_builtin = e->get_atomic_builtin(is_explicit);
+  if (atomic_builtin != atomic_builtin_t::NONE) {
+    return atomic_builtin_analyze(sema, e, atomic_builtin, is_explicit);
+  }
+  if (e->is_builtin_expect_call()) {
+    // the builtin is not declared, its name gets an entry for density only
+    c_type_t const* long_type = c_type_t::get_long_type();
+    sema.add_expression(e->get_child(0), {c_type_t::get_void_type(), expr_info_t::RVALUE, nullptr});
+    for (auto const& arg : args) {
+      arg->analyze(sema);
+      sema.convert(arg, long_type);
+    }
+    sema.add_expression(arg_list, {c_type_t::get_void_type(), expr_info_t::RVALUE, nullptr});
+    return long_type;
+  }
+
+  c_type_t const* callee_type = e->get_child(0)->analyze(sema);
+  for (auto const& arg : args) {
+    arg->analyze(sema);
+  }
+  sema.add_expression(arg_list, {c_type_t::get_void_type(), expr_info_t::RVALUE, nullptr});
+  if (!callee_type->is_pointer() || !callee_type->get_pointee_type()->is_function()) {
+    sema.error("called object is not a function");
+    return c_type_t::get_int_type();
+  }
+  c_type_t const* function_type = callee_type->get_pointee_type();
+  vector<c_type_t const*> const& param_types = function_type->get_param_types();
+  if (args.size() < param_types.size() ||
+      (args.size() > param_types.size() && !function_type->get_is_vararg())) {
+    sema.error("wrong number of arguments in function call");
+    return function_type->get_return_type();
+  }
+  for (size_t i = 0;i < args.size();i++) {
+    if (i < param_types.size()) {
+      sema.convert(args[i], param_types[i]);
+      continue;
+    }
+    // default argument promotions for the variable arguments
+    c_type_t const* arg_type = c_type_t::integer_promotion(sema.get_type(args[i]));
+    if (arg_type->get_base_type() == c_type_t::FLOAT) {
+      arg_type = c_type_t::get_double_type();
+    }
+    sema.convert(args[i], arg_type);
+  }
+  return function_type->get_return_type();
+}
+
+// Every expression gets its entry after the ones of its operands, so the ids
+// of a tree are a post-order numbering of it
+c_type_t const*
+expression_n::analyze(sema_t& sema) const
+{
+  if (!stack_space_t::has_space()) {
+    c_type_t const* ret;
+    if (!stack_space_t::run_on_new_stack([&]() { ret = this->analyze(sema); })) {
+      sema.error(stack_space_t::get_error());
+      // taken for an int, like an undeclared identifier
+      ret = c_type_t::get_int_type();
+      sema.add_expression(this, {ret, expr_info_t::RVALUE, nullptr});
+    }
+    return ret;
+  }
+  c_type_t const* int_type = c_type_t::get_int_type();
+  expr_info_t info = {nullptr, expr_info_t::RVALUE, nullptr};
+  switch (this->get_kind()) {
+    case expression_n::OP_EMPTY: {
+      info.c_type = c_type_t::get_void_type();
+      break;
+    }
+    case expression_n::OP_VAR: {
+      string const& name = this->get_identifier()->get_identifier_name();
+      c_type_t const* c_type = sema.lookup_symbol(name);
+      sema.record_use(this->get_identifier(), c_type);
+      int constant;
+      if (c_type == nullptr && get_builtin_constant(name, constant)) {
+        // memory_order_seq_cst and the like, which the missing
+        // <stdatomic.h> would define
+        info.c_type = int_type;
+      }
+      else if (c_type == nullptr) {
+        sema.error("use of undeclared identifier " + name);
+        // taken for an int variable, which avoids cascading errors
+        info.c_type = int_type;
+        info.category = expr_info_t::LVALUE;
+      }
+      else if (c_type->is_function()) {
+        // function designators decay to function pointers
+        info.c_type = c_type_t::mk_pointer(c_type);
+        info.category = expr_info_t::FUNCTION_DESIGNATOR;
+      }
+      else {
+        info.c_type = c_type;
+        info.category = expr_info_t::LVALUE;
+      }
+      break;
+    }
+    case expression_n::OP_CONST: {
+      info.c_type = this->get_constant()->get_c_type();
+      if (this->get_constant()->get_sort() == constant_n::STRING_LITERAL) {
+        sema.add_string_literal(this);
+      }
+      break;
+    }
+    case expression_n::OP_COMMA: {
+      this->get_child(0)->analyze(sema);
+      info.c_type = this->get_child(1)->analyze(sema);
+      break;
+    }
+    case expression_n::OP_FUNC_CALL: {
+      info.c_type = function_call_analyze(sema, this);
+      break;
+    }
+    case expression_n::OP_SUBSCRIPT: {
+      // a[i] is *(a + i), either operand may be the pointer
+      c_type_t const* l = this->get_child(0)->analyze(sema);
+      c_type_t const* r = this->get_child(1)->analyze(sema);
+      c_type_t const* l_to;
+      c_type_t const* r_to;
+      c_type_t const* pointer_type;
+      string msg = binary_op_types(expression_n::OP_ADD, l, r, l_to, r_to, pointer_type);
+      if (!msg.empty() || !pointer_type->is_pointer()) {
+        sema.error("subscripted value is not a pointer");
+        info.c_type = int_type;
+        info.category = expr_info_t::LVALUE;
+        break;
+      }
+      sema.convert(this->get_child(0), l_to);
+      sema.convert(this->get_child(1), r_to);
+      deref_analyze(sema, pointer_type, info);
+      break;
+    }
+    case expression_n::OP_DEREF: {
+      c_type_t const* c_type = this->get_child(0)->analyze(sema);
+      if (!c_type->is_pointer()) {
+        sema.error("indirection requires pointer operand (" + c_type->c_type_to_string() + "invalid)");
+        info.c_type = int_type;
+        info.category = expr_info_t::LVALUE;
+        break;
+      }
+      deref_analyze(sema, c_type, info);
+      break;
+    }
+    case expression_n::OP_ADDR: {
+      expression_n const* operand = this->get_child(0);
+      c_type_t const* c_type = operand->analyze(sema);
+      expr_info_t::value_category_t category = sema.get_info(operand).category;
+      if (category == expr_info_t::FUNCTION_DESIGNATOR) {
+        info.c_type = c_type;
+        break;
+      }
+      if (category != expr_info_t::LVALUE) {
+        sema.error("cannot take the address of an rvalue of type " + c_type->c_type_to_string());
+      }
+      else if (operand->is_var() && !sema.is_global_symbol(operand->get_identifier()->get_identifier_name())) {
+        sema.set_takes_local_address();
+      }
+      info.c_type = c_type_t::mk_pointer(c_type);
+      break;
+    }
+    case expression_n::OP_POST_INC:
+    case expression_n::OP_POST_DEC:
+    case expression_n::OP_PRE_INC:
+    case expression_n::OP_PRE_DEC: {
+      expression_n const* operand = this->get_child(0);
+      info.c_type = operand->analyze(sema);
+      if (check_assignable(sema, operand) && !info.c_type->is_scalar()) {
+        sema.error("cannot increment value of type " + info.c_type->c_type_to_string());
+      }
+      break;
+    }
+    case expression_n::OP_POS:
+    case expression_n::OP_NEG:
+    case expression_n::OP_COMPLEMENT: {
+      expression_n const* operand = this->get_child(0);
+      c_type_t const* c_type = operand->analyze(sema);
+      bool is_complement = this->get_kind() == expression_n::OP_COMPLEMENT;
+      if (!(is_complement ? c_type->is_integer() : c_type->is_arithmetic())) {
+        sema.error("invalid argument type " + c_type->c_type_to_string() + "to unary expression");
+        info.c_type = int_type;
+        break;
+      }
+      info.c_type = c_type_t::integer_promotion(c_type);
+      sema.convert(operand, info.c_type);
+      break;
+    }
+    case expression_n::OP_LOGIC_NOT: {
+      this->get_child(0)->analyze(sema);
+      sema.check_condition(this->get_child(0));
+      info.c_type = int_type;
+      break;
+    }
+    case expression_n::OP_MUL:
+    case expression_n::OP_DIV:
+    case expression_n::OP_MOD:
+    case expression_n::OP_ADD:
+    case expression_n::OP_SUB:
+    case expression_n::OP_LSHIFT:
+    case expression_n::OP_RSHIFT:
+    case expression_n::OP_LT:
+    case expression_n::OP_GT:
+    case expression_n::OP_LTE:
+    case expression_n::OP_GTE:
+    case expression_n::OP_EQ:
+    case expression_n::OP_NEQ:
+    case expression_n::OP_BIT_AND:
+    case expression_n::OP_BIT_OR:
+    case expression_n::OP_XOR: {
+      c_type_t const* l = this->get_child(0)->analyze(sema);
+      c_type_t const* r = this->get_child(1)->analyze(sema);
+      c_type_t const* l_to;
+      c_type_t const* r_to;
+      string msg = binary_op_types(this->get_kind(), l, r, l_to, r_to, info.c_type);
+      if (!msg.empty()) {
+        sema.error(msg);
+        info.c_type = int_type;
+        break;
+      }
+      sema.convert(this->get_child(0), l_to);
+      sema.convert(this->get_child(1), r_to);
+      break;
+    }
+    case expression_n::OP_LOGIC_AND:
+    case expression_n::OP_LOGIC_OR: {
+      for (auto const& child : this->get_list()) {
+        child->analyze(sema);
+        sema.check_condition(child);
+      }
+      info.c_type = int_type;
+      break;
+    }
+    case expression_n::OP_CONDITIONAL: {
+      this->get_child(0)->analyze(sema);
+      sema.check_condition(this->get_child(0));
+      c_type_t const* t = this->get_child(1)->analyze(sema);
+      c_type_t const* f = this->get_child(2)->analyze(sema);
+      if (t->is_arithmetic() && f->is_arithmetic()) {
+        info.c_type = c_type_t::usual_arithmetic_conversion(t, f);
+      }
+      else if (t->is_void() || f->is_void()) {
+        info.c_type = c_type_t::get_void_type();
+      }
+      else {
+        info.c_type = t->is_pointer() ? t : f;
+      }
+      sema.convert(this->get_child(1), info.c_type);
+      sema.convert(this->get_child(2), info.c_type);
+      break;
+    }
+    case expression_n::OP_ASSIGN: {
+      info.c_type = this->get_child(0)->analyze(sema);
+      this->get_child(1)->analyze(sema);
+      if (check_assignable(sema, this->get_child(0))) {
+        sema.convert(this->get_child(1), info.c_type);
+      }
+      break;
+    }
+    case expression_n::OP_MUL_ASSIGN:
+    case expression_n::OP_DIV_ASSIGN:
+    case expression_n::OP_MOD_ASSIGN:
+    case expression_n::OP_ADD_ASSIGN:
+    case expression_n::OP_SUB_ASSIGN:
+    case expression_n::OP_LSHIFT_ASSIGN:
+    case expression_n::OP_RSHIFT_ASSIGN:
+    case expression_n::OP_BIT_AND_ASSIGN:
+    case expression_n::OP_XOR_ASSIGN:
+    case expression_n::OP_BIT_OR_ASSIGN: {
+      info.c_type = this->get_child(0)->analyze(sema);
+      c_type_t const* r = this->get_child(1)->analyze(sema);
+      if (!check_assignable(sema, this->get_child(0))) {
+        break;
+      }
+      // the loaded value of the left operand and the right operand go
+      // through the conversions of the binary operator, its result through
+      // the one of the assignment (checked below, sema has no entry for it)
+      c_type_t const* l_to;
+      c_type_t const* r_to;
+      c_type_t const* result;
+      string msg = binary_op_types(compound_assignment_to_binary_op(this->get_kind()),
+                                   info.c_type, r, l_to, r_to, result);
+      if (!msg.empty()) {
+        sema.error(msg);
+        break;
+      }
+      if (!result->is_scalar() || !info.c_type->is_scalar()) {
+        sema.error("invalid conversion from " + result->c_type_to_string() +
+                   "to " + info.c_type->c_type_to_string());
+      }
+      sema.convert(this->get_child(0), l_to);
+      sema.convert(this->get_child(1), r_to);
+      break;
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+  sema.add_expression(this, info);
+  return info.c_type;
+}
+
+void
+selection_statement_n::analyze(sema_t& sema) const
+{
+  sema.count_node();
+  expression_n const* cond = this->get_cond();
+  cond->analyze(sema);
+  if (this->get_selection_sort() == selection_statement_n::SWITCH) {
+    // codegen switches on the first argument of __builtin_expect directly
+    expression_n const* expected = nullptr;
+    if (cond->is_builtin_expect_call()) {
+      expected = cond->get_child(1)->get_child(1);
+      cond = cond->get_child(1)->get_child(0);
+    }
+    c_type_t const* cond_type = sema.get_type(cond);
+    if (cond_type->is_integer()) {
+      cond_type = c_type_t::integer_promotion(cond_type);
+      sema.convert(cond, cond_type);
+      if (expected) {
+        sema.convert(expected, cond_type);
+      }
+    }
+    else {
+      sema.error("statement requires expression of integer type (" +
+                 cond_type->c_type_to_string() + "invalid)");
+      cond_type = c_type_t::get_int_type();
+    }
+    sema.push_switch(cond_type);
+    this->get_body()->analyze(sema);
+    sema.pop_switch();
+    return;
+  }
+  sema.check_condition(cond);
+  this->get_body()->analyze(sema);
+  if (this->get_selection_sort() == selection_statement_n::IF_THEN_ELSE) {
+    this->get_else_body()->analyze(sema);
+  }
+}
+
+void
+labeled_statement_n::analyze(sema_t& sema) const
+{
+  sema.count_node();
+  bool is_case = this->get_label_sort() == labeled_statement_n::CASE;
+  c_type_t const* switch_type = sema.get_cur_switch_type();
+  if (switch_type == nullptr) {
+    sema.error(string(is_case ? "case" : "default") + " label not within a switch statement");
+  }
+  if (is_case) {
+    c_type_t const* c_type = this->get_case_expr()->analyze(sema);
+    if (!c_type->is_integer()) {
+      sema.error("case label does not reduce to an integer constant");
+    }
+    else if (switch_type) {
+      sema.convert(this->get_case_expr(), switch_type);
+    }
+  }
+  this->get_body()->analyze(sema);
+}
+
+void
+iteration_statement_n::analyze(sema_t& sema) const
+{
+  sema.count_node();
+  iteration_sort_t sort = this->get_iteration_sort();
+  sema.push_scope();
+  if (sort == iteration_statement_n::FOR) {
+    this->get_init_expr()->analyze(sema);
+  }
+  else if (sort == iteration_statement_n::FOR_DECL) {
+    this->get_init_decl()->analyze(sema);
+  }
+  expression_n const* cond = this->get_cond();
+  cond->analyze(sema);
+  if (cond->get_kind() != expression_n::OP_EMPTY) {
+    sema.check_condition(cond);
+  }
+  this->get_body()->analyze(sema);
+  if (this->iteration_statement_has_update_expr()) {
+    this->get_update_expr()->analyze(sema);
+  }
+  sema.pop_scope();
+}
+
+void
+jump_statement_n::analyze(sema_t& sema) const
+{
+  sema.count_node();
+  if (this->get_jump_sort() != jump_statement_n::RETURN || this->get_expr_for_return() == nullptr) {
+    return;
+  }
+  expression_n const* expr = this->get_expr_for_return();
+  c_type_t const* c_type = expr->analyze(sema);
+  c_type_t const* ret_type = sema.get_cur_function_type()->get_return_type();
+  if (ret_type->is_void()) {
+    if (!c_type->is_void()) {
+      sema.error("void function should not return a value");
+    }
+    return;
+  }
+  sema.convert(expr, ret_type);
+}
+
+void
+statement_n::analyze(sema_t& sema) const
+{
+  if (!stack_space_t::has_space()) {
+    if (!stack_space_t::run_on_new_stack([&]() { this->analyze(sema); })) {
+      sema.error(stack_space_t::get_error());
+    }
+    return;
+  }
+  sema.count_node();
+  switch (this->m_statement_type) {
+    case statement_n::LABELED_STATEMENT: {
+      dynamic_cast<labeled_statement_n*>(this->m_generic_statement)->analyze(sema);
+      return;
+    }
+    case statement_n::COMPOUND_STATEMENT: {
+      dynamic_cast<compound_statement_n*>(this->m_generic_statement)->analyze(sema);
+      return;
+    }
+    case statement_n::EXPRESSION: {
+      dynamic_cast<expression_n*>(this->m_generic_statement)->analyze(sema);
+      return;
+    }
+    case statement_n::SELECTION_STATEMENT: {
+      dynamic_cast<selection_statement_n*>(this->m_generic_statement)->analyze(sema);
+      return;
+    }
+    case statement_n::ITERATION_STATEMENT: {
+      dynamic_cast<iteration_statement_n*>(this->m_generic_statement)->analyze(sema);
+      return;
+    }
+    case statement_n::JUMP_STATEMENT: {
+      dynamic_cast<jump_statement_n*>(this->m_generic_statement)->analyze(sema);
+      return;
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+void
+block_item_n::analyze(sema_t& sema) const
+{
+  sema.count_node();
+  if (this->m_declaration) {
+    this->m_declaration->analyze(sema);
+    return;
+  }
+  if (this->m_fp_pragma) {
+    return;
+  }
+  assert(this->m_statement);
+  this->m_statement->analyze(sema);
+}
+
+void
+compound_statement_n::analyze(sema_t& sema) const
+{
+  sema.count_node();
+  sema.push_scope();
+  for (auto const& block_item : this->get_list()) {
+    block_item->analyze(sema);
+  }
+  sema.pop_scope();
+}
+
+void
+declaration_n::analyze(sema_t& sema) const
+{
+  sema.count_node();
+  string error;
+  c_type_t const* base_type = this->m_declaration_specifiers->declaration_specifiers_get_c_type(&error);
+  if (base_type == nullptr) {
+    sema.error(error);
+    return;
+  }
+  if (this->m_init_declarator_list == nullptr) {
+    return;
+  }
+  for (auto const& init_declarator : this->m_init_declarator_list->get_list()) {
+    declarator_n const* declarator = init_declarator->get_declarator();
+    string const& name = declarator->get_identifier_name();
+    c_type_t const* c_type = declarator->get_c_type(base_type);
+    bool is_thread_local = this->m_declaration_specifiers->has_specifier(specifier_t::THREAD_LOCAL);
+    if (c_type->is_function() && is_thread_local) {
+      sema.error("_Thread_local on function " + name);
+      continue;
+    }
+    // a block scope variable of automatic storage cannot be per thread
+    if (is_thread_local && !sema.is_global_scope() &&
+        !this->m_declaration_specifiers->has_specifier(specifier_t::STATIC) &&
+        !this->m_declaration_specifiers->has_specifier(specifier_t::EXTERN)) {
+      sema.error("_Thread_local variable " + name + " in block scope is neither static nor extern");
+      continue;
+    }
+    if (!c_type->is_function()) {
+      if (this->m_declaration_specifiers->has_specifier(specifier_t::INLINE) ||
+          this->m_declaration_specifiers->has_specifier(specifier_t::NORETURN)) {
+        sema.error("function specifier on variable " + name);
+        continue;
+      }
+      if (c_type->is_void()) {
+        sema.error("variable " + name + " has incomplete type void");
+        continue;
+      }
+    }
+    sema.declare(declarator->get_identifier(), c_type);
+  }
+}
+
+void
+function_definition_n::analyze(sema_t& sema) const
+{
+  sema.count_node();
+  string error;
+  c_type_t const* base_type = this->m_declaration_specifiers->declaration_specifiers_get_c_type(&error);
+  if (base_type == nullptr) {
+    sema.error(error);
+    return;
+  }
+  c_type_t const* c_type = this->m_declarator->get_c_type(base_type);
+  string const& name = this->m_declarator->get_identifier_name();
+  if (!c_type->is_function()) {
+    sema.error(name + " is defined like a function but is not declared as one");
+    return;
+  }
+  if (this->m_declaration_specifiers->has_specifier(specifier_t::THREAD_LOCAL)) {
+    sema.error("_Thread_local on function " + name);
+    return;
+  }
+  sema.declare(this->m_declarator->get_identifier(), c_type);
+  if (!sema.get_analyzes_bodies()) {
+    return;
+  }
+  compound_statement_n const* body = this->get_compound_statement();
+  if (body == nullptr) {
+    string msg;
+    source_range_t range;
+    if (this->get_body_syntax_error(msg, range)) {
+      // like the syntax errors of the parse of the unit
+      sema.error(range, msg);
+    }
+    else {
+      sema.error("the body of " + name + " does not parse");
+    }
+    return;
+  }
+  sema.set_cur_function(this, c_type);
+  sema.push_scope();
+  vector<parameter_declaration_n*> const& params = this->m_declarator->get_parameter_list()->get_list();
+  for (size_t i = 0;i < c_type->get_param_types().size();i++) {
+    if (params[i]->get_declarator() != nullptr) {
+      sema.declare(params[i]->get_declarator()->get_identifier(), c_type->get_param_types()[i]);
+    }
+  }
+  body->analyze(sema);
+  sema.pop_scope();
+  sema.set_cur_function(nullptr, nullptr);
+}
+
+void
+external_declaration_n::analyze(sema_t& sema) const
+{
+  sema.count_node();
+  if (this->m_function_definition) {
+    this->m_function_definition->analyze(sema);
+    return;
+  }
+  if (this->m_fp_pragma) {
+    return;
+  }
+  assert(this->m_declaration);
+  this->m_declaration->analyze(sema);
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ast.h"
+#include "c_type.h"
+#include "diagnostics.h"
+#include "string_pool.h"
+#include "symbol_table.h"
+
+using namespace std;
+
+// What semantic analysis found out about one expression
+struct expr_info_t
+{
+  enum value_category_t
+  {
+    RVALUE,
+    LVALUE,
+    // a function name, its value is a pointer to the function
+    FUNCTION_DESIGNATOR,
+  };
+
+  // type of the value, function designators have already decayed to pointers
+  c_type_t const* c_type;
+  value_category_t category;
+  // implicit conversion the parent applies to the value (usual arithmetic
+  // conversions, integer promotions, assignment, argument passing), nullptr
+  // if the value is used as is
+  c_type_t const* converted_type;
+};
+
+// An identifier of the source and the type of what it names
+struct symbol_use_t
+{
+  identifier_n const* identifier;
+  c_type_t const* c_type;
+};
+
+// Resolves the identifiers and types every expression of a translation unit
+// in a single traversal. The results go in a dense side table indexed by
+// expression_n::get_id(), which codegen reads instead of recomputing types.
+class sema_t
+{
+public:
+  // Returns false, after printing the errors, if the unit is ill-typed
+  bool analyze(translation_unit_n const* translation_unit);
+  // Same a declaration at a time, as the parser hands them over:
+  // start_unit(), then analyze() with each declaration in order, then
+  // get_has_error()
+  void start_unit(translation_unit_n const* translation_unit);
+  // Same with global_scope holding the file scope declarations made so far,
+  // for analyzing a declaration in the middle of a unit on its own
+  void start_unit(symbol_table_t* global_scope);
+  void analyze(external_declaration_n const* external_declaration) { external_declaration->analyze(*this); }
+
+  expr_info_t const& get_info(expression_n const* e) const { return this->m_infos[e->get_id()]; }
+  c_type_t const* get_type(expression_n const* e) const { return this->get_info(e).c_type; }
+  // Type the parent uses the value of e as
+  c_type_t const* get_converted_type(expression_n const* e) const
+  {
+    expr_info_t const& info = this->get_info(e);
+    return info.converted_type ? info.converted_type : info.c_type;
+  }
+  // string literals of the unit, decoded and deduplicated
+  string_pool_t const& get_string_pool() const { return this->m_string_pool; }
+  // id in the pool of the value of e, a string literal
+  size_t get_string_id(expression_n const* e) const { return this->m_string_ids.at(e); }
+  // Order e stands for, a memory order argument of an atomic_*_explicit
+  // call
+  memory_order_t get_memory_order(expression_n const* e) const { return this->m_memory_orders.at(e); }
+  size_t get_num_expressions() const { return this->m_num_expressions; }
+  // Forgets the expressions and functions analyzed so far once codegen is
+  // done with them, so that their nodes can be freed. The ids of the
+  // expressions analyzed next start over from 0.
+  void release_declarations();
+  // every node visited, expressions included
+  size_t get_num_nodes() const { return this->m_num_nodes; }
+
+  // Where the errors go, located at the identifier sema resolved or
+  // declared last. By default a diagnostics_t of its own, which prints them.
+  void set_diagnostics(diagnostics_t* diagnostics) { this->m_diagnostics = diagnostics; }
+  diagnostics_t& get_diagnostics() const
+  {
+    return this->m_diagnostics ? *this->m_diagnostics : this->m_own_diagnostics;
+  }
+  // Makes sema remember each identifier it resolves or declares, for an
+  // editor to look them up
+  void set_records_symbols(bool records_symbols) { this->m_records_symbols = records_symbols; }
+  // With false, function definitions are checked like declarations and their
+  // bodies are left alone, unparsed if the parser skipped them
+  void set_analyzes_bodies(bool analyzes_bodies) { this->m_analyzes_bodies = analyzes_bodies; }
+  bool get_analyzes_bodies() const { return this->m_analyzes_bodies; }
+  // every declaration and use, in source order
+  vector<symbol_use_t> const& get_symbol_uses() const { return this->m_symbol_uses; }
+  // the declarations at file scope
+  vector<symbol_use_t> const& get_file_scope_symbols() const { return this->m_file_scope_symbols; }
+
+  // Used by the analyze() methods of the AST nodes
+  void error(string const& msg);
+  // An error at range rather than at the last identifier
+  void error(source_range_t const& range, string const& msg);
+  bool get_has_error() const { return this->m_has_error; }
+  void count_node() { this->m_num_nodes++; }
+  // Appends the entry of e to the side table, which gives e its id
+  void add_expression(expression_n const* e, expr_info_t const& info);
+  // Records that the value of e is converted to c_type, reports an error if
+  // it cannot be
+  void convert(expression_n const* e, c_type_t const* c_type);
+  // Decodes the string literal e and adds its value to the pool
+  void add_string_literal(expression_n const* e);
+  void set_memory_order(expression_n const* e, memory_order_t order) { this->m_memory_orders[e] = order; }
+  // Reports an error unless e can be tested against zero
+  void check_condition(expression_n const* e);
+
+  void push_scope();
+  void pop_scope();
+  bool is_global_scope() const { return this->m_scope == this->m_global_scope; }
+  void add_symbol(string const& name, c_type_t const* c_type) { this->m_scope->add_symbol(name, c_type); }
+  // Adds the symbol identifier declares, and records it if asked to
+  void declare(identifier_n const* identifier, c_type_t const* c_type);
+  // Records a use of identifier if asked to, c_type is nullptr if it is
+  // undeclared
+  void record_use(identifier_n const* identifier, c_type_t const* c_type)
+  {
+    this->m_last_identifier = identifier;
+    if (this->m_records_symbols && c_type != nullptr) {
+      this->m_symbol_uses.push_back({identifier, c_type});
+    }
+  }
+  c_type_t const* lookup_symbol(string const& name) const { return this->m_scope->lookup_symbol(name); }
+  // Whether name refers to a file scope declaration
+  bool is_global_symbol(string const& name) const;
+
+  // Called when the function being analyzed takes the address of one of
+  // its locals or parameters
+  void set_takes_local_address() { this->m_functions_taking_local_address.insert(this->m_cur_function); }
+  // Whether the body of function takes the address of one of its locals or
+  // parameters. The frame of such a function may be accessed by the
+  // functions it calls, so they cannot reuse it as a tail call does.
+  bool get_takes_local_address(function_definition_n const* function) const
+  {
+    return this->m_functions_taking_local_address.count(function) != 0;
+  }
+
+  // function whose body is being analyzed, nullptr for none
+  void set_cur_function(function_definition_n const* function, c_type_t const* c_type)
+  {
+    this->m_cur_function = function;
+    this->m_cur_function_type = c_type;
+  }
+  c_type_t const* get_cur_function_type() const { return this->m_cur_function_type; }
+  void push_switch(c_type_t const* cond_type) { this->m_switch_types.push_back(cond_type); }
+  void pop_switch() { this->m_switch_types.pop_back(); }
+  // promoted type of the controlling expression, nullptr outside a switch
+  c_type_t const* get_cur_switch_type() const
+  {
+    return this->m_switch_types.empty() ? nullptr : this->m_switch_types.back();
+  }
+private:
+  vector<expr_info_t> m_infos;
+  size_t m_num_expressions = 0;
+  string_pool_t m_string_pool;
+  unordered_map<expression_n const*, size_t> m_string_ids;
+  unordered_map<expression_n const*, memory_order_t> m_memory_orders;
+  diagnostics_t* m_diagnostics = nullptr;
+  mutable diagnostics_t m_own_diagnostics;
+  identifier_n const* m_last_identifier = nullptr;
+  bool m_records_symbols = false;
+  bool m_analyzes_bodies = true;
+  vector<symbol_use_t> m_symbol_uses;
+  vector<symbol_use_t> m_file_scope_symbols;
+  bool m_has_error = false;
+  size_t m_num_nodes = 0;
+  symbol_table_t* m_global_scope = nullptr;
+  symbol_table_t* m_scope = nullptr;
+  function_definition_n const* m_cur_function = nullptr;
+  c_type_t const* m_cur_function_type = nullptr;
+  unordered_set<function_definition_n const*> m_functions_taking_local_address;
+  vector<c_type_t const*> m_switch_types;
+};
@@ -0,0 +1,62 @@
+#include <pthread.h>
+
+#include "stack_space.h"
+
+using namespace std;
+
+// Room left for the frames between two checks, including whatever the LLVM
+// calls made while lowering a node need
+#define STACK_RED_ZONE (1 << 20)
+// Stack of each thread a walk continues on. Pages are only committed when
+// used, so this bounds the number of threads, not the memory.
+#define NEW_STACK_SIZE (64 << 20)
+
+// lowest address the walk may reach on this thread's stack
+static thread_local char const* stack_limit = nullptr;
+
+static char const*
+get_stack_limit()
+{
+  pthread_attr_t attr;
+  void* stack_addr;
+  size_t stack_size;
+  if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+    return nullptr;
+  }
+  pthread_attr_getstack(&attr, &stack_addr, &stack_size);
+  pthread_attr_destroy(&attr);
+  return (char const*)stack_addr + STACK_RED_ZONE;
+}
+
+// Stacks grow down on every target cc runs on
+bool
+stack_space_t::has_space()
+{
+  if (stack_limit == nullptr) {
+    stack_limit = get_stack_limit();
+  }
+  return (char const*)__builtin_frame_address(0) > stack_limit;
+}
+
+static void*
+run_fn(void* fn)
+{
+  (*(function<void()> const*)fn)();
+  return nullptr;
+}
+
+bool
+stack_space_t::run_on_new_stack(function<void()> const& fn)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, NEW_STACK_SIZE);
+  bool is_created = pthread_create(&thread, &attr, run_fn, (void*)&fn) == 0;
+  pthread_attr_destroy(&attr);
+  if (!is_created) {
+    return false;
+  }
+  pthread_join(thread, nullptr);
+  return true;
+}
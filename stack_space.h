@@ -0,0 +1,31 @@
+#pragma once
+
+#include <functional>
+
+using namespace std;
+
+// The passes walk the AST recursively, and generated code nests deep enough
+// (50000 term sums, 10000 deep if chains) to overflow the stack of the main
+// thread. Every recursive walk goes through a method that starts with
+//
+//   if (!stack_space_t::has_space()) {
+//     if (!stack_space_t::run_on_new_stack([&]() { ret = this->walk(...); })) {
+//       ...report stack_space_t::get_error(), ret stands for the subtree
+//     }
+//     return ret;
+//   }
+//
+// so that once the current stack is nearly used up the walk goes on below
+// that node on a new thread, with a fresh stack, while the caller waits.
+// Only one thread runs at a time and the depth is only bounded by memory.
+class stack_space_t
+{
+public:
+  // false once the stack of the calling thread is nearly used up
+  static bool has_space();
+  // Runs fn on a new thread and waits for it. False if the thread cannot be
+  // created, fn has not run then.
+  static bool run_on_new_stack(function<void()> const& fn);
+  // what to report when run_on_new_stack() fails
+  static char const* get_error() { return "out of stack space, the input nests too deeply"; }
+};
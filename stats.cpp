@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <cxxabi.h>
+
+#include <algorithm>
+
+#include "stats.h"
+
+using namespace std;
+
+map<string, uint64_t>&
+stats_t::get_counters()
+{
+  // counters are created during static initialization of other units too
+  static map<string, uint64_t> counters;
+  return counters;
+}
+
+uint64_t*
+stats_t::get_counter(string const& name)
+{
+  return &get_counters()[name];
+}
+
+string
+stats_t::demangle(char const* mangled_name)
+{
+  int status;
+  char* name = abi::__cxa_demangle(mangled_name, nullptr, nullptr, &status);
+  if (name == nullptr) {
+    return mangled_name;
+  }
+  string ret = name;
+  free(name);
+  return ret;
+}
+
+void
+stats_t::print_text(FILE* out)
+{
+  size_t width = 0;
+  for (auto const& counter : get_counters()) {
+    width = max(width, counter.first.size());
+  }
+  for (auto const& counter : get_counters()) {
+    fprintf(out, "%-*s %llu\n", (int)width, counter.first.c_str(), (unsigned long long)counter.second);
+  }
+}
+
+// Token names such as "';'" are the only ones with characters that need
+// escaping in a JSON string
+static string
+json_escape(string const& s)
+{
+  string ret;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      ret += '\\';
+    }
+    ret += c;
+  }
+  return ret;
+}
+
+void
+stats_t::print_json(FILE* out)
+{
+  fprintf(out, "{");
+  bool is_first = true;
+  for (auto const& counter : get_counters()) {
+    fprintf(out, "%s\n  \"%s\": %llu",
+            is_first ? "" : ",",
+            json_escape(counter.first).c_str(),
+            (unsigned long long)counter.second);
+    is_first = false;
+  }
+  fprintf(out, "\n}\n");
+}
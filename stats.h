@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+
+using namespace std;
+
+// Named counters incremented by the lexer, the parser, sema, codegen and the
+// driver, and printed by cc --stats. Names are dotted, the first component
+// being the phase ("lex.tokens.IDENTIFIER", "sema.symbols.lookups", ...).
+// Counting is not synchronized, only the compiling thread may count.
+// Build with -DNO_STATS to compile every counter out.
+class stats_t
+{
+public:
+  // The counter called name, created at 0 on first use. Its address never
+  // changes, so the STATS_ macros look it up once per call site.
+  static uint64_t* get_counter(string const& name);
+  // Name of a class as the source spells it, from typeid(...).name()
+  static string demangle(char const* mangled_name);
+  static void print_text(FILE* out);
+  static void print_json(FILE* out);
+private:
+  static map<string, uint64_t>& get_counters();
+};
+
+#ifdef NO_STATS
+#define STATS_ADD(name, n) do { } while (0)
+#define STATS_MAX(name, n) do { } while (0)
+#else
+#define STATS_ADD(name, n) do { \
+    static uint64_t* const stats_counter_ = stats_t::get_counter(name); \
+    *stats_counter_ += (n); \
+  } while (0)
+// Keeps the largest value seen
+#define STATS_MAX(name, n) do { \
+    static uint64_t* const stats_counter_ = stats_t::get_counter(name); \
+    uint64_t stats_value_ = (n); \
+    if (stats_value_ > *stats_counter_) { \
+      *stats_counter_ = stats_value_; \
+    } \
+  } while (0)
+#endif
+#define STATS_INC(name) STATS_ADD(name, 1)
@@ -0,0 +1,54 @@
+#include <algorithm>
+
+#include "stats.h"
+#include "string_pool.h"
+
+using namespace std;
+
+size_t
+string_pool_t::intern(string const& s)
+{
+  STATS_INC("strings.literals");
+  STATS_ADD("strings.literal_bytes", s.size() + 1);
+  this->m_num_literal_bytes += s.size() + 1;
+  auto it = this->m_ids.find(s);
+  if (it != this->m_ids.end()) {
+    return it->second;
+  }
+  STATS_INC("strings.distinct");
+  it = this->m_ids.emplace(s, this->m_values.size()).first;
+  this->m_values.push_back(&it->first);
+  return it->second;
+}
+
+// Sorting the values by their reversed text puts a value right before the
+// values it is a tail of, the longest of them ending the run. Walking the
+// order backwards then finds every owner in one pass.
+vector<string_pool_t::tail_t>
+string_pool_t::merge_tails(vector<size_t> const& ids) const
+{
+  vector<size_t> order(ids.size());
+  for (size_t i = 0;i < ids.size();i++) {
+    order[i] = i;
+  }
+  auto reversed_less = [&](size_t a, size_t b) {
+    string const& l = this->get(ids[a]);
+    string const& r = this->get(ids[b]);
+    return lexicographical_compare(l.rbegin(), l.rend(), r.rbegin(), r.rend());
+  };
+  sort(order.begin(), order.end(), reversed_less);
+
+  vector<tail_t> ret(ids.size());
+  for (size_t i = order.size();i-- > 0;) {
+    string const& s = this->get(ids[order[i]]);
+    size_t owner = ids[order[i]];
+    if (i + 1 < order.size()) {
+      string const& next = this->get(ids[order[i + 1]]);
+      if (next.size() > s.size() && equal(s.rbegin(), s.rend(), next.rbegin())) {
+        owner = ret[order[i + 1]].owner;
+      }
+    }
+    ret[order[i]] = {owner, this->get(owner).size() - s.size()};
+  }
+  return ret;
+}
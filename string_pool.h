@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// The distinct string literals of a translation unit, decoded. Sema interns
+// every literal, codegen emits a single global per id, and a literal that is
+// the tail of a longer one is emitted as a pointer into the longer one.
+class string_pool_t
+{
+public:
+  // Where the bytes of a literal live once tails are merged
+  struct tail_t
+  {
+    // id of the literal holding them, the literal itself if it is no tail
+    size_t owner;
+    // offset of the literal in its owner
+    size_t offset;
+  };
+
+  // Id of the literal whose value (without the terminating NUL) is s, equal
+  // values get the same id
+  size_t intern(string const& s);
+  string const& get(size_t id) const { return *this->m_values[id]; }
+  size_t size() const { return this->m_values.size(); }
+  // bytes of every literal interned, terminating NULs and duplicates included
+  size_t get_num_literal_bytes() const { return this->m_num_literal_bytes; }
+  // Owner and offset of each literal of ids, in the same order. Every owner
+  // is one of ids, and a literal only ever shares the end of its owner since
+  // both end with the terminating NUL.
+  vector<tail_t> merge_tails(vector<size_t> const& ids) const;
+private:
+  unordered_map<string, size_t> m_ids;
+  // keys of m_ids by id, they do not move when the map grows
+  vector<string const*> m_values;
+  size_t m_num_literal_bytes = 0;
+};
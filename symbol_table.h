@@ -3,14 +3,59 @@
 #include <map>
 
 #include "c_type.h"
+#include "stats.h"
 
 class symbol_table_t
 {
 public:
-  symbol_table_t() : m_prev_scope(nullptr) { }
-  symbol_table_t(symbol_table_t* prev_scope) : m_prev_scope(prev_scope) { }
+  symbol_table_t() : m_prev_scope(nullptr), m_lookup_scope(nullptr) { }
+  // Symbols are only added to the innermost scope, so prev_scope cannot
+  // change while this one exists and the empty scopes can be skipped once
+  // and for all. Lookups then cost the number of scopes with declarations,
+  // not the nesting depth.
+  symbol_table_t(symbol_table_t* prev_scope) :
+    m_prev_scope(prev_scope),
+    m_lookup_scope(prev_scope->m_table.empty() ? prev_scope->m_lookup_scope : prev_scope)
+  { }
+
+  void add_symbol(string const& name, c_type_t const* c_type)
+  {
+    STATS_INC("sema.symbols.inserts");
+    this->m_table[name] = c_type;
+  }
+  // Looks name up in this scope and then in the enclosing ones, nullptr if
+  // it is not declared. The scopes searched are counted as probes.
+  c_type_t const* lookup_symbol(string const& name) const
+  {
+    STATS_INC("sema.symbols.lookups");
+    uint64_t num_probes = 0;
+    c_type_t const* ret = nullptr;
+    for (symbol_table_t const* scope = this;scope != nullptr && ret == nullptr;scope = scope->m_lookup_scope) {
+      num_probes++;
+      auto sym = scope->m_table.find(name);
+      if (sym != scope->m_table.end()) {
+        ret = sym->second;
+      }
+    }
+    STATS_ADD("sema.symbols.probes", num_probes);
+    STATS_MAX("sema.symbols.max_probes", num_probes);
+    return ret;
+  }
+  // Scope that declares name, this one or an enclosing one, nullptr if it
+  // is not declared
+  symbol_table_t const* lookup_declaring_scope(string const& name) const
+  {
+    for (symbol_table_t const* scope = this;scope != nullptr;scope = scope->m_lookup_scope) {
+      if (scope->m_table.count(name) != 0) {
+        return scope;
+      }
+    }
+    return nullptr;
+  }
+  symbol_table_t* get_prev_scope() const { return this->m_prev_scope; }
 private:
-  map<string, c_type_t*> m_table;
+  map<string, c_type_t const*> m_table;
   symbol_table_t* m_prev_scope;
+  // innermost enclosing scope with symbols
+  symbol_table_t const* m_lookup_scope;
 };
-
@@ -0,0 +1,299 @@
+#include "ast.h"
+#include "common.h"
+#include "stack_space.h"
+#include "tail_recursion.h"
+
+tail_recursion_t::tail_recursion_t(function_definition_n const* function,
+                                   c_type_t const* function_type,
+                                   bool takes_local_address) :
+  m_name(function->get_declarator()->get_identifier_name()),
+  m_function_type(function_type),
+  m_takes_local_address(takes_local_address)
+{
+  vector<parameter_declaration_n*> const& params =
+    function->get_declarator()->get_parameter_list()->get_list();
+  for (size_t i = 0;i < function_type->get_param_types().size();i++) {
+    if (params[i]->get_declarator() == nullptr) {
+      this->m_has_unnamed_param = true;
+      continue;
+    }
+    this->m_params[params[i]->get_declarator()->get_identifier_name()] =
+      function_type->get_param_types()[i];
+  }
+  function->get_compound_statement()->find_tail_calls(*this, true);
+  this->classify();
+}
+
+void
+tail_recursion_t::add_tail_statement(ast_n const* stmt, expression_n const* expr)
+{
+  this->m_tail_statements.push_back({stmt, expr});
+}
+
+void
+tail_recursion_t::add_declaration(declaration_n const* declaration)
+{
+  if (declaration->get_init_declarator_list() == nullptr) {
+    return;
+  }
+  for (auto const& init_declarator : declaration->get_init_declarator_list()->get_list()) {
+    this->m_declared_names.insert(init_declarator->get_declarator()->get_identifier_name());
+  }
+}
+
+tail_recursion_t::tail_call_t
+tail_recursion_t::get_tail_call(ast_n const* stmt) const
+{
+  auto it = this->m_tail_calls.find(stmt);
+  if (it == this->m_tail_calls.end()) {
+    return {NOT_TAIL_RECURSIVE, nullptr, nullptr};
+  }
+  return it->second;
+}
+
+long long
+tail_recursion_t::get_accumulator_identity(expression_n::operation_kind_t op)
+{
+  switch (op) {
+    case expression_n::OP_ADD:
+    case expression_n::OP_BIT_OR:
+    case expression_n::OP_XOR: return 0;
+    case expression_n::OP_MUL: return 1;
+    case expression_n::OP_BIT_AND: return -1;
+    default: NOT_REACHED();
+  }
+  return 0;
+}
+
+char const*
+tail_recursion_t::accumulator_op_to_string(expression_n::operation_kind_t op)
+{
+  switch (op) {
+    case expression_n::OP_ADD: return "+";
+    case expression_n::OP_BIT_OR: return "|";
+    case expression_n::OP_XOR: return "^";
+    case expression_n::OP_MUL: return "*";
+    case expression_n::OP_BIT_AND: return "&";
+    default: NOT_REACHED();
+  }
+  return "";
+}
+
+bool
+tail_recursion_t::is_self_call(expression_n const* e) const
+{
+  return e->get_kind() == expression_n::OP_FUNC_CALL &&
+         e->get_child(0)->is_var() &&
+         e->get_child(0)->get_identifier()->get_identifier_name() == this->m_name &&
+         this->m_declared_names.count(this->m_name) == 0 &&
+         e->get_child(1)->get_size() == this->m_function_type->get_param_types().size();
+}
+
+// The accumulator has the return type, so x must be an integer for the
+// wrapping arithmetic on it to give the same result. Only the types of the
+// parameters are known at this point.
+bool
+tail_recursion_t::is_accumulator_operand(expression_n const* e) const
+{
+  if (!stack_space_t::has_space()) {
+    bool ret;
+    if (!stack_space_t::run_on_new_stack([&]() { ret = this->is_accumulator_operand(e); })) {
+      ret = false;
+    }
+    return ret;
+  }
+  switch (e->get_kind()) {
+    case expression_n::OP_CONST: {
+      return e->get_constant()->get_sort() == constant_n::INTEGER_CONST;
+    }
+    case expression_n::OP_VAR: {
+      string const& name = e->get_identifier()->get_identifier_name();
+      auto param = this->m_params.find(name);
+      return param != this->m_params.end() &&
+             param->second->is_integer() &&
+             this->m_declared_names.count(name) == 0;
+    }
+    case expression_n::OP_POS:
+    case expression_n::OP_NEG:
+    case expression_n::OP_COMPLEMENT:
+    case expression_n::OP_LOGIC_NOT:
+    case expression_n::OP_MUL:
+    case expression_n::OP_DIV:
+    case expression_n::OP_MOD:
+    case expression_n::OP_ADD:
+    case expression_n::OP_SUB:
+    case expression_n::OP_LSHIFT:
+    case expression_n::OP_RSHIFT:
+    case expression_n::OP_LT:
+    case expression_n::OP_GT:
+    case expression_n::OP_LTE:
+    case expression_n::OP_GTE:
+    case expression_n::OP_EQ:
+    case expression_n::OP_NEQ:
+    case expression_n::OP_BIT_AND:
+    case expression_n::OP_BIT_OR:
+    case expression_n::OP_XOR: {
+      for (auto const& child : e->get_list()) {
+        if (!this->is_accumulator_operand(child)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+// With no local address taken, nothing can see the parameter and local
+// slots of an iteration once the next one starts, so it can reuse them.
+void
+tail_recursion_t::classify()
+{
+  if (this->m_function_type->get_is_vararg() || this->m_has_unnamed_param || this->m_takes_local_address ||
+      this->m_is_incomplete) {
+    return;
+  }
+  c_type_t const* ret_type = this->m_function_type->get_return_type();
+  bool can_accumulate = ret_type->is_integer() && ret_type->get_base_type() != c_type_t::BOOL;
+  for (auto const& tail_statement : this->m_tail_statements) {
+    expression_n const* e = tail_statement.second;
+    bool is_expression_statement = tail_statement.first == e;
+    if (is_expression_statement && !ret_type->is_void()) {
+      continue;
+    }
+    if (this->is_self_call(e)) {
+      this->m_tail_calls[tail_statement.first] = {TAIL_RECURSIVE_CALL, e, nullptr};
+      this->m_num_eliminated++;
+      continue;
+    }
+    switch (e->get_kind()) {
+      case expression_n::OP_ADD:
+      case expression_n::OP_MUL:
+      case expression_n::OP_BIT_AND:
+      case expression_n::OP_BIT_OR:
+      case expression_n::OP_XOR: {
+        break;
+      }
+      default: {
+        continue;
+      }
+    }
+    if (!can_accumulate ||
+        (this->m_accumulator_op != expression_n::OP_EMPTY && this->m_accumulator_op != e->get_kind())) {
+      continue;
+    }
+    for (size_t i = 0;i < 2;i++) {
+      if (this->is_self_call(e->get_child(i)) && this->is_accumulator_operand(e->get_child(1 - i))) {
+        this->m_tail_calls[tail_statement.first] =
+          {ACCUMULATED_RECURSIVE_CALL, e->get_child(i), e->get_child(1 - i)};
+        this->m_accumulator_op = e->get_kind();
+        this->m_num_eliminated++;
+        break;
+      }
+    }
+  }
+}
+
+void
+compound_statement_n::find_tail_calls(tail_recursion_t& tre, bool is_tail) const
+{
+  vector<block_item_n*> const& items = this->get_list();
+  for (size_t i = 0;i < items.size();i++) {
+    // "f(args); return;" is a tail call too
+    bool is_item_tail = i + 1 == items.size() ? is_tail :
+                        items[i + 1]->get_statement() != nullptr &&
+                        items[i + 1]->get_statement()->is_return_without_value();
+    items[i]->find_tail_calls(tre, is_item_tail);
+  }
+}
+
+void
+block_item_n::find_tail_calls(tail_recursion_t& tre, bool is_tail) const
+{
+  if (this->m_declaration) {
+    tre.add_declaration(this->m_declaration);
+    return;
+  }
+  if (this->m_fp_pragma) {
+    return;
+  }
+  this->m_statement->find_tail_calls(tre, is_tail);
+}
+
+void
+statement_n::find_tail_calls(tail_recursion_t& tre, bool is_tail) const
+{
+  if (!stack_space_t::has_space()) {
+    if (!stack_space_t::run_on_new_stack([&]() { this->find_tail_calls(tre, is_tail); })) {
+      tre.set_is_incomplete();
+    }
+    return;
+  }
+  switch (this->m_statement_type) {
+    case statement_n::LABELED_STATEMENT: {
+      dynamic_cast<labeled_statement_n*>(this->m_generic_statement)->find_tail_calls(tre);
+      return;
+    }
+    case statement_n::COMPOUND_STATEMENT: {
+      dynamic_cast<compound_statement_n*>(this->m_generic_statement)->find_tail_calls(tre, is_tail);
+      return;
+    }
+    case statement_n::EXPRESSION: {
+      expression_n* expression = dynamic_cast<expression_n*>(this->m_generic_statement);
+      if (is_tail && expression->get_kind() == expression_n::OP_FUNC_CALL) {
+        tre.add_tail_statement(expression, expression);
+      }
+      return;
+    }
+    case statement_n::SELECTION_STATEMENT: {
+      dynamic_cast<selection_statement_n*>(this->m_generic_statement)->find_tail_calls(tre, is_tail);
+      return;
+    }
+    case statement_n::ITERATION_STATEMENT: {
+      dynamic_cast<iteration_statement_n*>(this->m_generic_statement)->find_tail_calls(tre);
+      return;
+    }
+    case statement_n::JUMP_STATEMENT: {
+      jump_statement_n* jump_statement = dynamic_cast<jump_statement_n*>(this->m_generic_statement);
+      if (jump_statement->get_jump_sort() == jump_statement_n::RETURN &&
+          jump_statement->get_expr_for_return() != nullptr) {
+        tre.add_tail_statement(jump_statement, jump_statement->get_expr_for_return());
+      }
+      return;
+    }
+    default: {
+      NOT_REACHED();
+    }
+  }
+}
+
+void
+selection_statement_n::find_tail_calls(tail_recursion_t& tre, bool is_tail) const
+{
+  // control may fall through from a case to the next one
+  if (this->get_selection_sort() == selection_statement_n::SWITCH) {
+    this->get_body()->find_tail_calls(tre, false);
+    return;
+  }
+  this->get_body()->find_tail_calls(tre, is_tail);
+  if (this->get_selection_sort() == selection_statement_n::IF_THEN_ELSE) {
+    this->get_else_body()->find_tail_calls(tre, is_tail);
+  }
+}
+
+void
+iteration_statement_n::find_tail_calls(tail_recursion_t& tre) const
+{
+  if (this->get_iteration_sort() == iteration_statement_n::FOR_DECL) {
+    tre.add_declaration(this->get_init_decl());
+  }
+  this->get_body()->find_tail_calls(tre, false);
+}
+
+void
+labeled_statement_n::find_tail_calls(tail_recursion_t& tre) const
+{
+  this->get_body()->find_tail_calls(tre, false);
+}
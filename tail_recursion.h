@@ -0,0 +1,77 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "c_type.h"
+
+using namespace std;
+
+// Front-end pass run over a function body before it is lowered. It finds the
+// calls of the function to itself that are in tail position:
+//   return f(args);            (or "f(args);" ending a void function)
+//   return x op f(args);       op in + * & | ^, x an integer expression of
+//                              the parameters and constants
+// llvm_codegen turns them into a branch back to the top of the body. The
+// second form keeps the pending "x op" in an accumulator which is applied to
+// the value of every other return of the function.
+class tail_recursion_t
+{
+public:
+  enum tail_call_kind_t
+  {
+    NOT_TAIL_RECURSIVE,
+    TAIL_RECURSIVE_CALL,
+    ACCUMULATED_RECURSIVE_CALL,
+  };
+  struct tail_call_t
+  {
+    tail_call_kind_t kind;
+    expression_n const* call;
+    // x in "x op f(args)"
+    expression_n const* operand;
+  };
+
+  // Nothing is eliminated in a function that takes the address of a local,
+  // whose slots may still be in use when the next iteration reuses them
+  tail_recursion_t(function_definition_n const* function,
+                   c_type_t const* function_type,
+                   bool takes_local_address);
+
+  // Called by the find_tail_calls() walk. stmt is a return statement, or an
+  // expression statement in tail position of a void function.
+  void add_tail_statement(ast_n const* stmt, expression_n const* expr);
+  void add_declaration(declaration_n const* declaration);
+  // Called when part of the body could not be walked, which may hide what
+  // rules out a call. Nothing is eliminated then.
+  void set_is_incomplete() { this->m_is_incomplete = true; }
+
+  bool is_eliminable() const { return this->m_num_eliminated > 0; }
+  size_t get_num_eliminated() const { return this->m_num_eliminated; }
+  // OP_EMPTY if no return needs an accumulator
+  expression_n::operation_kind_t get_accumulator_op() const { return this->m_accumulator_op; }
+  tail_call_t get_tail_call(ast_n const* stmt) const;
+
+  // Value x such that x op y == y
+  static long long get_accumulator_identity(expression_n::operation_kind_t op);
+  static char const* accumulator_op_to_string(expression_n::operation_kind_t op);
+private:
+  bool is_self_call(expression_n const* e) const;
+  bool is_accumulator_operand(expression_n const* e) const;
+  void classify();
+
+  string m_name;
+  c_type_t const* m_function_type;
+  map<string, c_type_t const*> m_params;
+  bool m_has_unnamed_param = false;
+  bool m_takes_local_address;
+  bool m_is_incomplete = false;
+  set<string> m_declared_names;
+  vector<pair<ast_n const*, expression_n const*>> m_tail_statements;
+  map<ast_n const*, tail_call_t> m_tail_calls;
+  expression_n::operation_kind_t m_accumulator_op = expression_n::OP_EMPTY;
+  size_t m_num_eliminated = 0;
+};
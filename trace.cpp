@@ -0,0 +1,211 @@
+#include <stdarg.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace.h"
+
+using namespace std;
+
+atomic<unsigned> trace_t::s_enabled[TRACE_VERBOSE + 1];
+
+namespace {
+
+struct trace_record_t
+{
+  uint64_t time_ns;
+  trace_category_t category;
+  trace_level_t level;
+  char text[240];
+};
+
+// Written by one thread and read by the writer thread. head and tail only
+// grow, the record of index i lives in records[i % NUM_RECORDS].
+struct trace_ring_t
+{
+  static size_t const NUM_RECORDS = 1024;
+
+  trace_record_t records[NUM_RECORDS];
+  atomic<size_t> head{0};
+  atomic<size_t> tail{0};
+  atomic<uint64_t> num_dropped{0};
+  size_t thread_index;
+};
+
+struct trace_writer_t
+{
+  mutex m;
+  condition_variable cv;
+  // rings of every thread that has traced, they live as long as the process
+  vector<unique_ptr<trace_ring_t>> rings;
+  FILE* out = nullptr;
+  thread writer;
+  bool is_stopping = false;
+  chrono::steady_clock::time_point start;
+
+  // Writes the records of every ring, with m held
+  void drain()
+  {
+    for (auto& ring : this->rings) {
+      size_t tail = ring->tail.load(memory_order_relaxed);
+      size_t head = ring->head.load(memory_order_acquire);
+      for (;tail < head;tail++) {
+        trace_record_t const& record = ring->records[tail % trace_ring_t::NUM_RECORDS];
+        fprintf(this->out, "[%12.3f ms] #%zu %s.%s: %s\n",
+                record.time_ns / 1e6, ring->thread_index, category_to_string(record.category),
+                level_to_string(record.level), record.text);
+      }
+      ring->tail.store(tail, memory_order_release);
+    }
+    fflush(this->out);
+  }
+
+  static char const* category_to_string(trace_category_t category)
+  {
+    switch (category) {
+      case TRACE_LEXER: return "lexer";
+      case TRACE_PARSER: return "parser";
+      case TRACE_TYPES: return "types";
+      case TRACE_CODEGEN: return "codegen";
+    }
+    return "?";
+  }
+
+  static char const* level_to_string(trace_level_t level)
+  {
+    switch (level) {
+      case TRACE_INFO: return "info";
+      case TRACE_DEBUG: return "debug";
+      case TRACE_VERBOSE: return "verbose";
+    }
+    return "?";
+  }
+};
+
+trace_writer_t&
+get_writer()
+{
+  static trace_writer_t writer;
+  return writer;
+}
+
+thread_local trace_ring_t* thread_ring = nullptr;
+
+}
+
+bool
+trace_t::parse_spec(string const& spec, unsigned& categories, unsigned& level)
+{
+  static pair<char const*, unsigned> const names[] = {
+    {"lexer", TRACE_LEXER},
+    {"parser", TRACE_PARSER},
+    {"types", TRACE_TYPES},
+    {"codegen", TRACE_CODEGEN},
+    {"all", TRACE_LEXER | TRACE_PARSER | TRACE_TYPES | TRACE_CODEGEN},
+  };
+  size_t colon = spec.find(':');
+  level = TRACE_DEBUG;
+  if (colon != string::npos) {
+    string level_spec = spec.substr(colon + 1);
+    if (level_spec.size() != 1 || level_spec[0] < '1' || level_spec[0] > '0' + TRACE_VERBOSE) {
+      return false;
+    }
+    level = level_spec[0] - '0';
+  }
+  categories = 0;
+  string list = spec.substr(0, colon);
+  for (size_t begin = 0;begin <= list.size();) {
+    size_t end = list.find(',', begin);
+    if (end == string::npos) {
+      end = list.size();
+    }
+    string name = list.substr(begin, end - begin);
+    bool is_known = false;
+    for (auto const& n : names) {
+      if (name == n.first) {
+        categories |= n.second;
+        is_known = true;
+      }
+    }
+    if (!is_known) {
+      return false;
+    }
+    begin = end + 1;
+  }
+  return true;
+}
+
+void
+trace_t::start(unsigned categories, unsigned level, FILE* out)
+{
+  trace_writer_t& w = get_writer();
+  w.out = out;
+  w.start = chrono::steady_clock::now();
+  w.writer = thread([&w]() {
+    unique_lock<mutex> lock(w.m);
+    while (!w.is_stopping) {
+      w.cv.wait_for(lock, chrono::milliseconds(10));
+      w.drain();
+    }
+  });
+  for (unsigned l = TRACE_INFO;l <= level;l++) {
+    s_enabled[l].store(categories, memory_order_relaxed);
+  }
+}
+
+void
+trace_t::stop()
+{
+  for (auto& enabled : s_enabled) {
+    enabled.store(0, memory_order_relaxed);
+  }
+  trace_writer_t& w = get_writer();
+  if (!w.writer.joinable()) {
+    return;
+  }
+  {
+    lock_guard<mutex> lock(w.m);
+    w.is_stopping = true;
+  }
+  w.cv.notify_all();
+  w.writer.join();
+  w.drain();
+  for (auto& ring : w.rings) {
+    if (ring->num_dropped != 0) {
+      fprintf(w.out, "trace: thread #%zu dropped %llu records\n",
+              ring->thread_index, (unsigned long long)ring->num_dropped.load());
+    }
+  }
+}
+
+void
+trace_t::write(trace_category_t category, trace_level_t level, char const* format, ...)
+{
+  trace_writer_t& w = get_writer();
+  if (thread_ring == nullptr) {
+    lock_guard<mutex> lock(w.m);
+    w.rings.push_back(make_unique<trace_ring_t>());
+    thread_ring = w.rings.back().get();
+    thread_ring->thread_index = w.rings.size() - 1;
+  }
+  trace_ring_t& ring = *thread_ring;
+  size_t head = ring.head.load(memory_order_relaxed);
+  if (head - ring.tail.load(memory_order_acquire) == trace_ring_t::NUM_RECORDS) {
+    ring.num_dropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  trace_record_t& record = ring.records[head % trace_ring_t::NUM_RECORDS];
+  record.time_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - w.start).count();
+  record.category = category;
+  record.level = level;
+  va_list args;
+  va_start(args, format);
+  vsnprintf(record.text, sizeof(record.text), format, args);
+  va_end(args);
+  ring.head.store(head + 1, memory_order_release);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+
+using namespace std;
+
+// Tracing for working on the compiler itself. A trace point
+//
+//   TRACE(TRACE_CODEGEN, TRACE_DEBUG, "function %s", name.c_str());
+//
+// only evaluates its arguments and formats its message when cc runs with a
+// --trace that turns its category on at its level, otherwise it costs a load
+// and a branch. Levels above TRACE_MAX_LEVEL and categories left out of
+// TRACE_CATEGORIES are compiled out, -DTRACE_MAX_LEVEL=0 removes them all.
+//
+// Every thread writes its records to a ring buffer of its own, without locks
+// or system calls, and a background thread writes them out. A thread that
+// fills its ring faster than that drops records, the number is reported.
+enum trace_category_t
+{
+  TRACE_LEXER = 1 << 0,
+  TRACE_PARSER = 1 << 1,
+  TRACE_TYPES = 1 << 2,
+  TRACE_CODEGEN = 1 << 3,
+};
+
+enum trace_level_t
+{
+  TRACE_INFO = 1,
+  TRACE_DEBUG = 2,
+  // a record per token
+  TRACE_VERBOSE = 3,
+};
+
+#ifndef TRACE_MAX_LEVEL
+#define TRACE_MAX_LEVEL TRACE_VERBOSE
+#endif
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES (TRACE_LEXER | TRACE_PARSER | TRACE_TYPES | TRACE_CODEGEN)
+#endif
+
+#define TRACE(category, level, ...) do { \
+    if (((TRACE_CATEGORIES) & (category)) != 0 && (level) <= (TRACE_MAX_LEVEL) && \
+        trace_t::is_enabled(category, level)) { \
+      trace_t::write(category, level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+class trace_t
+{
+public:
+  // Reads a --trace value, "<category>[,<category>]...[:<level>]" with
+  // categories lexer, parser, types, codegen or all and a level from 1 to 3,
+  // 2 if left out. Returns false if it is malformed.
+  static bool parse_spec(string const& spec, unsigned& categories, unsigned& level);
+  // Turns categories on up to level and starts writing the records to out
+  static void start(unsigned categories, unsigned level, FILE* out);
+  // Turns everything off and writes the records left
+  static void stop();
+  static bool is_enabled(trace_category_t category, trace_level_t level)
+  {
+    return (s_enabled[level].load(memory_order_relaxed) & category) != 0;
+  }
+  static void write(trace_category_t category, trace_level_t level, char const* format, ...)
+    __attribute__((format(printf, 3, 4)));
+private:
+  // categories on, by level
+  static atomic<unsigned> s_enabled[TRACE_VERBOSE + 1];
+};